@@ -0,0 +1,173 @@
+#pragma once
+
+#include <windows.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+// Default cache file, next to the executable.
+#define CALIBRATION_CACHE_FILE		"encoderCalibration.ini"
+
+// Default encode latency budget of a calibration, in milliseconds.
+#define CALIBRATION_LATENCY_BUDGET_MS	8.0
+
+namespace Toolkit3DLibrary
+{
+	// Measurements taken for a single candidate.
+	typedef struct _CalibrationResult
+	{
+		char encoderPreset[32];
+		int rcMode;
+		int bitrate;
+		double encodeFps;
+		double averageLatencyMs;
+		double maxLatencyMs;
+		double averageFrameBytes;
+		bool withinBudget;
+	} CalibrationResult;
+
+	// INI cache of the encoder calibration, one section per host name,
+	// resolution, frame rate, bitrate and latency budget. Header only and
+	// free of NvEnc dependencies, so that the streaming plugin reads the same
+	// entries EncoderCalibrator writes.
+	class EncoderCalibrationCache
+	{
+	public:
+		static const int						kDefaultRcMode = 0x8;	// NV_ENC_PARAMS_RC_CBR_LOWDELAY_HQ
+
+		static bool								Load(
+													const char* cacheFileName,
+													int width,
+													int height,
+													int fps,
+													int bitrate,
+													double latencyBudgetMs,
+													CalibrationResult* result)
+		{
+			char path[MAX_PATH];
+			char section[MAX_PATH];
+			char value[64];
+
+			GetPath(cacheFileName, path, sizeof(path));
+			GetSection(width, height, fps, bitrate, latencyBudgetMs, section, sizeof(section));
+
+			// The preset is mandatory, everything else falls back to defaults.
+			if (GetPrivateProfileStringA(section, "encoderPreset", "", value, sizeof(value), path) == 0)
+			{
+				return false;
+			}
+
+			memset(result, 0, sizeof(CalibrationResult));
+			strncpy(result->encoderPreset, value, sizeof(result->encoderPreset) - 1);
+			result->rcMode = GetPrivateProfileIntA(section, "rcMode", kDefaultRcMode, path);
+			result->bitrate = GetPrivateProfileIntA(section, "bitrate", 0, path);
+			result->withinBudget = GetPrivateProfileIntA(section, "withinBudget", 0, path) != 0;
+
+			GetPrivateProfileStringA(section, "encodeFps", "0", value, sizeof(value), path);
+			result->encodeFps = atof(value);
+			GetPrivateProfileStringA(section, "averageLatencyMs", "0", value, sizeof(value), path);
+			result->averageLatencyMs = atof(value);
+			GetPrivateProfileStringA(section, "maxLatencyMs", "0", value, sizeof(value), path);
+			result->maxLatencyMs = atof(value);
+			GetPrivateProfileStringA(section, "averageFrameBytes", "0", value, sizeof(value), path);
+			result->averageFrameBytes = atof(value);
+
+			return true;
+		}
+
+		// Replaces the entry of these settings on this host, |measurements|
+		// are kept for reference.
+		static void								Save(
+													const char* cacheFileName,
+													int width,
+													int height,
+													int fps,
+													int bitrate,
+													double latencyBudgetMs,
+													const CalibrationResult* result,
+													const CalibrationResult* measurements,
+													int measurementCount)
+		{
+			char path[MAX_PATH];
+			char section[MAX_PATH];
+			char value[256];
+
+			GetPath(cacheFileName, path, sizeof(path));
+			GetSection(width, height, fps, bitrate, latencyBudgetMs, section, sizeof(section));
+
+			// Clears any previous calibration of these settings.
+			WritePrivateProfileStringA(section, nullptr, nullptr, path);
+
+			WritePrivateProfileStringA(section, "encoderPreset", result->encoderPreset, path);
+			WritePrivateProfileStringA(section, "rcMode", std::to_string(result->rcMode).c_str(), path);
+			WritePrivateProfileStringA(section, "bitrate", std::to_string(result->bitrate).c_str(), path);
+			WritePrivateProfileStringA(section, "withinBudget", result->withinBudget ? "1" : "0", path);
+
+			sprintf(value, "%.2f", result->encodeFps);
+			WritePrivateProfileStringA(section, "encodeFps", value, path);
+			sprintf(value, "%.3f", result->averageLatencyMs);
+			WritePrivateProfileStringA(section, "averageLatencyMs", value, path);
+			sprintf(value, "%.3f", result->maxLatencyMs);
+			WritePrivateProfileStringA(section, "maxLatencyMs", value, path);
+			sprintf(value, "%.0f", result->averageFrameBytes);
+			WritePrivateProfileStringA(section, "averageFrameBytes", value, path);
+
+			// Keeps every measurement for reference as:
+			// preset,rcMode,fps,averageLatencyMs,maxLatencyMs,averageFrameBytes
+			for (int i = 0; i < measurementCount; i++)
+			{
+				const CalibrationResult* measurement = &measurements[i];
+				std::string key = "candidate" + std::to_string(i);
+				sprintf(value, "%s,%d,%.2f,%.3f,%.3f,%.0f",
+					measurement->encoderPreset,
+					measurement->rcMode,
+					measurement->encodeFps,
+					measurement->averageLatencyMs,
+					measurement->maxLatencyMs,
+					measurement->averageFrameBytes);
+
+				WritePrivateProfileStringA(section, key.c_str(), value, path);
+			}
+		}
+
+		// A preset chosen for a frame rate, bitrate or budget doesn't hold
+		// for another, each combination has its own section.
+		static void								GetSection(
+													int width,
+													int height,
+													int fps,
+													int bitrate,
+													double latencyBudgetMs,
+													char* section,
+													size_t size)
+		{
+			char hostName[MAX_COMPUTERNAME_LENGTH + 1] = { 0 };
+			DWORD hostNameSize = sizeof(hostName);
+			if (!GetComputerNameA(hostName, &hostNameSize))
+			{
+				strcpy(hostName, "localhost");
+			}
+
+			_snprintf_s(section, size, _TRUNCATE, "%s-%dx%d-%dfps-%dbps-%.1fms",
+				hostName, width, height, fps, bitrate, latencyBudgetMs);
+		}
+
+		// Relative cache paths are resolved against the executable directory.
+		static void								GetPath(const char* cacheFileName, char* path, size_t size)
+		{
+			if (strchr(cacheFileName, ':') || cacheFileName[0] == '\\')
+			{
+				strncpy_s(path, size, cacheFileName, _TRUNCATE);
+				return;
+			}
+
+			char buffer[MAX_PATH];
+			GetModuleFileNameA(NULL, buffer, MAX_PATH);
+			std::string exePath(buffer);
+			std::string::size_type pos = exePath.find_last_of("\\/");
+			std::string cachePath = exePath.substr(0, pos + 1) + cacheFileName;
+			strncpy_s(path, size, cachePath.c_str(), _TRUNCATE);
+		}
+	};
+}
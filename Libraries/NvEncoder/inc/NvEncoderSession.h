@@ -0,0 +1,62 @@
+/*
+ * NvEnc session backed by D3D11 input textures, leased from
+ * CNvEncoderSessionPool.
+ */
+
+#pragma once
+
+#include "NvHWEncoder.h"
+#include "NvEncoderSessionPool.h"
+
+#define MAX_SESSION_ENCODE_BUFFERS 16
+#define SESSION_BITSTREAM_BUFFER_SIZE 2 * 1024 * 1024
+
+#if defined (NV_WINDOWS)
+// NvEnc session backed by D3D11 input textures.
+class CNvEncoderSession : public INvEncoderSession
+{
+public:
+    CNvEncoderSession();
+    virtual ~CNvEncoderSession();
+
+    NVENCSTATUS                                          Initialize(ID3D11Device* pDevice, const EncodeConfig* pEncodeConfig, GUID profileGUID, DXGI_FORMAT format);
+    NVENCSTATUS                                          Reset() override;
+
+    CNvHWEncoder*                                        GetEncoder() { return m_pNvHWEncoder; }
+    EncodeBuffer*                                        GetEncodeBuffers() { return m_stEncodeBuffer; }
+    uint32_t                                             GetEncodeBufferCount() { return m_uEncodeBufferCount; }
+    EncodeOutputBuffer*                                  GetEOSOutputBuffer() { return &m_stEOSOutputBfr; }
+    const EncodeConfig&                                  GetEncodeConfig() { return m_encodeConfig; }
+
+    // A reused session has no reference the new receiver knows about, so the
+    // first frame after a reset must be an IDR.
+    bool                                                 IsIDRPending() { return m_bIDRPending; }
+    void                                                 ClearIDRPending() { m_bIDRPending = false; }
+
+private:
+    NVENCSTATUS                                          AllocateIOBuffers(ID3D11Device* pDevice, DXGI_FORMAT format);
+    void                                                 ReleaseIOBuffers();
+
+    CNvHWEncoder*                                        m_pNvHWEncoder;
+    EncodeConfig                                         m_encodeConfig;
+    EncodeBuffer                                         m_stEncodeBuffer[MAX_SESSION_ENCODE_BUFFERS];
+    uint32_t                                             m_uEncodeBufferCount;
+    EncodeOutputBuffer                                   m_stEOSOutputBfr;
+    bool                                                 m_bIDRPending;
+};
+
+// Creates D3D11 backed sessions from a base encode configuration.
+class CNvEncoderSessionFactory : public INvEncoderSessionFactory
+{
+public:
+    CNvEncoderSessionFactory(ID3D11Device* pDevice, const EncodeConfig& baseConfig, DXGI_FORMAT format);
+
+    INvEncoderSession*                                   CreateSession(const EncoderSessionKey& key) override;
+    void                                                 DestroySession(INvEncoderSession* pSession) override;
+
+private:
+    ID3D11Device*                                        m_pDevice;
+    EncodeConfig                                         m_baseConfig;
+    DXGI_FORMAT                                          m_format;
+};
+#endif
@@ -0,0 +1,134 @@
+/*
+ * Pool of pre-initialized NvEnc sessions.
+ *
+ * Creating an encoder session (Initialize, CreateEncoder and the IO buffer
+ * allocation) is expensive and used to happen on every new stream. The pool
+ * keeps warm sessions keyed by resolution, codec profile and version of the
+ * encode settings, sessions are leased when a stream starts, then reset and
+ * returned when it stops.
+ *
+ * Consumer GPUs only run a couple of NvEnc sessions at once, idle ones
+ * included, so the pool never prewarms past that limit and a lease which
+ * needs a new session first destroys an idle one of another key.
+ *
+ * The pool only depends on INvEncoderSession and INvEncoderSessionFactory,
+ * and on nvEncodeAPI.h for the status codes, so it can be exercised with a
+ * mock encoder where NvEnc is not available. The D3D11 backed session lives
+ * in NvEncoderSession.h.
+ */
+
+#pragma once
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "nvEncodeAPI.h"
+
+typedef struct _EncoderSessionKey
+{
+    uint32_t width;
+    uint32_t height;
+    int      profile;
+
+    // Sessions keep the encode settings they were created with, a change
+    // of the settings makes the sessions of the previous version stale.
+    uint32_t configVersion;
+
+    bool operator<(const _EncoderSessionKey& other) const
+    {
+        if (width != other.width)
+            return width < other.width;
+
+        if (height != other.height)
+            return height < other.height;
+
+        if (profile != other.profile)
+            return profile < other.profile;
+
+        return configVersion < other.configVersion;
+    }
+}EncoderSessionKey;
+
+typedef struct _EncoderSessionPoolStats
+{
+    uint32_t uLeaseHits;
+    uint32_t uLeaseMisses;
+    uint32_t uResetFailures;
+    uint32_t uIdleSessions;
+    uint32_t uLeasedSessions;
+
+    // Idle sessions destroyed to make room for a lease, or because their
+    // settings changed.
+    uint32_t uEvictedSessions;
+}EncoderSessionPoolStats;
+
+class INvEncoderSession
+{
+public:
+    virtual ~INvEncoderSession() {}
+
+    // Brings the session back to a clean state so that it can be leased again.
+    virtual NVENCSTATUS Reset() = 0;
+};
+
+class INvEncoderSessionFactory
+{
+public:
+    virtual ~INvEncoderSessionFactory() {}
+
+    virtual INvEncoderSession* CreateSession(const EncoderSessionKey& key) = 0;
+    virtual void DestroySession(INvEncoderSession* pSession) = 0;
+};
+
+class CNvEncoderSessionPool
+{
+public:
+    // |uMaxSessions| is the number of sessions the GPU runs at once, idle and
+    // leased ones together.
+    CNvEncoderSessionPool(INvEncoderSessionFactory* pFactory, uint32_t uMaxIdlePerKey, uint32_t uMaxSessions);
+    ~CNvEncoderSessionPool();
+
+    // Creates sessions up front until |uCount| sessions are idle for |key|.
+    // Returns NV_ENC_ERR_ENCODER_BUSY once the sessions the GPU allows are
+    // all created.
+    NVENCSTATUS                                          Prewarm(const EncoderSessionKey& key, uint32_t uCount);
+
+    // Returns a warm session for |key|, or creates a new one if none is idle,
+    // destroying an idle session of another key first at the session limit.
+    INvEncoderSession*                                   Lease(const EncoderSessionKey& key);
+
+    // Resets the session and keeps it for the next lease. Sessions failing to
+    // reset, exceeding the idle limit or of a stale version are destroyed.
+    void                                                 Return(const EncoderSessionKey& key, INvEncoderSession* pSession);
+
+    // Makes the sessions of the other versions stale, destroying the idle
+    // ones, after a change of the encode settings.
+    void                                                 SetConfigVersion(uint32_t uConfigVersion);
+
+    // Destroys all idle sessions.
+    void                                                 Clear();
+
+    uint32_t                                             GetIdleCount(const EncoderSessionKey& key);
+    EncoderSessionPoolStats                              GetStats();
+
+private:
+    // Idle, leased and pending sessions. Call with the lock held.
+    uint32_t                                             SessionCount() const;
+
+    // Removes an idle session of any key, nullptr if none. Call with the
+    // lock held.
+    INvEncoderSession*                                   TakeIdleSession();
+
+    INvEncoderSessionFactory*                            m_pFactory;
+    uint32_t                                             m_uMaxIdlePerKey;
+    uint32_t                                             m_uMaxSessions;
+    uint32_t                                             m_uConfigVersion;
+
+    // Sessions being created outside of the lock, counted against the limit.
+    uint32_t                                             m_uPendingSessions;
+    std::map<EncoderSessionKey, std::vector<INvEncoderSession*>> m_idleSessions;
+    EncoderSessionPoolStats                              m_stats;
+    std::mutex                                           m_lock;
+};
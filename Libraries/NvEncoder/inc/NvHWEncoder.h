@@ -9,6 +9,8 @@
  *
  */
 
+#pragma once
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <assert.h>
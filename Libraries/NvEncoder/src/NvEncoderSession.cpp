@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "NvEncoderSession.h"
+
+#if defined (NV_WINDOWS)
+CNvEncoderSession::CNvEncoderSession() :
+    m_pNvHWEncoder(NULL),
+    m_uEncodeBufferCount(0),
+    m_bIDRPending(true)
+{
+    memset(&m_encodeConfig, 0, sizeof(m_encodeConfig));
+    memset(m_stEncodeBuffer, 0, sizeof(m_stEncodeBuffer));
+    memset(&m_stEOSOutputBfr, 0, sizeof(m_stEOSOutputBfr));
+}
+
+CNvEncoderSession::~CNvEncoderSession()
+{
+    if (m_pNvHWEncoder)
+    {
+        ReleaseIOBuffers();
+        m_pNvHWEncoder->NvEncDestroyEncoder();
+        delete m_pNvHWEncoder;
+        m_pNvHWEncoder = NULL;
+    }
+}
+
+NVENCSTATUS CNvEncoderSession::Initialize(ID3D11Device* pDevice, const EncodeConfig* pEncodeConfig, GUID profileGUID, DXGI_FORMAT format)
+{
+    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+
+    m_encodeConfig = *pEncodeConfig;
+    m_pNvHWEncoder = new CNvHWEncoder();
+    m_pNvHWEncoder->m_stEncodeConfig.profileGUID = profileGUID;
+
+    nvStatus = m_pNvHWEncoder->Initialize((void*)pDevice, NV_ENC_DEVICE_TYPE_DIRECTX);
+    if (nvStatus != NV_ENC_SUCCESS)
+    {
+        return nvStatus;
+    }
+
+    m_encodeConfig.presetGUID = m_pNvHWEncoder->GetPresetGUID(m_encodeConfig.encoderPreset, m_encodeConfig.codec);
+
+    //H264 level sets maximum bitrate limits.  4.1 supported by almost all mobile devices.
+    m_pNvHWEncoder->m_stEncodeConfig.encodeCodecConfig.h264Config.level = NV_ENC_LEVEL_H264_41;
+
+    nvStatus = m_pNvHWEncoder->CreateEncoder(&m_encodeConfig);
+    if (nvStatus != NV_ENC_SUCCESS)
+    {
+        return nvStatus;
+    }
+
+    m_uEncodeBufferCount = min(m_encodeConfig.numB + 4, MAX_SESSION_ENCODE_BUFFERS);
+    return AllocateIOBuffers(pDevice, format);
+}
+
+NVENCSTATUS CNvEncoderSession::Reset()
+{
+    NVENCSTATUS nvStatus = m_pNvHWEncoder->NvEncFlushEncoderQueue(m_stEOSOutputBfr.hOutputEvent);
+    if (nvStatus != NV_ENC_SUCCESS)
+    {
+        return nvStatus;
+    }
+
+    // Drains and unmaps whatever the previous stream left in flight.
+    for (uint32_t i = 0; i < m_uEncodeBufferCount; i++)
+    {
+        if (m_stEncodeBuffer[i].stInputBfr.hInputSurface)
+        {
+            m_pNvHWEncoder->ProcessOutput(&m_stEncodeBuffer[i]);
+            m_pNvHWEncoder->NvEncUnmapInputResource(m_stEncodeBuffer[i].stInputBfr.hInputSurface);
+            m_stEncodeBuffer[i].stInputBfr.hInputSurface = NULL;
+        }
+    }
+
+    if (WaitForSingleObject(m_stEOSOutputBfr.hOutputEvent, 500) != WAIT_OBJECT_0)
+    {
+        return NV_ENC_ERR_GENERIC;
+    }
+
+    m_bIDRPending = true;
+    return NV_ENC_SUCCESS;
+}
+
+NVENCSTATUS CNvEncoderSession::AllocateIOBuffers(ID3D11Device* pDevice, DXGI_FORMAT format)
+{
+    NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+
+    for (uint32_t i = 0; i < m_uEncodeBufferCount; i++)
+    {
+        // Initializes the input buffer, backed by ID3D11Texture2D*.
+        D3D11_TEXTURE2D_DESC desc = { 0 };
+        desc.ArraySize = 1;
+        desc.Format = format;
+        desc.Width = m_encodeConfig.width;
+        desc.Height = m_encodeConfig.height;
+        desc.MipLevels = 1;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        if (FAILED(pDevice->CreateTexture2D(&desc, nullptr, &m_stEncodeBuffer[i].stInputBfr.pARGBSurface)))
+        {
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+
+        // Registers the input buffer with NvEnc.
+        nvStatus = m_pNvHWEncoder->NvEncRegisterResource(
+            NV_ENC_INPUT_RESOURCE_TYPE_DIRECTX,
+            (void*)m_stEncodeBuffer[i].stInputBfr.pARGBSurface,
+            m_encodeConfig.width,
+            m_encodeConfig.height,
+            m_stEncodeBuffer[i].stInputBfr.uARGBStride,
+            &m_stEncodeBuffer[i].stInputBfr.nvRegisteredResource);
+        if (nvStatus != NV_ENC_SUCCESS)
+            return nvStatus;
+
+        m_stEncodeBuffer[i].stInputBfr.bufferFmt = format == DXGI_FORMAT_B8G8R8A8_UNORM ?
+            NV_ENC_BUFFER_FORMAT_ARGB : NV_ENC_BUFFER_FORMAT_ABGR;
+
+        m_stEncodeBuffer[i].stInputBfr.dwWidth = m_encodeConfig.width;
+        m_stEncodeBuffer[i].stInputBfr.dwHeight = m_encodeConfig.height;
+
+        // Initializes the output buffer.
+        nvStatus = m_pNvHWEncoder->NvEncCreateBitstreamBuffer(SESSION_BITSTREAM_BUFFER_SIZE, &m_stEncodeBuffer[i].stOutputBfr.hBitstreamBuffer);
+        if (nvStatus != NV_ENC_SUCCESS)
+            return nvStatus;
+
+        m_stEncodeBuffer[i].stOutputBfr.dwBitstreamBufferSize = SESSION_BITSTREAM_BUFFER_SIZE;
+
+        // Registers for the output event.
+        nvStatus = m_pNvHWEncoder->NvEncRegisterAsyncEvent(&m_stEncodeBuffer[i].stOutputBfr.hOutputEvent);
+        if (nvStatus != NV_ENC_SUCCESS)
+            return nvStatus;
+
+        m_stEncodeBuffer[i].stOutputBfr.bWaitOnEvent = true;
+    }
+
+    m_stEOSOutputBfr.bEOSFlag = TRUE;
+
+    // Registers for the output event.
+    return m_pNvHWEncoder->NvEncRegisterAsyncEvent(&m_stEOSOutputBfr.hOutputEvent);
+}
+
+void CNvEncoderSession::ReleaseIOBuffers()
+{
+    for (uint32_t i = 0; i < m_uEncodeBufferCount; i++)
+    {
+        if (m_stEncodeBuffer[i].stInputBfr.nvRegisteredResource)
+        {
+            m_pNvHWEncoder->NvEncUnregisterResource(m_stEncodeBuffer[i].stInputBfr.nvRegisteredResource);
+            m_stEncodeBuffer[i].stInputBfr.nvRegisteredResource = NULL;
+        }
+
+        SAFE_RELEASE(m_stEncodeBuffer[i].stInputBfr.pARGBSurface);
+
+        if (m_stEncodeBuffer[i].stOutputBfr.hBitstreamBuffer)
+        {
+            m_pNvHWEncoder->NvEncDestroyBitstreamBuffer(m_stEncodeBuffer[i].stOutputBfr.hBitstreamBuffer);
+            m_stEncodeBuffer[i].stOutputBfr.hBitstreamBuffer = NULL;
+        }
+
+        if (m_stEncodeBuffer[i].stOutputBfr.hOutputEvent)
+        {
+            m_pNvHWEncoder->NvEncUnregisterAsyncEvent(m_stEncodeBuffer[i].stOutputBfr.hOutputEvent);
+            CloseHandle(m_stEncodeBuffer[i].stOutputBfr.hOutputEvent);
+            m_stEncodeBuffer[i].stOutputBfr.hOutputEvent = NULL;
+        }
+    }
+
+    if (m_stEOSOutputBfr.hOutputEvent)
+    {
+        m_pNvHWEncoder->NvEncUnregisterAsyncEvent(m_stEOSOutputBfr.hOutputEvent);
+        CloseHandle(m_stEOSOutputBfr.hOutputEvent);
+        m_stEOSOutputBfr.hOutputEvent = NULL;
+    }
+}
+
+CNvEncoderSessionFactory::CNvEncoderSessionFactory(ID3D11Device* pDevice, const EncodeConfig& baseConfig, DXGI_FORMAT format) :
+    m_pDevice(pDevice),
+    m_baseConfig(baseConfig),
+    m_format(format)
+{
+}
+
+INvEncoderSession* CNvEncoderSessionFactory::CreateSession(const EncoderSessionKey& key)
+{
+    EncodeConfig encodeConfig = m_baseConfig;
+    encodeConfig.width = key.width;
+    encodeConfig.height = key.height;
+    encodeConfig.fOutput = NULL;
+
+    CNvEncoderSession* pSession = new CNvEncoderSession();
+
+    // Same profile indices as nvEncodeProfile in nvEncConfig.json.
+    GUID profileGUID;
+    switch (key.profile)
+    {
+    case 1:
+        profileGUID = NV_ENC_H264_PROFILE_MAIN_GUID;
+        break;
+
+    case 2:
+        profileGUID = NV_ENC_PRESET_LOW_LATENCY_HQ_GUID;
+        break;
+
+    case 3:
+        profileGUID = NV_ENC_H264_PROFILE_STEREO_GUID;
+        break;
+
+    default:
+        profileGUID = NV_ENC_CODEC_PROFILE_AUTOSELECT_GUID;
+        break;
+    }
+
+    if (pSession->Initialize(m_pDevice, &encodeConfig, profileGUID, m_format) != NV_ENC_SUCCESS)
+    {
+        delete pSession;
+        return NULL;
+    }
+
+    return pSession;
+}
+
+void CNvEncoderSessionFactory::DestroySession(INvEncoderSession* pSession)
+{
+    delete pSession;
+}
+#endif
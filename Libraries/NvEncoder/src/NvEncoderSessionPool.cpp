@@ -0,0 +1,233 @@
+// Built without the precompiled header, the pool doesn't depend on Windows.
+#include <stdio.h>
+#include <string.h>
+
+#include "NvEncoderSessionPool.h"
+
+CNvEncoderSessionPool::CNvEncoderSessionPool(INvEncoderSessionFactory* pFactory, uint32_t uMaxIdlePerKey, uint32_t uMaxSessions) :
+    m_pFactory(pFactory),
+    m_uMaxIdlePerKey(uMaxIdlePerKey),
+    m_uMaxSessions(uMaxSessions),
+    m_uConfigVersion(0),
+    m_uPendingSessions(0)
+{
+    memset(&m_stats, 0, sizeof(m_stats));
+}
+
+CNvEncoderSessionPool::~CNvEncoderSessionPool()
+{
+    Clear();
+}
+
+NVENCSTATUS CNvEncoderSessionPool::Prewarm(const EncoderSessionKey& key, uint32_t uCount)
+{
+    uCount = (std::min)(uCount, m_uMaxIdlePerKey);
+    for (;;)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            // The settings changed since the caller built the key.
+            if (m_idleSessions[key].size() >= uCount || key.configVersion != m_uConfigVersion)
+            {
+                return NV_ENC_SUCCESS;
+            }
+
+            // Idle sessions would make the next lease of another key fail.
+            if (SessionCount() >= m_uMaxSessions)
+            {
+                return NV_ENC_ERR_ENCODER_BUSY;
+            }
+
+            m_uPendingSessions++;
+        }
+
+        // Creates the session outside of the lock, this is the slow path.
+        INvEncoderSession* pSession = m_pFactory->CreateSession(key);
+        if (!pSession)
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_uPendingSessions--;
+            fprintf(stderr, "Failed to prewarm encoder session %ux%u\n", key.width, key.height);
+            return NV_ENC_ERR_OUT_OF_MEMORY;
+        }
+
+        // Another prewarm or a return may have filled the pool meanwhile, the
+        // count is checked again with the insert so the limit always holds.
+        bool bKeep;
+        {
+            std::lock_guard<std::mutex> lock(m_lock);
+            m_uPendingSessions--;
+            std::vector<INvEncoderSession*>& idleSessions = m_idleSessions[key];
+            bKeep = idleSessions.size() < uCount && key.configVersion == m_uConfigVersion;
+            if (bKeep)
+            {
+                idleSessions.push_back(pSession);
+                m_stats.uIdleSessions++;
+            }
+        }
+
+        if (!bKeep)
+        {
+            m_pFactory->DestroySession(pSession);
+            return NV_ENC_SUCCESS;
+        }
+    }
+}
+
+INvEncoderSession* CNvEncoderSessionPool::Lease(const EncoderSessionKey& key)
+{
+    INvEncoderSession* pEvicted = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto it = m_idleSessions.find(key);
+        if (it != m_idleSessions.end() && !it->second.empty())
+        {
+            INvEncoderSession* pSession = it->second.back();
+            it->second.pop_back();
+            m_stats.uLeaseHits++;
+            m_stats.uIdleSessions--;
+            m_stats.uLeasedSessions++;
+            return pSession;
+        }
+
+        m_stats.uLeaseMisses++;
+
+        // The GPU would refuse the new session while idle ones hold the
+        // slots, a stream starting matters more than a warm session.
+        if (SessionCount() >= m_uMaxSessions)
+        {
+            pEvicted = TakeIdleSession();
+        }
+
+        m_uPendingSessions++;
+    }
+
+    if (pEvicted)
+    {
+        m_pFactory->DestroySession(pEvicted);
+    }
+
+    // Creates the session outside of the lock, this is the slow path.
+    INvEncoderSession* pSession = m_pFactory->CreateSession(key);
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_uPendingSessions--;
+        if (pSession)
+        {
+            m_stats.uLeasedSessions++;
+        }
+    }
+
+    return pSession;
+}
+
+void CNvEncoderSessionPool::Return(const EncoderSessionKey& key, INvEncoderSession* pSession)
+{
+    if (!pSession)
+    {
+        return;
+    }
+
+    bool bKeep = pSession->Reset() == NV_ENC_SUCCESS;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_stats.uLeasedSessions--;
+        if (!bKeep)
+        {
+            m_stats.uResetFailures++;
+        }
+        else if (key.configVersion != m_uConfigVersion)
+        {
+            m_stats.uEvictedSessions++;
+        }
+        else if (m_idleSessions[key].size() < m_uMaxIdlePerKey)
+        {
+            m_idleSessions[key].push_back(pSession);
+            m_stats.uIdleSessions++;
+            return;
+        }
+    }
+
+    m_pFactory->DestroySession(pSession);
+}
+
+void CNvEncoderSessionPool::Clear()
+{
+    std::map<EncoderSessionKey, std::vector<INvEncoderSession*>> idleSessions;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        idleSessions.swap(m_idleSessions);
+        m_stats.uIdleSessions = 0;
+    }
+
+    for (auto& entry : idleSessions)
+    {
+        for (INvEncoderSession* pSession : entry.second)
+        {
+            m_pFactory->DestroySession(pSession);
+        }
+    }
+}
+
+void CNvEncoderSessionPool::SetConfigVersion(uint32_t uConfigVersion)
+{
+    std::vector<INvEncoderSession*> staleSessions;
+    {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_uConfigVersion = uConfigVersion;
+        for (auto it = m_idleSessions.begin(); it != m_idleSessions.end();)
+        {
+            if (it->first.configVersion == uConfigVersion)
+            {
+                ++it;
+                continue;
+            }
+
+            staleSessions.insert(staleSessions.end(), it->second.begin(), it->second.end());
+            m_stats.uIdleSessions -= (uint32_t)it->second.size();
+            m_stats.uEvictedSessions += (uint32_t)it->second.size();
+            it = m_idleSessions.erase(it);
+        }
+    }
+
+    // Leased sessions of the previous version are destroyed when returned.
+    for (INvEncoderSession* pSession : staleSessions)
+    {
+        m_pFactory->DestroySession(pSession);
+    }
+}
+
+uint32_t CNvEncoderSessionPool::GetIdleCount(const EncoderSessionKey& key)
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    auto it = m_idleSessions.find(key);
+    return it != m_idleSessions.end() ? (uint32_t)it->second.size() : 0;
+}
+
+EncoderSessionPoolStats CNvEncoderSessionPool::GetStats()
+{
+    std::lock_guard<std::mutex> lock(m_lock);
+    return m_stats;
+}
+
+uint32_t CNvEncoderSessionPool::SessionCount() const
+{
+    return m_stats.uIdleSessions + m_stats.uLeasedSessions + m_uPendingSessions;
+}
+
+INvEncoderSession* CNvEncoderSessionPool::TakeIdleSession()
+{
+    for (auto& entry : m_idleSessions)
+    {
+        if (!entry.second.empty())
+        {
+            INvEncoderSession* pSession = entry.second.back();
+            entry.second.pop_back();
+            m_stats.uIdleSessions--;
+            m_stats.uEvictedSessions++;
+            return pSession;
+        }
+    }
+
+    return nullptr;
+}
@@ -0,0 +1,125 @@
+#ifndef WEBRTC_DNS_CACHE_H_
+#define WEBRTC_DNS_CACHE_H_
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "webrtc/base/ipaddress.h"
+#include "webrtc/base/nethelpers.h"
+#include "webrtc/base/sigslot.h"
+
+// Called with the addresses of the host in connection order, or with a
+// non-zero |error| when the lookup failed.
+typedef std::function<void(int error, const std::vector<rtc::IPAddress>& addresses)> DnsCallback;
+
+// Lookup counters of the resolver cache.
+struct DnsCacheStats
+{
+	int hits;
+	int misses;
+
+	// Lookups answered by a cached failure.
+	int negative_hits;
+
+	// Resolutions started, including refreshes.
+	int resolutions;
+	int failures;
+	int refreshes;
+};
+
+// Process wide cache of host name resolutions, so that reconnects and new
+// sessions don't wait for DNS.
+//
+// The system resolver doesn't report record TTLs, successful lookups are
+// kept for 5 minutes and failures for 30 seconds. An entry used past half
+// its lifetime is refreshed in the background. Concurrent requests for a
+// host share a single resolution.
+//
+// Addresses are returned with the families interleaved, the family which
+// last connected to the host first and IPv6 first otherwise (RFC 8305).
+//
+// Not thread safe, it belongs to the signaling thread. Callbacks run on the
+// thread which requested the resolution.
+class DnsCache : public sigslot::has_slots<>
+{
+public:
+	static DnsCache* Instance();
+
+	// Host of |uri|, e.g. "turn.example.com" for "turns:turn.example.com:443"
+	// or "https://user@turn.example.com/path". Empty when |uri| has no host
+	// or holds an IP literal.
+	static std::string GetUriHost(const std::string& uri);
+
+	// Fills |addresses| from the cache. Returns false on a miss, true with
+	// |error| set for a cached failure.
+	bool Lookup(const std::string& host, std::vector<rtc::IPAddress>* addresses, int* error);
+
+	// Resolves |host| and caches the result. Returns the id of the request
+	// for Cancel(), |callback| is not called once the request is cancelled.
+	int Resolve(const std::string& host, const DnsCallback& callback);
+
+	void Cancel(int request_id);
+
+	// Resolves the hosts of |uris| which aren't cached yet, without waiting
+	// for the results.
+	void PreResolve(const std::vector<std::string>& uris);
+
+	// Moves the family of |address| to the front of the addresses of |host|
+	// when the connection succeeded, behind the other family otherwise.
+	void ReportConnectResult(const std::string& host, const rtc::IPAddress& address, bool success);
+
+	DnsCacheStats GetStats() const;
+
+private:
+	static const int64_t kPositiveTtlMs = 5 * 60 * 1000;
+	static const int64_t kNegativeTtlMs = 30 * 1000;
+
+	// Hosts remembered at once, the least recently used is dropped first.
+	static const size_t kMaxEntries = 64;
+
+	struct Entry
+	{
+		// Sorted in connection order, empty for a failed lookup.
+		std::vector<rtc::IPAddress> addresses;
+		int error;
+		int64_t expires_ms;
+
+		// Lookups after this time refresh the entry in the background.
+		int64_t refresh_ms;
+		int64_t used_ms;
+
+		// AF_UNSPEC until a connection reported which family works.
+		int preferred_family;
+	};
+
+	struct PendingResolution
+	{
+		rtc::AsyncResolver* resolver;
+		std::vector<int> request_ids;
+	};
+
+	DnsCache();
+
+	// Starts resolving |host| unless a resolution is running already.
+	PendingResolution& StartResolution(const std::string& host);
+
+	void OnResolveDone(rtc::AsyncResolverInterface* resolver);
+
+	void Insert(const std::string& host, int error, const std::vector<rtc::IPAddress>& addresses,
+		int64_t now);
+
+	// Interleaves the families of |addresses|, |preferred_family| first.
+	static void SortAddresses(int preferred_family, std::vector<rtc::IPAddress>* addresses);
+
+	std::map<std::string, Entry> entries_;
+	std::map<std::string, PendingResolution> pending_;
+	std::map<int, DnsCallback> requests_;
+	int next_request_id_;
+	DnsCacheStats stats_;
+};
+
+#endif  // WEBRTC_DNS_CACHE_H_
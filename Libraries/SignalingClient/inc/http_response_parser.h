@@ -0,0 +1,110 @@
+#ifndef WEBRTC_HTTP_RESPONSE_PARSER_H_
+#define WEBRTC_HTTP_RESPONSE_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Region of the buffer handed to the parser. Offsets rather than pointers,
+// so that spans stay valid when the caller's buffer grows.
+struct HttpSpan
+{
+	size_t offset;
+	size_t length;
+};
+
+// Incremental HTTP/1.x response parser.
+//
+// The caller appends the received bytes to its own buffer and calls Parse()
+// with the whole buffer, only the bytes added since the previous call are
+// scanned. The parser doesn't allocate nor copy, header values and the body
+// are returned as spans of the caller's buffer. Chunked bodies are decoded in
+// place, compacting the chunk data right after the headers.
+//
+// Once a response is complete, the bytes following consumed() belong to the
+// next pipelined response. Reset() must be called before parsing it.
+class HttpResponseParser
+{
+public:
+	enum Result
+	{
+		NEED_MORE_DATA,
+		COMPLETE,
+		PARSE_ERROR,
+	};
+
+	// Headers past this count are validated but can't be looked up.
+	static const int kMaxHeaders = 24;
+
+	// Longest status, header or chunk size line accepted.
+	static const size_t kMaxLineLength = 8192;
+
+	HttpResponseParser();
+
+	void Reset();
+
+	Result Parse(char* data, size_t length);
+
+	// Completes a response whose body is delimited by the connection close.
+	Result Finish();
+
+	int status_code() const { return status_code_; }
+
+	// True if the connection can carry another response.
+	bool keep_alive() const;
+
+	HttpSpan body() const;
+
+	size_t consumed() const { return consumed_; }
+
+	// Header lookup, |name| is matched case insensitively.
+	bool GetHeader(const char* data, const char* name, HttpSpan* value) const;
+	bool GetHeaderInt(const char* data, const char* name, int64_t* value) const;
+
+	// Parses a non negative decimal integer, rejecting any other character.
+	static bool ParseInt(const char* data, size_t length, int64_t* value);
+
+private:
+	enum State
+	{
+		STATUS_LINE,
+		HEADER_LINE,
+		BODY_IDENTITY,
+		BODY_UNTIL_CLOSE,
+		CHUNK_SIZE,
+		CHUNK_DATA,
+		CHUNK_DATA_END,
+		CHUNK_TRAILER,
+		DONE,
+	};
+
+	bool OnLine(char* data, size_t begin, size_t end);
+	bool ParseStatusLine(const char* data, size_t begin, size_t end);
+	bool ParseHeaderLine(const char* data, size_t begin, size_t end);
+	bool ParseChunkSize(const char* data, size_t begin, size_t end);
+	void OnHeadersComplete();
+
+	State state_;
+
+	// Next byte to scan and beginning of the current line.
+	size_t position_;
+	size_t line_begin_;
+
+	int status_code_;
+	int minor_version_;
+	bool connection_close_;
+	bool connection_keep_alive_;
+	bool chunked_;
+	bool until_close_;
+	int64_t content_length_;
+	uint64_t chunk_remaining_;
+
+	HttpSpan header_names_[kMaxHeaders];
+	HttpSpan header_values_[kMaxHeaders];
+	int header_count_;
+
+	size_t body_offset_;
+	size_t body_length_;
+	size_t consumed_;
+};
+
+#endif  // WEBRTC_HTTP_RESPONSE_PARSER_H_
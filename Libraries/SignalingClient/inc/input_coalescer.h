@@ -0,0 +1,75 @@
+#ifndef WEBRTC_INPUT_COALESCER_H_
+#define WEBRTC_INPUT_COALESCER_H_
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "input_message.h"
+
+// Counters of the coalesced input.
+struct InputCoalescerStats
+{
+	// Values passed to Update().
+	int updates;
+
+	// Values sent, the others were replaced by a newer one first.
+	int sent;
+
+	int interval_ms;
+};
+
+// Keeps the latest value of each continuous input, the camera pose for
+// instance, and sends it on a fixed schedule instead of once per window
+// event. Intermediate values are dropped, which only loses states the
+// server would have overwritten within the same frame anyway.
+//
+// The send interval is one server frame, lengthened to a quarter of the
+// round trip time, up to 100 ms, on slow links where more frequent
+// updates only queue up in the network. An update after an idle period is
+// sent immediately, the following ones at most once per interval.
+//
+// Doesn't schedule anything itself, the owner calls Flush() when
+// NextFlushMs() is due.
+class InputCoalescer
+{
+public:
+	InputCoalescer();
+
+	// Frame rate of the server stream, 0 restores the default of 60.
+	void SetFrameRate(int frame_rate);
+
+	// Current round trip time estimate, 0 while unknown.
+	void SetRoundTripTimeMs(int rtt_ms);
+
+	// Replaces the pending value of |type|, |message| is the encoded
+	// message.
+	void Update(InputMessage::Type type, const std::string& message);
+
+	// Time at which the pending values are due, -1 if there are none.
+	int64_t NextFlushMs() const;
+
+	// Moves the pending values to |messages| if they are due at |now_ms|.
+	void Flush(int64_t now_ms, std::vector<std::string>* messages);
+
+	// Moves the pending values to |messages| regardless of the schedule,
+	// before a discrete event which must not overtake them.
+	void FlushNow(int64_t now_ms, std::vector<std::string>* messages);
+
+	const InputCoalescerStats& stats() const { return stats_; }
+
+private:
+	void TakePending(std::vector<std::string>* messages);
+
+	void UpdateInterval();
+
+	int frame_rate_;
+	int rtt_ms_;
+	int64_t last_flush_ms_;
+	std::map<InputMessage::Type, std::string> pending_;
+	InputCoalescerStats stats_;
+};
+
+#endif  // WEBRTC_INPUT_COALESCER_H_
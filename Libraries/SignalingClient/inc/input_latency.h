@@ -0,0 +1,123 @@
+#ifndef WEBRTC_INPUT_LATENCY_H_
+#define WEBRTC_INPUT_LATENCY_H_
+
+#include <stdint.h>
+
+#include <deque>
+
+#include "input_message.h"
+
+// Distribution of one latency component, in microseconds.
+struct LatencyPercentiles
+{
+	int64_t p50_us;
+	int64_t p90_us;
+	int64_t p99_us;
+	int64_t max_us;
+};
+
+// Input to photon latency over the recent frames, see InputLatencyTracker.
+struct InputLatencyStats
+{
+	// Frames measured, at most the window size.
+	int samples;
+
+	// Client input to the presentation of the first frame rendered with it.
+	LatencyPercentiles total;
+
+	// Input reception to frame capture on the server, the wait for the next
+	// frame update.
+	LatencyPercentiles server;
+
+	// The rest up to the decoded frame, network both ways, encoding and
+	// decoding.
+	LatencyPercentiles transport;
+
+	// Decoded frame to its presentation on the client.
+	LatencyPercentiles present;
+};
+
+// Decides which frames the server tags with the last applied input, see
+// FrameInput. Fed with the frames delivered to the encoder, so a frame the
+// capturer drops doesn't use up the tag.
+//
+// The encoder may still drop a delivered frame, so the same input is tagged
+// on a few frames in a row. InputLatencyTracker measures the first of them
+// presented. Not thread safe, the capture thread owns it.
+class FrameInputTagger
+{
+public:
+	static const int kMaxTaggedFrames = 3;
+
+	FrameInputTagger();
+
+	// |timestamp_us| and |push_time_us| are those of the last input applied
+	// before the frame captured at |capture_ntp_ms|, 0 if there was none.
+	// Returns false if the frame carries no tag.
+	bool OnFrameDelivered(int64_t capture_ntp_ms, int64_t timestamp_us, int64_t push_time_us,
+		int64_t now_us, FrameInput* frame_input);
+
+private:
+	int64_t tagged_timestamp_us_;
+	int tagged_frames_;
+};
+
+// Matches the FrameInput tags of the server with the presented frames, by
+// capture NTP time, and measures the input to photon latency. The total is
+// measured on the client clock only, the server reports durations, so the
+// clocks need no synchronization.
+//
+// The tag and the frame travel separately and may arrive in either order.
+// The receiver's NTP time is estimated from the RTCP sender reports, which
+// round it, so the closest frame within a few milliseconds matches. Frames
+// presented before the first sender report have no NTP time and aren't
+// measured. Not thread safe.
+class InputLatencyTracker
+{
+public:
+	// Well below the interval between two frames.
+	static const int64_t kMaxNtpErrorMs = 4;
+
+	InputLatencyTracker();
+
+	void OnFrameInput(const FrameInput& frame_input);
+
+	// |capture_ntp_ms| is the NTP time the receiver estimated for the frame,
+	// 0 or less without one. |decoded_time_us| and |now_us| are on the clock
+	// of the input timestamps.
+	void OnFramePresented(int64_t capture_ntp_ms, int64_t decoded_time_us, int64_t now_us);
+
+	InputLatencyStats GetStats() const;
+
+private:
+	struct PresentedFrame
+	{
+		int64_t capture_ntp_ms;
+		int64_t decoded_time_us;
+		int64_t presented_time_us;
+	};
+
+	struct Sample
+	{
+		int64_t total_us;
+		int64_t server_us;
+		int64_t transport_us;
+		int64_t present_us;
+	};
+
+	void AddSample(const FrameInput& frame_input, const PresentedFrame& frame);
+
+	LatencyPercentiles GetPercentiles(int64_t Sample::*component) const;
+
+	// Tags waiting for their frame, and frames presented before their tag.
+	std::deque<FrameInput> pending_inputs_;
+	std::deque<PresentedFrame> presented_frames_;
+
+	std::deque<Sample> samples_;
+
+	// Input of the last measurement, the later tags of the same input are
+	// frames presenting it again.
+	int64_t measured_timestamp_us_;
+};
+
+#endif  // WEBRTC_INPUT_LATENCY_H_
@@ -0,0 +1,138 @@
+#ifndef WEBRTC_INPUT_MESSAGE_H_
+#define WEBRTC_INPUT_MESSAGE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// Camera, keyboard and mouse input sent by the clients on the input and
+// pose data channels.
+struct InputMessage
+{
+	enum Type
+	{
+		UNKNOWN,
+
+		// |stereo| requests a stereo or a mono stream.
+		STEREO_RENDERING,
+
+		// |values| holds the eye, focus and up vectors.
+		CAMERA_TRANSFORM_LOOKAT,
+
+		// |values| holds x, y, z, yaw, pitch and roll.
+		CAMERA_TRANSFORM,
+
+		// |values| holds the left then the right view projection matrix, row
+		// major.
+		CAMERA_TRANSFORM_STEREO,
+
+		// Win32 |message|, |wparam| and |lparam| of the client window.
+		KEYBOARD_EVENT,
+		MOUSE_EVENT,
+	};
+
+	static const int kMaxValues = 32;
+
+	InputMessage();
+
+	Type type;
+
+	// Client monotonic clock when the input was sampled, 0 if the message
+	// carries no timestamp.
+	int64_t timestamp_us;
+
+	// Display time, on the clock of |timestamp_us|, the client predicted the
+	// pose of a CAMERA_TRANSFORM_STEREO message for, 0 if the message
+	// doesn't say. Only the JSON envelope carries it, as "targetTime".
+	int64_t target_time_us;
+
+	bool stereo;
+	float values[kMaxValues];
+	int value_count;
+	uint32_t message;
+	uint32_t wparam;
+	int32_t lparam;
+};
+
+// Sent by the server on the input channel for the frames rendered after new
+// input, as {"type":"input-frame","body":"<ntp>,<timestamp>,<delay>"}.
+struct FrameInput
+{
+	// NTP time the video frame was captured at, in milliseconds on the
+	// server clock. The receiver estimates the same value for the decoded
+	// frame from the RTCP sender reports, as VideoFrame::ntp_time_ms(),
+	// unlike the RTP timestamp which the sender offsets per stream.
+	int64_t capture_ntp_ms;
+
+	// Client timestamp of the last input applied before the frame was
+	// captured.
+	int64_t timestamp_us;
+
+	// Time between the reception of that input and the capture, measured by
+	// the server.
+	int64_t server_delay_us;
+};
+
+// Binary encoding of the input messages, in place of the JSON envelope
+// {"type":"camera-transform-lookat","body":"<floats>"}.
+//
+// A message is a 4 byte header, magic 0xB3, version, type and flags, the
+// 8 byte timestamp if kTimestampFlag is set, then the little-endian
+// payload of its type: 1 byte for STEREO_RENDERING, 9, 6 or 32 floats for
+// the camera transforms, and message, wparam and lparam as 32 bit integers
+// for the Win32 events. The magic never starts a JSON text, so both
+// encodings can share the channel.
+//
+// The client offers the binary encoding with the JSON message
+// {"type":"input-protocol","body":"<highest version>"} once the channel is
+// open. A server which decodes it answers with the version to use, clients
+// which get no answer keep sending JSON.
+class InputMessageCodec
+{
+public:
+	static const uint8_t kMagic = 0xB3;
+	static const uint8_t kVersion = 1;
+	static const size_t kHeaderSize = 4;
+	static const size_t kTimestampSize = 8;
+
+	// Header flags.
+	static const uint8_t kTimestampFlag = 0x01;
+
+	// The writers add the timestamp unless |timestamp_us| is 0.
+	static std::string WriteStereoRendering(bool stereo, int64_t timestamp_us = 0);
+
+	static std::string WriteCameraLookAt(const float eye[3], const float focus[3], const float up[3],
+		int64_t timestamp_us = 0);
+
+	static std::string WriteCameraTransform(float x, float y, float z, float yaw, float pitch,
+		float roll, int64_t timestamp_us = 0);
+
+	static std::string WriteCameraStereo(const float left[16], const float right[16],
+		int64_t timestamp_us = 0);
+
+	// |type| is KEYBOARD_EVENT or MOUSE_EVENT.
+	static std::string WriteWindowEvent(InputMessage::Type type, uint32_t message, uint32_t wparam,
+		int32_t lparam, int64_t timestamp_us = 0);
+
+	// Starts with the binary magic, JSON messages don't.
+	static bool IsBinary(const char* data, size_t length);
+
+	// Decodes a binary message. Returns false for another version, an
+	// unknown type or a payload which doesn't match the type.
+	static bool Parse(const char* data, size_t length, InputMessage* message);
+
+	// The "input-protocol" message offering or accepting |version|.
+	static std::string WriteProtocolMessage(int version);
+
+	// Reads the version of an "input-protocol" message. Returns false for
+	// any other message.
+	static bool ParseProtocolMessage(const char* data, size_t length, int* version);
+
+	static std::string WriteFrameInputMessage(const FrameInput& frame_input);
+
+	// Returns false for any other message.
+	static bool ParseFrameInputMessage(const char* data, size_t length, FrameInput* frame_input);
+};
+
+#endif  // WEBRTC_INPUT_MESSAGE_H_
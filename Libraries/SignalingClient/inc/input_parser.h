@@ -0,0 +1,55 @@
+#ifndef WEBRTC_INPUT_PARSER_H_
+#define WEBRTC_INPUT_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "input_message.h"
+
+// Receives the decoded input messages, the default implementations ignore
+// them.
+class InputHandler
+{
+public:
+	virtual ~InputHandler() {}
+
+	virtual void OnStereoRendering(bool stereo);
+
+	virtual void OnCameraLookAt(const float eye[3], const float focus[3], const float up[3]);
+
+	// x, y, z, yaw, pitch and roll.
+	virtual void OnCameraTransform(const float transform[6]);
+
+	// Row major view projection matrices, |target_time_us| is the client
+	// time the pose was predicted for, 0 if the message has none.
+	virtual void OnCameraStereo(const float left[16], const float right[16], int64_t target_time_us);
+
+	virtual void OnKeyboardEvent(uint32_t message, uint32_t wparam);
+
+	virtual void OnMouseEvent(uint32_t message, uint32_t wparam, int32_t lparam);
+};
+
+// Decodes the input messages of the data channel in both encodings, the
+// binary one of InputMessageCodec and the JSON envelope
+// {"type":"camera-transform-lookat","body":"<comma separated floats>"},
+// which may carry the client timestamp as a "timestamp" number and the
+// prediction target of a stereo pose as a "targetTime" number.
+//
+// Parses in a single pass over |data|, without allocating and without
+// reading outside of it. Malformed messages, including bodies with fewer or
+// more values than their type takes, are rejected as a whole.
+class InputParser
+{
+public:
+	static bool Parse(const char* data, size_t length, InputMessage* message);
+
+	// Parses the message and calls the matching |handler| method. Returns
+	// false, without calling it, for malformed or unknown messages.
+	static bool Dispatch(const char* data, size_t length, InputHandler* handler);
+
+	// Parses exactly |count| comma separated floats of [begin, end) into
+	// |values|.
+	static bool ParseFloats(const char* begin, const char* end, float* values, int count);
+};
+
+#endif  // WEBRTC_INPUT_PARSER_H_
@@ -0,0 +1,109 @@
+#ifndef WEBRTC_INPUT_QUEUE_H_
+#define WEBRTC_INPUT_QUEUE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+// Counters of the input queue, safe to read from any thread.
+struct InputQueueStats
+{
+	// Messages passed to Push(), including the dropped ones.
+	uint64_t pushed;
+
+	// Messages discarded by the overflow policy.
+	uint64_t dropped;
+
+	uint64_t drained;
+
+	// Time the drained messages spent in the queue.
+	int64_t total_latency_us;
+	int64_t max_latency_us;
+};
+
+// Bounded lock-free queue of the input messages, from the data channel
+// threads to the render thread. The render loop drains it once per frame,
+// so the input handlers never race with the drawing and the network thread
+// never waits on the application.
+//
+// Any thread may push, a single thread drains. Each slot keeps the capacity
+// of its string, so pushing doesn't allocate once the messages fit.
+class InputQueue
+{
+public:
+	enum OverflowPolicy
+	{
+		// Discards the message being pushed.
+		DROP_NEWEST,
+
+		// Discards the oldest queued message to make room, a stalled render
+		// loop then resumes with the latest input.
+		DROP_OLDEST,
+	};
+
+	static const size_t kDefaultCapacity = 256;
+
+	// |capacity| is rounded up to a power of two.
+	explicit InputQueue(
+		size_t capacity = kDefaultCapacity,
+		OverflowPolicy policy = DROP_OLDEST);
+
+	~InputQueue();
+
+	// Queues a copy of |data|, |now_us| is the time on the clock passed to
+	// Drain() and |client_timestamp_us| the timestamp of the message, if it
+	// has one. Returns false if a message was dropped.
+	bool Push(const char* data, size_t length, int64_t now_us, int64_t client_timestamp_us = 0);
+
+	// Calls |input_update_func| with the queued messages in order, at most
+	// one capacity worth so a flood can't stall the frame. Returns the
+	// number of messages.
+	size_t Drain(int64_t now_us, void (*input_update_func)(const std::string&));
+
+	InputQueueStats GetStats() const;
+
+	// Client timestamp and push time of the last drained message which had
+	// a timestamp, 0 if none did. Consumer thread only.
+	int64_t last_client_timestamp_us() const { return last_client_timestamp_us_; }
+	int64_t last_client_push_time_us() const { return last_client_push_time_us_; }
+
+private:
+	struct Slot;
+
+	// Claims the oldest message, false if the queue is empty.
+	bool Pop(std::string* message, int64_t* push_time_us, int64_t* client_timestamp_us);
+
+	// Discards the oldest message, leaving its buffer to the slot so the
+	// push taking its place doesn't allocate.
+	bool DropOldest();
+
+	// Claims the slot of the oldest message and its position, nullptr if
+	// the queue is empty. The slot is freed by Release().
+	Slot* Claim(size_t* pos);
+	void Release(Slot* slot, size_t pos);
+
+	const size_t mask_;
+	const OverflowPolicy policy_;
+	std::unique_ptr<Slot[]> slots_;
+
+	// Padded to separate cache lines, the producers and the consumer update
+	// them concurrently.
+	std::atomic<size_t> push_position_;
+	char push_padding_[64];
+	std::atomic<size_t> pop_position_;
+	char pop_padding_[64];
+
+	std::atomic<uint64_t> pushed_;
+	std::atomic<uint64_t> dropped_;
+	std::atomic<uint64_t> drained_;
+	std::atomic<int64_t> total_latency_us_;
+	std::atomic<int64_t> max_latency_us_;
+
+	int64_t last_client_timestamp_us_;
+	int64_t last_client_push_time_us_;
+};
+
+#endif  // WEBRTC_INPUT_QUEUE_H_
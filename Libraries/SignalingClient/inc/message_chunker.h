@@ -0,0 +1,127 @@
+#ifndef WEBRTC_MESSAGE_CHUNKER_H_
+#define WEBRTC_MESSAGE_CHUNKER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+// Splits payloads larger than a data channel message, scene snapshots or
+// asset patches for instance, into chunks which interleave with the other
+// messages of the channel.
+//
+// A chunk is a 14 byte header, magic 0xB4, flags, then the little-endian
+// message id, chunk sequence number and total payload length as 32 bit
+// integers, followed by its part of the payload. The magic never starts a
+// JSON text nor an InputMessageCodec message, so chunks can share a channel
+// with both. The chunks of a message must arrive in order, on a reliable
+// ordered channel.
+class MessageChunker
+{
+public:
+	static const uint8_t kMagic = 0xB4;
+	static const size_t kHeaderSize = 14;
+
+	// Header flags.
+	static const uint8_t kLastChunkFlag = 0x01;
+
+	// Chunks fit the 16 KiB messages every data channel implementation
+	// accepts.
+	static const size_t kDefaultChunkSize = 16 * 1024;
+
+	static const size_t kMaxPayloadSize = 64 * 1024 * 1024;
+
+	// |chunk_size| includes the header.
+	explicit MessageChunker(size_t chunk_size = kDefaultChunkSize);
+
+	// Queues |payload|, false if it is larger than kMaxPayloadSize.
+	bool Add(const std::string& payload);
+
+	// Writes the next chunk to |chunk|, one of each queued message in turn,
+	// so a large transfer doesn't hold back the smaller ones queued after
+	// it. Returns false when all were written.
+	bool Next(std::string* chunk);
+
+	// Drops the queued messages, when the channel closes.
+	void Clear();
+
+	bool empty() const { return messages_.empty(); }
+
+	// Payload bytes not written yet.
+	size_t pending_bytes() const { return pending_bytes_; }
+
+private:
+	struct Message
+	{
+		uint32_t id;
+		uint32_t sequence;
+		size_t offset;
+		std::string payload;
+	};
+
+	size_t chunk_size_;
+	uint32_t next_id_;
+	std::deque<Message> messages_;
+	size_t pending_bytes_;
+};
+
+// Counters of the reassembled messages.
+struct MessageReassemblerStats
+{
+	uint64_t completed;
+
+	// Malformed or out of order chunks, and incomplete messages evicted or
+	// timed out.
+	uint64_t dropped;
+
+	// Reserved for the incomplete messages.
+	size_t buffered_bytes;
+};
+
+// Reassembles the payloads of MessageChunker. The memory is bounded, a
+// message reserves its whole length on its first chunk and the oldest
+// incomplete messages are evicted to make room, as are the ones which got
+// no chunk for 10 seconds.
+//
+// Not thread safe.
+class MessageReassembler
+{
+public:
+	static const size_t kDefaultMaxMessages = 8;
+	static const size_t kDefaultMaxBufferedBytes = 64 * 1024 * 1024;
+
+	explicit MessageReassembler(
+		size_t max_messages = kDefaultMaxMessages,
+		size_t max_buffered_bytes = kDefaultMaxBufferedBytes);
+
+	// Starts with the chunk magic.
+	static bool IsChunk(const char* data, size_t length);
+
+	// Adds a chunk received at |now_ms|. Returns true and moves the payload
+	// to |payload| when it completes a message.
+	bool Add(const char* data, size_t length, int64_t now_ms, std::string* payload);
+
+	const MessageReassemblerStats& stats() const { return stats_; }
+
+private:
+	struct Message
+	{
+		uint32_t id;
+		uint32_t next_sequence;
+		uint32_t length;
+		int64_t last_chunk_ms;
+		std::string payload;
+	};
+
+	// Drops |messages_[index]|.
+	void Drop(size_t index);
+
+	size_t max_messages_;
+	size_t max_buffered_bytes_;
+	std::vector<Message> messages_;
+	MessageReassemblerStats stats_;
+};
+
+#endif  // WEBRTC_MESSAGE_CHUNKER_H_
@@ -11,19 +11,43 @@
 #ifndef WEBRTC_PEER_CONNECTION_CLIENT_H_
 #define WEBRTC_PEER_CONNECTION_CLIENT_H_
 
+#include <algorithm>
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
 #include <functional>
+#include <vector>
 
 #include "webrtc/base/nethelpers.h"
 #include "webrtc/base/physicalsocketserver.h"
 #include "webrtc/base/signalthread.h"
 #include "webrtc/base/sigslot.h"
 
+#include "dns_cache.h"
+#include "http_response_parser.h"
+#include "peer_directory.h"
+#include "reconnect_controller.h"
 #include "ssl_capable_socket.h"
+#include "websocket_framer.h"
 
-typedef std::map<int, std::string> Peers;
+// Outbound signaling queue counters.
+struct SignalingQueueStats
+{
+	// Messages waiting for the control connection.
+	size_t queue_depth;
+	size_t max_queue_depth;
+
+	int messages_sent;
+	int requests_sent;
+
+	// Candidates which shared their request with other candidates.
+	int batched_candidates;
+
+	// Time from SendToPeer until the server acknowledged the message.
+	int64_t average_send_latency_ms;
+	int64_t max_send_latency_ms;
+};
 
 struct PeerConnectionClientObserver
 {
@@ -31,6 +55,9 @@ struct PeerConnectionClientObserver
 
 	virtual void OnDisconnected() = 0;
 
+	// Peer list changes announced after sign in, the sign in list itself is
+	// in peers(). Observers rebuilding a list should rather register a
+	// PeerDirectoryObserver, which gets the changes in batches.
 	virtual void OnPeerConnected(int id, const std::string& name) = 0;
 
 	virtual void OnPeerDisconnected(int peer_id) = 0;
@@ -55,6 +82,10 @@ public:
 		RESOLVING,
 		SIGNING_IN,
 		CONNECTED,
+
+		// Lost the server while connected, signing in again with the same
+		// peer id. Messages are queued meanwhile.
+		RECONNECTING,
 		SIGNING_OUT_WAITING,
 		SIGNING_OUT,
 	};
@@ -67,19 +98,37 @@ public:
 
 	bool is_connected() const;
 
-	const Peers& peers() const;
+	const PeerDirectory& peers() const;
 
 	void RegisterObserver(PeerConnectionClientObserver* callback);
 
+	// |observer| gets the peer list changes matching |filter|, notifications
+	// received within 100 ms are delivered together. The sign in list is
+	// delivered as a reset.
+	void RegisterPeerObserver(PeerDirectoryObserver* observer, const PeerFilter& filter = PeerFilter());
+
+	// |server| may start with http://, https://, or with ws:// and wss://
+	// which select the WebSocket transport. The WebSocket transport carries
+	// sign in, messages, notifications and heartbeats on a single connection
+	// instead of the control, hanging get and heartbeat connections.
 	void Connect(const std::string& server, int port,
 				 const std::string& client_name);
 
+	// Queues |message| for |peer_id|, the client keeps its own copy. Queued
+	// ICE candidates are sent as a single JSON array when the server
+	// advertises message batching. Messages queued while reconnecting are
+	// sent if the server restores our peer id, and dropped otherwise.
 	bool SendToPeer(int peer_id, const std::string& message);
 
 	bool SendHangUp(int peer_id);
 
+	// Returns true while messages are waiting for the control connection.
 	bool IsSendingMessage();
 
+	SignalingQueueStats GetQueueStats() const;
+
+	ReconnectStats GetReconnectStats() const;
+
 	bool SignOut();
 
 	bool Shutdown();
@@ -100,10 +149,48 @@ protected:
 
 	void Close();
 
+	// Signing in, either for the first time or to resume our peer id.
+	bool IsSigningIn() const;
+
+	// Reconnects with backoff while signed in or signing in, gives up on
+	// the session otherwise.
+	void OnConnectionLost();
+
+	// Closes the connections and signs in again after the backoff delay of
+	// |reconnect_|. Keeps our peer id and the unanswered messages when we
+	// were connected, so that the server can resume the session.
+	void ScheduleReconnect();
+
+	// Stores the peer id and the peer list of the sign in response. When
+	// |resuming| and the server restored our peer id, the session carries
+	// on without the observer noticing. A new peer id ends the previous
+	// session and starts a new one.
+	void OnSignInResponse(bool resuming, int peer_id, const char* peer_list, size_t length);
+
 	void InitSocketSignals();
 
 	bool ConnectControlSocket();
 
+	// Queues a request on the control connection and sends it as soon as the
+	// connection allows it.
+	bool QueueControlRequest(const std::string& request);
+
+	// Moves queued peer messages to the control connection, as long as it
+	// has room for more requests in flight.
+	bool FlushOutboundQueue();
+
+	// Sends the queued messages as WebSocket frames once the connection is
+	// upgraded.
+	bool FlushWebSocketQueue();
+
+	bool SendWebSocketFrame(WebSocketFramer::Opcode opcode, const std::string& payload);
+
+	// Sends the queued requests, connecting the control socket if needed.
+	bool FlushControlQueue();
+
+	// Number of requests which can be in flight on the control connection.
+	size_t MaxControlRequestsInFlight() const;
+
 	void OnConnect(rtc::AsyncSocket* socket);
 
 	void OnHangingGetConnect(rtc::AsyncSocket* socket);
@@ -112,54 +199,135 @@ protected:
 
 	void OnMessageFromPeer(int peer_id, const std::string& message);
 
-	// Quick and dirty support for parsing HTTP header values.
-	bool GetHeaderValue(const std::string& data, size_t eoh,
-						const char* header_pattern, size_t* value);
-
-	bool GetHeaderValue(const std::string& data, size_t eoh,
-						const char* header_pattern, std::string* value);
+	// Appends everything available on |socket| to |data|. Returns true if
+	// the connection was closed by the server.
+	bool ReceiveIntoBuffer(rtc::AsyncSocket* socket, std::string* data);
 
-	// Returns true if the whole response has been read.
-	bool ReadIntoBuffer(rtc::AsyncSocket* socket, std::string* data,
-						size_t* content_length);
+	// Appends everything available on |socket| to |data| and parses it.
+	HttpResponseParser::Result ReadIntoBuffer(rtc::AsyncSocket* socket, std::string* data,
+						HttpResponseParser* parser);
 
 	void OnRead(rtc::AsyncSocket* socket);
 
+	// Handles one complete response read from the control connection.
+	void OnControlResponse(const char* data, const HttpResponseParser& parser);
+
 	void OnHangingGetRead(rtc::AsyncSocket* socket);
 
+	// Waits again right away after a first failure, reconnects with backoff
+	// when the next wait fails too.
+	void OnHangingGetFailure();
+
+	// Handles the upgrade response and the frames of the WebSocket transport.
+	void OnWebSocketRead(rtc::AsyncSocket* socket);
+
+	// Handles one "<peer id>\n<body>" text message.
+	void OnWebSocketMessage(const std::string& message);
+
+	// Adds the "<name>,<id>,<connected>" lines of the sign in response.
+	void OnPeerList(const char* data, size_t length);
+
+	// Handles a peer list change when |peer_id| is ours, a message from
+	// |peer_id| otherwise.
+	void OnNotification(int peer_id, const char* data, size_t length);
+
+	// Delivers the peer list changes once the current batch is over.
+	void SchedulePeerFlush();
+
 	void OnHeartbeatGetRead(rtc::AsyncSocket* socket);
 
+	void ScheduleHeartbeat();
+
 	// Parses a single line entry in the form "<name>,<id>,<connected>"
-	bool ParseEntry(const std::string& entry, std::string* name, int* id,
+	bool ParseEntry(const char* entry, size_t length, std::string* name, int* id,
 					bool* connected);
 
-	int GetResponseStatus(const std::string& response);
-
-	bool ParseServerResponse(const std::string& response, size_t content_length,
-							size_t* peer_id, size_t* eoh);
+	// Checks the response status and reads the peer id of the Pragma header.
+	// Errors reconnect or disconnect depending on |request|, and return false.
+	bool ParseServerResponse(SignalingRequest request, const char* data,
+							const HttpResponseParser& parser, int* peer_id);
 
 	void OnClose(rtc::AsyncSocket* socket, int err);
 
 	void OnSignalingServerClose(rtc::AsyncSocket* socket, int err);
 
-	void OnResolveResult(rtc::AsyncResolverInterface* resolver);
+	void OnResolveResult(int error, const std::vector<rtc::IPAddress>& addresses);
+
+	// Switches |server_address_| to the next resolved address. Returns false
+	// once every address failed since the last successful connection.
+	bool TryNextAddress();
 
-	std::string PrepareRequest(const std::string& method, const std::string& fragment, std::map<std::string, std::string> headers);
+	// |keep_alive| requests are sent as HTTP/1.1 on the persistent control
+	// connection, the other requests use HTTP/1.0.
+	std::string PrepareRequest(const std::string& method, const std::string& fragment, std::map<std::string, std::string> headers,
+		bool keep_alive = false);
 
 	PeerConnectionClientObserver* callback_;
 	bool server_address_ssl_;
 	rtc::SocketAddress server_address_;
-	rtc::AsyncResolver* resolver_;
+
+	// Resolved addresses of the server in connection order, tried in turn
+	// when connecting fails or takes longer than 250 ms.
+	std::vector<rtc::IPAddress> server_addresses_;
+	size_t address_index_;
+	size_t addresses_failed_;
+	int connect_attempt_;
+	int resolve_request_;
+	ReconnectController reconnect_;
+
+	// Consecutive waits which ended without a notification.
+	int hanging_get_failures_;
 	rtc::Thread* signaling_thread_;
 	std::unique_ptr<SslCapableSocket> control_socket_;
 	std::unique_ptr<SslCapableSocket> hanging_get_;
 	std::unique_ptr<SslCapableSocket> heartbeat_get_;
-	std::string onconnect_data_;
+	struct OutboundMessage
+	{
+		int peer_id;
+		std::string message;
+		int64_t queued_ms;
+		bool candidate;
+	};
+
+	struct ControlRequest
+	{
+		std::string data;
+
+		// Time the oldest message of the request was queued.
+		int64_t queued_ms;
+
+		// Number of peer messages carried by the request.
+		int messages;
+	};
+
+	std::deque<OutboundMessage> outbound_queue_;
+	std::deque<ControlRequest> control_queue_;
+	std::deque<ControlRequest> control_in_flight_;
+
+	// Message requests left unanswered by the lost connection, sent again
+	// once the server restored our peer id.
+	std::deque<ControlRequest> resume_queue_;
+	bool control_keep_alive_;
+	bool message_batching_;
+	SignalingQueueStats queue_stats_;
+	int64_t total_send_latency_ms_;
+	int control_connections_;
+	int control_requests_;
 	std::string control_data_;
 	std::string notification_data_;
+	std::string heartbeat_data_;
+	HttpResponseParser control_parser_;
+	HttpResponseParser notification_parser_;
+	HttpResponseParser heartbeat_parser_;
+	bool websocket_;
+	bool websocket_open_;
+	std::string websocket_key_;
+	WebSocketFramer websocket_framer_;
 	std::string client_name_;
 	std::string authorization_header_;
-	Peers peers_;
+	PeerDirectory peers_;
+	bool peer_flush_scheduled_;
+	bool heartbeat_scheduled_;
 	State state_;
 	int my_id_;
 	int heartbeat_tick_ms_;
@@ -0,0 +1,121 @@
+#ifndef WEBRTC_PEER_DIRECTORY_H_
+#define WEBRTC_PEER_DIRECTORY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// Peer registered on the signaling server. Ids are assigned by the server
+// and never reused while the peer is signed in.
+struct PeerInfo
+{
+	int id;
+	std::string name;
+
+	// Role of the peer, the part of its name before the first '_', e.g.
+	// "renderingserver" for "renderingserver_user@host".
+	std::string tag() const;
+};
+
+// Selects peers by name prefix and/or tag, empty members match everything.
+struct PeerFilter
+{
+	std::string name_prefix;
+	std::string tag;
+
+	bool Matches(const std::string& name) const;
+};
+
+// Changes delivered to an observer in one batch. Removals apply before
+// additions, a peer renamed within the batch is in both lists.
+struct PeerDirectoryDelta
+{
+	// The whole directory was replaced, |added| holds every peer and the
+	// observer should drop what it knew before.
+	bool reset;
+
+	std::vector<PeerInfo> added;
+	std::vector<PeerInfo> removed;
+};
+
+class PeerDirectoryObserver
+{
+public:
+	virtual void OnPeersChanged(const PeerDirectoryDelta& delta) = 0;
+
+protected:
+	virtual ~PeerDirectoryObserver() {}
+};
+
+// Peers known to the signaling client, indexed by id and by name.
+//
+// Changes are accumulated until FlushChanges(), which hands every observer
+// the part matching its filter. Adding and removing a peer within the same
+// batch cancels out, so observers only rebuild what actually changed.
+class PeerDirectory
+{
+public:
+	PeerDirectory();
+
+	// Bulk update, replaces every entry with |peers|.
+	void Reset(const std::vector<PeerInfo>& peers);
+
+	// Delta updates, return false when nothing changed.
+	bool Add(int id, const std::string& name);
+	bool Remove(int id);
+	void Clear();
+
+	void Reserve(size_t count);
+
+	size_t size() const { return entries_.size(); }
+	bool empty() const { return entries_.empty(); }
+
+	// Incremented on every change.
+	uint64_t version() const { return version_; }
+
+	// Returns nullptr for unknown peers.
+	const PeerInfo* Find(int id) const;
+
+	// Peers matching |filter|, sorted by id. The pointers are valid until
+	// the next change.
+	std::vector<const PeerInfo*> Select(const PeerFilter& filter = PeerFilter()) const;
+
+	// Most recently signed in peer matching |filter|, or nullptr.
+	const PeerInfo* Newest(const PeerFilter& filter = PeerFilter()) const;
+
+	void AddObserver(PeerDirectoryObserver* observer, const PeerFilter& filter = PeerFilter());
+	void RemoveObserver(PeerDirectoryObserver* observer);
+
+	bool has_pending_changes() const;
+
+	// Delivers the changes since the previous call.
+	void FlushChanges();
+
+private:
+	typedef std::set<std::pair<std::string, int>> NameIndex;
+
+	// Visits the name index entries matching |filter|.
+	template <typename Visitor>
+	void VisitMatches(const PeerFilter& filter, Visitor visitor) const;
+
+	void RemoveEntry(std::unordered_map<int, PeerInfo>::iterator it);
+
+	std::unordered_map<int, PeerInfo> entries_;
+	NameIndex by_name_;
+	uint64_t version_;
+
+	// Changes since the last flush.
+	bool pending_reset_;
+	std::unordered_set<int> pending_added_;
+	std::vector<PeerInfo> pending_removed_;
+
+	std::vector<std::pair<PeerDirectoryObserver*, PeerFilter>> observers_;
+};
+
+#endif  // WEBRTC_PEER_DIRECTORY_H_
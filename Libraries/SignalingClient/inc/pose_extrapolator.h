@@ -0,0 +1,85 @@
+#ifndef WEBRTC_POSE_EXTRAPOLATOR_H_
+#define WEBRTC_POSE_EXTRAPOLATOR_H_
+
+#include <stdint.h>
+
+#include <deque>
+
+// Counters of the pose extrapolation.
+struct PoseExtrapolatorStats
+{
+	int samples;
+
+	// Frames rendered with an extrapolated pose, the others used the latest
+	// pose as is.
+	int extrapolated;
+
+	// Pose changes which weren't a rigid motion, a new projection for
+	// instance, the history restarts from them.
+	int discontinuities;
+
+	// Horizon and head rotation speed, in radians per second, of the last
+	// extrapolation.
+	int64_t horizon_us;
+	float angular_velocity;
+};
+
+// Extrapolates the head pose of a stereo client, sent as the view
+// projection matrices of its holographic camera, to the time the frame
+// being rendered will be displayed.
+//
+// The client keeps its projections, so between two samples of the same eye
+// M1^-1 * M2 cancels them out and leaves the rigid head motion, shared by
+// both eyes. Its angular and linear velocity over the last few samples is
+// assumed constant over the horizon, the render time plus the pipeline
+// latency past the latest sample, at most 100 ms.
+//
+// The matrices are the row major ones of the messages, transposed for
+// column vectors. Not thread safe.
+class PoseExtrapolator
+{
+public:
+	static const int64_t kDefaultPipelineLatencyUs = 50000;
+
+	PoseExtrapolator();
+
+	// Time from the render of a frame to its display on the client, encode,
+	// network, decode and presentation.
+	void SetPipelineLatencyUs(int64_t latency_us);
+
+	// |target_time_us| is the client time the pose was predicted for, 0 if
+	// the message has none, and |now_us| the time it was received.
+	void AddSample(int64_t target_time_us, int64_t now_us, const float left[16], const float right[16]);
+
+	// Computes the matrices of a frame rendered at |now_us|, the latest pose
+	// without enough history or once the client stopped sending poses for
+	// longer than the velocity is trusted. Returns false before the first
+	// sample.
+	bool Extrapolate(int64_t now_us, float left[16], float right[16]);
+
+	// Forgets the history, when the client stops sending stereo poses.
+	void Reset();
+
+	const PoseExtrapolatorStats& stats() const { return stats_; }
+
+private:
+	struct Sample
+	{
+		// Client time the pose was predicted for when the message said,
+		// else the reception time.
+		int64_t time_us;
+		int64_t received_time_us;
+		float left[16];
+		float right[16];
+	};
+
+	// Latest sample time on the clock of |now_us|.
+	int64_t LatestSampleTimeUs() const;
+
+	int64_t pipeline_latency_us_;
+	bool client_timestamps_;
+	std::deque<Sample> samples_;
+	PoseExtrapolatorStats stats_;
+};
+
+#endif  // WEBRTC_POSE_EXTRAPOLATOR_H_
@@ -0,0 +1,89 @@
+#ifndef WEBRTC_RECONNECT_CONTROLLER_H_
+#define WEBRTC_RECONNECT_CONTROLLER_H_
+
+#include <stdint.h>
+
+#include <random>
+
+// Reconnect counters of the signaling connection.
+struct ReconnectStats
+{
+	// Reconnect attempts scheduled since the client was created.
+	int attempts;
+
+	// Reconnects which kept the previous peer id.
+	int resumed;
+
+	// Reconnects which got a new peer id from the server.
+	int new_sessions;
+
+	// Attempts since the last successful connection.
+	int consecutive_failures;
+
+	int last_delay_ms;
+	int64_t total_delay_ms;
+};
+
+// Requests of the signaling protocol, see ReconnectController::ActionForResponse.
+enum SignalingRequest
+{
+	SIGNALING_SIGN_IN,
+	SIGNALING_MESSAGE,
+	SIGNALING_SIGN_OUT,
+	SIGNALING_WAIT,
+	SIGNALING_HEARTBEAT,
+};
+
+// What the client does with the answer to a signaling request.
+enum ResponseAction
+{
+	// Handles the response.
+	RESPONSE_PROCESS,
+
+	// The server lost the session or can't serve it right now, e.g.
+	// "500 Peer most likely gone." after a restart. Signs in again after the
+	// backoff, asking for the previous peer id.
+	RESPONSE_RECONNECT,
+
+	// The server refused a request of the session itself, or the client is
+	// signing out anyway.
+	RESPONSE_DISCONNECT,
+};
+
+// Delays of the reconnect attempts, capped exponential backoff with full
+// jitter: attempt n waits a uniformly random time in
+// [0, min(max_delay, base_delay * 2^n)]. The jitter spreads the clients
+// which lost the server at the same time, so they don't come back in
+// lockstep.
+//
+// Doesn't schedule anything itself, the owner posts the attempts.
+class ReconnectController
+{
+public:
+	ReconnectController(int base_delay_ms = 500, int max_delay_ms = 30000);
+
+	// Delay of the next attempt, counts the attempt as a failure until
+	// OnConnected() is called.
+	int NextDelayMs();
+
+	// The connection is up again, the next failure starts from the base delay.
+	void OnConnected();
+
+	// Records whether the server restored the previous peer id.
+	void OnResumed(bool same_id);
+
+	const ReconnectStats& stats() const { return stats_; }
+
+	// Action for an HTTP |status_code| answering |request|. Only the errors
+	// of the wait and heartbeat, which the server sends for peers it doesn't
+	// know, reconnect.
+	static ResponseAction ActionForResponse(SignalingRequest request, int status_code);
+
+private:
+	int base_delay_ms_;
+	int max_delay_ms_;
+	std::mt19937 random_;
+	ReconnectStats stats_;
+};
+
+#endif  // WEBRTC_RECONNECT_CONTROLLER_H_
@@ -0,0 +1,67 @@
+#ifndef WEBRTC_SEND_FLOW_CONTROL_H_
+#define WEBRTC_SEND_FLOW_CONTROL_H_
+
+#include <stdint.h>
+
+// Buffer metrics of a data channel sender.
+struct SendFlowControlStats
+{
+	// Bytes queued in the channel at the last update, and the peak.
+	uint64_t buffered_amount;
+	uint64_t max_buffered_amount;
+
+	// Times the buffered amount reached the high water mark.
+	int pauses;
+
+	// Low priority messages dropped while paused.
+	uint64_t dropped;
+};
+
+// Flow control of a data channel sender, on its buffered amount. The data
+// channel queues whatever it can't send yet, without bound, so on a
+// congested link every message waits behind all the previous ones.
+//
+// Once the buffered amount reaches the high water mark, the low priority
+// messages are held back, until it drains below the low water mark. The
+// sender drops them or coalesces them to the latest value meanwhile. High
+// priority messages, the discrete input events, are always sent.
+//
+// Not thread safe.
+class SendFlowControl
+{
+public:
+	enum Priority
+	{
+		HIGH_PRIORITY,
+		LOW_PRIORITY,
+	};
+
+	// Under a second of camera updates on a slow link.
+	static const uint64_t kDefaultHighWaterMark = 8 * 1024;
+	static const uint64_t kDefaultLowWaterMark = 2 * 1024;
+
+	explicit SendFlowControl(
+		uint64_t high_water_mark = kDefaultHighWaterMark,
+		uint64_t low_water_mark = kDefaultLowWaterMark);
+
+	// Updates the state with the current buffered amount of the channel,
+	// from DataChannelObserver::OnBufferedAmountChange() for instance.
+	void Update(uint64_t buffered_amount);
+
+	// Updates the state, then returns whether a message of |priority| may
+	// be sent. A refused message is counted as dropped.
+	bool ShouldSend(uint64_t buffered_amount, Priority priority);
+
+	// Low priority messages are held back.
+	bool paused() const { return paused_; }
+
+	const SendFlowControlStats& stats() const { return stats_; }
+
+private:
+	uint64_t high_water_mark_;
+	uint64_t low_water_mark_;
+	bool paused_;
+	SendFlowControlStats stats_;
+};
+
+#endif  // WEBRTC_SEND_FLOW_CONTROL_H_
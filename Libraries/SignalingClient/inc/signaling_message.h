@@ -0,0 +1,57 @@
+#ifndef WEBRTC_SIGNALING_MESSAGE_H_
+#define WEBRTC_SIGNALING_MESSAGE_H_
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+// Session description or ICE candidate relayed by the signaling server,
+// the JSON objects
+//   {"sdp":"v=0\r\n...","type":"offer"}
+//   {"candidate":"candidate:1 1 udp ...","sdpMLineIndex":0,"sdpMid":"audio"}
+struct SignalingMessage
+{
+	SignalingMessage();
+
+	// "offer", "answer" or "offer-loopback", empty for candidates.
+	std::string type;
+	std::string sdp;
+	bool has_sdp;
+
+	std::string sdp_mid;
+	int sdp_mline_index;
+	std::string candidate;
+	bool has_sdp_mid;
+	bool has_sdp_mline_index;
+	bool has_candidate;
+
+	bool is_session_description() const { return !type.empty(); }
+
+	// Every candidate member is present.
+	bool is_candidate() const;
+};
+
+// Compact writer and single pass parser of the signaling messages, in
+// place of Json::StyledWriter and Json::Reader.
+class SignalingMessageCodec
+{
+public:
+	static std::string WriteSessionDescription(const std::string& type, const std::string& sdp);
+
+	static std::string WriteCandidate(const std::string& sdp_mid, int sdp_mline_index,
+		const std::string& candidate);
+
+	// Parses a JSON object. Whitespace and member order don't matter, so the
+	// indented Json::StyledWriter output of older peers is accepted too.
+	// Unknown members are skipped. Returns false when |data| isn't a single
+	// JSON object.
+	static bool Parse(const char* data, size_t length, SignalingMessage* message);
+	static bool Parse(const std::string& data, SignalingMessage* message);
+
+	// Splits a JSON array into the text of its elements, without decoding
+	// them. Returns false when |data| isn't a single JSON array.
+	static bool SplitArray(const std::string& data, std::vector<std::string>* elements);
+};
+
+#endif  // WEBRTC_SIGNALING_MESSAGE_H_
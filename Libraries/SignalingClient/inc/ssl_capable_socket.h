@@ -5,6 +5,8 @@
 #include "webrtc/base/asyncsocket.h"
 #include "webrtc/base/openssladapter.h"
 
+#include "tls_client_adapter.h"
+
 using namespace rtc;
 
 class SslCapableSocket : public AsyncSocket, public sigslot::has_slots<>
@@ -39,7 +41,7 @@ public:
 private:
 	rtc::Thread* signaling_thread_;
 	AsyncSocket* socket_;
-	std::unique_ptr<SSLAdapter> ssl_adapter_;
+	std::unique_ptr<TlsClientAdapter> ssl_adapter_;
 
 	void MapUnderlyingEvents(AsyncSocket* provider, AsyncSocket* oldProvider = nullptr);
 
@@ -0,0 +1,74 @@
+#ifndef WEBRTC_TLS_CLIENT_ADAPTER_H_
+#define WEBRTC_TLS_CLIENT_ADAPTER_H_
+
+#include <string>
+
+#include "webrtc/base/asyncsocket.h"
+
+#include "tls_session_cache.h"
+
+// Client TLS over an AsyncSocket, resuming the sessions of TlsSessionCache.
+//
+// The TLS engine works on memory BIOs: ciphertext received on the socket is
+// fed to it and its output is written to the socket, buffering what the
+// socket doesn't take until it is writable again. The connect event is only
+// signaled once the handshake completes.
+class TlsClientAdapter : public rtc::AsyncSocketAdapter
+{
+public:
+	// Takes ownership of |socket|.
+	explicit TlsClientAdapter(rtc::AsyncSocket* socket);
+	~TlsClientAdapter() override;
+
+	int Connect(const rtc::SocketAddress& addr) override;
+	int Send(const void* pv, size_t cb) override;
+	int SendTo(const void* pv, size_t cb, const rtc::SocketAddress& addr) override;
+	int Recv(void* pv, size_t cb, int64_t* timestamp) override;
+	int RecvFrom(void* pv, size_t cb, rtc::SocketAddress* paddr, int64_t* timestamp) override;
+	int Close() override;
+	ConnState GetState() const override;
+
+protected:
+	void OnConnectEvent(rtc::AsyncSocket* socket) override;
+	void OnReadEvent(rtc::AsyncSocket* socket) override;
+	void OnWriteEvent(rtc::AsyncSocket* socket) override;
+	void OnCloseEvent(rtc::AsyncSocket* socket, int err) override;
+
+private:
+	enum State
+	{
+		TLS_NONE,
+		TLS_CONNECTING,
+		TLS_HANDSHAKE,
+		TLS_CONNECTED,
+		TLS_ERROR,
+	};
+
+	bool BeginHandshake();
+	void ContinueHandshake();
+
+	// Moves the ciphertext received on the socket into the TLS engine.
+	void ReadInput();
+
+	// Writes the TLS engine output to the socket, returns false on error.
+	bool FlushOutput();
+
+	void OnError(const char* context, int err);
+	void Cleanup();
+
+	State state_;
+
+	// DNS name or IP literal the certificate is verified against.
+	std::string hostname_;
+
+	// "<host>:<port>", also the application data of |ssl_|.
+	std::string session_key_;
+	bool resuming_;
+
+	SSL* ssl_;
+	BIO* input_;
+	BIO* output_;
+	std::string pending_output_;
+};
+
+#endif  // WEBRTC_TLS_CLIENT_ADAPTER_H_
@@ -0,0 +1,74 @@
+#ifndef WEBRTC_TLS_SESSION_CACHE_H_
+#define WEBRTC_TLS_SESSION_CACHE_H_
+
+#include <map>
+#include <string>
+
+#include "webrtc/base/criticalsection.h"
+
+// OpenSSL types, declared here so that users of the signaling client don't
+// need the BoringSSL headers.
+typedef struct ssl_st SSL;
+typedef struct ssl_ctx_st SSL_CTX;
+typedef struct ssl_session_st SSL_SESSION;
+typedef struct bio_st BIO;
+
+// Handshake counters of the signaling connections.
+struct TlsHandshakeStats
+{
+	int full_handshakes;
+	int resumed_handshakes;
+	int failed_handshakes;
+	int cached_sessions;
+};
+
+// Process wide client TLS context, with the sessions of the servers we
+// connected to so that reconnects only do an abbreviated handshake.
+//
+// Sessions are keyed by "<host>:<port>" and replaced whenever the server
+// issues a new one, which also covers TLS 1.3 tickets sent after the
+// handshake.
+class TlsSessionCache
+{
+public:
+	static TlsSessionCache* Instance();
+
+	// Shared context, verifying servers against the built-in root
+	// certificates.
+	SSL_CTX* ssl_ctx() const { return ssl_ctx_; }
+
+	// Returns a new reference to the session cached for |key|, or nullptr.
+	SSL_SESSION* Lookup(const std::string& key);
+
+	// Takes ownership of |session|.
+	void Insert(const std::string& key, SSL_SESSION* session);
+
+	void Remove(const std::string& key);
+
+	void OnHandshakeComplete(bool resumed);
+	void OnHandshakeFailed();
+
+	TlsHandshakeStats GetStats() const;
+
+	// Sets the server |ssl| connects to, |host| being a DNS name or an IP
+	// literal. Names are sent as SNI and matched against the DNS names of
+	// the certificate, IP literals against its IP addresses. Returns false
+	// when |host| is empty, the connection must not go on then.
+	static bool SetPeerName(SSL* ssl, const std::string& host);
+
+private:
+	// Servers remembered at once.
+	static const size_t kMaxSessions = 32;
+
+	TlsSessionCache();
+	~TlsSessionCache();
+
+	static int OnNewSession(SSL* ssl, SSL_SESSION* session);
+
+	SSL_CTX* ssl_ctx_;
+	rtc::CriticalSection crit_;
+	std::map<std::string, SSL_SESSION*> sessions_;
+	TlsHandshakeStats stats_;
+};
+
+#endif  // WEBRTC_TLS_SESSION_CACHE_H_
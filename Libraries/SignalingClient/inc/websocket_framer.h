@@ -0,0 +1,69 @@
+#ifndef WEBRTC_WEBSOCKET_FRAMER_H_
+#define WEBRTC_WEBSOCKET_FRAMER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// Client side of the RFC 6455 framing, used by the WebSocket signaling
+// transport.
+//
+// Outgoing frames are masked as required from clients. Incoming data
+// messages split in several frames are reassembled, control frames (close,
+// ping, pong) may arrive between the fragments and are returned on their own.
+class WebSocketFramer
+{
+public:
+	enum Opcode
+	{
+		CONTINUATION = 0x0,
+		TEXT = 0x1,
+		BINARY = 0x2,
+		CLOSE = 0x8,
+		PING = 0x9,
+		PONG = 0xA,
+	};
+
+	enum Result
+	{
+		NEED_MORE_DATA,
+		COMPLETE,
+		PARSE_ERROR,
+	};
+
+	// Normal closure status code, sent when signing out.
+	static const uint16_t kCloseNormal = 1000;
+
+	// Largest message accepted from the server.
+	static const size_t kMaxMessageSize = 1024 * 1024;
+
+	WebSocketFramer();
+
+	void Reset();
+
+	// Removes the next complete message from the front of |data|. |payload|
+	// is only valid when COMPLETE is returned.
+	Result ReadMessage(std::string* data, Opcode* opcode, std::string* payload);
+
+	// Appends a single masked frame to |frame|.
+	static void WriteFrame(Opcode opcode, const char* payload, size_t length,
+		std::string* frame);
+
+	// Appends a close frame carrying |status_code|.
+	static void WriteCloseFrame(uint16_t status_code, std::string* frame);
+
+	// Random Sec-WebSocket-Key for the opening handshake.
+	static std::string CreateKey();
+
+	// Sec-WebSocket-Accept value the server must answer |key| with.
+	static std::string ComputeAccept(const std::string& key);
+
+private:
+	// Fragments of the data message being reassembled.
+	std::string message_;
+	Opcode message_opcode_;
+	bool in_message_;
+};
+
+#endif  // WEBRTC_WEBSOCKET_FRAMER_H_
@@ -0,0 +1,320 @@
+#include "dns_cache.h"
+
+#include <ctype.h>
+
+#include <algorithm>
+
+#include "webrtc/base/logging.h"
+#include "webrtc/base/socket.h"
+#include "webrtc/base/timeutils.h"
+
+namespace
+{
+	// Host names are case insensitive.
+	std::string ToLower(std::string value)
+	{
+		std::transform(value.begin(), value.end(), value.begin(),
+			[](char c) { return static_cast<char>(tolower(static_cast<unsigned char>(c))); });
+
+		return value;
+	}
+
+	// ICE server schemes, which are followed by the host without "//".
+	bool IsIceScheme(const std::string& scheme)
+	{
+		std::string lower = ToLower(scheme);
+		return lower == "stun" || lower == "stuns" || lower == "turn" || lower == "turns";
+	}
+}
+
+DnsCache* DnsCache::Instance()
+{
+	// Never destroyed, resolutions may still complete during shutdown.
+	static DnsCache* instance = new DnsCache();
+	return instance;
+}
+
+DnsCache::DnsCache() :
+	next_request_id_(0),
+	stats_()
+{
+}
+
+std::string DnsCache::GetUriHost(const std::string& uri)
+{
+	std::string rest = uri;
+	size_t scheme_end = rest.find("://");
+	if (scheme_end != std::string::npos)
+	{
+		rest = rest.substr(scheme_end + 3);
+	}
+	else
+	{
+		size_t colon = rest.find(':');
+		if (colon != std::string::npos && IsIceScheme(rest.substr(0, colon)))
+		{
+			rest = rest.substr(colon + 1);
+		}
+	}
+
+	rest = rest.substr(0, rest.find_first_of("/?#"));
+
+	size_t at = rest.rfind('@');
+	if (at != std::string::npos)
+	{
+		rest = rest.substr(at + 1);
+	}
+
+	// Bracketed IPv6 literal.
+	if (!rest.empty() && rest[0] == '[')
+	{
+		return std::string();
+	}
+
+	std::string host = rest.substr(0, rest.find(':'));
+	rtc::IPAddress ip;
+	if (host.empty() || rtc::IPFromString(host, &ip))
+	{
+		return std::string();
+	}
+
+	return ToLower(host);
+}
+
+bool DnsCache::Lookup(const std::string& host, std::vector<rtc::IPAddress>* addresses, int* error)
+{
+	std::string key = ToLower(host);
+	int64_t now = rtc::TimeMillis();
+	auto it = entries_.find(key);
+	if (it == entries_.end() || it->second.expires_ms <= now)
+	{
+		if (it != entries_.end())
+		{
+			entries_.erase(it);
+		}
+
+		stats_.misses++;
+		return false;
+	}
+
+	Entry& entry = it->second;
+	entry.used_ms = now;
+	if (entry.error != 0)
+	{
+		stats_.negative_hits++;
+		addresses->clear();
+		*error = entry.error;
+		return true;
+	}
+
+	stats_.hits++;
+	*addresses = entry.addresses;
+	*error = 0;
+
+	// Refreshes ahead of expiry so that hosts in use never miss.
+	if (now >= entry.refresh_ms && pending_.find(key) == pending_.end())
+	{
+		stats_.refreshes++;
+		StartResolution(key);
+	}
+
+	return true;
+}
+
+int DnsCache::Resolve(const std::string& host, const DnsCallback& callback)
+{
+	int request_id = ++next_request_id_;
+	requests_[request_id] = callback;
+	StartResolution(ToLower(host)).request_ids.push_back(request_id);
+	return request_id;
+}
+
+void DnsCache::Cancel(int request_id)
+{
+	// The resolution keeps running for the cache.
+	requests_.erase(request_id);
+}
+
+void DnsCache::PreResolve(const std::vector<std::string>& uris)
+{
+	int64_t now = rtc::TimeMillis();
+	for (const std::string& uri : uris)
+	{
+		std::string host = GetUriHost(uri);
+		if (host.empty() || pending_.find(host) != pending_.end())
+		{
+			continue;
+		}
+
+		auto it = entries_.find(host);
+		if (it == entries_.end() || it->second.expires_ms <= now)
+		{
+			LOG(INFO) << "Pre-resolving " << host;
+			StartResolution(host);
+		}
+	}
+}
+
+void DnsCache::ReportConnectResult(const std::string& host, const rtc::IPAddress& address,
+	bool success)
+{
+	auto it = entries_.find(ToLower(host));
+	if (it == entries_.end() || it->second.error != 0)
+	{
+		return;
+	}
+
+	Entry& entry = it->second;
+	int family = address.family();
+	if (success)
+	{
+		entry.preferred_family = family;
+	}
+	else if (entry.preferred_family == family || entry.preferred_family == AF_UNSPEC)
+	{
+		entry.preferred_family = family == AF_INET ? AF_INET6 : AF_INET;
+	}
+
+	SortAddresses(entry.preferred_family, &entry.addresses);
+}
+
+DnsCacheStats DnsCache::GetStats() const
+{
+	return stats_;
+}
+
+DnsCache::PendingResolution& DnsCache::StartResolution(const std::string& host)
+{
+	auto it = pending_.find(host);
+	if (it != pending_.end())
+	{
+		return it->second;
+	}
+
+	PendingResolution& pending = pending_[host];
+	pending.resolver = new rtc::AsyncResolver();
+	pending.resolver->SignalDone.connect(this, &DnsCache::OnResolveDone);
+	pending.resolver->Start(rtc::SocketAddress(host, 0));
+	stats_.resolutions++;
+	return pending;
+}
+
+void DnsCache::OnResolveDone(rtc::AsyncResolverInterface* resolver)
+{
+	auto it = std::find_if(pending_.begin(), pending_.end(),
+		[resolver](const std::pair<const std::string, PendingResolution>& entry)
+		{
+			return entry.second.resolver == resolver;
+		});
+
+	if (it == pending_.end())
+	{
+		return;
+	}
+
+	std::string host = it->first;
+	std::vector<int> request_ids;
+	request_ids.swap(it->second.request_ids);
+
+	int error = it->second.resolver->GetError();
+	std::vector<rtc::IPAddress> addresses = it->second.resolver->addresses();
+	if (error == 0 && addresses.empty())
+	{
+		error = SOCKET_ERROR;
+	}
+
+	it->second.resolver->Destroy(false);
+	pending_.erase(it);
+
+	if (error != 0)
+	{
+		stats_.failures++;
+		LOG(WARNING) << "Failed to resolve " << host << ", error " << error;
+	}
+
+	Insert(host, error, addresses, rtc::TimeMillis());
+
+	// A failed refresh leaves the previous addresses in place.
+	const Entry& entry = entries_.at(host);
+	std::vector<rtc::IPAddress> result = entry.addresses;
+	int result_error = entry.error;
+
+	// Callbacks may cancel other requests or start new ones.
+	for (int request_id : request_ids)
+	{
+		auto request = requests_.find(request_id);
+		if (request != requests_.end())
+		{
+			DnsCallback callback = request->second;
+			requests_.erase(request);
+			callback(result_error, result);
+		}
+	}
+}
+
+void DnsCache::Insert(const std::string& host, int error,
+	const std::vector<rtc::IPAddress>& addresses, int64_t now)
+{
+	auto it = entries_.find(host);
+	if (error != 0 && it != entries_.end() && it->second.error == 0 && it->second.expires_ms > now)
+	{
+		// Keeps the previous addresses, without refreshing again before a
+		// failure would have expired.
+		it->second.refresh_ms = now + kNegativeTtlMs;
+		return;
+	}
+
+	if (it == entries_.end())
+	{
+		it = entries_.insert(std::make_pair(host, Entry())).first;
+		it->second.preferred_family = AF_UNSPEC;
+	}
+
+	Entry& entry = it->second;
+	entry.addresses = addresses;
+	entry.error = error;
+	entry.expires_ms = now + (error == 0 ? kPositiveTtlMs : kNegativeTtlMs);
+	entry.refresh_ms = now + kPositiveTtlMs / 2;
+	entry.used_ms = now;
+	SortAddresses(entry.preferred_family, &entry.addresses);
+
+	while (entries_.size() > kMaxEntries)
+	{
+		auto oldest = entries_.end();
+		for (auto candidate = entries_.begin(); candidate != entries_.end(); ++candidate)
+		{
+			if (candidate->first != host &&
+				(oldest == entries_.end() || candidate->second.used_ms < oldest->second.used_ms))
+			{
+				oldest = candidate;
+			}
+		}
+
+		entries_.erase(oldest);
+	}
+}
+
+void DnsCache::SortAddresses(int preferred_family, std::vector<rtc::IPAddress>* addresses)
+{
+	int first_family = preferred_family != AF_UNSPEC ? preferred_family : AF_INET6;
+	std::vector<rtc::IPAddress> first;
+	std::vector<rtc::IPAddress> second;
+	for (const rtc::IPAddress& address : *addresses)
+	{
+		(address.family() == first_family ? first : second).push_back(address);
+	}
+
+	addresses->clear();
+	for (size_t i = 0; i < first.size() || i < second.size(); ++i)
+	{
+		if (i < first.size())
+		{
+			addresses->push_back(first[i]);
+		}
+
+		if (i < second.size())
+		{
+			addresses->push_back(second[i]);
+		}
+	}
+}
@@ -0,0 +1,451 @@
+#include "http_response_parser.h"
+
+#include <string.h>
+
+namespace
+{
+	char ToLower(char c)
+	{
+		return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+	}
+
+	bool EqualsIgnoreCase(const char* data, size_t length, const char* value)
+	{
+		size_t i = 0;
+		for (; i < length && value[i] != '\0'; ++i)
+		{
+			if (ToLower(data[i]) != ToLower(value[i]))
+			{
+				return false;
+			}
+		}
+
+		return i == length && value[i] == '\0';
+	}
+
+	bool IsWhitespace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	// Strips the leading and trailing whitespaces of [begin, end).
+	void Trim(const char* data, size_t* begin, size_t* end)
+	{
+		while (*begin < *end && IsWhitespace(data[*begin]))
+		{
+			(*begin)++;
+		}
+
+		while (*end > *begin && IsWhitespace(data[*end - 1]))
+		{
+			(*end)--;
+		}
+	}
+
+	// Returns true if the comma separated list [begin, end) holds |token|.
+	bool HasToken(const char* data, size_t begin, size_t end, const char* token)
+	{
+		while (begin < end)
+		{
+			const char* comma = static_cast<const char*>(memchr(data + begin, ',', end - begin));
+			size_t token_end = comma ? comma - data : end;
+			size_t token_begin = begin;
+			Trim(data, &token_begin, &token_end);
+			if (EqualsIgnoreCase(data + token_begin, token_end - token_begin, token))
+			{
+				return true;
+			}
+
+			begin = comma ? (comma - data) + 1 : end;
+		}
+
+		return false;
+	}
+}
+
+HttpResponseParser::HttpResponseParser()
+{
+	Reset();
+}
+
+void HttpResponseParser::Reset()
+{
+	state_ = STATUS_LINE;
+	position_ = 0;
+	line_begin_ = 0;
+	status_code_ = -1;
+	minor_version_ = 0;
+	connection_close_ = false;
+	connection_keep_alive_ = false;
+	chunked_ = false;
+	until_close_ = false;
+	content_length_ = -1;
+	chunk_remaining_ = 0;
+	header_count_ = 0;
+	body_offset_ = 0;
+	body_length_ = 0;
+	consumed_ = 0;
+}
+
+HttpResponseParser::Result HttpResponseParser::Parse(char* data, size_t length)
+{
+	while (state_ != DONE)
+	{
+		switch (state_)
+		{
+		case BODY_IDENTITY:
+		{
+			size_t available = length - position_;
+			uint64_t needed = static_cast<uint64_t>(content_length_) - body_length_;
+			size_t take = needed < available ? static_cast<size_t>(needed) : available;
+			body_length_ += take;
+			position_ += take;
+			if (body_length_ < static_cast<uint64_t>(content_length_))
+			{
+				return NEED_MORE_DATA;
+			}
+
+			state_ = DONE;
+			break;
+		}
+
+		case BODY_UNTIL_CLOSE:
+			position_ = length;
+			body_length_ = length - body_offset_;
+			return NEED_MORE_DATA;
+
+		case CHUNK_DATA:
+		{
+			size_t available = length - position_;
+			size_t take = chunk_remaining_ < available ? static_cast<size_t>(chunk_remaining_) : available;
+
+			// The decoded body never overtakes the raw data, moving it back
+			// doesn't overwrite anything left to parse.
+			memmove(data + body_offset_ + body_length_, data + position_, take);
+			body_length_ += take;
+			position_ += take;
+			chunk_remaining_ -= take;
+			if (chunk_remaining_ > 0)
+			{
+				return NEED_MORE_DATA;
+			}
+
+			state_ = CHUNK_DATA_END;
+			line_begin_ = position_;
+			break;
+		}
+
+		default:
+		{
+			// Line based states, only the new bytes are scanned.
+			const char* eol = static_cast<const char*>(
+				memchr(data + position_, '\n', length - position_));
+
+			if (!eol)
+			{
+				position_ = length;
+				return (length - line_begin_ > kMaxLineLength) ? PARSE_ERROR : NEED_MORE_DATA;
+			}
+
+			size_t begin = line_begin_;
+			size_t end = eol - data;
+			position_ = end + 1;
+			line_begin_ = position_;
+			if (end - begin > kMaxLineLength)
+			{
+				return PARSE_ERROR;
+			}
+
+			// Tolerates bare LF line endings.
+			if (end > begin && data[end - 1] == '\r')
+			{
+				end--;
+			}
+
+			if (!OnLine(data, begin, end))
+			{
+				return PARSE_ERROR;
+			}
+
+			break;
+		}
+		}
+	}
+
+	consumed_ = position_;
+	return COMPLETE;
+}
+
+HttpResponseParser::Result HttpResponseParser::Finish()
+{
+	if (state_ == BODY_UNTIL_CLOSE)
+	{
+		state_ = DONE;
+		consumed_ = position_;
+	}
+
+	return state_ == DONE ? COMPLETE : PARSE_ERROR;
+}
+
+bool HttpResponseParser::keep_alive() const
+{
+	if (until_close_)
+	{
+		return false;
+	}
+
+	// HTTP/1.1 connections are persistent unless told otherwise, HTTP/1.0
+	// ones only when the server opts in.
+	return minor_version_ >= 1 ? !connection_close_ : connection_keep_alive_;
+}
+
+HttpSpan HttpResponseParser::body() const
+{
+	HttpSpan span = { body_offset_, body_length_ };
+	return span;
+}
+
+bool HttpResponseParser::GetHeader(const char* data, const char* name, HttpSpan* value) const
+{
+	for (int i = 0; i < header_count_; ++i)
+	{
+		if (EqualsIgnoreCase(data + header_names_[i].offset, header_names_[i].length, name))
+		{
+			*value = header_values_[i];
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool HttpResponseParser::GetHeaderInt(const char* data, const char* name, int64_t* value) const
+{
+	HttpSpan span;
+	return GetHeader(data, name, &span) && ParseInt(data + span.offset, span.length, value);
+}
+
+bool HttpResponseParser::ParseInt(const char* data, size_t length, int64_t* value)
+{
+	// Up to 18 digits, so that the value can't overflow.
+	if (length == 0 || length > 18)
+	{
+		return false;
+	}
+
+	int64_t result = 0;
+	for (size_t i = 0; i < length; ++i)
+	{
+		if (data[i] < '0' || data[i] > '9')
+		{
+			return false;
+		}
+
+		result = result * 10 + (data[i] - '0');
+	}
+
+	*value = result;
+	return true;
+}
+
+bool HttpResponseParser::OnLine(char* data, size_t begin, size_t end)
+{
+	switch (state_)
+	{
+	case STATUS_LINE:
+		if (!ParseStatusLine(data, begin, end))
+		{
+			return false;
+		}
+
+		state_ = HEADER_LINE;
+		return true;
+
+	case HEADER_LINE:
+		if (begin == end)
+		{
+			OnHeadersComplete();
+			return true;
+		}
+
+		return ParseHeaderLine(data, begin, end);
+
+	case CHUNK_SIZE:
+		return ParseChunkSize(data, begin, end);
+
+	case CHUNK_DATA_END:
+		// Chunk data must be followed by an empty line.
+		if (begin != end)
+		{
+			return false;
+		}
+
+		state_ = CHUNK_SIZE;
+		return true;
+
+	case CHUNK_TRAILER:
+		// Trailer headers are ignored, the response ends with an empty line.
+		if (begin == end)
+		{
+			state_ = DONE;
+		}
+
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+bool HttpResponseParser::ParseStatusLine(const char* data, size_t begin, size_t end)
+{
+	// "HTTP/1.x NNN reason"
+	const char kVersionPrefix[] = "HTTP/1.";
+	const size_t kPrefixLength = sizeof(kVersionPrefix) - 1;
+	if (end - begin < kPrefixLength + 5 ||
+		memcmp(data + begin, kVersionPrefix, kPrefixLength) != 0)
+	{
+		return false;
+	}
+
+	size_t pos = begin + kPrefixLength;
+	if (data[pos] < '0' || data[pos] > '9' || data[pos + 1] != ' ')
+	{
+		return false;
+	}
+
+	minor_version_ = data[pos] - '0';
+	pos += 2;
+
+	int64_t status = 0;
+	if (!ParseInt(data + pos, 3, &status) ||
+		(end - pos > 3 && data[pos + 3] != ' '))
+	{
+		return false;
+	}
+
+	status_code_ = static_cast<int>(status);
+	return true;
+}
+
+bool HttpResponseParser::ParseHeaderLine(const char* data, size_t begin, size_t end)
+{
+	const char* colon = static_cast<const char*>(memchr(data + begin, ':', end - begin));
+	if (!colon || colon == data + begin)
+	{
+		return false;
+	}
+
+	size_t name_end = colon - data;
+	for (size_t i = begin; i < name_end; ++i)
+	{
+		if (IsWhitespace(data[i]))
+		{
+			return false;
+		}
+	}
+
+	size_t value_begin = name_end + 1;
+	size_t value_end = end;
+	Trim(data, &value_begin, &value_end);
+
+	const char* name = data + begin;
+	size_t name_length = name_end - begin;
+	if (EqualsIgnoreCase(name, name_length, "Content-Length"))
+	{
+		int64_t content_length = 0;
+		if (!ParseInt(data + value_begin, value_end - value_begin, &content_length) ||
+			(content_length_ >= 0 && content_length_ != content_length))
+		{
+			return false;
+		}
+
+		content_length_ = content_length;
+	}
+	else if (EqualsIgnoreCase(name, name_length, "Transfer-Encoding"))
+	{
+		chunked_ = HasToken(data, value_begin, value_end, "chunked");
+	}
+	else if (EqualsIgnoreCase(name, name_length, "Connection"))
+	{
+		connection_close_ |= HasToken(data, value_begin, value_end, "close");
+		connection_keep_alive_ |= HasToken(data, value_begin, value_end, "keep-alive");
+	}
+
+	if (header_count_ < kMaxHeaders)
+	{
+		header_names_[header_count_].offset = begin;
+		header_names_[header_count_].length = name_length;
+		header_values_[header_count_].offset = value_begin;
+		header_values_[header_count_].length = value_end - value_begin;
+		header_count_++;
+	}
+
+	return true;
+}
+
+bool HttpResponseParser::ParseChunkSize(const char* data, size_t begin, size_t end)
+{
+	// Chunk extensions, after ';', are ignored.
+	const char* extension = static_cast<const char*>(memchr(data + begin, ';', end - begin));
+	size_t size_end = extension ? extension - data : end;
+	Trim(data, &begin, &size_end);
+
+	// Up to 15 hex digits, so that the size can't overflow.
+	if (begin == size_end || size_end - begin > 15)
+	{
+		return false;
+	}
+
+	uint64_t size = 0;
+	for (size_t i = begin; i < size_end; ++i)
+	{
+		char c = ToLower(data[i]);
+		int digit;
+		if (c >= '0' && c <= '9')
+		{
+			digit = c - '0';
+		}
+		else if (c >= 'a' && c <= 'f')
+		{
+			digit = c - 'a' + 10;
+		}
+		else
+		{
+			return false;
+		}
+
+		size = (size << 4) | digit;
+	}
+
+	chunk_remaining_ = size;
+	state_ = size > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+	return true;
+}
+
+void HttpResponseParser::OnHeadersComplete()
+{
+	body_offset_ = position_;
+	body_length_ = 0;
+
+	// Informational, no content and not modified responses have no body.
+	if ((status_code_ >= 100 && status_code_ < 200) ||
+		status_code_ == 204 || status_code_ == 304)
+	{
+		state_ = DONE;
+	}
+	else if (chunked_)
+	{
+		// Transfer-Encoding takes precedence over Content-Length.
+		state_ = CHUNK_SIZE;
+	}
+	else if (content_length_ >= 0)
+	{
+		state_ = content_length_ > 0 ? BODY_IDENTITY : DONE;
+	}
+	else
+	{
+		state_ = BODY_UNTIL_CLOSE;
+		until_close_ = true;
+	}
+}
@@ -0,0 +1,93 @@
+#include "input_coalescer.h"
+
+#include <algorithm>
+
+namespace
+{
+	const int kDefaultFrameRate = 60;
+	const int kMaxIntervalMs = 100;
+
+	// Updates in flight per round trip on slow links.
+	const int kUpdatesPerRoundTrip = 4;
+}
+
+InputCoalescer::InputCoalescer() :
+	frame_rate_(kDefaultFrameRate),
+	rtt_ms_(0),
+	last_flush_ms_(-1),
+	stats_()
+{
+	UpdateInterval();
+}
+
+void InputCoalescer::SetFrameRate(int frame_rate)
+{
+	frame_rate_ = frame_rate > 0 ? frame_rate : kDefaultFrameRate;
+	UpdateInterval();
+}
+
+void InputCoalescer::SetRoundTripTimeMs(int rtt_ms)
+{
+	rtt_ms_ = (std::max)(rtt_ms, 0);
+	UpdateInterval();
+}
+
+void InputCoalescer::Update(InputMessage::Type type, const std::string& message)
+{
+	stats_.updates++;
+	pending_[type] = message;
+}
+
+int64_t InputCoalescer::NextFlushMs() const
+{
+	if (pending_.empty())
+	{
+		return -1;
+	}
+
+	// Idle until now, no reason to hold the first update back.
+	return last_flush_ms_ < 0 ? 0 : last_flush_ms_ + stats_.interval_ms;
+}
+
+void InputCoalescer::Flush(int64_t now_ms, std::vector<std::string>* messages)
+{
+	int64_t due_ms = NextFlushMs();
+	if (due_ms < 0 || now_ms < due_ms)
+	{
+		return;
+	}
+
+	TakePending(messages);
+
+	// Keeps the schedule when the flush runs a little late, restarts it
+	// after a longer gap.
+	last_flush_ms_ = last_flush_ms_ >= 0 && now_ms - due_ms < stats_.interval_ms ? due_ms : now_ms;
+}
+
+void InputCoalescer::FlushNow(int64_t now_ms, std::vector<std::string>* messages)
+{
+	if (!pending_.empty())
+	{
+		TakePending(messages);
+		last_flush_ms_ = now_ms;
+	}
+}
+
+void InputCoalescer::TakePending(std::vector<std::string>* messages)
+{
+	for (auto& value : pending_)
+	{
+		messages->push_back(std::move(value.second));
+		stats_.sent++;
+	}
+
+	pending_.clear();
+}
+
+void InputCoalescer::UpdateInterval()
+{
+	// Rounded down, at least one update per server frame.
+	int frame_interval_ms = 1000 / frame_rate_;
+	stats_.interval_ms = (std::min)((std::max)(frame_interval_ms, rtt_ms_ / kUpdatesPerRoundTrip),
+		kMaxIntervalMs);
+}
@@ -0,0 +1,180 @@
+#include "input_latency.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+	// Frames kept waiting for the other half of their measurement, a few
+	// seconds of video.
+	const size_t kMaxPendingFrames = 256;
+
+	// Measurements the percentiles are computed over.
+	const size_t kMaxSamples = 1024;
+}
+
+FrameInputTagger::FrameInputTagger() :
+	tagged_timestamp_us_(0),
+	tagged_frames_(0)
+{
+}
+
+bool FrameInputTagger::OnFrameDelivered(int64_t capture_ntp_ms, int64_t timestamp_us,
+	int64_t push_time_us, int64_t now_us, FrameInput* frame_input)
+{
+	if (timestamp_us == 0)
+	{
+		return false;
+	}
+
+	if (timestamp_us != tagged_timestamp_us_)
+	{
+		tagged_timestamp_us_ = timestamp_us;
+		tagged_frames_ = 0;
+	}
+
+	if (tagged_frames_ == kMaxTaggedFrames)
+	{
+		return false;
+	}
+
+	tagged_frames_++;
+	frame_input->capture_ntp_ms = capture_ntp_ms;
+	frame_input->timestamp_us = timestamp_us;
+	frame_input->server_delay_us = now_us - push_time_us;
+	return true;
+}
+
+InputLatencyTracker::InputLatencyTracker() :
+	measured_timestamp_us_(0)
+{
+}
+
+void InputLatencyTracker::OnFrameInput(const FrameInput& frame_input)
+{
+	auto match = presented_frames_.end();
+	for (auto it = presented_frames_.begin(); it != presented_frames_.end(); ++it)
+	{
+		int64_t error_ms = llabs(it->capture_ntp_ms - frame_input.capture_ntp_ms);
+		if (error_ms <= kMaxNtpErrorMs &&
+			(match == presented_frames_.end() ||
+				error_ms < llabs(match->capture_ntp_ms - frame_input.capture_ntp_ms)))
+		{
+			match = it;
+		}
+	}
+
+	if (match != presented_frames_.end())
+	{
+		AddSample(frame_input, *match);
+		presented_frames_.erase(match);
+		return;
+	}
+
+	pending_inputs_.push_back(frame_input);
+	if (pending_inputs_.size() > kMaxPendingFrames)
+	{
+		// Its frame was dropped, by the encoder or the network.
+		pending_inputs_.pop_front();
+	}
+}
+
+void InputLatencyTracker::OnFramePresented(
+	int64_t capture_ntp_ms, int64_t decoded_time_us, int64_t now_us)
+{
+	if (capture_ntp_ms <= 0)
+	{
+		return;
+	}
+
+	PresentedFrame frame = { capture_ntp_ms, decoded_time_us, now_us };
+	auto match = pending_inputs_.end();
+	for (auto it = pending_inputs_.begin(); it != pending_inputs_.end(); ++it)
+	{
+		int64_t error_ms = llabs(it->capture_ntp_ms - capture_ntp_ms);
+		if (error_ms <= kMaxNtpErrorMs &&
+			(match == pending_inputs_.end() || error_ms < llabs(match->capture_ntp_ms - capture_ntp_ms)))
+		{
+			match = it;
+		}
+	}
+
+	if (match != pending_inputs_.end())
+	{
+		AddSample(*match, frame);
+		pending_inputs_.erase(match);
+		return;
+	}
+
+	// Most frames follow no new input and never get a tag.
+	presented_frames_.push_back(frame);
+	if (presented_frames_.size() > kMaxPendingFrames)
+	{
+		presented_frames_.pop_front();
+	}
+}
+
+InputLatencyStats InputLatencyTracker::GetStats() const
+{
+	InputLatencyStats stats;
+	stats.samples = static_cast<int>(samples_.size());
+	stats.total = GetPercentiles(&Sample::total_us);
+	stats.server = GetPercentiles(&Sample::server_us);
+	stats.transport = GetPercentiles(&Sample::transport_us);
+	stats.present = GetPercentiles(&Sample::present_us);
+	return stats;
+}
+
+void InputLatencyTracker::AddSample(const FrameInput& frame_input, const PresentedFrame& frame)
+{
+	// A later frame tagged with an input already measured.
+	if (frame_input.timestamp_us <= measured_timestamp_us_)
+	{
+		return;
+	}
+
+	Sample sample;
+	sample.total_us = frame.presented_time_us - frame_input.timestamp_us;
+	sample.server_us = frame_input.server_delay_us;
+	sample.present_us = frame.presented_time_us - frame.decoded_time_us;
+	sample.transport_us = sample.total_us - sample.server_us - sample.present_us;
+
+	// The input timestamp comes from another session or is garbled.
+	if (sample.total_us < 0 || sample.transport_us < 0)
+	{
+		return;
+	}
+
+	measured_timestamp_us_ = frame_input.timestamp_us;
+	samples_.push_back(sample);
+	if (samples_.size() > kMaxSamples)
+	{
+		samples_.pop_front();
+	}
+}
+
+LatencyPercentiles InputLatencyTracker::GetPercentiles(int64_t Sample::*component) const
+{
+	LatencyPercentiles percentiles = {};
+	if (samples_.empty())
+	{
+		return percentiles;
+	}
+
+	std::vector<int64_t> values;
+	values.reserve(samples_.size());
+	for (const Sample& sample : samples_)
+	{
+		values.push_back(sample.*component);
+	}
+
+	std::sort(values.begin(), values.end());
+	size_t last = values.size() - 1;
+	percentiles.p50_us = values[last * 50 / 100];
+	percentiles.p90_us = values[last * 90 / 100];
+	percentiles.p99_us = values[last * 99 / 100];
+	percentiles.max_us = values[last];
+	return percentiles;
+}
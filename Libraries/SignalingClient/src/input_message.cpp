@@ -0,0 +1,317 @@
+#include "input_message.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace
+{
+	const char kProtocolMessageType[] = "\"input-protocol\"";
+	const char kFrameInputMessageType[] = "\"input-frame\"";
+	const char kBodyMember[] = "\"body\"";
+
+	// Protocol and frame input messages are tiny, longer messages are never
+	// scanned.
+	const size_t kMaxProtocolMessageSize = 128;
+
+	// Payload size of each type, -1 for types without a binary encoding.
+	int PayloadSize(InputMessage::Type type)
+	{
+		switch (type)
+		{
+		case InputMessage::STEREO_RENDERING:
+			return 1;
+
+		case InputMessage::CAMERA_TRANSFORM_LOOKAT:
+			return 9 * 4;
+
+		case InputMessage::CAMERA_TRANSFORM:
+			return 6 * 4;
+
+		case InputMessage::CAMERA_TRANSFORM_STEREO:
+			return 32 * 4;
+
+		case InputMessage::KEYBOARD_EVENT:
+		case InputMessage::MOUSE_EVENT:
+			return 3 * 4;
+
+		default:
+			return -1;
+		}
+	}
+
+	void WriteUint32(uint32_t value, std::string* data)
+	{
+		char bytes[4] =
+		{
+			static_cast<char>(value),
+			static_cast<char>(value >> 8),
+			static_cast<char>(value >> 16),
+			static_cast<char>(value >> 24)
+		};
+
+		data->append(bytes, sizeof(bytes));
+	}
+
+	std::string WriteHeader(InputMessage::Type type, int64_t timestamp_us)
+	{
+		std::string data;
+		data.reserve(InputMessageCodec::kHeaderSize + InputMessageCodec::kTimestampSize +
+			PayloadSize(type));
+
+		data += static_cast<char>(InputMessageCodec::kMagic);
+		data += static_cast<char>(InputMessageCodec::kVersion);
+		data += static_cast<char>(type);
+		data += static_cast<char>(timestamp_us != 0 ? InputMessageCodec::kTimestampFlag : 0);
+		if (timestamp_us != 0)
+		{
+			uint64_t bits = static_cast<uint64_t>(timestamp_us);
+			WriteUint32(static_cast<uint32_t>(bits), &data);
+			WriteUint32(static_cast<uint32_t>(bits >> 32), &data);
+		}
+
+		return data;
+	}
+
+	void WriteFloats(const float* values, int count, std::string* data)
+	{
+		for (int i = 0; i < count; ++i)
+		{
+			uint32_t bits;
+			memcpy(&bits, &values[i], sizeof(bits));
+			WriteUint32(bits, data);
+		}
+	}
+
+	uint32_t ReadUint32(const char* data)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+		return static_cast<uint32_t>(bytes[0]) | (static_cast<uint32_t>(bytes[1]) << 8) |
+			(static_cast<uint32_t>(bytes[2]) << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+	}
+
+	const char* Find(const char* begin, const char* end, const char* literal)
+	{
+		const char* found = std::search(begin, end, literal, literal + strlen(literal));
+		return found == end ? nullptr : found;
+	}
+
+	// Start of the body of a JSON message of |type|, nullptr for any other
+	// message.
+	const char* FindBody(const char* data, size_t length, const char* type)
+	{
+		if (length > kMaxProtocolMessageSize || InputMessageCodec::IsBinary(data, length))
+		{
+			return nullptr;
+		}
+
+		const char* end = data + length;
+		const char* body = Find(data, end, kBodyMember);
+		if (!Find(data, end, type) || !body)
+		{
+			return nullptr;
+		}
+
+		// "body":"<value>", whitespace and quotes are optional.
+		const char* pos = body + strlen(kBodyMember);
+		while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r' || *pos == '\n' ||
+			*pos == ':' || *pos == '"'))
+		{
+			pos++;
+		}
+
+		return pos;
+	}
+
+	// Reads the decimal digits at |pos|, at most |max_digits|. Returns the
+	// position after them, nullptr if there are none.
+	const char* ReadDigits(const char* pos, const char* end, int max_digits, int64_t* value)
+	{
+		const char* digits = pos;
+		int64_t result = 0;
+		while (pos < end && *pos >= '0' && *pos <= '9' && pos - digits < max_digits)
+		{
+			result = result * 10 + (*pos++ - '0');
+		}
+
+		if (pos == digits)
+		{
+			return nullptr;
+		}
+
+		*value = result;
+		return pos;
+	}
+}
+
+InputMessage::InputMessage() :
+	type(UNKNOWN),
+	timestamp_us(0),
+	target_time_us(0),
+	stereo(false),
+	values(),
+	value_count(0),
+	message(0),
+	wparam(0),
+	lparam(0)
+{
+}
+
+std::string InputMessageCodec::WriteStereoRendering(bool stereo, int64_t timestamp_us)
+{
+	std::string data = WriteHeader(InputMessage::STEREO_RENDERING, timestamp_us);
+	data += stereo ? '\1' : '\0';
+	return data;
+}
+
+std::string InputMessageCodec::WriteCameraLookAt(const float eye[3], const float focus[3],
+	const float up[3], int64_t timestamp_us)
+{
+	std::string data = WriteHeader(InputMessage::CAMERA_TRANSFORM_LOOKAT, timestamp_us);
+	WriteFloats(eye, 3, &data);
+	WriteFloats(focus, 3, &data);
+	WriteFloats(up, 3, &data);
+	return data;
+}
+
+std::string InputMessageCodec::WriteCameraTransform(float x, float y, float z, float yaw,
+	float pitch, float roll, int64_t timestamp_us)
+{
+	const float values[] = { x, y, z, yaw, pitch, roll };
+	std::string data = WriteHeader(InputMessage::CAMERA_TRANSFORM, timestamp_us);
+	WriteFloats(values, 6, &data);
+	return data;
+}
+
+std::string InputMessageCodec::WriteCameraStereo(const float left[16], const float right[16],
+	int64_t timestamp_us)
+{
+	std::string data = WriteHeader(InputMessage::CAMERA_TRANSFORM_STEREO, timestamp_us);
+	WriteFloats(left, 16, &data);
+	WriteFloats(right, 16, &data);
+	return data;
+}
+
+std::string InputMessageCodec::WriteWindowEvent(InputMessage::Type type, uint32_t message,
+	uint32_t wparam, int32_t lparam, int64_t timestamp_us)
+{
+	std::string data = WriteHeader(type, timestamp_us);
+	WriteUint32(message, &data);
+	WriteUint32(wparam, &data);
+	WriteUint32(static_cast<uint32_t>(lparam), &data);
+	return data;
+}
+
+bool InputMessageCodec::IsBinary(const char* data, size_t length)
+{
+	return length > 0 && static_cast<uint8_t>(data[0]) == kMagic;
+}
+
+bool InputMessageCodec::Parse(const char* data, size_t length, InputMessage* message)
+{
+	if (length < kHeaderSize || !IsBinary(data, length) ||
+		static_cast<uint8_t>(data[1]) != kVersion || (data[3] & ~kTimestampFlag) != 0)
+	{
+		return false;
+	}
+
+	InputMessage::Type type = static_cast<InputMessage::Type>(static_cast<uint8_t>(data[2]));
+	size_t header_size = kHeaderSize + ((data[3] & kTimestampFlag) ? kTimestampSize : 0);
+	int payload_size = PayloadSize(type);
+	if (payload_size < 0 || length < header_size ||
+		length - header_size != static_cast<size_t>(payload_size))
+	{
+		return false;
+	}
+
+	message->timestamp_us = 0;
+	if (data[3] & kTimestampFlag)
+	{
+		uint64_t bits = ReadUint32(data + kHeaderSize) |
+			(static_cast<uint64_t>(ReadUint32(data + kHeaderSize + 4)) << 32);
+
+		message->timestamp_us = static_cast<int64_t>(bits);
+	}
+
+	const char* payload = data + header_size;
+	message->type = type;
+	message->value_count = 0;
+	switch (type)
+	{
+	case InputMessage::STEREO_RENDERING:
+		message->stereo = payload[0] != 0;
+		break;
+
+	case InputMessage::KEYBOARD_EVENT:
+	case InputMessage::MOUSE_EVENT:
+		message->message = ReadUint32(payload);
+		message->wparam = ReadUint32(payload + 4);
+		message->lparam = static_cast<int32_t>(ReadUint32(payload + 8));
+		break;
+
+	default:
+		message->value_count = payload_size / 4;
+		for (int i = 0; i < message->value_count; ++i)
+		{
+			uint32_t bits = ReadUint32(payload + i * 4);
+			memcpy(&message->values[i], &bits, sizeof(bits));
+		}
+
+		break;
+	}
+
+	return true;
+}
+
+std::string InputMessageCodec::WriteProtocolMessage(int version)
+{
+	return std::string("{\"type\":\"input-protocol\",\"body\":\"") + std::to_string(version) + "\"}";
+}
+
+bool InputMessageCodec::ParseProtocolMessage(const char* data, size_t length, int* version)
+{
+	const char* pos = FindBody(data, length, kProtocolMessageType);
+	int64_t value = 0;
+	if (!pos || !ReadDigits(pos, data + length, 4, &value))
+	{
+		return false;
+	}
+
+	*version = static_cast<int>(value);
+	return true;
+}
+
+std::string InputMessageCodec::WriteFrameInputMessage(const FrameInput& frame_input)
+{
+	return std::string("{\"type\":\"input-frame\",\"body\":\"") +
+		std::to_string(frame_input.capture_ntp_ms) + "," +
+		std::to_string(frame_input.timestamp_us) + "," +
+		std::to_string(frame_input.server_delay_us) + "\"}";
+}
+
+bool InputMessageCodec::ParseFrameInputMessage(
+	const char* data, size_t length, FrameInput* frame_input)
+{
+	const char* end = data + length;
+	const char* pos = FindBody(data, length, kFrameInputMessageType);
+	int64_t values[3] = { 0, 0, 0 };
+	for (int i = 0; i < 3; i++)
+	{
+		if (pos && i > 0)
+		{
+			pos = pos < end && *pos == ',' ? pos + 1 : nullptr;
+		}
+
+		pos = pos ? ReadDigits(pos, end, 18, &values[i]) : nullptr;
+	}
+
+	if (!pos)
+	{
+		return false;
+	}
+
+	frame_input->capture_ntp_ms = values[0];
+	frame_input->timestamp_us = values[1];
+	frame_input->server_delay_us = values[2];
+	return true;
+}
@@ -0,0 +1,559 @@
+#include "input_parser.h"
+
+#include <math.h>
+#include <string.h>
+
+namespace
+{
+	// A body value string, escapes are left in place.
+	struct Span
+	{
+		const char* begin;
+		const char* end;
+	};
+
+	struct TypeName
+	{
+		const char* name;
+		InputMessage::Type type;
+		int value_count;
+	};
+
+	const TypeName kTypeNames[] =
+	{
+		{ "stereo-rendering", InputMessage::STEREO_RENDERING, 1 },
+		{ "camera-transform-lookat", InputMessage::CAMERA_TRANSFORM_LOOKAT, 9 },
+		{ "camera-transform", InputMessage::CAMERA_TRANSFORM, 6 },
+		{ "camera-transform-stereo", InputMessage::CAMERA_TRANSFORM_STEREO, 32 },
+		{ "keyboard-event", InputMessage::KEYBOARD_EVENT, 0 },
+		{ "mouse-event", InputMessage::MOUSE_EVENT, 0 },
+	};
+
+	// Powers of ten of the common exponents, others go through pow(). The
+	// negative ones are multiplied rather than divided by, their rounding
+	// error in double is far below float precision.
+	const double kPowersOfTen[] =
+	{
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+		1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+	const double kNegativePowersOfTen[] =
+	{
+		1e-0, 1e-1, 1e-2, 1e-3, 1e-4, 1e-5, 1e-6, 1e-7, 1e-8, 1e-9, 1e-10, 1e-11,
+		1e-12, 1e-13, 1e-14, 1e-15, 1e-16, 1e-17, 1e-18, 1e-19, 1e-20, 1e-21, 1e-22
+	};
+
+	// Significant digits which still fit a uint64_t.
+	const int kMaxMantissaDigits = 19;
+
+	bool IsSpace(char c)
+	{
+		return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+	}
+
+	bool IsDigit(char c)
+	{
+		return c >= '0' && c <= '9';
+	}
+
+	const char* SkipSpaces(const char* pos, const char* end)
+	{
+		while (pos < end && IsSpace(*pos))
+		{
+			pos++;
+		}
+
+		return pos;
+	}
+
+	bool Equals(const Span& span, const char* literal)
+	{
+		size_t length = strlen(literal);
+		return static_cast<size_t>(span.end - span.begin) == length &&
+			memcmp(span.begin, literal, length) == 0;
+	}
+
+	// Scans the string starting at the opening quote at |pos|. Returns the
+	// position after the closing quote, or nullptr if it isn't terminated.
+	const char* ScanString(const char* pos, const char* end, Span* span)
+	{
+		span->begin = ++pos;
+		while (pos < end)
+		{
+			// memchr is vectorized by the C runtimes, much faster than a
+			// byte loop on the long bodies.
+			const char* quote = static_cast<const char*>(memchr(pos, '"', end - pos));
+			if (!quote)
+			{
+				return nullptr;
+			}
+
+			// Escaped if preceded by an odd number of backslashes.
+			const char* escape = quote;
+			while (escape > span->begin && escape[-1] == '\\')
+			{
+				escape--;
+			}
+
+			if ((quote - escape) % 2 == 0)
+			{
+				span->end = quote;
+				return quote + 1;
+			}
+
+			pos = quote + 1;
+		}
+
+		return nullptr;
+	}
+
+	// Walks the top level members of a flat JSON object and keeps the
+	// "type" and "body" strings and the "timestamp" and "targetTime"
+	// numbers. Nested values are rejected, no input message has any.
+	bool ScanEnvelope(const char* data, size_t length, Span* type, Span* body, Span* timestamp,
+		Span* target_time)
+	{
+		const char* end = data + length;
+		const char* pos = SkipSpaces(data, end);
+		if (pos == end || *pos++ != '{')
+		{
+			return false;
+		}
+
+		type->begin = type->end = nullptr;
+		body->begin = body->end = nullptr;
+		timestamp->begin = timestamp->end = nullptr;
+		target_time->begin = target_time->end = nullptr;
+		pos = SkipSpaces(pos, end);
+		if (pos < end && *pos == '}')
+		{
+			return false;
+		}
+
+		while (pos < end)
+		{
+			Span key;
+			if (*pos != '"' || !(pos = ScanString(pos, end, &key)))
+			{
+				return false;
+			}
+
+			pos = SkipSpaces(pos, end);
+			if (pos == end || *pos++ != ':')
+			{
+				return false;
+			}
+
+			pos = SkipSpaces(pos, end);
+			if (pos == end || *pos == '{' || *pos == '[')
+			{
+				return false;
+			}
+
+			if (*pos == '"')
+			{
+				Span value;
+				if (!(pos = ScanString(pos, end, &value)))
+				{
+					return false;
+				}
+
+				if (Equals(key, "type"))
+				{
+					*type = value;
+				}
+				else if (Equals(key, "body"))
+				{
+					*body = value;
+				}
+			}
+			else
+			{
+				// Numbers, true, false and null.
+				Span value;
+				value.begin = pos;
+				while (pos < end && *pos != ',' && *pos != '}' && !IsSpace(*pos))
+				{
+					pos++;
+				}
+
+				value.end = pos;
+				if (Equals(key, "timestamp"))
+				{
+					*timestamp = value;
+				}
+				else if (Equals(key, "targetTime"))
+				{
+					*target_time = value;
+				}
+			}
+
+			pos = SkipSpaces(pos, end);
+			if (pos == end)
+			{
+				return false;
+			}
+
+			if (*pos == '}')
+			{
+				return type->begin && body->begin;
+			}
+
+			if (*pos++ != ',')
+			{
+				return false;
+			}
+
+			pos = SkipSpaces(pos, end);
+		}
+
+		return false;
+	}
+
+	// Parses a decimal float at |*pos|, advancing it past the number.
+	bool ParseFloat(const char** pos, const char* end, float* value)
+	{
+		const char* p = *pos;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p++ == '-';
+		}
+
+		uint64_t mantissa = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool any_digit = false;
+		for (; p < end && IsDigit(*p); ++p)
+		{
+			any_digit = true;
+			if (digits < kMaxMantissaDigits)
+			{
+				mantissa = mantissa * 10 + (*p - '0');
+				digits += mantissa != 0;
+			}
+			else
+			{
+				exponent++;
+			}
+		}
+
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && IsDigit(*p); ++p)
+			{
+				any_digit = true;
+				if (digits < kMaxMantissaDigits)
+				{
+					mantissa = mantissa * 10 + (*p - '0');
+					digits += mantissa != 0;
+					exponent--;
+				}
+			}
+		}
+
+		if (!any_digit)
+		{
+			return false;
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			const char* e = p + 1;
+			bool negative_exponent = false;
+			if (e < end && (*e == '-' || *e == '+'))
+			{
+				negative_exponent = *e++ == '-';
+			}
+
+			if (e == end || !IsDigit(*e))
+			{
+				return false;
+			}
+
+			int explicit_exponent = 0;
+			for (; e < end && IsDigit(*e); ++e)
+			{
+				// Saturates, anything this large is out of float range anyway.
+				if (explicit_exponent < 1000)
+				{
+					explicit_exponent = explicit_exponent * 10 + (*e - '0');
+				}
+			}
+
+			exponent += negative_exponent ? -explicit_exponent : explicit_exponent;
+			p = e;
+		}
+
+		double result = static_cast<double>(mantissa);
+		if (exponent >= 0 && exponent <= 22)
+		{
+			result *= kPowersOfTen[exponent];
+		}
+		else if (exponent < 0 && exponent >= -22)
+		{
+			result *= kNegativePowersOfTen[-exponent];
+		}
+		else if (mantissa != 0)
+		{
+			result *= pow(10.0, exponent);
+		}
+
+		*value = static_cast<float>(negative ? -result : result);
+		*pos = p;
+		return true;
+	}
+
+	// Parses the integer at |pos|. Returns the position after it, or nullptr
+	// if there is none or it overflows.
+	const char* ParseInteger(const char* pos, const char* end, int64_t* value)
+	{
+		bool negative = pos < end && *pos == '-';
+		pos += negative;
+		if (pos == end || !IsDigit(*pos))
+		{
+			return nullptr;
+		}
+
+		int64_t result = 0;
+		for (; pos < end && IsDigit(*pos); ++pos)
+		{
+			if (result > (INT64_MAX - 9) / 10)
+			{
+				return nullptr;
+			}
+
+			result = result * 10 + (*pos - '0');
+		}
+
+		*value = negative ? -result : result;
+		return pos;
+	}
+
+	// Parses the integer following |key| in the escaped JSON object of a
+	// keyboard or mouse event body, {\"message\" : 512, \"wParam\" : 0}.
+	bool FindInteger(const Span& body, const char* key, int64_t* value)
+	{
+		size_t key_length = strlen(key);
+		for (const char* pos = body.begin; pos + key_length <= body.end; ++pos)
+		{
+			pos = static_cast<const char*>(memchr(pos, key[0], body.end - pos));
+			if (!pos || pos + key_length > body.end)
+			{
+				return false;
+			}
+
+			if (memcmp(pos, key, key_length) != 0)
+			{
+				continue;
+			}
+
+			const char* p = pos + key_length;
+			while (p < body.end && (IsSpace(*p) || *p == '\\' || *p == '"' || *p == ':'))
+			{
+				p++;
+			}
+
+			return ParseInteger(p, body.end, value) != nullptr;
+		}
+
+		return false;
+	}
+
+	bool ParseWindowEvent(const Span& body, bool mouse, InputMessage* message)
+	{
+		int64_t msg = 0;
+		int64_t wparam = 0;
+		int64_t lparam = 0;
+		if (!FindInteger(body, "message", &msg) || !FindInteger(body, "wParam", &wparam) ||
+			(mouse && !FindInteger(body, "lParam", &lparam)))
+		{
+			return false;
+		}
+
+		message->message = static_cast<uint32_t>(msg);
+		message->wparam = static_cast<uint32_t>(wparam);
+		message->lparam = static_cast<int32_t>(lparam);
+		return true;
+	}
+
+	bool ParseJson(const char* data, size_t length, InputMessage* message)
+	{
+		Span type;
+		Span body;
+		Span timestamp;
+		Span target_time;
+		if (!ScanEnvelope(data, length, &type, &body, &timestamp, &target_time))
+		{
+			return false;
+		}
+
+		message->timestamp_us = 0;
+		if (timestamp.begin &&
+			ParseInteger(timestamp.begin, timestamp.end, &message->timestamp_us) != timestamp.end)
+		{
+			return false;
+		}
+
+		message->target_time_us = 0;
+		if (target_time.begin &&
+			ParseInteger(target_time.begin, target_time.end, &message->target_time_us) != target_time.end)
+		{
+			return false;
+		}
+
+		const TypeName* type_name = nullptr;
+		for (const TypeName& candidate : kTypeNames)
+		{
+			if (Equals(type, candidate.name))
+			{
+				type_name = &candidate;
+				break;
+			}
+		}
+
+		if (!type_name)
+		{
+			return false;
+		}
+
+		message->type = type_name->type;
+		message->value_count = 0;
+		switch (type_name->type)
+		{
+		case InputMessage::STEREO_RENDERING:
+		{
+			float stereo = 0;
+			if (!InputParser::ParseFloats(body.begin, body.end, &stereo, 1))
+			{
+				return false;
+			}
+
+			message->stereo = stereo == 1;
+			return true;
+		}
+
+		case InputMessage::KEYBOARD_EVENT:
+		case InputMessage::MOUSE_EVENT:
+			return ParseWindowEvent(body, type_name->type == InputMessage::MOUSE_EVENT, message);
+
+		default:
+			if (!InputParser::ParseFloats(body.begin, body.end, message->values, type_name->value_count))
+			{
+				return false;
+			}
+
+			message->value_count = type_name->value_count;
+			return true;
+		}
+	}
+}
+
+void InputHandler::OnStereoRendering(bool)
+{
+}
+
+void InputHandler::OnCameraLookAt(const float[3], const float[3], const float[3])
+{
+}
+
+void InputHandler::OnCameraTransform(const float[6])
+{
+}
+
+void InputHandler::OnCameraStereo(const float[16], const float[16], int64_t)
+{
+}
+
+void InputHandler::OnKeyboardEvent(uint32_t, uint32_t)
+{
+}
+
+void InputHandler::OnMouseEvent(uint32_t, uint32_t, int32_t)
+{
+}
+
+bool InputParser::Parse(const char* data, size_t length, InputMessage* message)
+{
+	if (InputMessageCodec::IsBinary(data, length))
+	{
+		return InputMessageCodec::Parse(data, length, message);
+	}
+
+	return ParseJson(data, length, message);
+}
+
+bool InputParser::Dispatch(const char* data, size_t length, InputHandler* handler)
+{
+	InputMessage message;
+	if (!Parse(data, length, &message))
+	{
+		return false;
+	}
+
+	const float* values = message.values;
+	switch (message.type)
+	{
+	case InputMessage::STEREO_RENDERING:
+		handler->OnStereoRendering(message.stereo);
+		break;
+
+	case InputMessage::CAMERA_TRANSFORM_LOOKAT:
+		handler->OnCameraLookAt(&values[0], &values[3], &values[6]);
+		break;
+
+	case InputMessage::CAMERA_TRANSFORM:
+		handler->OnCameraTransform(values);
+		break;
+
+	case InputMessage::CAMERA_TRANSFORM_STEREO:
+		handler->OnCameraStereo(&values[0], &values[16], message.target_time_us);
+		break;
+
+	case InputMessage::KEYBOARD_EVENT:
+		handler->OnKeyboardEvent(message.message, message.wparam);
+		break;
+
+	case InputMessage::MOUSE_EVENT:
+		handler->OnMouseEvent(message.message, message.wparam, message.lparam);
+		break;
+
+	default:
+		return false;
+	}
+
+	return true;
+}
+
+bool InputParser::ParseFloats(const char* begin, const char* end, float* values, int count)
+{
+	const char* pos = begin;
+	for (int i = 0; i < count; ++i)
+	{
+		pos = SkipSpaces(pos, end);
+		if (i > 0)
+		{
+			if (pos == end || *pos++ != ',')
+			{
+				return false;
+			}
+
+			pos = SkipSpaces(pos, end);
+		}
+
+		if (!ParseFloat(&pos, end, &values[i]))
+		{
+			return false;
+		}
+	}
+
+	// Tolerates a trailing separator, not another value.
+	pos = SkipSpaces(pos, end);
+	if (pos < end && *pos == ',')
+	{
+		pos = SkipSpaces(pos + 1, end);
+	}
+
+	return pos == end;
+}
@@ -0,0 +1,212 @@
+#include "input_queue.h"
+
+struct InputQueue::Slot
+{
+	// Position the slot is ready for, see Push() and Pop().
+	std::atomic<size_t> sequence;
+	std::string message;
+	int64_t push_time_us;
+	int64_t client_timestamp_us;
+};
+
+namespace
+{
+	size_t RoundUpToPowerOfTwo(size_t value)
+	{
+		size_t result = 2;
+		while (result < value)
+		{
+			result <<= 1;
+		}
+
+		return result;
+	}
+}
+
+InputQueue::InputQueue(size_t capacity, OverflowPolicy policy) :
+	mask_(RoundUpToPowerOfTwo(capacity) - 1),
+	policy_(policy),
+	slots_(new Slot[mask_ + 1]),
+	push_position_(0),
+	pop_position_(0),
+	pushed_(0),
+	dropped_(0),
+	drained_(0),
+	total_latency_us_(0),
+	max_latency_us_(0),
+	last_client_timestamp_us_(0),
+	last_client_push_time_us_(0)
+{
+	for (size_t i = 0; i <= mask_; i++)
+	{
+		slots_[i].sequence.store(i, std::memory_order_relaxed);
+		slots_[i].push_time_us = 0;
+		slots_[i].client_timestamp_us = 0;
+	}
+}
+
+InputQueue::~InputQueue()
+{
+}
+
+// A slot holds a message for position |pos| once its sequence is pos + 1,
+// and is free for position |pos| while its sequence is pos. Producers and
+// the consumer claim positions by compare and swap, then publish the slot
+// through its sequence.
+bool InputQueue::Push(
+	const char* data, size_t length, int64_t now_us, int64_t client_timestamp_us)
+{
+	pushed_.fetch_add(1, std::memory_order_relaxed);
+
+	bool dropped = false;
+	size_t pos = push_position_.load(std::memory_order_relaxed);
+	Slot* slot = nullptr;
+	for (;;)
+	{
+		slot = &slots_[pos & mask_];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+		if (diff == 0)
+		{
+			if (push_position_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+			{
+				break;
+			}
+		}
+		else if (diff < 0)
+		{
+			// Full.
+			if (policy_ == DROP_NEWEST)
+			{
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			if (DropOldest())
+			{
+				dropped_.fetch_add(1, std::memory_order_relaxed);
+				dropped = true;
+			}
+
+			pos = push_position_.load(std::memory_order_relaxed);
+		}
+		else
+		{
+			pos = push_position_.load(std::memory_order_relaxed);
+		}
+	}
+
+	slot->message.assign(data, length);
+	slot->push_time_us = now_us;
+	slot->client_timestamp_us = client_timestamp_us;
+	slot->sequence.store(pos + 1, std::memory_order_release);
+	return !dropped;
+}
+
+size_t InputQueue::Drain(int64_t now_us, void (*input_update_func)(const std::string&))
+{
+	// Swapped with the slots, so the buffers are recycled.
+	std::string message;
+	int64_t push_time_us = 0;
+	int64_t client_timestamp_us = 0;
+	size_t count = 0;
+	int64_t max_latency_us = max_latency_us_.load(std::memory_order_relaxed);
+	while (count <= mask_ && Pop(&message, &push_time_us, &client_timestamp_us))
+	{
+		if (client_timestamp_us != 0)
+		{
+			last_client_timestamp_us_ = client_timestamp_us;
+			last_client_push_time_us_ = push_time_us;
+		}
+
+		int64_t latency_us = now_us - push_time_us;
+		total_latency_us_.fetch_add(latency_us, std::memory_order_relaxed);
+		if (latency_us > max_latency_us)
+		{
+			max_latency_us = latency_us;
+			max_latency_us_.store(max_latency_us, std::memory_order_relaxed);
+		}
+
+		count++;
+		if (input_update_func)
+		{
+			input_update_func(message);
+		}
+	}
+
+	drained_.fetch_add(count, std::memory_order_relaxed);
+	return count;
+}
+
+InputQueueStats InputQueue::GetStats() const
+{
+	InputQueueStats stats;
+	stats.pushed = pushed_.load(std::memory_order_relaxed);
+	stats.dropped = dropped_.load(std::memory_order_relaxed);
+	stats.drained = drained_.load(std::memory_order_relaxed);
+	stats.total_latency_us = total_latency_us_.load(std::memory_order_relaxed);
+	stats.max_latency_us = max_latency_us_.load(std::memory_order_relaxed);
+	return stats;
+}
+
+bool InputQueue::Pop(std::string* message, int64_t* push_time_us, int64_t* client_timestamp_us)
+{
+	size_t pos = 0;
+	Slot* slot = Claim(&pos);
+	if (!slot)
+	{
+		return false;
+	}
+
+	message->swap(slot->message);
+	*push_time_us = slot->push_time_us;
+	*client_timestamp_us = slot->client_timestamp_us;
+	Release(slot, pos);
+	return true;
+}
+
+bool InputQueue::DropOldest()
+{
+	size_t pos = 0;
+	Slot* slot = Claim(&pos);
+	if (!slot)
+	{
+		return false;
+	}
+
+	Release(slot, pos);
+	return true;
+}
+
+InputQueue::Slot* InputQueue::Claim(size_t* pos)
+{
+	*pos = pop_position_.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		Slot* slot = &slots_[*pos & mask_];
+		size_t sequence = slot->sequence.load(std::memory_order_acquire);
+		intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(*pos + 1);
+		if (diff == 0)
+		{
+			if (pop_position_.compare_exchange_weak(*pos, *pos + 1, std::memory_order_relaxed))
+			{
+				return slot;
+			}
+		}
+		else if (diff < 0)
+		{
+			// Empty, or the next message is still being written.
+			return nullptr;
+		}
+		else
+		{
+			*pos = pop_position_.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+void InputQueue::Release(Slot* slot, size_t pos)
+{
+	// Free for the position one lap later.
+	slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+}
@@ -0,0 +1,209 @@
+#include "message_chunker.h"
+
+#include <algorithm>
+
+namespace
+{
+	// Incomplete messages are dropped after this long without a chunk.
+	const int64_t kReassemblyTimeoutMs = 10000;
+
+	void WriteUint32(uint32_t value, std::string* data)
+	{
+		char bytes[4] =
+		{
+			static_cast<char>(value),
+			static_cast<char>(value >> 8),
+			static_cast<char>(value >> 16),
+			static_cast<char>(value >> 24)
+		};
+
+		data->append(bytes, sizeof(bytes));
+	}
+
+	uint32_t ReadUint32(const char* data)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+		return static_cast<uint32_t>(bytes[0]) |
+			static_cast<uint32_t>(bytes[1]) << 8 |
+			static_cast<uint32_t>(bytes[2]) << 16 |
+			static_cast<uint32_t>(bytes[3]) << 24;
+	}
+}
+
+MessageChunker::MessageChunker(size_t chunk_size) :
+	chunk_size_((std::max)(chunk_size, kHeaderSize + 1)),
+	next_id_(0),
+	pending_bytes_(0)
+{
+}
+
+bool MessageChunker::Add(const std::string& payload)
+{
+	if (payload.size() > kMaxPayloadSize)
+	{
+		return false;
+	}
+
+	Message message;
+	message.id = next_id_++;
+	message.sequence = 0;
+	message.offset = 0;
+	message.payload = payload;
+	messages_.push_back(std::move(message));
+	pending_bytes_ += payload.size();
+	return true;
+}
+
+bool MessageChunker::Next(std::string* chunk)
+{
+	if (messages_.empty())
+	{
+		return false;
+	}
+
+	Message message = std::move(messages_.front());
+	messages_.pop_front();
+
+	size_t length = (std::min)(message.payload.size() - message.offset, chunk_size_ - kHeaderSize);
+	bool last = message.offset + length == message.payload.size();
+
+	chunk->clear();
+	chunk->reserve(kHeaderSize + length);
+	*chunk += static_cast<char>(kMagic);
+	*chunk += static_cast<char>(last ? kLastChunkFlag : 0);
+	WriteUint32(message.id, chunk);
+	WriteUint32(message.sequence, chunk);
+	WriteUint32(static_cast<uint32_t>(message.payload.size()), chunk);
+	chunk->append(message.payload, message.offset, length);
+
+	pending_bytes_ -= length;
+	if (!last)
+	{
+		message.offset += length;
+		message.sequence++;
+		messages_.push_back(std::move(message));
+	}
+
+	return true;
+}
+
+void MessageChunker::Clear()
+{
+	messages_.clear();
+	pending_bytes_ = 0;
+}
+
+MessageReassembler::MessageReassembler(size_t max_messages, size_t max_buffered_bytes) :
+	max_messages_((std::max)(max_messages, static_cast<size_t>(1))),
+	max_buffered_bytes_(max_buffered_bytes),
+	stats_()
+{
+}
+
+bool MessageReassembler::IsChunk(const char* data, size_t length)
+{
+	return length > 0 && static_cast<uint8_t>(data[0]) == MessageChunker::kMagic;
+}
+
+bool MessageReassembler::Add(const char* data, size_t length, int64_t now_ms, std::string* payload)
+{
+	for (size_t i = messages_.size(); i-- > 0;)
+	{
+		if (now_ms - messages_[i].last_chunk_ms > kReassemblyTimeoutMs)
+		{
+			Drop(i);
+		}
+	}
+
+	if (length < MessageChunker::kHeaderSize || !IsChunk(data, length))
+	{
+		stats_.dropped++;
+		return false;
+	}
+
+	const bool last = (data[1] & MessageChunker::kLastChunkFlag) != 0;
+	const uint32_t id = ReadUint32(data + 2);
+	const uint32_t sequence = ReadUint32(data + 6);
+	const uint32_t total_length = ReadUint32(data + 10);
+	const char* body = data + MessageChunker::kHeaderSize;
+	const size_t body_length = length - MessageChunker::kHeaderSize;
+
+	size_t index = 0;
+	while (index < messages_.size() && messages_[index].id != id)
+	{
+		index++;
+	}
+
+	// A restarted message replaces its incomplete copy.
+	if (index < messages_.size() && sequence == 0)
+	{
+		Drop(index);
+		index = messages_.size();
+	}
+
+	if (index == messages_.size())
+	{
+		if (sequence != 0 || total_length > MessageChunker::kMaxPayloadSize ||
+			total_length > max_buffered_bytes_)
+		{
+			stats_.dropped++;
+			return false;
+		}
+
+		// Evicts the messages which have waited the longest.
+		while (!messages_.empty() && (messages_.size() >= max_messages_ ||
+			stats_.buffered_bytes + total_length > max_buffered_bytes_))
+		{
+			size_t oldest = 0;
+			for (size_t i = 1; i < messages_.size(); ++i)
+			{
+				if (messages_[i].last_chunk_ms < messages_[oldest].last_chunk_ms)
+				{
+					oldest = i;
+				}
+			}
+
+			Drop(oldest);
+		}
+
+		Message message;
+		message.id = id;
+		message.next_sequence = 0;
+		message.length = total_length;
+		message.last_chunk_ms = now_ms;
+		message.payload.reserve(total_length);
+		messages_.push_back(std::move(message));
+		stats_.buffered_bytes += total_length;
+		index = messages_.size() - 1;
+	}
+
+	Message& message = messages_[index];
+	const size_t received = message.payload.size() + body_length;
+	if (sequence != message.next_sequence || total_length != message.length ||
+		received > message.length || (last != (received == message.length)))
+	{
+		Drop(index);
+		return false;
+	}
+
+	message.payload.append(body, body_length);
+	message.next_sequence++;
+	message.last_chunk_ms = now_ms;
+	if (!last)
+	{
+		return false;
+	}
+
+	*payload = std::move(message.payload);
+	stats_.buffered_bytes -= message.length;
+	stats_.completed++;
+	messages_.erase(messages_.begin() + index);
+	return true;
+}
+
+void MessageReassembler::Drop(size_t index)
+{
+	stats_.buffered_bytes -= messages_[index].length;
+	stats_.dropped++;
+	messages_.erase(messages_.begin() + index);
+}
@@ -8,11 +8,17 @@
  *  be found in the AUTHORS file in the root of the source tree.
  */
 
+#include <limits.h>
+#include <string.h>
+
 #include "peer_connection_client.h"
+#include "signaling_message.h"
+#include "tls_session_cache.h"
 #include "webrtc/base/checks.h"
 #include "webrtc/base/logging.h"
 #include "webrtc/base/nethelpers.h"
 #include "webrtc/base/stringutils.h"
+#include "webrtc/base/timeutils.h"
 
 #ifdef WIN32
 #include "webrtc/base/win32socketserver.h"
@@ -25,23 +31,76 @@ namespace
 	// This is our magical hangup signal.
 	const char kByeMessage[] = "BYE";
 
-	// Delay between server connection retries, in milliseconds
-	const int kReconnectDelay = 2000;
-
 	// The message id we use when scheduling a heartbeat operation
 	const int kHeartbeatScheduleId = 1523U;
 
+	// The message id delivering the batched peer list changes.
+	const int kPeerFlushId = 1524U;
+
+	// The message id switching to the next server address while connecting.
+	const int kHappyEyeballsId = 1525U;
+
+	// Time given to a server address before trying the next one, RFC 8305
+	// recommends 250 ms.
+	const int kHappyEyeballsDelayMs = 250;
+
+	// The message id of a reconnect attempt.
+	const int kReconnectId = 1526U;
+
+	// Consecutive failed waits which make us reconnect, the first one only
+	// waits again.
+	const int kMaxHangingGetFailures = 2;
+
+	// Peer list notifications received within this delay reach the peer
+	// observers as a single batch.
+	const int kPeerBatchDelayMs = 100;
+
 	// The default value for the tick heartbeat, used to disable the heartbeat
 	const int kHeartbeatDefault = -1;
+
+	// Requests sent on the control connection before waiting for responses.
+	const size_t kMaxPipelinedRequests = 4;
+
+	// Sign-in response header advertising that the server relays JSON arrays
+	// of messages.
+	const char kMessageBatchingHeader[] = "X-Message-Batching";
+
+	// Bytes received per Recv call, straight into the response buffer.
+	const size_t kReadChunkSize = 4096;
+
+	// Upper bound of candidates coalesced into a single request.
+	const int kMaxBatchedCandidates = 16;
+
+	// Only messages parsing to a complete candidate are batched, anything
+	// else, including text merely mentioning "candidate", is sent alone.
+	bool IsCandidateMessage(const std::string& message)
+	{
+		SignalingMessage parsed;
+		return SignalingMessageCodec::Parse(message, &parsed) && parsed.is_candidate();
+	}
 }
 
 PeerConnectionClient::PeerConnectionClient() :
 	callback_(NULL),
-    resolver_(NULL),
+	address_index_(0),
+	addresses_failed_(0),
+	connect_attempt_(0),
+	resolve_request_(0),
+	hanging_get_failures_(0),
     state_(NOT_CONNECTED),
     my_id_(-1),
 	heartbeat_tick_ms_(kHeartbeatDefault),
-	server_address_ssl_(false)
+	server_address_ssl_(false),
+	control_keep_alive_(true),
+	message_batching_(false),
+	queue_stats_(),
+	total_send_latency_ms_(0),
+	control_connections_(0),
+	control_requests_(0),
+	websocket_(false),
+	websocket_open_(false),
+	peer_flush_scheduled_(false),
+	heartbeat_scheduled_(false)
 {
 	// use the current thread or wrap a thread for signaling_thread_
 	auto thread = rtc::Thread::Current();
@@ -52,6 +111,10 @@ PeerConnectionClient::PeerConnectionClient() :
 
 PeerConnectionClient::~PeerConnectionClient()
 {
+	if (resolve_request_ != 0)
+	{
+		DnsCache::Instance()->Cancel(resolve_request_);
+	}
 }
 
 void PeerConnectionClient::InitSocketSignals()
@@ -80,7 +143,7 @@ bool PeerConnectionClient::is_connected() const
 	return my_id_ != -1;
 }
 
-const Peers& PeerConnectionClient::peers() const 
+const PeerDirectory& PeerConnectionClient::peers() const 
 {
 	return peers_;
 }
@@ -91,6 +154,11 @@ void PeerConnectionClient::RegisterObserver(PeerConnectionClientObserver* callba
 	callback_ = callback;
 }
 
+void PeerConnectionClient::RegisterPeerObserver(PeerDirectoryObserver* observer, const PeerFilter& filter)
+{
+	peers_.AddObserver(observer, filter);
+}
+
 void PeerConnectionClient::Connect(const std::string& server, int port, 
 	const std::string& client_name)
 {
@@ -117,6 +185,7 @@ void PeerConnectionClient::Connect(const std::string& server, int port,
 	}
 
 	std::string parsedServer = server;
+	websocket_ = false;
 
 	if (parsedServer.substr(0, 8).compare("https://") == 0)
 	{
@@ -127,18 +196,47 @@ void PeerConnectionClient::Connect(const std::string& server, int port,
 	{
 		parsedServer = parsedServer.substr(7);
 	}
+	else if (parsedServer.substr(0, 6).compare("wss://") == 0)
+	{
+		server_address_ssl_ = true;
+		websocket_ = true;
+		parsedServer = parsedServer.substr(6);
+	}
+	else if (parsedServer.substr(0, 5).compare("ws://") == 0)
+	{
+		websocket_ = true;
+		parsedServer = parsedServer.substr(5);
+	}
 
 	server_address_.SetIP(parsedServer);
 	server_address_.SetPort(port);
 	client_name_ = client_name;
 	std::replace(client_name_.begin(), client_name_.end(), ' ', '-');
 
+	server_addresses_.clear();
+	address_index_ = 0;
+	addresses_failed_ = 0;
+
 	if (server_address_.IsUnresolvedIP())
 	{
 		state_ = RESOLVING;
-		resolver_ = new rtc::AsyncResolver();
-		resolver_->SignalDone.connect(this, &PeerConnectionClient::OnResolveResult);
-		resolver_->Start(server_address_);
+
+		std::vector<rtc::IPAddress> addresses;
+		int error = 0;
+		DnsCache* dns_cache = DnsCache::Instance();
+		if (dns_cache->Lookup(server_address_.hostname(), &addresses, &error))
+		{
+			OnResolveResult(error, addresses);
+		}
+		else
+		{
+			resolve_request_ = dns_cache->Resolve(server_address_.hostname(),
+				[this](int error, const std::vector<rtc::IPAddress>& addresses)
+				{
+					resolve_request_ = 0;
+					OnResolveResult(error, addresses);
+				});
+		}
 	} 
 	else
 	{
@@ -146,23 +244,44 @@ void PeerConnectionClient::Connect(const std::string& server, int port,
 	}
 }
 
-void PeerConnectionClient::OnResolveResult(rtc::AsyncResolverInterface* resolver)
+void PeerConnectionClient::OnResolveResult(int error, const std::vector<rtc::IPAddress>& addresses)
 {
-	if (resolver_->GetError() != 0)
+	if (error != 0 || addresses.empty())
 	{
-		callback_->OnServerConnectionFailure();
-		resolver_->Destroy(false);
-		resolver_ = NULL;
 		state_ = NOT_CONNECTED;
+		callback_->OnServerConnectionFailure();
 	}
 	else
 	{
-		server_address_ = resolver_->address();
+		server_addresses_ = addresses;
+		server_address_.SetResolvedIP(server_addresses_[address_index_]);
 		DoConnect();
 	}
 }
 
-std::string PeerConnectionClient::PrepareRequest(const std::string& method, const std::string& fragment, std::map<std::string, std::string> headers)
+bool PeerConnectionClient::TryNextAddress()
+{
+	if (server_addresses_.size() < 2)
+	{
+		return false;
+	}
+
+	DnsCache::Instance()->ReportConnectResult(server_address_.hostname(),
+		server_address_.ipaddr(), false);
+
+	if (++addresses_failed_ >= server_addresses_.size())
+	{
+		return false;
+	}
+
+	address_index_ = (address_index_ + 1) % server_addresses_.size();
+	server_address_.SetResolvedIP(server_addresses_[address_index_]);
+	LOG(INFO) << "Trying server address " << server_address_.ToString();
+	return true;
+}
+
+std::string PeerConnectionClient::PrepareRequest(const std::string& method, const std::string& fragment, std::map<std::string, std::string> headers,
+	bool keep_alive)
 {
 	std::string result;
 
@@ -171,7 +290,12 @@ std::string PeerConnectionClient::PrepareRequest(const std::string& method, cons
 		result += (char)toupper(method[i]);
 	}
 
-	result += " " + fragment + " HTTP/1.0\r\n";
+	result += " " + fragment + (keep_alive ? " HTTP/1.1\r\n" : " HTTP/1.0\r\n");
+
+	if (keep_alive && headers.find("Connection") == headers.end())
+	{
+		headers["Connection"] = "keep-alive";
+	}
 
 	for (auto it = headers.begin(); it != headers.end(); ++it)
 	{
@@ -190,6 +314,8 @@ std::string PeerConnectionClient::PrepareRequest(const std::string& method, cons
 
 void PeerConnectionClient::DoConnect()
 {
+	connect_attempt_++;
+
 	control_socket_.reset(new SslCapableSocket(server_address_.ipaddr().family(), server_address_ssl_, signaling_thread_));
 	hanging_get_.reset(new SslCapableSocket(server_address_.ipaddr().family(), server_address_ssl_, signaling_thread_));
 	heartbeat_get_.reset(new SslCapableSocket(server_address_.ipaddr().family(), server_address_ssl_, signaling_thread_));
@@ -197,13 +323,64 @@ void PeerConnectionClient::DoConnect()
 	InitSocketSignals();
 	std::string clientName = client_name_;
 	std::string hostName = server_address_.hostname();
-	
-	onconnect_data_ = PrepareRequest("GET", "/sign_in?peer_name=" + clientName, { {"Host", hostName} });
 
-	bool ret = ConnectControlSocket();
+	// Messages queued while reconnecting wait for the sign in response.
+	bool resuming = state_ == RECONNECTING;
+	if (!resuming)
+	{
+		outbound_queue_.clear();
+	}
+
+	// Assumes keep-alive support until the server closes the connection.
+	control_queue_.clear();
+	control_in_flight_.clear();
+	control_data_.clear();
+	control_parser_.Reset();
+	control_keep_alive_ = true;
+	message_batching_ = false;
+	websocket_open_ = false;
+	websocket_framer_.Reset();
+
+	// Asks the server to give us our previous peer id back, servers which
+	// don't support it assign a new one.
+	std::string query = "?peer_name=" + clientName;
+	if (resuming)
+	{
+		query += "&peer_id=" + std::to_string(my_id_);
+	}
+
+	bool ret;
+	if (websocket_)
+	{
+		// Signs in with the opening handshake, the server answers with the
+		// peer list once the connection is upgraded.
+		websocket_key_ = WebSocketFramer::CreateKey();
+		ret = QueueControlRequest(
+			PrepareRequest("GET", "/ws" + query,
+			{
+				{"Host", hostName},
+				{"Upgrade", "websocket"},
+				{"Connection", "Upgrade"},
+				{"Sec-WebSocket-Key", websocket_key_},
+				{"Sec-WebSocket-Version", "13"}
+			},
+			true));
+	}
+	else
+	{
+		ret = QueueControlRequest(
+			PrepareRequest("GET", "/sign_in" + query, { {"Host", hostName} }, true));
+	}
+
 	if (ret)
 	{
-		state_ = SIGNING_IN;
+		state_ = resuming ? RECONNECTING : SIGNING_IN;
+
+		if (server_addresses_.size() > 1)
+		{
+			rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kHappyEyeballsDelayMs, this,
+				kHappyEyeballsId, new rtc::TypedMessageData<int>(connect_attempt_));
+		}
 	}
 
 	if (!ret) 
@@ -214,28 +391,26 @@ void PeerConnectionClient::DoConnect()
 
 bool PeerConnectionClient::SendToPeer(int peer_id, const std::string& message)
 {
-	if (state_ != CONNECTED)
+	if (state_ != CONNECTED && state_ != RECONNECTING)
 	{
 		return false;
 	}
 
 	RTC_DCHECK(is_connected());
-	RTC_DCHECK(control_socket_->GetState() == rtc::Socket::CS_CLOSED);
 	if (!is_connected() || peer_id == -1)
 	{
 		return false;
 	}
 
-	onconnect_data_ = PrepareRequest("POST",
-		"/message?peer_id=" + std::to_string(my_id_) + "&to=" + std::to_string(peer_id),
-		{
-			{"Host", server_address_.hostname()},
-			{"Content-Length", std::to_string(message.length())},
-			{"Content-Type", "text/plain"}
-		});
+	OutboundMessage outbound;
+	outbound.peer_id = peer_id;
+	outbound.message = message;
+	outbound.queued_ms = rtc::TimeMillis();
+	outbound.candidate = message_batching_ && IsCandidateMessage(message);
+	outbound_queue_.push_back(outbound);
 
-	onconnect_data_ += message;
-	return ConnectControlSocket();
+	queue_stats_.max_queue_depth = (std::max)(queue_stats_.max_queue_depth, outbound_queue_.size());
+	return FlushOutboundQueue();
 }
 
 bool PeerConnectionClient::SendHangUp(int peer_id)
@@ -245,7 +420,22 @@ bool PeerConnectionClient::SendHangUp(int peer_id)
 
 bool PeerConnectionClient::IsSendingMessage()
 {
-	return state_ == CONNECTED && control_socket_->GetState() != rtc::Socket::CS_CLOSED;
+	return (state_ == CONNECTED || state_ == RECONNECTING) && !outbound_queue_.empty();
+}
+
+SignalingQueueStats PeerConnectionClient::GetQueueStats() const
+{
+	SignalingQueueStats stats = queue_stats_;
+	stats.queue_depth = outbound_queue_.size();
+	stats.average_send_latency_ms = stats.messages_sent > 0 ?
+		total_send_latency_ms_ / stats.messages_sent : 0;
+
+	return stats;
+}
+
+ReconnectStats PeerConnectionClient::GetReconnectStats() const
+{
+	return reconnect_.stats();
 }
 
 bool PeerConnectionClient::SignOut()
@@ -255,19 +445,60 @@ bool PeerConnectionClient::SignOut()
 		return true;
 	}
 
+	if (IsSigningIn())
+	{
+		// Waiting for the server, the session ends here. A resumable peer is
+		// signed out by the server once it times out.
+		Close();
+		callback_->OnDisconnected();
+		return true;
+	}
+
 	if (hanging_get_->GetState() != rtc::Socket::CS_CLOSED)
 	{
 		hanging_get_->Close();
 	}
 
-	if (control_socket_->GetState() == rtc::Socket::CS_CLOSED) 
+	if (outbound_queue_.empty() && control_queue_.empty() && control_in_flight_.empty())
 	{
 		state_ = SIGNING_OUT;
 
 		if (my_id_ != -1)
 		{
-			onconnect_data_ = PrepareRequest("GET", "/sign_out?peer_id=" + std::to_string(my_id_), { {"Host", server_address_.hostname()} });
-			return ConnectControlSocket();
+			SignalingQueueStats stats = GetQueueStats();
+			LOG(INFO) << "Control connection sent " << control_requests_ << " requests over "
+				<< control_connections_ << " connections";
+
+			LOG(INFO) << "Signaling queue: " << stats.messages_sent << " messages in "
+				<< stats.requests_sent << " requests, " << stats.batched_candidates
+				<< " batched candidates, max depth " << stats.max_queue_depth
+				<< ", send latency avg " << stats.average_send_latency_ms
+				<< " ms, max " << stats.max_send_latency_ms << " ms";
+
+			ReconnectStats reconnect_stats = reconnect_.stats();
+			LOG(INFO) << "Reconnects: " << reconnect_stats.attempts << " attempts, "
+				<< reconnect_stats.resumed << " resumed, " << reconnect_stats.new_sessions
+				<< " new sessions, " << reconnect_stats.total_delay_ms << " ms of backoff";
+
+			if (server_address_ssl_)
+			{
+				TlsHandshakeStats tls_stats = TlsSessionCache::Instance()->GetStats();
+				LOG(INFO) << "TLS handshakes: " << tls_stats.full_handshakes << " full, "
+					<< tls_stats.resumed_handshakes << " resumed, " << tls_stats.failed_handshakes
+					<< " failed";
+			}
+
+			if (websocket_)
+			{
+				// The server closes its side in turn, see OnWebSocketRead.
+				std::string frame;
+				WebSocketFramer::WriteCloseFrame(WebSocketFramer::kCloseNormal, &frame);
+				int sent = control_socket_->Send(frame.data(), frame.size());
+				return sent == static_cast<int>(frame.size());
+			}
+
+			return QueueControlRequest(
+				PrepareRequest("GET", "/sign_out?peer_id=" + std::to_string(my_id_), { {"Host", server_address_.hostname()} }, true));
 		}
 		else
 		{
@@ -310,18 +541,95 @@ void PeerConnectionClient::Close()
 {
 	control_socket_->Close();
 	hanging_get_->Close();
-	onconnect_data_.clear();
-	peers_.clear();
-	if (resolver_ != NULL)
+	outbound_queue_.clear();
+	control_queue_.clear();
+	control_in_flight_.clear();
+	control_data_.clear();
+	control_parser_.Reset();
+	resume_queue_.clear();
+	websocket_open_ = false;
+	websocket_framer_.Reset();
+	hanging_get_failures_ = 0;
+	peers_.Clear();
+	peers_.FlushChanges();
+	if (resolve_request_ != 0)
 	{
-		resolver_->Destroy(false);
-		resolver_ = NULL;
+		DnsCache::Instance()->Cancel(resolve_request_);
+		resolve_request_ = 0;
 	}
 
+	// Drops the pending reconnect and address fallback.
+	connect_attempt_++;
+
 	my_id_ = -1;
 	state_ = NOT_CONNECTED;
 }
 
+bool PeerConnectionClient::IsSigningIn() const
+{
+	return state_ == SIGNING_IN || state_ == RECONNECTING;
+}
+
+void PeerConnectionClient::OnConnectionLost()
+{
+	if (state_ == CONNECTED || IsSigningIn())
+	{
+		ScheduleReconnect();
+	}
+	else if (state_ != NOT_CONNECTED)
+	{
+		Close();
+		callback_->OnDisconnected();
+	}
+}
+
+void PeerConnectionClient::ScheduleReconnect()
+{
+	if (state_ == CONNECTED)
+	{
+		LOG(WARNING) << "Lost the signaling server, resuming peer id " << my_id_;
+		state_ = RECONNECTING;
+	}
+
+	if (state_ == RECONNECTING)
+	{
+		// The server may have received some of these already, peers get
+		// those messages twice rather than not at all. The sign in request
+		// is created again.
+		for (const std::deque<ControlRequest>* queue : { &control_in_flight_, &control_queue_ })
+		{
+			for (const ControlRequest& request : *queue)
+			{
+				if (request.messages > 0)
+				{
+					resume_queue_.push_back(request);
+				}
+			}
+		}
+	}
+
+	control_socket_->Close();
+	hanging_get_->Close();
+	heartbeat_get_->Close();
+	control_queue_.clear();
+	control_in_flight_.clear();
+	control_data_.clear();
+	control_parser_.Reset();
+	websocket_open_ = false;
+	websocket_framer_.Reset();
+	hanging_get_failures_ = 0;
+
+	// Drops the pending address fallback.
+	connect_attempt_++;
+
+	int delay_ms = reconnect_.NextDelayMs();
+	LOG(INFO) << "Reconnecting to the signaling server in " << delay_ms << " ms (attempt "
+		<< reconnect_.stats().consecutive_failures << ")";
+
+	rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, delay_ms, this, kReconnectId,
+		new rtc::TypedMessageData<int>(connect_attempt_));
+}
+
 bool PeerConnectionClient::ConnectControlSocket() 
 {
 	RTC_DCHECK(control_socket_->GetState() == rtc::Socket::CS_CLOSED);
@@ -332,19 +640,189 @@ bool PeerConnectionClient::ConnectControlSocket()
 		return false;
 	}
 
+	control_connections_++;
 	return true;
 }
 
+bool PeerConnectionClient::QueueControlRequest(const std::string& request)
+{
+	ControlRequest control_request;
+	control_request.data = request;
+	control_request.queued_ms = rtc::TimeMillis();
+	control_request.messages = 0;
+	control_queue_.push_back(control_request);
+	return FlushControlQueue();
+}
+
+bool PeerConnectionClient::FlushOutboundQueue()
+{
+	if (websocket_)
+	{
+		return FlushWebSocketQueue();
+	}
+
+	// Message requests carry our peer id, which is only known once signed in.
+	while (!IsSigningIn() && !outbound_queue_.empty() &&
+		control_queue_.size() + control_in_flight_.size() < MaxControlRequestsInFlight())
+	{
+		const OutboundMessage& first = outbound_queue_.front();
+		int peer_id = first.peer_id;
+
+		ControlRequest control_request;
+		control_request.queued_ms = first.queued_ms;
+		control_request.messages = 0;
+
+		// Counts the candidates for the same peer waiting behind the first one.
+		int candidates = 0;
+		while (first.candidate &&
+			candidates < static_cast<int>(outbound_queue_.size()) &&
+			candidates < kMaxBatchedCandidates &&
+			outbound_queue_[candidates].candidate &&
+			outbound_queue_[candidates].peer_id == peer_id)
+		{
+			candidates++;
+		}
+
+		std::string body;
+		if (candidates > 1)
+		{
+			body = "[";
+			for (int i = 0; i < candidates; ++i)
+			{
+				body += (i ? "," : "") + outbound_queue_.front().message;
+				outbound_queue_.pop_front();
+			}
+
+			body += "]";
+			control_request.messages = candidates;
+			queue_stats_.batched_candidates += candidates;
+		}
+		else
+		{
+			body = first.message;
+			outbound_queue_.pop_front();
+			control_request.messages = 1;
+		}
+
+		control_request.data = PrepareRequest("POST",
+			"/message?peer_id=" + std::to_string(my_id_) + "&to=" + std::to_string(peer_id),
+			{
+				{"Host", server_address_.hostname()},
+				{"Content-Length", std::to_string(body.length())},
+				{"Content-Type", "text/plain"}
+			},
+			true);
+
+		control_request.data += body;
+		control_queue_.push_back(control_request);
+		queue_stats_.requests_sent++;
+	}
+
+	return FlushControlQueue();
+}
+
+bool PeerConnectionClient::FlushWebSocketQueue()
+{
+	if (!websocket_open_)
+	{
+		// Only the opening handshake goes through the control queue.
+		return FlushControlQueue();
+	}
+
+	// Frames are written as soon as they are queued, there is no request
+	// to wait for.
+	while (!IsSigningIn() && !outbound_queue_.empty())
+	{
+		const OutboundMessage& outbound = outbound_queue_.front();
+		if (!SendWebSocketFrame(WebSocketFramer::TEXT,
+			std::to_string(outbound.peer_id) + "\n" + outbound.message))
+		{
+			return false;
+		}
+
+		int64_t latency_ms = rtc::TimeMillis() - outbound.queued_ms;
+		queue_stats_.messages_sent++;
+		queue_stats_.requests_sent++;
+		queue_stats_.max_send_latency_ms = (std::max)(queue_stats_.max_send_latency_ms, latency_ms);
+		total_send_latency_ms_ += latency_ms;
+		outbound_queue_.pop_front();
+
+		callback_->OnMessageSent(0);
+	}
+
+	return true;
+}
+
+bool PeerConnectionClient::SendWebSocketFrame(WebSocketFramer::Opcode opcode,
+	const std::string& payload)
+{
+	std::string frame;
+	WebSocketFramer::WriteFrame(opcode, payload.data(), payload.size(), &frame);
+
+	int sent = control_socket_->Send(frame.data(), frame.size());
+	RTC_DCHECK(sent == static_cast<int>(frame.size()));
+	return sent == static_cast<int>(frame.size());
+}
+
+bool PeerConnectionClient::FlushControlQueue()
+{
+	switch (control_socket_->GetState())
+	{
+	case rtc::Socket::CS_CLOSED:
+		if (control_queue_.empty())
+		{
+			return true;
+		}
+
+		return ConnectControlSocket();
+
+	case rtc::Socket::CS_CONNECTING:
+		// Flushed again from OnConnect.
+		return true;
+
+	default:
+		break;
+	}
+
+	while (!control_queue_.empty() && control_in_flight_.size() < MaxControlRequestsInFlight())
+	{
+		const ControlRequest& request = control_queue_.front();
+		size_t sent = control_socket_->Send(request.data.c_str(), request.data.length());
+		RTC_DCHECK(sent == request.data.length());
+		control_in_flight_.push_back(request);
+		control_queue_.pop_front();
+		control_requests_++;
+	}
+
+	return true;
+}
+
+size_t PeerConnectionClient::MaxControlRequestsInFlight() const
+{
+	// Without keep-alive the server answers a single request per connection.
+	return control_keep_alive_ ? kMaxPipelinedRequests : 1;
+}
+
 void PeerConnectionClient::OnConnect(rtc::AsyncSocket* socket)
 {
-	RTC_DCHECK(!onconnect_data_.empty());
-	size_t sent = socket->Send(onconnect_data_.c_str(), onconnect_data_.length());
-	RTC_DCHECK(sent == onconnect_data_.length());
-	onconnect_data_.clear();
+	RTC_DCHECK(!control_queue_.empty());
+
+	if (!server_addresses_.empty())
+	{
+		// Remembers the family which works for the next sessions.
+		DnsCache::Instance()->ReportConnectResult(server_address_.hostname(),
+			server_address_.ipaddr(), true);
+	}
+
+	addresses_failed_ = 0;
+	FlushOutboundQueue();
 }
 
 void PeerConnectionClient::OnHangingGetConnect(rtc::AsyncSocket* socket)
 {
+	notification_data_.clear();
+	notification_parser_.Reset();
+
 	auto req = PrepareRequest("GET", "/wait?peer_id=" + std::to_string(my_id_), { {"Host", server_address_.hostname()} });
 
 	int sent = socket->Send(req.c_str(), req.length());
@@ -353,6 +831,19 @@ void PeerConnectionClient::OnHangingGetConnect(rtc::AsyncSocket* socket)
 
 void PeerConnectionClient::OnMessageFromPeer(int peer_id, const std::string& message)
 {
+	// Batched candidates are delivered one by one.
+	std::vector<std::string> messages;
+	if (!message.empty() && message[0] == '[' &&
+		SignalingMessageCodec::SplitArray(message, &messages))
+	{
+		for (const std::string& element : messages)
+		{
+			OnMessageFromPeer(peer_id, element);
+		}
+
+		return;
+	}
+
 	if (message.length() == (sizeof(kByeMessage) - 1) && 
 		message.compare(kByeMessage) == 0)
 	{
@@ -364,276 +855,521 @@ void PeerConnectionClient::OnMessageFromPeer(int peer_id, const std::string& mes
 	}
 }
 
-bool PeerConnectionClient::GetHeaderValue(const std::string& data, size_t eoh, 
-	const char* header_pattern, size_t* value)
+bool PeerConnectionClient::ReceiveIntoBuffer(rtc::AsyncSocket* socket, std::string* data)
 {
-	RTC_DCHECK(value != NULL);
-	size_t found = data.find(header_pattern);
-	if (found != std::string::npos && found < eoh)
+	// Receives straight into the buffer, without an intermediate copy.
+	while (true)
 	{
-		*value = atoi(&data[found + strlen(header_pattern)]);
-		return true;
+		size_t size = data->size();
+		data->resize(size + kReadChunkSize);
+		int bytes = socket->Recv(&(*data)[size], kReadChunkSize, nullptr);
+		data->resize(size + (bytes > 0 ? bytes : 0));
+		if (bytes <= 0)
+		{
+			return bytes == 0;
+		}
+	}
+}
+
+HttpResponseParser::Result PeerConnectionClient::ReadIntoBuffer(rtc::AsyncSocket* socket,
+	std::string* data, HttpResponseParser* parser)
+{
+	// The parser only scans the new bytes.
+	bool closed = ReceiveIntoBuffer(socket, data);
+
+	HttpResponseParser::Result result = parser->Parse(&(*data)[0], data->size());
+	if (result == HttpResponseParser::NEED_MORE_DATA && closed && !data->empty())
+	{
+		// The body may be delimited by the end of the connection.
+		result = parser->Finish();
 	}
 
-	return false;
+	return result;
 }
 
-bool PeerConnectionClient::GetHeaderValue(const std::string& data, size_t eoh, 
-	const char* header_pattern, std::string* value)
+void PeerConnectionClient::OnRead(rtc::AsyncSocket* socket)
 {
-	RTC_DCHECK(value != NULL);
-	size_t found = data.find(header_pattern);
-	if (found != std::string::npos && found < eoh)
+	if (websocket_)
+	{
+		OnWebSocketRead(socket);
+		return;
+	}
+
+	HttpResponseParser::Result result = ReadIntoBuffer(socket, &control_data_, &control_parser_);
+
+	// Pipelined responses come back in request order.
+	while (result == HttpResponseParser::COMPLETE)
 	{
-		size_t begin = found + strlen(header_pattern);
-		size_t end = data.find("\r\n", begin);
-		if (end == std::string::npos)
+		if (!control_in_flight_.empty())
 		{
-			end = eoh;
+			const ControlRequest& request = control_in_flight_.front();
+			if (request.messages > 0)
+			{
+				int64_t latency_ms = rtc::TimeMillis() - request.queued_ms;
+				queue_stats_.messages_sent += request.messages;
+				queue_stats_.max_send_latency_ms = (std::max)(queue_stats_.max_send_latency_ms, latency_ms);
+				total_send_latency_ms_ += latency_ms * request.messages;
+			}
+
+			control_in_flight_.pop_front();
 		}
 
-		value->assign(data.substr(begin, end - begin));
-		return true;
+		bool keep_alive = control_parser_.keep_alive();
+		OnControlResponse(control_data_.data(), control_parser_);
+		if (state_ == NOT_CONNECTED)
+		{
+			return;
+		}
+
+		if (!keep_alive)
+		{
+			// The server doesn't keep the connection, falls back to one
+			// connection per request.
+			if (control_keep_alive_)
+			{
+				LOG(INFO) << "Signaling server closes connections, keep-alive disabled";
+				control_keep_alive_ = false;
+			}
+
+			socket->Close();
+
+			// Since we closed the socket, there was no notification delivered
+			// to us.  Compensate by letting ourselves know.
+			OnClose(socket, 0);
+			return;
+		}
+
+		callback_->OnMessageSent(0);
+
+		// The next response may already be in the buffer.
+		control_data_.erase(0, control_parser_.consumed());
+		control_parser_.Reset();
+		result = control_parser_.Parse(&control_data_[0], control_data_.size());
 	}
 
-	return false;
+	if (result == HttpResponseParser::PARSE_ERROR)
+	{
+		LOG(LS_ERROR) << "Invalid response received from the server";
+		Close();
+		callback_->OnDisconnected();
+		return;
+	}
+
+	FlushOutboundQueue();
 }
 
-bool PeerConnectionClient::ReadIntoBuffer(rtc::AsyncSocket* socket, std::string* data, 
-	size_t* content_length)
+void PeerConnectionClient::OnControlResponse(const char* data, const HttpResponseParser& parser)
 {
-	char buffer[0xffff];
-	do 
+	SignalingRequest request = IsSigningIn() ? SIGNALING_SIGN_IN :
+		(state_ == SIGNING_OUT || state_ == SIGNING_OUT_WAITING) ? SIGNALING_SIGN_OUT : SIGNALING_MESSAGE;
+
+	int peer_id = -1;
+	bool ok = ParseServerResponse(request, data, parser, &peer_id);
+	if (ok) 
 	{
-		int bytes = socket->Recv(buffer, sizeof(buffer), nullptr);
-		if (bytes <= 0)
+		if (IsSigningIn()) 
 		{
-			break;
+			// First response.  Let's store our server assigned ID.
+			HttpSpan batching;
+			message_batching_ = parser.GetHeader(data, kMessageBatchingHeader, &batching) &&
+				batching.length == 1 && data[batching.offset] == '1';
+
+			// The body of the response will be a list of already connected peers.
+			HttpSpan body = parser.body();
+			OnSignInResponse(state_ == RECONNECTING, peer_id, data + body.offset, body.length);
 		}
+		else if (state_ == SIGNING_OUT)
+		{
+			Close();
+			callback_->OnDisconnected();
+		} 
+		else if (state_ == SIGNING_OUT_WAITING)
+		{
+			SignOut();
+		}
+	}
+
+	if (IsSigningIn()) 
+	{
+		RTC_DCHECK(hanging_get_->GetState() == rtc::Socket::CS_CLOSED);
+		state_ = CONNECTED;
+		hanging_get_->Connect(server_address_);
 
-		data->append(buffer, bytes);
+		// A heartbeat scheduled before a reconnect carries on.
+		if (heartbeat_tick_ms_ != kHeartbeatDefault && !heartbeat_scheduled_)
+		{
+			heartbeat_get_->Connect(server_address_);
+		}
 	}
-	while (true);
+}
 
-	bool ret = false;
-	size_t i = data->find("\r\n\r\n");
-	if (i != std::string::npos)
+void PeerConnectionClient::OnSignInResponse(bool resuming, int peer_id, const char* peer_list,
+	size_t length)
+{
+	RTC_DCHECK(peer_id != -1);
+	bool resumed = resuming && peer_id == my_id_;
+	reconnect_.OnConnected();
+	if (resuming)
 	{
-		LOG(INFO) << "Headers received";
-		if (GetHeaderValue(*data, i, "\r\nContent-Length: ", content_length))
+		reconnect_.OnResumed(resumed);
+		if (resumed)
 		{
-			size_t total_response_size = (i + 4) + *content_length;
-			if (data->length() >= total_response_size)
-			{
-				ret = true;
-				std::string should_close;
-				const char kConnection[] = "\r\nConnection: ";
-				if (GetHeaderValue(*data, i, kConnection, &should_close) &&
-					should_close.compare("close") == 0)
-				{
-					socket->Close();
+			LOG(INFO) << "Resumed peer id " << peer_id << ", resending "
+				<< resume_queue_.size() << " requests";
 
-					// Since we closed the socket, there was no notification delivered
-					// to us.  Compensate by letting ourselves know.
-					OnClose(socket, 0);
-				}
-			}
-			else
-			{
-				// We haven't received everything.  Just continue to accept data.
-			}
+			control_queue_.insert(control_queue_.begin(), resume_queue_.begin(), resume_queue_.end());
 		}
 		else
 		{
-			LOG(LS_ERROR) << "No content length field specified by the server.";
+			// The server forgot us, the messages were meant for the peers of
+			// the previous session.
+			LOG(WARNING) << "Signaling server assigned peer id " << peer_id << " in place of " << my_id_;
+			outbound_queue_.clear();
+			callback_->OnDisconnected();
 		}
+
+		resume_queue_.clear();
 	}
 
-	return ret;
+	my_id_ = peer_id;
+	OnPeerList(peer_list, length);
+
+	RTC_DCHECK(is_connected());
+	if (!resumed)
+	{
+		callback_->OnSignedIn();
+	}
 }
 
-void PeerConnectionClient::OnRead(rtc::AsyncSocket* socket)
+void PeerConnectionClient::OnHangingGetRead(rtc::AsyncSocket* socket) 
 {
-	size_t content_length = 0;
-	if (ReadIntoBuffer(socket, &control_data_, &content_length))
+	LOG(INFO) << __FUNCTION__;
+	HttpResponseParser::Result result =
+		ReadIntoBuffer(socket, &notification_data_, &notification_parser_);
+
+	if (result == HttpResponseParser::COMPLETE)
 	{
-		size_t peer_id = 0, eoh = 0;
-		bool ok = ParseServerResponse(control_data_, content_length, &peer_id, &eoh);
+		// Each wait request is answered once, the next one goes on a new
+		// connection.
+		socket->Close();
+
+		int peer_id = -1;
+		const char* data = notification_data_.data();
+		bool ok = ParseServerResponse(SIGNALING_WAIT, data, notification_parser_, &peer_id);
+
 		if (ok) 
 		{
-			if (my_id_ == -1) 
-			{
-				// First response.  Let's store our server assigned ID.
-				RTC_DCHECK(state_ == SIGNING_IN);
-				my_id_ = static_cast<int>(peer_id);
-				RTC_DCHECK(my_id_ != -1);
+			hanging_get_failures_ = 0;
+			HttpSpan body = notification_parser_.body();
+			OnNotification(peer_id, data + body.offset, body.length);
+		}
+	}
+	else if (result == HttpResponseParser::PARSE_ERROR)
+	{
+		LOG(LS_ERROR) << "Invalid notification received from the server";
+		socket->Close();
+	}
 
-				// The body of the response will be a list of already connected peers.
-				if (content_length)
-				{
-					size_t pos = eoh + 4;
-					while (pos < control_data_.size()) 
-					{
-						size_t eol = control_data_.find('\n', pos);
-						if (eol == std::string::npos)
-						{
-							break;
-						}
-
-						int id = 0;
-						std::string name;
-						bool connected;
-						if (ParseEntry(control_data_.substr(pos, eol - pos), 
-							&name, &id, &connected) && id != my_id_)
-						{
-							peers_[id] = name;
-							callback_->OnPeerConnected(id, name);
-						}
-
-						pos = eol + 1;
-					}
-				}
+	if (result != HttpResponseParser::NEED_MORE_DATA)
+	{
+		notification_data_.clear();
+		notification_parser_.Reset();
+	}
 
-				RTC_DCHECK(is_connected());
-				callback_->OnSignedIn();
-			}
-			else if (state_ == SIGNING_OUT)
-			{
-				Close();
-				callback_->OnDisconnected();
-			} 
-			else if (state_ == SIGNING_OUT_WAITING)
-			{
-				SignOut();
-			}
-		}
+	if (result == HttpResponseParser::PARSE_ERROR)
+	{
+		OnHangingGetFailure();
+	}
+	else if (hanging_get_->GetState() == rtc::Socket::CS_CLOSED && state_ == CONNECTED) 
+	{
+		hanging_get_->Connect(server_address_);
+	}
+}
+
+void PeerConnectionClient::OnHangingGetFailure()
+{
+	if (state_ != CONNECTED)
+	{
+		return;
+	}
+
+	if (++hanging_get_failures_ < kMaxHangingGetFailures)
+	{
+		hanging_get_->Close();
+		hanging_get_->Connect(server_address_);
+		return;
+	}
 
-		control_data_.clear();
+	LOG(WARNING) << hanging_get_failures_ << " waits in a row failed";
+	ScheduleReconnect();
+}
+
+void PeerConnectionClient::OnPeerList(const char* data, size_t length)
+{
+	// Bulk update, the observers get a single reset.
+	const char* pos = data;
+	const char* end = data + length;
+	peers_.Clear();
+	peers_.Reserve(std::count(pos, end, '\n'));
+	while (pos < end) 
+	{
+		const char* eol = static_cast<const char*>(memchr(pos, '\n', end - pos));
+		if (!eol)
+		{
+			break;
+		}
 
-		if (state_ == SIGNING_IN) 
+		int id = 0;
+		std::string name;
+		bool connected;
+		if (ParseEntry(pos, eol - pos, &name, &id, &connected) && id != my_id_)
 		{
-			RTC_DCHECK(hanging_get_->GetState() == rtc::Socket::CS_CLOSED);
-			state_ = CONNECTED;
-			hanging_get_->Connect(server_address_);
+			peers_.Add(id, name);
+		}
+
+		pos = eol + 1;
+	}
 
-			if (heartbeat_tick_ms_ != kHeartbeatDefault)
+	peers_.FlushChanges();
+}
+
+void PeerConnectionClient::OnNotification(int peer_id, const char* data, size_t length)
+{
+	if (my_id_ == peer_id) 
+	{
+		// A notification about a new member or a member that just
+		// disconnected.
+		int id = 0;
+		std::string name;
+		bool connected = false;
+		if (ParseEntry(data, length, &name, &id, &connected)) 
+		{
+			if (connected) 
+			{
+				peers_.Add(id, name);
+				callback_->OnPeerConnected(id, name);
+			} 
+			else 
 			{
-				heartbeat_get_->Connect(server_address_);
+				peers_.Remove(id);
+				callback_->OnPeerDisconnected(id);
 			}
+
+			SchedulePeerFlush();
 		}
+	} 
+	else 
+	{
+		OnMessageFromPeer(peer_id, std::string(data, length));
 	}
 }
 
-void PeerConnectionClient::OnHangingGetRead(rtc::AsyncSocket* socket) 
+void PeerConnectionClient::SchedulePeerFlush()
 {
-	LOG(INFO) << __FUNCTION__;
-	size_t content_length = 0;
-	if (ReadIntoBuffer(socket, &notification_data_, &content_length))
+	if (!peer_flush_scheduled_ && peers_.has_pending_changes())
 	{
-		size_t peer_id = 0, eoh = 0;
-		bool ok = ParseServerResponse(notification_data_, content_length, &peer_id, &eoh);
+		peer_flush_scheduled_ = true;
+		rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kPeerBatchDelayMs, this, kPeerFlushId);
+	}
+}
 
-		if (ok) 
+void PeerConnectionClient::OnWebSocketRead(rtc::AsyncSocket* socket)
+{
+	if (!websocket_open_)
+	{
+		HttpResponseParser::Result result = ReadIntoBuffer(socket, &control_data_, &control_parser_);
+		if (result == HttpResponseParser::NEED_MORE_DATA)
 		{
-			// Store the position where the body begins.
-			size_t pos = eoh + 4;
+			return;
+		}
 
-			if (my_id_ == static_cast<int>(peer_id)) 
-			{
-				// A notification about a new member or a member that just
-				// disconnected.
-				int id = 0;
-				std::string name;
-				bool connected = false;
-				if (ParseEntry(notification_data_.substr(pos), &name, &id, &connected)) 
-				{
-					if (connected) 
-					{
-						peers_[id] = name;
-						callback_->OnPeerConnected(id, name);
-					} 
-					else 
-					{
-						peers_.erase(id);
-						callback_->OnPeerDisconnected(id);
-					}
-				}
-			} 
-			else 
+		HttpSpan accept;
+		bool upgraded = result == HttpResponseParser::COMPLETE &&
+			control_parser_.status_code() == 101 &&
+			control_parser_.GetHeader(control_data_.data(), "Sec-WebSocket-Accept", &accept) &&
+			control_data_.compare(accept.offset, accept.length,
+				WebSocketFramer::ComputeAccept(websocket_key_)) == 0;
+
+		if (!upgraded)
+		{
+			LOG(LS_ERROR) << "WebSocket upgrade refused by the server (" << control_parser_.status_code() << ")";
+			Close();
+			callback_->OnDisconnected();
+			return;
+		}
+
+		// Frames may follow the handshake in the same read.
+		control_data_.erase(0, control_parser_.consumed());
+		control_parser_.Reset();
+		control_in_flight_.clear();
+		websocket_open_ = true;
+	}
+	else
+	{
+		ReceiveIntoBuffer(socket, &control_data_);
+	}
+
+	WebSocketFramer::Opcode opcode;
+	std::string payload;
+	WebSocketFramer::Result result;
+	while ((result = websocket_framer_.ReadMessage(&control_data_, &opcode, &payload)) ==
+		WebSocketFramer::COMPLETE)
+	{
+		switch (opcode)
+		{
+		case WebSocketFramer::TEXT:
+			OnWebSocketMessage(payload);
+			break;
+
+		case WebSocketFramer::PING:
+			SendWebSocketFrame(WebSocketFramer::PONG, payload);
+			break;
+
+		case WebSocketFramer::PONG:
+			// Answer to our heartbeat.
+			ScheduleHeartbeat();
+			break;
+
+		case WebSocketFramer::CLOSE:
+			if (state_ != SIGNING_OUT)
 			{
-				OnMessageFromPeer(static_cast<int>(peer_id), notification_data_.substr(pos));
+				// Going away, e.g. restarting.
+				LOG(WARNING) << "Signaling server closed the WebSocket";
+				OnConnectionLost();
+				return;
 			}
+
+			Close();
+			callback_->OnDisconnected();
+			return;
+
+		default:
+			LOG(WARNING) << "Ignoring WebSocket message with opcode " << opcode;
+			break;
 		}
 
-		notification_data_.clear();
+		if (state_ == NOT_CONNECTED)
+		{
+			return;
+		}
 	}
 
-	if (hanging_get_->GetState() == rtc::Socket::CS_CLOSED && state_ == CONNECTED) 
+	if (result == WebSocketFramer::PARSE_ERROR)
 	{
-		hanging_get_->Connect(server_address_);
+		LOG(LS_ERROR) << "Invalid WebSocket frame received from the server";
+		Close();
+		callback_->OnDisconnected();
+	}
+}
+
+void PeerConnectionClient::OnWebSocketMessage(const std::string& message)
+{
+	// "<peer id>\n<body>", the same peer id and body as the Pragma header
+	// and body of the HTTP responses.
+	size_t eol = message.find('\n');
+	int64_t peer_id = -1;
+	if (eol == std::string::npos ||
+		!HttpResponseParser::ParseInt(message.data(), eol, &peer_id) ||
+		peer_id > INT_MAX)
+	{
+		LOG(WARNING) << "Invalid WebSocket signaling message";
+		return;
+	}
+
+	const char* body = message.data() + eol + 1;
+	size_t length = message.size() - eol - 1;
+	if (IsSigningIn())
+	{
+		// First message, our server assigned ID and the connected peers.
+		bool resuming = state_ == RECONNECTING;
+		state_ = CONNECTED;
+		OnSignInResponse(resuming, static_cast<int>(peer_id), body, length);
+
+		ScheduleHeartbeat();
+
+		// Messages queued while reconnecting.
+		FlushOutboundQueue();
+	}
+	else
+	{
+		OnNotification(static_cast<int>(peer_id), body, length);
 	}
 }
 
-bool PeerConnectionClient::ParseEntry(const std::string& entry, std::string* name, 
+bool PeerConnectionClient::ParseEntry(const char* entry, size_t length, std::string* name, 
 	int* id, bool* connected)
 {
+	RTC_DCHECK(entry != NULL);
 	RTC_DCHECK(name != NULL);
 	RTC_DCHECK(id != NULL);
 	RTC_DCHECK(connected != NULL);
-	RTC_DCHECK(!entry.empty());
 
 	*connected = false;
-	size_t separator = entry.find(',');
-	if (separator != std::string::npos) 
+	name->clear();
+
+	const char* end = entry + length;
+	while (end > entry && (end[-1] == '\r' || end[-1] == '\n'))
 	{
-		*id = atoi(&entry[separator + 1]);
-		name->assign(entry.substr(0, separator));
-		separator = entry.find(',', separator + 1);
-		if (separator != std::string::npos) 
-		{
-			*connected = atoi(&entry[separator + 1]) ? true : false;
-		}
+		end--;
 	}
 
-	return !name->empty();
-}
+	const char* separator = static_cast<const char*>(memchr(entry, ',', end - entry));
+	if (separator == NULL)
+	{
+		return false;
+	}
 
-int PeerConnectionClient::GetResponseStatus(const std::string& response) 
-{
-	int status = -1;
-	size_t pos = response.find(' ');
-	if (pos != std::string::npos)
+	const char* id_begin = separator + 1;
+	const char* id_end = static_cast<const char*>(memchr(id_begin, ',', end - id_begin));
+	int64_t value = 0;
+	if (!HttpResponseParser::ParseInt(id_begin, (id_end ? id_end : end) - id_begin, &value) ||
+		value > INT_MAX)
 	{
-		status = atoi(&response[pos + 1]);
+		LOG(WARNING) << "Invalid peer id in entry " << std::string(entry, end);
+		return false;
+	}
+
+	*id = static_cast<int>(value);
+	name->assign(entry, separator);
+	if (id_end != NULL)
+	{
+		*connected = HttpResponseParser::ParseInt(id_end + 1, end - (id_end + 1), &value) &&
+			value != 0;
 	}
 
-	return status;
+	return !name->empty();
 }
 
-bool PeerConnectionClient::ParseServerResponse(const std::string& response, 
-	size_t content_length, size_t* peer_id, size_t* eoh)
+bool PeerConnectionClient::ParseServerResponse(SignalingRequest request, const char* data,
+	const HttpResponseParser& parser, int* peer_id)
 {
-	int status = GetResponseStatus(response.c_str());
-	if (status != 200) 
+	switch (ReconnectController::ActionForResponse(request, parser.status_code()))
 	{
+	case RESPONSE_RECONNECT:
+		// A reconnect already under way asks for the peer id again anyway.
+		if (state_ != RECONNECTING)
+		{
+			LOG(WARNING) << "Received error " << parser.status_code() << " from server, signing in again";
+			OnConnectionLost();
+		}
+
+		return false;
+
+	case RESPONSE_DISCONNECT:
 		LOG(LS_ERROR) << "Received error from server";
 		Close();
 		callback_->OnDisconnected();
 		return false;
-	}
 
-	*eoh = response.find("\r\n\r\n");
-	RTC_DCHECK(*eoh != std::string::npos);
-	if (*eoh == std::string::npos)
-	{
-		return false;
+	default:
+		break;
 	}
 
-	*peer_id = -1;
-
 	// See comment in peer_channel.cc for why we use the Pragma header and
 	// not e.g. "X-Peer-Id".
-	GetHeaderValue(response, *eoh, "\r\nPragma: ", peer_id);
+	int64_t value = -1;
+	*peer_id = (parser.GetHeaderInt(data, "Pragma", &value) && value <= INT_MAX) ?
+		static_cast<int>(value) : -1;
 
 	return true;
 }
@@ -641,7 +1377,9 @@ bool PeerConnectionClient::ParseServerResponse(const std::string& response,
 
 void PeerConnectionClient::OnSignalingServerClose(rtc::AsyncSocket* socket, int err) 
 {
-	Close();
+	// The wait ended without a notification, or the server refused it.
+	socket->Close();
+	OnHangingGetFailure();
 }
 
 void PeerConnectionClient::OnClose(rtc::AsyncSocket* socket, int err) 
@@ -665,17 +1403,45 @@ void PeerConnectionClient::OnClose(rtc::AsyncSocket* socket, int err)
 				hanging_get_->Connect(server_address_);
 			}
 		} 
+		else if (websocket_ && socket == control_socket_.get())
+		{
+			// The WebSocket carries the whole session.
+			OnConnectionLost();
+		}
 		else 
 		{
+			if (socket == control_socket_.get())
+			{
+				// Requests the server didn't answer before closing are sent
+				// again on a new connection.
+				control_queue_.insert(control_queue_.begin(),
+					control_in_flight_.begin(), control_in_flight_.end());
+
+				control_in_flight_.clear();
+				control_data_.clear();
+				control_parser_.Reset();
+			}
+
 			callback_->OnMessageSent(err);
+
+			if (socket == control_socket_.get() && state_ != NOT_CONNECTED)
+			{
+				FlushOutboundQueue();
+			}
 		}
 	} 
 	else 
 	{
 		if (socket == control_socket_.get()) 
 		{
-			LOG(WARNING) << "Connection refused; retrying in 2 seconds";
-			rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kReconnectDelay, this, 0);
+			if (IsSigningIn() && TryNextAddress())
+			{
+				DoConnect();
+				return;
+			}
+
+			LOG(WARNING) << "Connection refused";
+			OnConnectionLost();
 		}
 		else 
 		{
@@ -690,12 +1456,22 @@ void PeerConnectionClient::OnMessage(rtc::Message* msg)
 	// indicates this message is to trigger a heartbeat request
 	if (msg->message_id == kHeartbeatScheduleId)
 	{
+		heartbeat_scheduled_ = false;
+
 		// if we aren't connected any longer, don't beat
 		if (state_ != State::CONNECTED)
 		{
 			return;
 		}
 
+		if (websocket_)
+		{
+			// Pings on the signaling connection, the pong schedules the
+			// next beat.
+			SendWebSocketFrame(WebSocketFramer::PING, std::string());
+			return;
+		}
+
 		// if the socket is still open, close it and then reconnect to trigger the beat
 		if (heartbeat_get_->GetState() != rtc::Socket::ConnState::CS_CLOSED)
 		{
@@ -703,10 +1479,34 @@ void PeerConnectionClient::OnMessage(rtc::Message* msg)
 		}
 		heartbeat_get_->Connect(server_address_);
 	}
-	else
+	else if (msg->message_id == kPeerFlushId)
 	{
-		// default case - other than the heartbeat message, there is only one other message ("retry")
-		DoConnect();
+		peer_flush_scheduled_ = false;
+		peers_.FlushChanges();
+	}
+	else if (msg->message_id == kHappyEyeballsId)
+	{
+		std::unique_ptr<rtc::TypedMessageData<int>> attempt(
+			static_cast<rtc::TypedMessageData<int>*>(msg->pdata));
+
+		// Still waiting for the server on the address of this attempt.
+		if (attempt->data() == connect_attempt_ && IsSigningIn() &&
+			control_socket_->GetState() == rtc::Socket::CS_CONNECTING && TryNextAddress())
+		{
+			DoConnect();
+		}
+	}
+	else if (msg->message_id == kReconnectId)
+	{
+		std::unique_ptr<rtc::TypedMessageData<int>> attempt(
+			static_cast<rtc::TypedMessageData<int>*>(msg->pdata));
+
+		// Nothing connected or closed the client meanwhile.
+		if (attempt->data() == connect_attempt_ && IsSigningIn())
+		{
+			addresses_failed_ = 0;
+			DoConnect();
+		}
 	}
 }
 
@@ -722,6 +1522,9 @@ void PeerConnectionClient::SetAuthorizationHeader(const std::string& value)
 
 void PeerConnectionClient::OnHeartbeatGetConnect(rtc::AsyncSocket* socket)
 {
+	heartbeat_data_.clear();
+	heartbeat_parser_.Reset();
+
 	auto req = PrepareRequest("GET", "/heartbeat?peer_id=" + std::to_string(my_id_), { {"Host", server_address_.hostname()} });
 
 	int sent = socket->Send(req.c_str(), req.length());
@@ -730,21 +1533,38 @@ void PeerConnectionClient::OnHeartbeatGetConnect(rtc::AsyncSocket* socket)
 
 void PeerConnectionClient::OnHeartbeatGetRead(rtc::AsyncSocket* socket)
 {
-	std::string data;
-	size_t content_length = 0;
-	if (ReadIntoBuffer(socket, &data, &content_length))
+	HttpResponseParser::Result result = ReadIntoBuffer(socket, &heartbeat_data_, &heartbeat_parser_);
+	if (result == HttpResponseParser::NEED_MORE_DATA)
 	{
-		size_t peer_id = 0, eoh = 0;
-		int status = GetResponseStatus(data);
+		return;
+	}
 
-		if (status != 200)
-		{
-			LOG(INFO) << "heartbeat failed (" << status << ")" << (heartbeat_tick_ms_ != kHeartbeatDefault ? ", will retry" : "");
-		}
+	int peer_id = -1;
+	if (result == HttpResponseParser::COMPLETE &&
+		!ParseServerResponse(SIGNALING_HEARTBEAT, heartbeat_data_.data(), heartbeat_parser_, &peer_id))
+	{
+		// The server forgot us, the beats resume once signed in again.
+		heartbeat_data_.clear();
+		heartbeat_parser_.Reset();
+		return;
+	}
+
+	if (result != HttpResponseParser::COMPLETE)
+	{
+		LOG(INFO) << "heartbeat failed" << (heartbeat_tick_ms_ != kHeartbeatDefault ? ", will retry" : "");
 	}
 
-	if (heartbeat_tick_ms_ != kHeartbeatDefault)
+	heartbeat_data_.clear();
+	heartbeat_parser_.Reset();
+	ScheduleHeartbeat();
+}
+
+void PeerConnectionClient::ScheduleHeartbeat()
+{
+	// A single beat is scheduled at a time, also across reconnects.
+	if (heartbeat_tick_ms_ != kHeartbeatDefault && !heartbeat_scheduled_)
 	{
+		heartbeat_scheduled_ = true;
 		rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, heartbeat_tick_ms_, this, kHeartbeatScheduleId);
 
 		LOG(INFO) << "heartbeat scheduled for " << heartbeat_tick_ms_ << "ms";
@@ -0,0 +1,262 @@
+#include "peer_directory.h"
+
+#include <limits.h>
+
+#include <algorithm>
+
+namespace
+{
+	bool StartsWith(const std::string& value, const std::string& prefix)
+	{
+		return value.compare(0, prefix.size(), prefix) == 0;
+	}
+
+	bool ById(const PeerInfo* left, const PeerInfo* right)
+	{
+		return left->id < right->id;
+	}
+}
+
+std::string PeerInfo::tag() const
+{
+	return name.substr(0, name.find('_'));
+}
+
+bool PeerFilter::Matches(const std::string& name) const
+{
+	if (!StartsWith(name, name_prefix))
+	{
+		return false;
+	}
+
+	return tag.empty() || (StartsWith(name, tag) &&
+		(name.size() == tag.size() || name[tag.size()] == '_'));
+}
+
+PeerDirectory::PeerDirectory() :
+	version_(0),
+	pending_reset_(false)
+{
+}
+
+void PeerDirectory::Reset(const std::vector<PeerInfo>& peers)
+{
+	Clear();
+	Reserve(peers.size());
+	for (const PeerInfo& peer : peers)
+	{
+		Add(peer.id, peer.name);
+	}
+}
+
+bool PeerDirectory::Add(int id, const std::string& name)
+{
+	auto it = entries_.find(id);
+	if (it != entries_.end())
+	{
+		if (it->second.name == name)
+		{
+			return false;
+		}
+
+		// Renamed, reported as a removal and an addition.
+		RemoveEntry(it);
+	}
+
+	PeerInfo& peer = entries_[id];
+	peer.id = id;
+	peer.name = name;
+	by_name_.insert(std::make_pair(name, id));
+	pending_added_.insert(id);
+	version_++;
+	return true;
+}
+
+bool PeerDirectory::Remove(int id)
+{
+	auto it = entries_.find(id);
+	if (it == entries_.end())
+	{
+		return false;
+	}
+
+	RemoveEntry(it);
+	version_++;
+	return true;
+}
+
+void PeerDirectory::Clear()
+{
+	entries_.clear();
+	by_name_.clear();
+	pending_reset_ = true;
+	pending_added_.clear();
+	pending_removed_.clear();
+	version_++;
+}
+
+void PeerDirectory::Reserve(size_t count)
+{
+	entries_.reserve(count);
+}
+
+const PeerInfo* PeerDirectory::Find(int id) const
+{
+	auto it = entries_.find(id);
+	return it != entries_.end() ? &it->second : nullptr;
+}
+
+template <typename Visitor>
+void PeerDirectory::VisitMatches(const PeerFilter& filter, Visitor visitor) const
+{
+	if (filter.name_prefix.empty() && filter.tag.empty())
+	{
+		for (const auto& entry : entries_)
+		{
+			visitor(entry.second);
+		}
+
+		return;
+	}
+
+	// Every match starts with the longer of the prefix and the tag, which
+	// bounds the range of the name index to scan.
+	const std::string& prefix = filter.name_prefix.size() > filter.tag.size() ?
+		filter.name_prefix : filter.tag;
+
+	for (auto it = by_name_.lower_bound(std::make_pair(prefix, INT_MIN));
+		it != by_name_.end() && StartsWith(it->first, prefix); ++it)
+	{
+		if (filter.Matches(it->first))
+		{
+			visitor(entries_.at(it->second));
+		}
+	}
+}
+
+std::vector<const PeerInfo*> PeerDirectory::Select(const PeerFilter& filter) const
+{
+	std::vector<const PeerInfo*> peers;
+	VisitMatches(filter, [&peers](const PeerInfo& peer) { peers.push_back(&peer); });
+	std::sort(peers.begin(), peers.end(), ById);
+	return peers;
+}
+
+const PeerInfo* PeerDirectory::Newest(const PeerFilter& filter) const
+{
+	const PeerInfo* newest = nullptr;
+	VisitMatches(filter, [&newest](const PeerInfo& peer)
+	{
+		if (!newest || peer.id > newest->id)
+		{
+			newest = &peer;
+		}
+	});
+
+	return newest;
+}
+
+void PeerDirectory::AddObserver(PeerDirectoryObserver* observer, const PeerFilter& filter)
+{
+	observers_.push_back(std::make_pair(observer, filter));
+}
+
+void PeerDirectory::RemoveObserver(PeerDirectoryObserver* observer)
+{
+	observers_.erase(std::remove_if(observers_.begin(), observers_.end(),
+		[observer](const std::pair<PeerDirectoryObserver*, PeerFilter>& entry)
+		{
+			return entry.first == observer;
+		}),
+		observers_.end());
+}
+
+bool PeerDirectory::has_pending_changes() const
+{
+	return pending_reset_ || !pending_added_.empty() || !pending_removed_.empty();
+}
+
+void PeerDirectory::FlushChanges()
+{
+	if (!has_pending_changes())
+	{
+		return;
+	}
+
+	PeerDirectoryDelta delta;
+	delta.reset = pending_reset_;
+	delta.removed.swap(pending_removed_);
+
+	std::vector<const PeerInfo*> added;
+	if (pending_reset_)
+	{
+		added = Select();
+	}
+	else
+	{
+		added.reserve(pending_added_.size());
+		for (int id : pending_added_)
+		{
+			added.push_back(&entries_.at(id));
+		}
+
+		std::sort(added.begin(), added.end(), ById);
+	}
+
+	delta.added.reserve(added.size());
+	for (const PeerInfo* peer : added)
+	{
+		delta.added.push_back(*peer);
+	}
+
+	pending_reset_ = false;
+	pending_added_.clear();
+
+	// Observers may unregister while being notified.
+	auto observers = observers_;
+	for (const auto& entry : observers)
+	{
+		const PeerFilter& filter = entry.second;
+		if (filter.name_prefix.empty() && filter.tag.empty())
+		{
+			entry.first->OnPeersChanged(delta);
+			continue;
+		}
+
+		PeerDirectoryDelta filtered;
+		filtered.reset = delta.reset;
+		for (const PeerInfo& peer : delta.added)
+		{
+			if (filter.Matches(peer.name))
+			{
+				filtered.added.push_back(peer);
+			}
+		}
+
+		for (const PeerInfo& peer : delta.removed)
+		{
+			if (filter.Matches(peer.name))
+			{
+				filtered.removed.push_back(peer);
+			}
+		}
+
+		if (filtered.reset || !filtered.added.empty() || !filtered.removed.empty())
+		{
+			entry.first->OnPeersChanged(filtered);
+		}
+	}
+}
+
+void PeerDirectory::RemoveEntry(std::unordered_map<int, PeerInfo>::iterator it)
+{
+	by_name_.erase(std::make_pair(it->second.name, it->first));
+
+	// A peer added since the last flush was never reported.
+	if (pending_added_.erase(it->first) == 0 && !pending_reset_)
+	{
+		pending_removed_.push_back(std::move(it->second));
+	}
+
+	entries_.erase(it);
+}
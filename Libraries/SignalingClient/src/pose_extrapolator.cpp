@@ -0,0 +1,459 @@
+#include "pose_extrapolator.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace
+{
+	// The velocity is measured from the newest sample at least this old,
+	// enough frames to average out the jitter of the timestamps.
+	const int64_t kVelocityWindowUs = 50000;
+
+	// Older history doesn't describe the current motion, after a pause of
+	// the client for instance.
+	const int64_t kMaxVelocityIntervalUs = 200000;
+
+	// Longer horizons overshoot more than they save.
+	const int64_t kMaxHorizonUs = 100000;
+
+	// Half a second at 60 fps, the clock mapping needs a longer history
+	// than the velocity.
+	const size_t kMaxSamples = 32;
+
+	// Tolerance of the rigid motion check, well above the float precision
+	// of the matrices.
+	const double kRigidTolerance = 1e-2;
+
+	// Rotations below it extrapolate as a pure translation.
+	const double kMinAngle = 1e-6;
+
+	typedef double Matrix[4][4];
+
+	void Load(const float values[16], Matrix m)
+	{
+		for (int i = 0; i < 16; ++i)
+		{
+			m[i / 4][i % 4] = values[i];
+		}
+	}
+
+	void Multiply(const Matrix a, const Matrix b, Matrix result)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				double sum = 0;
+				for (int k = 0; k < 4; ++k)
+				{
+					sum += a[i][k] * b[k][j];
+				}
+
+				result[i][j] = sum;
+			}
+		}
+	}
+
+	// Gauss-Jordan elimination with partial pivoting, false if |m| is
+	// singular.
+	bool Invert(const Matrix m, Matrix result)
+	{
+		Matrix a;
+		memcpy(a, m, sizeof(a));
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				result[i][j] = i == j ? 1 : 0;
+			}
+		}
+
+		for (int column = 0; column < 4; ++column)
+		{
+			int pivot = column;
+			for (int row = column + 1; row < 4; ++row)
+			{
+				if (fabs(a[row][column]) > fabs(a[pivot][column]))
+				{
+					pivot = row;
+				}
+			}
+
+			if (fabs(a[pivot][column]) < 1e-12)
+			{
+				return false;
+			}
+
+			for (int j = 0; j < 4; ++j)
+			{
+				std::swap(a[column][j], a[pivot][j]);
+				std::swap(result[column][j], result[pivot][j]);
+			}
+
+			double scale = 1 / a[column][column];
+			for (int j = 0; j < 4; ++j)
+			{
+				a[column][j] *= scale;
+				result[column][j] *= scale;
+			}
+
+			for (int row = 0; row < 4; ++row)
+			{
+				double factor = a[row][column];
+				if (row == column || factor == 0)
+				{
+					continue;
+				}
+
+				for (int j = 0; j < 4; ++j)
+				{
+					a[row][j] -= factor * a[column][j];
+					result[row][j] -= factor * result[column][j];
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// Rigid motion from |from| to |to|, the rotation in the upper 3x3 and
+	// the translation in the last column. False if the matrices differ by
+	// more than a rigid motion, a new projection for instance.
+	bool GetMotion(const float from[16], const float to[16], Matrix motion)
+	{
+		Matrix a, b, inverse;
+		Load(from, a);
+		Load(to, b);
+		if (!Invert(a, inverse))
+		{
+			return false;
+		}
+
+		Multiply(inverse, b, motion);
+		if (fabs(motion[3][0]) > kRigidTolerance || fabs(motion[3][1]) > kRigidTolerance ||
+			fabs(motion[3][2]) > kRigidTolerance || fabs(motion[3][3] - 1) > kRigidTolerance)
+		{
+			return false;
+		}
+
+		// Orthonormal columns, and no reflection.
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				double dot = 0;
+				for (int k = 0; k < 3; ++k)
+				{
+					dot += motion[k][i] * motion[k][j];
+				}
+
+				if (fabs(dot - (i == j ? 1 : 0)) > kRigidTolerance)
+				{
+					return false;
+				}
+			}
+		}
+
+		double determinant =
+			motion[0][0] * (motion[1][1] * motion[2][2] - motion[1][2] * motion[2][1]) -
+			motion[0][1] * (motion[1][0] * motion[2][2] - motion[1][2] * motion[2][0]) +
+			motion[0][2] * (motion[1][0] * motion[2][1] - motion[1][1] * motion[2][0]);
+
+		return determinant > 0;
+	}
+
+	// Unit rotation axis and angle in [0, pi] of the upper 3x3 of |motion|,
+	// through its quaternion, which tolerates the rounding errors.
+	void GetAxisAngle(const Matrix motion, double axis[3], double* angle)
+	{
+		const double trace = motion[0][0] + motion[1][1] + motion[2][2];
+		double q[4];
+		if (trace > 0)
+		{
+			double s = 2 * sqrt(trace + 1);
+			q[0] = (motion[2][1] - motion[1][2]) / s;
+			q[1] = (motion[0][2] - motion[2][0]) / s;
+			q[2] = (motion[1][0] - motion[0][1]) / s;
+			q[3] = s / 4;
+		}
+		else if (motion[0][0] > motion[1][1] && motion[0][0] > motion[2][2])
+		{
+			double s = 2 * sqrt(1 + motion[0][0] - motion[1][1] - motion[2][2]);
+			q[0] = s / 4;
+			q[1] = (motion[0][1] + motion[1][0]) / s;
+			q[2] = (motion[0][2] + motion[2][0]) / s;
+			q[3] = (motion[2][1] - motion[1][2]) / s;
+		}
+		else if (motion[1][1] > motion[2][2])
+		{
+			double s = 2 * sqrt(1 + motion[1][1] - motion[0][0] - motion[2][2]);
+			q[0] = (motion[0][1] + motion[1][0]) / s;
+			q[1] = s / 4;
+			q[2] = (motion[1][2] + motion[2][1]) / s;
+			q[3] = (motion[0][2] - motion[2][0]) / s;
+		}
+		else
+		{
+			double s = 2 * sqrt(1 + motion[2][2] - motion[0][0] - motion[1][1]);
+			q[0] = (motion[0][2] + motion[2][0]) / s;
+			q[1] = (motion[1][2] + motion[2][1]) / s;
+			q[2] = s / 4;
+			q[3] = (motion[1][0] - motion[0][1]) / s;
+		}
+
+		// The shortest of the two equivalent rotations.
+		if (q[3] < 0)
+		{
+			for (double& value : q)
+			{
+				value = -value;
+			}
+		}
+
+		double sine = sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2]);
+		*angle = 2 * atan2(sine, q[3]);
+		for (int i = 0; i < 3; ++i)
+		{
+			axis[i] = sine > 0 ? q[i] / sine : (i == 0 ? 1 : 0);
+		}
+	}
+
+	// Rotates |v| by |angle| around the unit |axis|, Rodrigues' formula.
+	void Rotate(const double axis[3], double angle, const double v[3], double result[3])
+	{
+		const double c = cos(angle);
+		const double s = sin(angle);
+		const double dot = axis[0] * v[0] + axis[1] * v[1] + axis[2] * v[2];
+		const double cross[3] =
+		{
+			axis[1] * v[2] - axis[2] * v[1],
+			axis[2] * v[0] - axis[0] * v[2],
+			axis[0] * v[1] - axis[1] * v[0]
+		};
+
+		for (int i = 0; i < 3; ++i)
+		{
+			result[i] = v[i] * c + cross[i] * s + axis[i] * dot * (1 - c);
+		}
+	}
+
+	// |motion| continued at the same velocity for |scale| times its
+	// duration. As a screw motion, the rotation turns around a fixed axis
+	// while the translation along it grows linearly, so a head turning in
+	// place keeps turning in place.
+	void ScaleMotion(const Matrix motion, double scale, Matrix result)
+	{
+		double axis[3];
+		double angle;
+		GetAxisAngle(motion, axis, &angle);
+
+		const double translation[3] = { motion[0][3], motion[1][3], motion[2][3] };
+		double scaled_translation[3];
+		if (angle < kMinAngle)
+		{
+			for (int i = 0; i < 3; ++i)
+			{
+				scaled_translation[i] = translation[i] * scale;
+			}
+		}
+		else
+		{
+			// Splits the translation along the axis from the one moving the
+			// axis itself, then finds the point |p| the rotation turns
+			// around, (I - R) p = t in the plane orthogonal to the axis.
+			const double along = axis[0] * translation[0] + axis[1] * translation[1] +
+				axis[2] * translation[2];
+			double orthogonal[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				orthogonal[i] = translation[i] - along * axis[i];
+			}
+
+			const double cotangent = 1 / tan(angle / 2);
+			const double cross[3] =
+			{
+				axis[1] * orthogonal[2] - axis[2] * orthogonal[1],
+				axis[2] * orthogonal[0] - axis[0] * orthogonal[2],
+				axis[0] * orthogonal[1] - axis[1] * orthogonal[0]
+			};
+
+			double p[3];
+			for (int i = 0; i < 3; ++i)
+			{
+				p[i] = (orthogonal[i] + cotangent * cross[i]) / 2;
+			}
+
+			double rotated[3];
+			Rotate(axis, angle * scale, p, rotated);
+			for (int i = 0; i < 3; ++i)
+			{
+				scaled_translation[i] = p[i] - rotated[i] + along * scale * axis[i];
+			}
+		}
+
+		for (int j = 0; j < 3; ++j)
+		{
+			const double column[3] = { j == 0 ? 1. : 0., j == 1 ? 1. : 0., j == 2 ? 1. : 0. };
+			double rotated[3];
+			Rotate(axis, angle * scale, column, rotated);
+			for (int i = 0; i < 3; ++i)
+			{
+				result[i][j] = rotated[i];
+			}
+		}
+
+		for (int i = 0; i < 3; ++i)
+		{
+			result[i][3] = scaled_translation[i];
+			result[3][i] = 0;
+		}
+
+		result[3][3] = 1;
+	}
+
+	void Apply(const float values[16], const Matrix motion, float result[16])
+	{
+		Matrix m, product;
+		Load(values, m);
+		Multiply(m, motion, product);
+		for (int i = 0; i < 16; ++i)
+		{
+			result[i] = static_cast<float>(product[i / 4][i % 4]);
+		}
+	}
+}
+
+PoseExtrapolator::PoseExtrapolator() :
+	pipeline_latency_us_(kDefaultPipelineLatencyUs),
+	client_timestamps_(false),
+	stats_()
+{
+}
+
+void PoseExtrapolator::SetPipelineLatencyUs(int64_t latency_us)
+{
+	pipeline_latency_us_ = (std::max)(latency_us, static_cast<int64_t>(0));
+}
+
+void PoseExtrapolator::AddSample(
+	int64_t target_time_us, int64_t now_us, const float left[16], const float right[16])
+{
+	Sample sample;
+	sample.time_us = target_time_us != 0 ? target_time_us : now_us;
+	sample.received_time_us = now_us;
+	memcpy(sample.left, left, sizeof(sample.left));
+	memcpy(sample.right, right, sizeof(sample.right));
+	stats_.samples++;
+
+	if (!samples_.empty())
+	{
+		const Sample& latest = samples_.back();
+		Matrix motion;
+
+		// A new session, or a client clock which went backwards.
+		if (client_timestamps_ != (target_time_us != 0) || sample.time_us < latest.time_us)
+		{
+			samples_.clear();
+		}
+		else if (!GetMotion(latest.left, sample.left, motion))
+		{
+			stats_.discontinuities++;
+			samples_.clear();
+		}
+		else if (sample.time_us == latest.time_us)
+		{
+			// Resent for the same display time.
+			samples_.pop_back();
+		}
+	}
+
+	client_timestamps_ = target_time_us != 0;
+	samples_.push_back(sample);
+
+	if (samples_.size() > kMaxSamples)
+	{
+		samples_.pop_front();
+	}
+}
+
+bool PoseExtrapolator::Extrapolate(int64_t now_us, float left[16], float right[16])
+{
+	if (samples_.empty())
+	{
+		return false;
+	}
+
+	const Sample& latest = samples_.back();
+	memcpy(left, latest.left, sizeof(latest.left));
+	memcpy(right, latest.right, sizeof(latest.right));
+
+	// The client paused, its last motion doesn't describe the head anymore.
+	const int64_t latest_time_us = LatestSampleTimeUs();
+	if (now_us - latest_time_us > kMaxVelocityIntervalUs)
+	{
+		return true;
+	}
+
+	auto first = samples_.rbegin();
+	while (first + 1 != samples_.rend() && latest.time_us - first->time_us < kVelocityWindowUs)
+	{
+		++first;
+	}
+
+	const int64_t interval_us = latest.time_us - first->time_us;
+	if (interval_us <= 0 || interval_us > kMaxVelocityIntervalUs)
+	{
+		return true;
+	}
+
+	const int64_t horizon_us = (std::min)(
+		now_us + pipeline_latency_us_ - latest_time_us, kMaxHorizonUs);
+
+	Matrix motion;
+	if (horizon_us <= 0 || !GetMotion(first->left, latest.left, motion))
+	{
+		return true;
+	}
+
+	Matrix scaled;
+	ScaleMotion(motion, static_cast<double>(horizon_us) / interval_us, scaled);
+
+	// The head moves both eyes alike.
+	Apply(latest.left, scaled, left);
+	Apply(latest.right, scaled, right);
+
+	double axis[3];
+	double angle;
+	GetAxisAngle(motion, axis, &angle);
+
+	stats_.extrapolated++;
+	stats_.horizon_us = horizon_us;
+	stats_.angular_velocity = static_cast<float>(angle * 1e6 / interval_us);
+	return true;
+}
+
+void PoseExtrapolator::Reset()
+{
+	samples_.clear();
+}
+
+int64_t PoseExtrapolator::LatestSampleTimeUs() const
+{
+	const Sample& latest = samples_.back();
+	if (!client_timestamps_)
+	{
+		return latest.received_time_us;
+	}
+
+	// Maps the client clock with the smallest transit of the history, the
+	// others waited in the network or in the input queue.
+	int64_t offset_us = latest.received_time_us - latest.time_us;
+	for (const Sample& sample : samples_)
+	{
+		offset_us = (std::min)(offset_us, sample.received_time_us - sample.time_us);
+	}
+
+	return latest.time_us + offset_us;
+}
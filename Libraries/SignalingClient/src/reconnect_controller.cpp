@@ -0,0 +1,66 @@
+#include "reconnect_controller.h"
+
+#include <algorithm>
+
+ReconnectController::ReconnectController(int base_delay_ms, int max_delay_ms) :
+	base_delay_ms_(base_delay_ms),
+	max_delay_ms_(max_delay_ms),
+	random_(std::random_device()()),
+	stats_()
+{
+}
+
+int ReconnectController::NextDelayMs()
+{
+	// Doubles until the cap, without overflowing on long outages.
+	int64_t ceiling = base_delay_ms_;
+	for (int i = 0; i < stats_.consecutive_failures && ceiling < max_delay_ms_; ++i)
+	{
+		ceiling *= 2;
+	}
+
+	ceiling = (std::min)(ceiling, static_cast<int64_t>(max_delay_ms_));
+	std::uniform_int_distribution<int> distribution(0, static_cast<int>(ceiling));
+	int delay_ms = distribution(random_);
+
+	stats_.attempts++;
+	stats_.consecutive_failures++;
+	stats_.last_delay_ms = delay_ms;
+	stats_.total_delay_ms += delay_ms;
+	return delay_ms;
+}
+
+void ReconnectController::OnConnected()
+{
+	stats_.consecutive_failures = 0;
+}
+
+void ReconnectController::OnResumed(bool same_id)
+{
+	if (same_id)
+	{
+		stats_.resumed++;
+	}
+	else
+	{
+		stats_.new_sessions++;
+	}
+}
+
+ResponseAction ReconnectController::ActionForResponse(SignalingRequest request, int status_code)
+{
+	if (status_code == 200)
+	{
+		return RESPONSE_PROCESS;
+	}
+
+	switch (request)
+	{
+	case SIGNALING_WAIT:
+	case SIGNALING_HEARTBEAT:
+		return RESPONSE_RECONNECT;
+
+	default:
+		return RESPONSE_DISCONNECT;
+	}
+}
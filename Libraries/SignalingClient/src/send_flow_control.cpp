@@ -0,0 +1,42 @@
+#include "send_flow_control.h"
+
+SendFlowControl::SendFlowControl(uint64_t high_water_mark, uint64_t low_water_mark) :
+	high_water_mark_(high_water_mark),
+	low_water_mark_(low_water_mark < high_water_mark ? low_water_mark : high_water_mark),
+	paused_(false),
+	stats_()
+{
+}
+
+void SendFlowControl::Update(uint64_t buffered_amount)
+{
+	stats_.buffered_amount = buffered_amount;
+	if (buffered_amount > stats_.max_buffered_amount)
+	{
+		stats_.max_buffered_amount = buffered_amount;
+	}
+
+	// The gap between the marks keeps the sender from toggling on every
+	// message.
+	if (!paused_ && buffered_amount >= high_water_mark_)
+	{
+		paused_ = true;
+		stats_.pauses++;
+	}
+	else if (paused_ && buffered_amount <= low_water_mark_)
+	{
+		paused_ = false;
+	}
+}
+
+bool SendFlowControl::ShouldSend(uint64_t buffered_amount, Priority priority)
+{
+	Update(buffered_amount);
+	if (priority == LOW_PRIORITY && paused_)
+	{
+		stats_.dropped++;
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,555 @@
+#include "signaling_message.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	// Member names of the signaling messages.
+	const char kTypeName[] = "type";
+	const char kSdpName[] = "sdp";
+	const char kSdpMidName[] = "sdpMid";
+	const char kSdpMLineIndexName[] = "sdpMLineIndex";
+	const char kCandidateName[] = "candidate";
+
+	// Nesting accepted in skipped values.
+	const int kMaxDepth = 32;
+
+	const char kHexDigits[] = "0123456789abcdef";
+
+	void AppendQuoted(const std::string& value, std::string* out)
+	{
+		out->push_back('"');
+		const char* data = value.data();
+		const char* end = data + value.size();
+		const char* run = data;
+		for (const char* p = data; p < end; ++p)
+		{
+			unsigned char c = static_cast<unsigned char>(*p);
+			if (c >= 0x20 && c != '"' && c != '\\')
+			{
+				continue;
+			}
+
+			out->append(run, p - run);
+			run = p + 1;
+			char escape[] = { '\\', static_cast<char>(c), '\0' };
+			switch (c)
+			{
+			case '\n': escape[1] = 'n'; break;
+			case '\r': escape[1] = 'r'; break;
+			case '\t': escape[1] = 't'; break;
+			case '\b': escape[1] = 'b'; break;
+			case '\f': escape[1] = 'f'; break;
+			case '"':
+			case '\\':
+				break;
+			default:
+				out->append("\\u00");
+				escape[0] = kHexDigits[c >> 4];
+				escape[1] = kHexDigits[c & 0xf];
+				break;
+			}
+
+			out->append(escape, 2);
+		}
+
+		out->append(run, end - run);
+		out->push_back('"');
+	}
+
+	void AppendUtf8(unsigned int code_point, std::string* out)
+	{
+		if (code_point < 0x80)
+		{
+			out->push_back(static_cast<char>(code_point));
+		}
+		else if (code_point < 0x800)
+		{
+			out->push_back(static_cast<char>(0xc0 | (code_point >> 6)));
+			out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+		}
+		else if (code_point < 0x10000)
+		{
+			out->push_back(static_cast<char>(0xe0 | (code_point >> 12)));
+			out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+			out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+		}
+		else
+		{
+			out->push_back(static_cast<char>(0xf0 | (code_point >> 18)));
+			out->push_back(static_cast<char>(0x80 | ((code_point >> 12) & 0x3f)));
+			out->push_back(static_cast<char>(0x80 | ((code_point >> 6) & 0x3f)));
+			out->push_back(static_cast<char>(0x80 | (code_point & 0x3f)));
+		}
+	}
+
+	// Single pass reader of a JSON text.
+	class JsonScanner
+	{
+	public:
+		JsonScanner(const char* data, size_t length) :
+			p_(data),
+			end_(data + length)
+		{
+		}
+
+		// Returns the next character after whitespaces, '\0' at the end.
+		char Peek()
+		{
+			while (p_ < end_ && (*p_ == ' ' || *p_ == '\t' || *p_ == '\r' || *p_ == '\n'))
+			{
+				p_++;
+			}
+
+			return p_ < end_ ? *p_ : '\0';
+		}
+
+		bool Consume(char c)
+		{
+			if (Peek() != c)
+			{
+				return false;
+			}
+
+			p_++;
+			return true;
+		}
+
+		bool AtEnd()
+		{
+			Peek();
+			return p_ == end_;
+		}
+
+		const char* position() const { return p_; }
+
+		// Reads a string value, or skips it when |value| is null.
+		bool ReadString(std::string* value)
+		{
+			if (!Consume('"'))
+			{
+				return false;
+			}
+
+			if (value)
+			{
+				value->clear();
+			}
+
+			while (p_ < end_)
+			{
+				// Copies the runs without escapes at once.
+				const char* run = p_;
+				while (p_ < end_ && *p_ != '"' && *p_ != '\\')
+				{
+					p_++;
+				}
+
+				if (value)
+				{
+					value->append(run, p_ - run);
+				}
+
+				if (p_ == end_)
+				{
+					return false;
+				}
+
+				if (*p_++ == '"')
+				{
+					return true;
+				}
+
+				if (!ReadEscape(value))
+				{
+					return false;
+				}
+			}
+
+			return false;
+		}
+
+		// Reads an integer, given as a number or as a numeric string.
+		bool ReadInt(int* value)
+		{
+			std::string text;
+			if (Peek() == '"')
+			{
+				if (!ReadString(&text))
+				{
+					return false;
+				}
+			}
+			else
+			{
+				const char* begin = p_;
+				SkipNumber();
+				text.assign(begin, p_ - begin);
+			}
+
+			if (text.empty())
+			{
+				return false;
+			}
+
+			char* end = nullptr;
+			long number = strtol(text.c_str(), &end, 10);
+			if (*end != '\0')
+			{
+				// Integral numbers written with a fraction or an exponent.
+				double real = strtod(text.c_str(), &end);
+				if (*end != '\0' || real != static_cast<double>(static_cast<long>(real)))
+				{
+					return false;
+				}
+
+				number = static_cast<long>(real);
+			}
+
+			if (number < INT_MIN || number > INT_MAX)
+			{
+				return false;
+			}
+
+			*value = static_cast<int>(number);
+			return true;
+		}
+
+		bool SkipValue(int depth = 0)
+		{
+			char c = Peek();
+			if (c == '"')
+			{
+				return ReadString(nullptr);
+			}
+
+			if (c == '{' || c == '[')
+			{
+				if (depth >= kMaxDepth)
+				{
+					return false;
+				}
+
+				char close = c == '{' ? '}' : ']';
+				p_++;
+				if (Consume(close))
+				{
+					return true;
+				}
+
+				do
+				{
+					if (c == '{' && (!ReadString(nullptr) || !Consume(':')))
+					{
+						return false;
+					}
+
+					if (!SkipValue(depth + 1))
+					{
+						return false;
+					}
+				} while (Consume(','));
+
+				return Consume(close);
+			}
+
+			if (c == '-' || (c >= '0' && c <= '9'))
+			{
+				SkipNumber();
+				return true;
+			}
+
+			return SkipLiteral("true") || SkipLiteral("false") || SkipLiteral("null");
+		}
+
+	private:
+		bool ReadEscape(std::string* value)
+		{
+			if (p_ == end_)
+			{
+				return false;
+			}
+
+			char c = *p_++;
+			char decoded;
+			switch (c)
+			{
+			case '"': decoded = '"'; break;
+			case '\\': decoded = '\\'; break;
+			case '/': decoded = '/'; break;
+			case 'n': decoded = '\n'; break;
+			case 'r': decoded = '\r'; break;
+			case 't': decoded = '\t'; break;
+			case 'b': decoded = '\b'; break;
+			case 'f': decoded = '\f'; break;
+			case 'u':
+			{
+				unsigned int code_point;
+				if (!ReadHex4(&code_point))
+				{
+					return false;
+				}
+
+				// Surrogate pair.
+				unsigned int low;
+				if (code_point >= 0xd800 && code_point < 0xdc00 &&
+					end_ - p_ >= 6 && p_[0] == '\\' && p_[1] == 'u')
+				{
+					p_ += 2;
+					if (!ReadHex4(&low) || low < 0xdc00 || low >= 0xe000)
+					{
+						return false;
+					}
+
+					code_point = 0x10000 + ((code_point - 0xd800) << 10) + (low - 0xdc00);
+				}
+
+				if (value)
+				{
+					AppendUtf8(code_point, value);
+				}
+
+				return true;
+			}
+			default:
+				return false;
+			}
+
+			if (value)
+			{
+				value->push_back(decoded);
+			}
+
+			return true;
+		}
+
+		bool ReadHex4(unsigned int* value)
+		{
+			if (end_ - p_ < 4)
+			{
+				return false;
+			}
+
+			*value = 0;
+			for (int i = 0; i < 4; ++i)
+			{
+				char c = *p_++;
+				unsigned int digit;
+				if (c >= '0' && c <= '9')
+				{
+					digit = c - '0';
+				}
+				else if (c >= 'a' && c <= 'f')
+				{
+					digit = c - 'a' + 10;
+				}
+				else if (c >= 'A' && c <= 'F')
+				{
+					digit = c - 'A' + 10;
+				}
+				else
+				{
+					return false;
+				}
+
+				*value = (*value << 4) | digit;
+			}
+
+			return true;
+		}
+
+		void SkipNumber()
+		{
+			while (p_ < end_ && ((*p_ >= '0' && *p_ <= '9') ||
+				*p_ == '-' || *p_ == '+' || *p_ == '.' || *p_ == 'e' || *p_ == 'E'))
+			{
+				p_++;
+			}
+		}
+
+		bool SkipLiteral(const char* literal)
+		{
+			size_t length = strlen(literal);
+			if (static_cast<size_t>(end_ - p_) < length || memcmp(p_, literal, length) != 0)
+			{
+				return false;
+			}
+
+			p_ += length;
+			return true;
+		}
+
+		const char* p_;
+		const char* end_;
+	};
+
+	// Reads a string member, values of other types are skipped the way
+	// rtc::GetStringFromJsonObject ignores them.
+	bool ReadStringMember(JsonScanner* scanner, std::string* value, bool* present)
+	{
+		if (scanner->Peek() != '"')
+		{
+			return scanner->SkipValue();
+		}
+
+		*present = true;
+		return scanner->ReadString(value);
+	}
+}
+
+SignalingMessage::SignalingMessage() :
+	has_sdp(false),
+	sdp_mline_index(0),
+	has_sdp_mid(false),
+	has_sdp_mline_index(false),
+	has_candidate(false)
+{
+}
+
+bool SignalingMessage::is_candidate() const
+{
+	return has_sdp_mid && has_sdp_mline_index && has_candidate;
+}
+
+std::string SignalingMessageCodec::WriteSessionDescription(const std::string& type,
+	const std::string& sdp)
+{
+	std::string out;
+	out.reserve(sdp.size() + type.size() + 64);
+	out.append("{\"");
+	out.append(kSdpName);
+	out.append("\":");
+	AppendQuoted(sdp, &out);
+	out.append(",\"");
+	out.append(kTypeName);
+	out.append("\":");
+	AppendQuoted(type, &out);
+	out.push_back('}');
+	return out;
+}
+
+std::string SignalingMessageCodec::WriteCandidate(const std::string& sdp_mid, int sdp_mline_index,
+	const std::string& candidate)
+{
+	std::string out;
+	out.reserve(candidate.size() + sdp_mid.size() + 64);
+	out.append("{\"");
+	out.append(kCandidateName);
+	out.append("\":");
+	AppendQuoted(candidate, &out);
+	out.append(",\"");
+	out.append(kSdpMLineIndexName);
+	out.append("\":");
+	out.append(std::to_string(sdp_mline_index));
+	out.append(",\"");
+	out.append(kSdpMidName);
+	out.append("\":");
+	AppendQuoted(sdp_mid, &out);
+	out.push_back('}');
+	return out;
+}
+
+bool SignalingMessageCodec::Parse(const char* data, size_t length, SignalingMessage* message)
+{
+	*message = SignalingMessage();
+
+	JsonScanner scanner(data, length);
+	if (!scanner.Consume('{'))
+	{
+		return false;
+	}
+
+	if (scanner.Consume('}'))
+	{
+		return scanner.AtEnd();
+	}
+
+	std::string name;
+	bool has_type = false;
+	do
+	{
+		if (!scanner.ReadString(&name) || !scanner.Consume(':'))
+		{
+			return false;
+		}
+
+		bool ok;
+		if (name == kSdpName)
+		{
+			ok = ReadStringMember(&scanner, &message->sdp, &message->has_sdp);
+		}
+		else if (name == kCandidateName)
+		{
+			ok = ReadStringMember(&scanner, &message->candidate, &message->has_candidate);
+		}
+		else if (name == kSdpMidName)
+		{
+			ok = ReadStringMember(&scanner, &message->sdp_mid, &message->has_sdp_mid);
+		}
+		else if (name == kSdpMLineIndexName)
+		{
+			char c = scanner.Peek();
+			if (c == '"' || c == '-' || (c >= '0' && c <= '9'))
+			{
+				ok = scanner.ReadInt(&message->sdp_mline_index);
+				message->has_sdp_mline_index = ok;
+			}
+			else
+			{
+				ok = scanner.SkipValue();
+			}
+		}
+		else if (name == kTypeName)
+		{
+			ok = ReadStringMember(&scanner, &message->type, &has_type);
+		}
+		else
+		{
+			ok = scanner.SkipValue();
+		}
+
+		if (!ok)
+		{
+			return false;
+		}
+	} while (scanner.Consume(','));
+
+	return scanner.Consume('}') && scanner.AtEnd();
+}
+
+bool SignalingMessageCodec::Parse(const std::string& data, SignalingMessage* message)
+{
+	return Parse(data.data(), data.size(), message);
+}
+
+bool SignalingMessageCodec::SplitArray(const std::string& data, std::vector<std::string>* elements)
+{
+	elements->clear();
+
+	JsonScanner scanner(data.data(), data.size());
+	if (!scanner.Consume('['))
+	{
+		return false;
+	}
+
+	if (scanner.Consume(']'))
+	{
+		return scanner.AtEnd();
+	}
+
+	do
+	{
+		scanner.Peek();
+		const char* begin = scanner.position();
+		if (!scanner.SkipValue())
+		{
+			return false;
+		}
+
+		elements->push_back(std::string(begin, scanner.position() - begin));
+	} while (scanner.Consume(','));
+
+	return scanner.Consume(']') && scanner.AtEnd();
+}
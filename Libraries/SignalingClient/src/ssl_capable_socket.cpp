@@ -45,8 +45,7 @@ void SslCapableSocket::SetUseSsl(const bool& useSsl)
 {
 	if (useSsl && ssl_adapter_.get() == nullptr)
 	{
-		ssl_adapter_.reset(SSLAdapter::Create(socket_));
-		ssl_adapter_->SetMode(rtc::SSL_MODE_TLS);
+		ssl_adapter_.reset(new TlsClientAdapter(socket_));
 		MapUnderlyingEvents(ssl_adapter_.get(), socket_);
 	}
 	else if (!useSsl && ssl_adapter_.get() != nullptr)
@@ -86,14 +85,9 @@ int SslCapableSocket::Connect(const SocketAddress& addr)
 	}
 	else
 	{
-		int err = ssl_adapter_->StartSSL(addr.hostname().c_str(), false);
-
-		if (err == 0)
-		{
-			err = ssl_adapter_->Connect(addr);
-		}
-
-		return err;
+		// The adapter handshakes once connected, resuming the cached session
+		// of the server if any.
+		return ssl_adapter_->Connect(addr);
 	}
 }
 
@@ -0,0 +1,358 @@
+#include "tls_client_adapter.h"
+
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+
+#include "webrtc/base/checks.h"
+#include "webrtc/base/logging.h"
+
+namespace
+{
+	// Ciphertext moved between the socket and the TLS engine per call.
+	const size_t kTransferChunkSize = 4096;
+}
+
+TlsClientAdapter::TlsClientAdapter(rtc::AsyncSocket* socket) :
+	rtc::AsyncSocketAdapter(socket),
+	state_(TLS_NONE),
+	resuming_(false),
+	ssl_(nullptr),
+	input_(nullptr),
+	output_(nullptr)
+{
+}
+
+TlsClientAdapter::~TlsClientAdapter()
+{
+	Cleanup();
+}
+
+int TlsClientAdapter::Connect(const rtc::SocketAddress& addr)
+{
+	// Servers given by address are verified against it.
+	hostname_ = addr.hostname().empty() ? addr.ipaddr().ToString() : addr.hostname();
+	session_key_ = hostname_ + ":" + std::to_string(addr.port());
+
+	state_ = TLS_CONNECTING;
+	int err = AsyncSocketAdapter::Connect(addr);
+	if (err == 0 && AsyncSocketAdapter::GetState() == CS_CONNECTED)
+	{
+		// Connected synchronously, no connect event will follow.
+		return BeginHandshake() ? 0 : -1;
+	}
+
+	return err;
+}
+
+int TlsClientAdapter::Send(const void* pv, size_t cb)
+{
+	if (state_ != TLS_CONNECTED)
+	{
+		SetError(state_ == TLS_ERROR ? ENOTCONN : EWOULDBLOCK);
+		return SOCKET_ERROR;
+	}
+
+	// Memory BIOs never block, the whole buffer is taken at once.
+	int written = SSL_write(ssl_, pv, static_cast<int>(cb));
+	if (written <= 0)
+	{
+		OnError("SSL_write", SSL_get_error(ssl_, written));
+		return SOCKET_ERROR;
+	}
+
+	if (!FlushOutput())
+	{
+		return SOCKET_ERROR;
+	}
+
+	return written;
+}
+
+int TlsClientAdapter::SendTo(const void* pv, size_t cb, const rtc::SocketAddress& addr)
+{
+	return Send(pv, cb);
+}
+
+int TlsClientAdapter::Recv(void* pv, size_t cb, int64_t* timestamp)
+{
+	if (timestamp)
+	{
+		*timestamp = -1;
+	}
+
+	if (state_ != TLS_CONNECTED)
+	{
+		SetError(state_ == TLS_ERROR ? ENOTCONN : EWOULDBLOCK);
+		return SOCKET_ERROR;
+	}
+
+	int read = SSL_read(ssl_, pv, static_cast<int>(cb));
+	if (read > 0)
+	{
+		return read;
+	}
+
+	int err = SSL_get_error(ssl_, read);
+	switch (err)
+	{
+	case SSL_ERROR_WANT_READ:
+	case SSL_ERROR_WANT_WRITE:
+		// Post handshake messages, e.g. session tickets, may need an answer.
+		FlushOutput();
+		SetError(EWOULDBLOCK);
+		return SOCKET_ERROR;
+
+	case SSL_ERROR_ZERO_RETURN:
+		// The server sent close_notify.
+		return 0;
+
+	default:
+		OnError("SSL_read", err);
+		return SOCKET_ERROR;
+	}
+}
+
+int TlsClientAdapter::RecvFrom(void* pv, size_t cb, rtc::SocketAddress* paddr, int64_t* timestamp)
+{
+	if (paddr)
+	{
+		*paddr = GetRemoteAddress();
+	}
+
+	return Recv(pv, cb, timestamp);
+}
+
+int TlsClientAdapter::Close()
+{
+	if (state_ == TLS_CONNECTED)
+	{
+		// Sends close_notify, sessions of connections closed without it
+		// can't be resumed.
+		SSL_shutdown(ssl_);
+		FlushOutput();
+	}
+
+	Cleanup();
+	state_ = TLS_NONE;
+	return AsyncSocketAdapter::Close();
+}
+
+rtc::Socket::ConnState TlsClientAdapter::GetState() const
+{
+	ConnState state = AsyncSocketAdapter::GetState();
+	if (state == CS_CONNECTED && state_ != TLS_CONNECTED)
+	{
+		// Still handshaking.
+		state = CS_CONNECTING;
+	}
+
+	return state;
+}
+
+void TlsClientAdapter::OnConnectEvent(rtc::AsyncSocket* socket)
+{
+	if (state_ != TLS_CONNECTING)
+	{
+		AsyncSocketAdapter::OnConnectEvent(socket);
+		return;
+	}
+
+	BeginHandshake();
+}
+
+void TlsClientAdapter::OnReadEvent(rtc::AsyncSocket* socket)
+{
+	if (state_ != TLS_HANDSHAKE && state_ != TLS_CONNECTED)
+	{
+		return;
+	}
+
+	ReadInput();
+	if (state_ == TLS_HANDSHAKE)
+	{
+		ContinueHandshake();
+	}
+	else if (state_ == TLS_CONNECTED)
+	{
+		AsyncSocketAdapter::OnReadEvent(this);
+	}
+}
+
+void TlsClientAdapter::OnWriteEvent(rtc::AsyncSocket* socket)
+{
+	if (state_ != TLS_HANDSHAKE && state_ != TLS_CONNECTED)
+	{
+		return;
+	}
+
+	if (!FlushOutput())
+	{
+		return;
+	}
+
+	if (state_ == TLS_CONNECTED && pending_output_.empty())
+	{
+		AsyncSocketAdapter::OnWriteEvent(this);
+	}
+}
+
+void TlsClientAdapter::OnCloseEvent(rtc::AsyncSocket* socket, int err)
+{
+	if (state_ == TLS_HANDSHAKE)
+	{
+		TlsSessionCache::Instance()->OnHandshakeFailed();
+	}
+
+	AsyncSocketAdapter::OnCloseEvent(this, err);
+}
+
+bool TlsClientAdapter::BeginHandshake()
+{
+	TlsSessionCache* cache = TlsSessionCache::Instance();
+	ssl_ = SSL_new(cache->ssl_ctx());
+	input_ = BIO_new(BIO_s_mem());
+	output_ = BIO_new(BIO_s_mem());
+	if (!ssl_ || !input_ || !output_)
+	{
+		SSL_free(ssl_);
+		BIO_free(input_);
+		BIO_free(output_);
+		ssl_ = nullptr;
+		input_ = nullptr;
+		output_ = nullptr;
+		OnError("SSL_new", SSL_ERROR_SSL);
+		return false;
+	}
+
+	// |ssl_| owns the BIOs from now on.
+	SSL_set_bio(ssl_, input_, output_);
+	SSL_set_app_data(ssl_, &session_key_);
+	SSL_set_connect_state(ssl_);
+
+	if (!TlsSessionCache::SetPeerName(ssl_, hostname_))
+	{
+		// Any certificate from a trusted CA would be accepted otherwise.
+		OnError("SetPeerName", SSL_ERROR_SSL);
+		return false;
+	}
+
+	SSL_SESSION* session = cache->Lookup(session_key_);
+	resuming_ = session != nullptr;
+	if (session)
+	{
+		SSL_set_session(ssl_, session);
+		SSL_SESSION_free(session);
+	}
+
+	state_ = TLS_HANDSHAKE;
+	ContinueHandshake();
+	return state_ != TLS_ERROR;
+}
+
+void TlsClientAdapter::ContinueHandshake()
+{
+	int result = SSL_do_handshake(ssl_);
+	if (!FlushOutput())
+	{
+		return;
+	}
+
+	if (result == 1)
+	{
+		bool resumed = SSL_session_reused(ssl_) != 0;
+		TlsSessionCache::Instance()->OnHandshakeComplete(resumed);
+		LOG(INFO) << "TLS handshake with " << session_key_ << (resumed ? " resumed" : " completed");
+
+		state_ = TLS_CONNECTED;
+		AsyncSocketAdapter::OnConnectEvent(this);
+
+		// Application data may have arrived with the last handshake message.
+		if (state_ == TLS_CONNECTED && (SSL_pending(ssl_) > 0 || BIO_ctrl_pending(input_) > 0))
+		{
+			AsyncSocketAdapter::OnReadEvent(this);
+		}
+
+		return;
+	}
+
+	int err = SSL_get_error(ssl_, result);
+	if (err != SSL_ERROR_WANT_READ && err != SSL_ERROR_WANT_WRITE)
+	{
+		if (resuming_)
+		{
+			// Don't offer a session the server refused to resume.
+			TlsSessionCache::Instance()->Remove(session_key_);
+		}
+
+		TlsSessionCache::Instance()->OnHandshakeFailed();
+		OnError("SSL_do_handshake", err);
+	}
+}
+
+void TlsClientAdapter::ReadInput()
+{
+	char buffer[kTransferChunkSize];
+	while (true)
+	{
+		int bytes = AsyncSocketAdapter::Recv(buffer, sizeof(buffer), nullptr);
+		if (bytes <= 0)
+		{
+			break;
+		}
+
+		BIO_write(input_, buffer, bytes);
+	}
+}
+
+bool TlsClientAdapter::FlushOutput()
+{
+	char buffer[kTransferChunkSize];
+	int bytes;
+	while ((bytes = BIO_read(output_, buffer, sizeof(buffer))) > 0)
+	{
+		pending_output_.append(buffer, bytes);
+	}
+
+	while (!pending_output_.empty())
+	{
+		int sent = AsyncSocketAdapter::Send(pending_output_.data(), pending_output_.size());
+		if (sent < 0)
+		{
+			if (IsBlocking())
+			{
+				// Flushed again from OnWriteEvent.
+				return true;
+			}
+
+			OnError("Send", GetError());
+			return false;
+		}
+
+		pending_output_.erase(0, sent);
+	}
+
+	return true;
+}
+
+void TlsClientAdapter::OnError(const char* context, int err)
+{
+	char description[256];
+	ERR_error_string_n(ERR_get_error(), description, sizeof(description));
+	LOG(LS_ERROR) << "TLS " << context << " failed for " << session_key_ << ": " << err
+		<< " (" << description << ")";
+
+	ERR_clear_error();
+	state_ = TLS_ERROR;
+	SetError(err);
+	AsyncSocketAdapter::OnCloseEvent(this, err);
+}
+
+void TlsClientAdapter::Cleanup()
+{
+	// Also frees the BIOs.
+	SSL_free(ssl_);
+	ssl_ = nullptr;
+	input_ = nullptr;
+	output_ = nullptr;
+	pending_output_.clear();
+}
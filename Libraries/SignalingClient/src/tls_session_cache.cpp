@@ -0,0 +1,162 @@
+#include "tls_session_cache.h"
+
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include "webrtc/base/arraysize.h"
+#include "webrtc/base/checks.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/sslroots.h"
+
+TlsSessionCache* TlsSessionCache::Instance()
+{
+	// Never destroyed, sockets may still be closing during shutdown.
+	static TlsSessionCache* instance = new TlsSessionCache();
+	return instance;
+}
+
+TlsSessionCache::TlsSessionCache() :
+	ssl_ctx_(SSL_CTX_new(SSLv23_client_method())),
+	stats_()
+{
+	RTC_CHECK(ssl_ctx_ != nullptr);
+
+	// Same trust as the WebRTC SSL adapter.
+	X509_STORE* store = SSL_CTX_get_cert_store(ssl_ctx_);
+	for (size_t i = 0; i < arraysize(kSSLCertCertificateList); ++i)
+	{
+		const unsigned char* cert_buffer = kSSLCertCertificateList[i];
+		X509* cert = d2i_X509(nullptr, &cert_buffer,
+			static_cast<long>(kSSLCertCertificateSizeList[i]));
+
+		if (cert)
+		{
+			X509_STORE_add_cert(store, cert);
+			X509_free(cert);
+		}
+	}
+
+	SSL_CTX_set_verify(ssl_ctx_, SSL_VERIFY_PEER, nullptr);
+	SSL_CTX_set_options(ssl_ctx_, SSL_OP_NO_SSLv2 | SSL_OP_NO_SSLv3);
+
+	// Sessions are kept here rather than in the context, indexed by server
+	// instead of session id.
+	SSL_CTX_set_session_cache_mode(ssl_ctx_,
+		SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+
+	SSL_CTX_sess_set_new_cb(ssl_ctx_, &TlsSessionCache::OnNewSession);
+}
+
+TlsSessionCache::~TlsSessionCache()
+{
+	for (auto& session : sessions_)
+	{
+		SSL_SESSION_free(session.second);
+	}
+
+	SSL_CTX_free(ssl_ctx_);
+}
+
+SSL_SESSION* TlsSessionCache::Lookup(const std::string& key)
+{
+	rtc::CritScope lock(&crit_);
+	auto it = sessions_.find(key);
+	if (it == sessions_.end())
+	{
+		return nullptr;
+	}
+
+	SSL_SESSION_up_ref(it->second);
+	return it->second;
+}
+
+void TlsSessionCache::Insert(const std::string& key, SSL_SESSION* session)
+{
+	rtc::CritScope lock(&crit_);
+	auto it = sessions_.find(key);
+	if (it != sessions_.end())
+	{
+		SSL_SESSION_free(it->second);
+		it->second = session;
+		return;
+	}
+
+	if (sessions_.size() >= kMaxSessions)
+	{
+		SSL_SESSION_free(sessions_.begin()->second);
+		sessions_.erase(sessions_.begin());
+	}
+
+	sessions_[key] = session;
+}
+
+void TlsSessionCache::Remove(const std::string& key)
+{
+	rtc::CritScope lock(&crit_);
+	auto it = sessions_.find(key);
+	if (it != sessions_.end())
+	{
+		SSL_SESSION_free(it->second);
+		sessions_.erase(it);
+	}
+}
+
+void TlsSessionCache::OnHandshakeComplete(bool resumed)
+{
+	rtc::CritScope lock(&crit_);
+	if (resumed)
+	{
+		stats_.resumed_handshakes++;
+	}
+	else
+	{
+		stats_.full_handshakes++;
+	}
+}
+
+void TlsSessionCache::OnHandshakeFailed()
+{
+	rtc::CritScope lock(&crit_);
+	stats_.failed_handshakes++;
+}
+
+TlsHandshakeStats TlsSessionCache::GetStats() const
+{
+	rtc::CritScope lock(&crit_);
+	TlsHandshakeStats stats = stats_;
+	stats.cached_sessions = static_cast<int>(sessions_.size());
+	return stats;
+}
+
+bool TlsSessionCache::SetPeerName(SSL* ssl, const std::string& host)
+{
+	if (host.empty())
+	{
+		return false;
+	}
+
+	// Only succeeds for IPv4 and IPv6 literals, which SNI can't carry.
+	X509_VERIFY_PARAM* param = SSL_get0_param(ssl);
+	if (X509_VERIFY_PARAM_set1_ip_asc(param, host.c_str()))
+	{
+		return true;
+	}
+
+	return SSL_set_tlsext_host_name(ssl, host.c_str()) == 1 &&
+		X509_VERIFY_PARAM_set1_host(param, host.c_str(), host.size()) == 1;
+}
+
+int TlsSessionCache::OnNewSession(SSL* ssl, SSL_SESSION* session)
+{
+	// The adapters store their session key as application data.
+	const std::string* key = static_cast<const std::string*>(SSL_get_app_data(ssl));
+	if (key == nullptr || key->empty())
+	{
+		return 0;
+	}
+
+	// Returning 1 keeps the reference we were given.
+	Instance()->Insert(*key, session);
+	return 1;
+}
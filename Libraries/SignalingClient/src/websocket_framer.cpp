@@ -0,0 +1,243 @@
+#include "websocket_framer.h"
+
+#include "webrtc/base/base64.h"
+#include "webrtc/base/checks.h"
+#include "webrtc/base/helpers.h"
+#include "webrtc/base/messagedigest.h"
+
+namespace
+{
+	// Appended to the key before hashing, see RFC 6455 section 1.3.
+	const char kAcceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+	const uint8_t kFinBit = 0x80;
+	const uint8_t kReservedBits = 0x70;
+	const uint8_t kOpcodeBits = 0x0F;
+	const uint8_t kMaskBit = 0x80;
+	const uint8_t kLengthBits = 0x7F;
+
+	// Payload length values announcing an extended length.
+	const uint8_t kLength16 = 126;
+	const uint8_t kLength64 = 127;
+
+	bool IsControl(int opcode)
+	{
+		return (opcode & 0x8) != 0;
+	}
+}
+
+WebSocketFramer::WebSocketFramer()
+{
+	Reset();
+}
+
+void WebSocketFramer::Reset()
+{
+	message_.clear();
+	message_opcode_ = TEXT;
+	in_message_ = false;
+}
+
+WebSocketFramer::Result WebSocketFramer::ReadMessage(std::string* data, Opcode* opcode,
+	std::string* payload)
+{
+	while (true)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data->data());
+		size_t length = data->size();
+		if (length < 2)
+		{
+			return NEED_MORE_DATA;
+		}
+
+		bool fin = (bytes[0] & kFinBit) != 0;
+		int frame_opcode = bytes[0] & kOpcodeBits;
+
+		// No extension is negotiated, the server must not mask its frames.
+		if ((bytes[0] & kReservedBits) != 0 || (bytes[1] & kMaskBit) != 0)
+		{
+			return PARSE_ERROR;
+		}
+
+		size_t header_length = 2;
+		uint64_t payload_length = bytes[1] & kLengthBits;
+		if (payload_length == kLength16)
+		{
+			header_length += 2;
+			if (length < header_length)
+			{
+				return NEED_MORE_DATA;
+			}
+
+			payload_length = (bytes[2] << 8) | bytes[3];
+		}
+		else if (payload_length == kLength64)
+		{
+			header_length += 8;
+			if (length < header_length)
+			{
+				return NEED_MORE_DATA;
+			}
+
+			payload_length = 0;
+			for (int i = 0; i < 8; ++i)
+			{
+				payload_length = (payload_length << 8) | bytes[2 + i];
+			}
+		}
+
+		switch (frame_opcode)
+		{
+		case CONTINUATION:
+			if (!in_message_)
+			{
+				return PARSE_ERROR;
+			}
+
+			break;
+
+		case TEXT:
+		case BINARY:
+			if (in_message_)
+			{
+				return PARSE_ERROR;
+			}
+
+			break;
+
+		case CLOSE:
+		case PING:
+		case PONG:
+			// Control frames are never fragmented and carry at most 125 bytes.
+			if (!fin || payload_length > 125)
+			{
+				return PARSE_ERROR;
+			}
+
+			break;
+
+		default:
+			return PARSE_ERROR;
+		}
+
+		if (payload_length > kMaxMessageSize - message_.size())
+		{
+			return PARSE_ERROR;
+		}
+
+		size_t frame_length = header_length + static_cast<size_t>(payload_length);
+		if (length < frame_length)
+		{
+			return NEED_MORE_DATA;
+		}
+
+		const char* frame_payload = data->data() + header_length;
+		size_t frame_payload_length = static_cast<size_t>(payload_length);
+		if (IsControl(frame_opcode))
+		{
+			*opcode = static_cast<Opcode>(frame_opcode);
+			payload->assign(frame_payload, frame_payload_length);
+			data->erase(0, frame_length);
+			return COMPLETE;
+		}
+
+		if (frame_opcode != CONTINUATION)
+		{
+			message_opcode_ = static_cast<Opcode>(frame_opcode);
+			in_message_ = true;
+		}
+
+		message_.append(frame_payload, frame_payload_length);
+		data->erase(0, frame_length);
+
+		if (fin)
+		{
+			*opcode = message_opcode_;
+			payload->swap(message_);
+			message_.clear();
+			in_message_ = false;
+			return COMPLETE;
+		}
+	}
+}
+
+void WebSocketFramer::WriteFrame(Opcode opcode, const char* payload, size_t length,
+	std::string* frame)
+{
+	RTC_DCHECK(!IsControl(opcode) || length <= 125);
+
+	frame->push_back(static_cast<char>(kFinBit | opcode));
+	if (length < kLength16)
+	{
+		frame->push_back(static_cast<char>(kMaskBit | length));
+	}
+	else if (length <= 0xFFFF)
+	{
+		frame->push_back(static_cast<char>(kMaskBit | kLength16));
+		frame->push_back(static_cast<char>((length >> 8) & 0xFF));
+		frame->push_back(static_cast<char>(length & 0xFF));
+	}
+	else
+	{
+		frame->push_back(static_cast<char>(kMaskBit | kLength64));
+		uint64_t length64 = length;
+		for (int shift = 56; shift >= 0; shift -= 8)
+		{
+			frame->push_back(static_cast<char>((length64 >> shift) & 0xFF));
+		}
+	}
+
+	uint32_t mask_key = rtc::CreateRandomId();
+	char mask[4] =
+	{
+		static_cast<char>(mask_key >> 24),
+		static_cast<char>(mask_key >> 16),
+		static_cast<char>(mask_key >> 8),
+		static_cast<char>(mask_key),
+	};
+
+	frame->append(mask, sizeof(mask));
+
+	size_t offset = frame->size();
+	frame->resize(offset + length);
+	for (size_t i = 0; i < length; ++i)
+	{
+		(*frame)[offset + i] = payload[i] ^ mask[i & 3];
+	}
+}
+
+void WebSocketFramer::WriteCloseFrame(uint16_t status_code, std::string* frame)
+{
+	char payload[2] =
+	{
+		static_cast<char>(status_code >> 8),
+		static_cast<char>(status_code & 0xFF),
+	};
+
+	WriteFrame(CLOSE, payload, sizeof(payload), frame);
+}
+
+std::string WebSocketFramer::CreateKey()
+{
+	std::string nonce;
+	if (!rtc::CreateRandomData(16, &nonce))
+	{
+		nonce = rtc::CreateRandomString(16);
+	}
+
+	std::string key;
+	rtc::Base64::EncodeFromArray(nonce.data(), nonce.size(), &key);
+	return key;
+}
+
+std::string WebSocketFramer::ComputeAccept(const std::string& key)
+{
+	std::string input = key + kAcceptGuid;
+	uint8_t digest[20];
+	size_t digest_length = rtc::ComputeDigest(rtc::DIGEST_SHA_1, input.data(), input.size(),
+		digest, sizeof(digest));
+
+	std::string accept;
+	rtc::Base64::EncodeFromArray(digest, digest_length, &accept);
+	return accept;
+}
@@ -11,18 +11,22 @@
 #ifndef WEBRTC_CONDUCTOR_H_
 #define WEBRTC_CONDUCTOR_H_
 
-#include <deque>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
+#include <vector>
 
 #include "video_helper.h"
+#include "config_service.h"
 #include "peer_connection_client.h"
 #include "default_data_channel_observer.h"
+#include "input_latency.h"
 #include "main_window.h"
 #include "webrtc/api/mediastreaminterface.h"
 #include "webrtc/api/peerconnectioninterface.h"
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/messagehandler.h"
 
 namespace webrtc
 {
@@ -37,7 +41,10 @@ namespace cricket
 class Conductor : public webrtc::PeerConnectionObserver,
 	public webrtc::CreateSessionDescriptionObserver,
     public PeerConnectionClientObserver,
-	public MainWindowCallback
+	public PeerDirectoryObserver,
+	public MainWindowCallback,
+	public rtc::MessageHandler,
+	public sigslot::has_slots<>
 {
 public:
 	enum CallbackID 
@@ -47,6 +54,13 @@ public:
 		SEND_MESSAGE_TO_PEER,
 		NEW_STREAM_ADDED,
 		STREAM_REMOVED,
+		ENCODER_BITRATE_CHANGED,
+		SEND_FRAME_INPUT,
+		SEND_PAYLOAD,
+		REQUEST_FIRST_FRAME_STATS,
+		FIRST_FRAME_ENCODED,
+		REQUEST_PIPELINE_STATS,
+		RUN_LOOPBACK_SESSION,
 	};
 
 	Conductor(PeerConnectionClient* client, MainWindow* main_window,
@@ -55,6 +69,30 @@ public:
 
 	bool connection_active() const;
 
+	// Accepts the binary input encoding on the data channels opened from
+	// now on, the input update function must decode it.
+	void SetBinaryInputEnabled(bool enabled);
+
+	// Counters of the input queued for the frame updates.
+	InputQueueStats input_queue_stats() const;
+
+	// Estimated time from the capture of a frame to its display on the
+	// client: encode time, half the round trip time and an assumed decode
+	// and presentation. Updated every second from the send stats, 0 before
+	// the first ones of the session. Any thread.
+	int64_t pipeline_latency_us() const;
+
+	// Sends a payload of any size to the client on the input channel, in
+	// chunks interleaved with the other messages, see MessageChunker. Any
+	// thread, returns false if the payload is too large.
+	bool SendPayload(const std::string& payload);
+
+	// Connects |sessions| loopback sessions one after the other and logs the
+	// min, average and max time from the start of each to its first encoded
+	// frame. Without |shared_factory| each session creates its own factory
+	// and threads, as before SharedPeerConnectionFactory. UI thread.
+	void RunLoopbackTest(int sessions, bool shared_factory);
+
 	virtual void Close();
 
 protected:
@@ -72,9 +110,48 @@ protected:
 
 	void AddStreams();
 
+	// ConfigService apply hook, called on the config watch thread.
+	void OnBitrateChanged(int bitrate);
+
+	// Caps the video sender bitrate, which the encoder follows through
+	// its rate allocation.
+	void ApplyBitrate(int bitrate);
+
 	std::unique_ptr<cricket::VideoCapturer> OpenVideoCaptureDevice();
 	std::unique_ptr<cricket::VideoCapturer> OpenFakeVideoCaptureDevice();
 
+	// With a frame update function, the input is queued and applied on the
+	// capture thread right before it, instead of on the signaling thread
+	// while the frame may be rendering.
+	DefaultDataChannelObserver* CreateDataChannelObserver(
+		webrtc::DataChannelInterface* channel);
+
+	// Capturer hook, drains the input queue on the capture thread.
+	void OnFrameUpdate();
+
+	// Capturer hook for the frames delivered to the encoder, tags those
+	// rendered after new input with it, for the input latency measurement
+	// of the client. See FrameInputTagger.
+	void OnFrameCaptured(int64_t ntp_time_ms);
+
+	// Polls the send stats until the first frame is encoded, to log the time
+	// from the start of the session to the first encoded frame. Accurate to
+	// the polling interval. UI thread.
+	class FirstFrameStatsObserver;
+	void RequestFirstFrameStats();
+
+	// Polls the send stats for the pipeline latency while the session is
+	// active. UI thread.
+	class PipelineStatsObserver;
+	void RequestPipelineStats();
+
+	// Records the first frame time of a loopback test session, -1 if none
+	// was encoded, and starts the next session or logs the results.
+	void FinishLoopbackSession(int64_t first_frame_ms);
+
+	// Polls again after the interval, posted on the signaling thread.
+	void OnMessage(rtc::Message* msg) override;
+
 	//-------------------------------------------------------------------------
 	// PeerConnectionObserver implementation.
 	//-------------------------------------------------------------------------
@@ -94,7 +171,7 @@ protected:
 	void OnRenegotiationNeeded() override {}
 
 	void OnIceConnectionChange(
-		webrtc::PeerConnectionInterface::IceConnectionState new_state) override {};
+		webrtc::PeerConnectionInterface::IceConnectionState new_state) override;
 
 	void OnIceGatheringChange(
 		webrtc::PeerConnectionInterface::IceGatheringState new_state) override {};
@@ -121,6 +198,12 @@ protected:
 
 	void OnServerConnectionFailure() override;
 
+	//-------------------------------------------------------------------------
+	// PeerDirectoryObserver implementation.
+	//-------------------------------------------------------------------------
+
+	void OnPeersChanged(const PeerDirectoryDelta& delta) override;
+
 	//-------------------------------------------------------------------------
 	// MainWndCallback implementation.
 	//-------------------------------------------------------------------------
@@ -153,11 +236,30 @@ protected:
 	PeerConnectionClient* client_;
 	rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel_;
 	std::unique_ptr<DefaultDataChannelObserver> data_channel_observer_;
+	rtc::scoped_refptr<webrtc::DataChannelInterface> pose_channel_;
+	std::unique_ptr<DefaultDataChannelObserver> pose_channel_observer_;
+	InputQueue input_queue_;
+
+	// Start of the session and whether its first encoded frame is awaited.
+	int64_t connect_time_ms_;
+	bool first_frame_pending_;
+
+	// Loopback test sessions left to run, and the first frame times of
+	// those completed.
+	int loopback_test_sessions_;
+	bool shared_factory_;
+	std::vector<int64_t> loopback_test_times_ms_;
+
+	rtc::CriticalSection pipeline_latency_lock_;
+	int64_t pipeline_latency_us_ GUARDED_BY(pipeline_latency_lock_);
+
+	// Capture thread only.
+	FrameInputTagger frame_input_tagger_;
+	bool binary_input_;
 	MainWindow* main_window_;
 	void (*frame_update_func_)();
 	void (*input_update_func_)(const std::string&);
 	Toolkit3DLibrary::VideoHelper* video_helper_;
-	std::deque<std::string*> pending_messages_;
 	std::map<std::string, rtc::scoped_refptr<webrtc::MediaStreamInterface>>
 		active_streams_;
 
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/sigslot.h"
+#include "webrtc/base/task_queue.h"
+#include "webrtc/modules/video_coding/codecs/h264/h264_encoder_impl.h"
+
+namespace Toolkit3DLibrary
+{
+	// NvencodeSettings section of nvEncConfig.json, passed as is to the
+	// encoder.
+	typedef webrtc::NvEncoderSettings EncoderSettings;
+
+	// Capture settings of nvEncConfig.json.
+	struct CaptureSettings
+	{
+		bool use_software_encoding = false;
+		int frame_capture_fps = 60;
+
+		// 720p frames per second the software encoder sustains on this host,
+		// 0 estimates it from the CPU cores.
+		int software_encoder_capacity_fps = 0;
+	};
+
+	// Ice server entry of webrtcConfig.json.
+	struct IceServerSettings
+	{
+		std::string uri;
+		std::string username;
+		std::string password;
+	};
+
+	// webrtcConfig.json.
+	struct WebRTCSettings
+	{
+		std::string ice_configuration;
+		IceServerSettings turn_server;
+		IceServerSettings stun_server;
+		std::string server;
+		int port = -1;
+		int heartbeat = -1;
+	};
+
+	struct ServerConfig
+	{
+		// Incremented every time a new configuration is applied.
+		int version = 0;
+		CaptureSettings capture;
+		EncoderSettings encoder;
+		WebRTCSettings webrtc;
+	};
+
+	// Parses nvEncConfig.json and webrtcConfig.json once and watches both files
+	// for changes. Reloaded settings are validated as a whole, a missing or
+	// invalid file keeps the previous configuration active. Missing files only
+	// fall back to the defaults on the first load.
+	//
+	// Changes are published through the apply hooks below, which are fired on
+	// the thread performing the reload, normally the watch task queue. Listeners
+	// are expected to marshal to their own thread when needed. The encoder
+	// settings go to H264EncoderImpl, which applies them on its own thread.
+	// Every applied version is recorded in the Toolkit3D.ConfigVersion
+	// histogram.
+	class ConfigService
+	{
+	public:
+		static ConfigService* Instance();
+
+		// Loads the configuration and starts watching for changes.
+		void Start();
+		void Stop();
+
+		// Forces a reload, returns false if the files failed validation.
+		// Reloads are serialized, concurrent callers each publish a version.
+		bool Reload();
+
+		ServerConfig config();
+		int version();
+
+		// Apply hooks. Fired only for values which actually changed.
+		sigslot::signal1<int> SignalCaptureFramerateChanged;
+		sigslot::signal1<int> SignalBitrateChanged;
+		sigslot::signal1<bool> SignalEncoderModeChanged;
+
+		// Fired after a new configuration version has been applied.
+		sigslot::signal1<int> SignalConfigApplied;
+
+	private:
+		class WatchTask;
+
+		ConfigService();
+		~ConfigService();
+
+		bool Load(ServerConfig* config);
+		bool LoadEncoderConfig(const std::string& path, ServerConfig* config);
+		bool LoadWebRTCConfig(const std::string& path, ServerConfig* config);
+		bool Validate(const ServerConfig& config);
+		void Apply(const ServerConfig& previous, const ServerConfig& current);
+		bool HasChanged();
+
+		rtc::CriticalSection lock_;
+		ServerConfig config_ GUARDED_BY(&lock_);
+		bool watching_ GUARDED_BY(&lock_);
+
+		// Held for a whole reload, so reading the previous configuration and
+		// publishing the next one cannot interleave with another reload.
+		rtc::CriticalSection reload_lock_;
+		bool loaded_ GUARDED_BY(&reload_lock_);
+		uint64_t encoder_config_write_time_ GUARDED_BY(&reload_lock_);
+		uint64_t webrtc_config_write_time_ GUARDED_BY(&reload_lock_);
+
+		// Must be the last field, so it will be deconstructed first as tasks
+		// in the TaskQueue access other fields of the instance of this class.
+		rtc::TaskQueue task_queue_;
+	};
+}
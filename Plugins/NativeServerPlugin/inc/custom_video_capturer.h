@@ -31,6 +31,7 @@
 #include "ppltasks.h"
 
 #include "video_helper.h"
+#include "config_service.h"
 #include "libyuv/convert.h"
 
 using namespace Concurrency;
@@ -132,15 +133,35 @@ namespace Toolkit3DLibrary
 		int64_t first_frame_capture_time() const { return first_frame_capture_time_; }
 
 		sigslot::signal1<CustomVideoCapturer*> SignalDestroyed;
+
+		// Fired on the capture thread before each frame update, synthetic
+		// frames included.
+		sigslot::signal0<> SignalFrameUpdate;
+
+		// Fired on the capture thread with the NTP time of each frame, once
+		// delivered to the encoder's sink. Frames the capturer drops aren't
+		// reported, the encoder may still drop the others.
+		sigslot::signal1<int64_t> SignalFrameCaptured;
 		bool Init();
 
 	private:
 		class InsertFrameTask;
 
 		void InsertFrame();
+
+		// Generates a frame without D3D, used when there is no video helper.
+		void InsertSyntheticFrame();
+
+		// Passes a rendered or synthetic frame on to the sink.
+		void DeliverFrame(const webrtc::VideoFrame& frame, int width, int height);
 		int GetCurrentConfiguredFramerate();
+
+		// ConfigService apply hooks.
+		void OnCaptureFramerateChanged(int fps);
+		void OnEncoderModeChanged(bool use_software_encoder);
+
 		Clock* const clock_;
-		bool use_software_encoder_;
+		bool use_software_encoder_ GUARDED_BY(&lock_);
 		int target_fps_ GUARDED_BY(&lock_);
 		rtc::Optional<int> wanted_fps_ GUARDED_BY(&lock_);
 		VideoRotation fake_rotation_ = kVideoRotation_0;
@@ -154,6 +175,7 @@ namespace Toolkit3DLibrary
 		Toolkit3DLibrary::VideoHelper* video_helper_;
 
 		int64_t first_frame_capture_time_;
+		uint32_t synthetic_frame_count_;
 		// Must be the last field, so it will be deconstructed first as tasks
 		// in the TaskQueue access other fields of the instance of this class.
 		rtc::TaskQueue task_queue_;
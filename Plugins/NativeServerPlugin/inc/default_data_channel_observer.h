@@ -11,14 +11,88 @@
 #ifndef WEBRTC_DEFAULT_DATA_CHANNEL_OBSERVER_H_
 #define WEBRTC_DEFAULT_DATA_CHANNEL_OBSERVER_H_
 
+#include <map>
+#include <string>
+#include <vector>
+
+#include "input_message.h"
+#include "input_queue.h"
+#include "message_chunker.h"
+#include "send_flow_control.h"
 #include "webrtc/api/mediastreaminterface.h"
 #include "webrtc/api/peerconnectioninterface.h"
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/messagehandler.h"
+#include "webrtc/base/thread.h"
+
+// Counters of one message type on a data channel.
+struct DataChannelTypeStats
+{
+	// Inter-arrival time buckets, bucket i counts the gaps below 2^i ms and
+	// the last one the longer gaps.
+	static const int kInterArrivalBuckets = 10;
+
+	uint64_t messages;
+	uint64_t bytes;
+
+	// Dropped as older than the last message of the type.
+	uint64_t stale;
+
+	uint32_t inter_arrival[kInterArrivalBuckets];
+
+	// Interarrival jitter against the client timestamps, as defined by
+	// RFC 3550, 0 for messages without timestamp.
+	int64_t jitter_us;
+};
+
+// Counters of a data channel, see DefaultDataChannelObserver::GetStats().
+struct DataChannelStats
+{
+	static const int kMessageTypes = InputMessage::MOUSE_EVENT + 1;
 
-class DefaultDataChannelObserver : public webrtc::DataChannelObserver {
+	uint64_t messages;
+	uint64_t bytes;
+
+	// Received during the last full second.
+	uint64_t bytes_per_second;
+
+	// By InputMessage::Type, UNKNOWN also counts the protocol and the
+	// malformed messages.
+	DataChannelTypeStats types[kMessageTypes];
+
+	// Of the messages sent through DefaultDataChannelObserver::Send().
+	SendFlowControlStats flow_control;
+
+	// Payloads passed to DefaultDataChannelObserver::SendPayload(), and the
+	// bytes of them not sent yet.
+	uint64_t payloads;
+	uint64_t payload_chunks;
+	size_t pending_payload_bytes;
+};
+
+class DefaultDataChannelObserver : public webrtc::DataChannelObserver,
+	public rtc::MessageHandler {
 public:
+	// Messages kept for diagnostics, the oldest are overwritten.
+	static const size_t kRecentMessages = 64;
+
+	// |binary_input| accepts the binary input encoding offered by the
+	// clients, |input_update_func| must then decode both encodings, see
+	// InputMessageCodec.
+	//
+	// On unordered channels, the messages older than the last one of the
+	// same type are dropped, by their client timestamp.
+	//
+	// Must be created on the signaling thread, which sends the payload
+	// chunks.
+	//
+	// With |input_queue|, the messages are queued for the render thread
+	// instead of passed to |input_update_func|.
 	explicit DefaultDataChannelObserver(
 		webrtc::DataChannelInterface* channel,
-		void (*input_update_func)(const std::string&));
+		void (*input_update_func)(const std::string&),
+		bool binary_input = false,
+		InputQueue* input_queue = nullptr);
 
 	virtual ~DefaultDataChannelObserver();
 
@@ -29,18 +103,79 @@ public:
 	void OnMessage(const webrtc::DataBuffer& buffer) override;
 
 	bool IsOpen() const;
-	
+
+	// Sends |message| to the client, unless the channel is congested and
+	// the message is of low priority, see SendFlowControl. Any thread.
+	bool Send(const std::string& message, SendFlowControl::Priority priority);
+
+	// Queues a payload of any size, up to MessageChunker::kMaxPayloadSize,
+	// for the client. It is sent in chunks paced on the signaling thread,
+	// one at a time while the channel buffers nothing, so the real-time
+	// messages of Send() wait at most one chunk behind it. Concurrent
+	// payloads interleave. Reliable channels only, any thread.
+	bool SendPayload(const std::string& payload);
+
+	// Sends the next payload chunk, on the signaling thread.
+	void OnMessage(rtc::Message* msg) override;
+
+	// The statistics and the recent messages may be read from any thread.
+	DataChannelStats GetStats() const;
+
+	// Calls |visitor| with each recent message, oldest first, without
+	// copying them. The data is only valid during the call, which holds the
+	// lock of the channel.
+	void VisitRecentMessages(
+		void (*visitor)(const char* data, size_t length, void* context),
+		void* context) const;
+
+	// Copies of the recent messages, oldest first.
 	std::vector<std::string> messages() const;
 	
 	std::string last_message() const;
 	
+	// All the messages received, including the overwritten ones.
 	size_t received_message_count() const;
 
 private:
+	// A message of |type| arrived after a newer one.
+	bool IsStale(InputMessage::Type type, int64_t timestamp_us);
+
+	// |timestamp_us| is -1 for the stale messages.
+	void Record(const webrtc::DataBuffer& buffer, InputMessage::Type type, int64_t timestamp_us,
+		int64_t now_us);
+
+	// Lock held.
+	uint64_t BytesPerSecond(int64_t now_us) const;
+
+	// Lock held. Posts the next chunk unless it is already.
+	void ScheduleChunk(int delay_ms);
+
 	rtc::scoped_refptr<webrtc::DataChannelInterface> channel_;
 	void (*input_update_func_)(const std::string&);
+	bool binary_input_;
+	InputQueue* input_queue_;
 	webrtc::DataChannelInterface::DataState state_;
-	std::vector<std::string> messages_;
+	rtc::Thread* signaling_thread_;
+	std::map<InputMessage::Type, int64_t> latest_timestamp_us_;
+
+	rtc::CriticalSection lock_;
+
+	// Ring of the recent messages, each slot keeps the capacity of its
+	// string so recording doesn't allocate once the messages fit.
+	std::vector<std::string> recent_messages_ GUARDED_BY(&lock_);
+	size_t next_message_ GUARDED_BY(&lock_);
+
+	SendFlowControl flow_control_ GUARDED_BY(&lock_);
+	MessageChunker chunker_ GUARDED_BY(&lock_);
+	bool chunk_scheduled_ GUARDED_BY(&lock_);
+	DataChannelStats stats_ GUARDED_BY(&lock_);
+	int64_t second_start_us_ GUARDED_BY(&lock_);
+	uint64_t second_bytes_ GUARDED_BY(&lock_);
+	uint64_t last_second_bytes_ GUARDED_BY(&lock_);
+
+	// Arrival time and client timestamp of the last message of each type.
+	int64_t last_arrival_us_[DataChannelStats::kMessageTypes] GUARDED_BY(&lock_);
+	int64_t last_timestamp_us_[DataChannelStats::kMessageTypes] GUARDED_BY(&lock_);
 };
 
 #endif // WEBRTC_DEFAULT_DATA_CHANNEL_OBSERVER_H_
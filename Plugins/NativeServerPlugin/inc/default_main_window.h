@@ -57,7 +57,7 @@ public:
 
 	virtual void SwitchToConnectUI();
 
-	virtual void SwitchToPeerList(const Peers& peers);
+	virtual void SwitchToPeerList(const PeerDirectory& peers);
 
 	virtual void SwitchToStreamingUI();
 
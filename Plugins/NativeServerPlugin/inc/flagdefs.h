@@ -30,5 +30,9 @@ DEFINE_bool(autocall, false, "Call the first available other client on "
   "the server without user intervention.  Note: this flag should only be set "
   "to true on one of the two clients.");
 DEFINE_int(heartbeat, kDefaultHeartbeat, "The interval (in ms) at which heartbeat requests will be issued");
+DEFINE_int(loopbacktest, 0, "Connects this many loopback sessions one after "
+  "the other and logs the time from connect to the first encoded frame.");
+DEFINE_bool(sharedfactory, true, "Creates the loopback test sessions from the "
+  "shared PeerConnectionFactory, or each from its own when false.");
 
 #endif  // WEBRTC_FLAGDEFS_H_
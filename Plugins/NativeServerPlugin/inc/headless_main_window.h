@@ -0,0 +1,53 @@
+#pragma once
+
+#include "main_window.h"
+#include "webrtc/base/messagehandler.h"
+#include "webrtc/base/thread.h"
+
+// MainWindow without any window, used to host streaming sessions which are
+// not tied to a rendered UI (session manager, load tests).
+//
+// UI callbacks are posted to the thread which created the instance, which
+// must be the signaling thread running the message loop.
+class HeadlessMainWindow : public MainWindow, public rtc::MessageHandler
+{
+public:
+	explicit HeadlessMainWindow(bool auto_call);
+
+	~HeadlessMainWindow();
+
+	void RegisterObserver(MainWindowCallback* callback) override;
+
+	// There is no native window, but the conductor must still drive the UI
+	// state machine.
+	bool IsWindow() override { return true; }
+
+	void MessageBox(const char* caption, const char* text, bool is_error) override;
+
+	UI current_ui() override { return ui_; }
+
+	void SwitchToConnectUI() override;
+
+	void SwitchToPeerList(const PeerDirectory& peers) override;
+
+	void SwitchToStreamingUI() override;
+
+	void StartLocalRenderer(webrtc::VideoTrackInterface* local_video) override {}
+
+	void StopLocalRenderer() override {}
+
+	void StartRemoteRenderer(webrtc::VideoTrackInterface* remote_video) override {}
+
+	void StopRemoteRenderer() override {}
+
+	void QueueUIThreadCallback(int msg_id, void* data) override;
+
+protected:
+	// rtc::MessageHandler implementation.
+	void OnMessage(rtc::Message* msg) override;
+
+	MainWindowCallback* callback_;
+	rtc::Thread* ui_thread_;
+	UI ui_;
+	bool auto_call_;
+};
@@ -64,7 +64,7 @@ public:
 
 	virtual void SwitchToConnectUI() = 0;
 
-	virtual void SwitchToPeerList(const Peers& peers) = 0;
+	virtual void SwitchToPeerList(const PeerDirectory& peers) = 0;
 
 	virtual void SwitchToStreamingUI() = 0;
 
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "conductor.h"
+#include "main_window.h"
+#include "peer_connection_client.h"
+#include "video_helper.h"
+#include "webrtc/base/thread.h"
+
+namespace Toolkit3DLibrary
+{
+	// Settings of a single streaming session.
+	struct SessionParams
+	{
+		std::string server;
+		int port = -1;
+		int heartbeat = -1;
+
+		// Resolution and framerate used for admission control.
+		int width = 1280;
+		int height = 720;
+		int fps = 60;
+
+		// Source of the frames, nullptr selects the synthetic source which
+		// needs neither a D3D device nor a window.
+		VideoHelper* video_helper = nullptr;
+		void(*frame_update_func)() = nullptr;
+		void(*input_update_func)(const std::string&) = nullptr;
+
+		// |input_update_func| decodes the binary input encoding as well.
+		bool binary_input = false;
+
+		// Calls the most recently connected peer once signed in.
+		bool auto_call = false;
+	};
+
+	// Hosts independent streaming sessions in one process. Each session owns
+	// its signaling client, headless window, conductor and therefore its own
+	// capturer, encoder and peer connection, while the PeerConnectionFactory
+	// and its threads are shared through SharedPeerConnectionFactory.
+	//
+	// Sessions are only admitted while the measured hardware encoder capacity
+	// allows it. The capacity comes from the encoder calibration cache written
+	// by the video test runner (-calibrate), hosts without calibration data
+	// are only limited by |max_sessions|. With software encoding, the capacity
+	// is softwareEncoderCapacityFps of nvEncConfig.json, or estimated from the
+	// CPU cores.
+	//
+	// All the methods must be called on the signaling thread.
+	class SessionManager
+	{
+	public:
+		explicit SessionManager(int max_sessions);
+		~SessionManager();
+
+		// Creates and signs in a new session. Returns the session id, or -1
+		// if the session was not admitted, or has no D3D source while the
+		// hardware encoder is selected.
+		int CreateSession(const SessionParams& params);
+
+		// Closes the session and releases all of its resources.
+		void DestroySession(int session_id);
+		void DestroyAllSessions();
+
+		// Returns true if a session with |params| would be admitted.
+		bool CanAdmit(const SessionParams& params);
+
+		int session_count() const { return static_cast<int>(sessions_.size()); }
+		int active_session_count() const;
+
+		// Fraction of the measured encoder capacity used by the sessions.
+		double encoder_load() const { return encoder_load_; }
+
+	private:
+		struct Session
+		{
+			SessionParams params;
+			double encoder_load;
+			std::unique_ptr<PeerConnectionClient> client;
+			std::unique_ptr<MainWindow> main_window;
+			rtc::scoped_refptr<Conductor> conductor;
+		};
+
+		// Returns the share of the encoder used by one session with |params|,
+		// or 0 when the capacity is unknown.
+		double GetEncoderLoad(const SessionParams& params);
+
+		// Measured encoder frames per second for a resolution, 0 if unknown.
+		double GetEncoderCapacityFps(int width, int height);
+
+		// Software encoder frames per second for a resolution, configured or
+		// estimated from the CPU cores.
+		double GetSoftwareEncoderCapacityFps(int width, int height);
+
+		rtc::Thread* signaling_thread_;
+		int max_sessions_;
+		int next_session_id_;
+		double encoder_load_;
+		std::map<int, std::unique_ptr<Session>> sessions_;
+		std::map<std::pair<int, int>, double> encoder_capacity_fps_;
+	};
+}
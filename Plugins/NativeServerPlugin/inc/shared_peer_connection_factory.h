@@ -0,0 +1,45 @@
+#pragma once
+
+#include <memory>
+
+#include "webrtc/api/peerconnectioninterface.h"
+#include "webrtc/base/criticalsection.h"
+#include "webrtc/base/thread.h"
+
+namespace Toolkit3DLibrary
+{
+	// Process-wide PeerConnectionFactory and thread set, shared by all the
+	// Conductor instances. Creating the factory starts the network and worker
+	// threads, which used to happen for every new peer connection.
+	class SharedPeerConnectionFactory
+	{
+	public:
+		static SharedPeerConnectionFactory* Instance();
+
+		// Creates the factory and its threads. The calling thread becomes the
+		// signaling thread and must run a message loop.
+		bool Initialize();
+
+		// Releases the factory and stops its threads. Must be called on the
+		// signaling thread once all the peer connections have been closed.
+		void Shutdown();
+
+		// Returns the shared factory, initializing it from the calling thread
+		// if needed.
+		rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory();
+
+		rtc::Thread* signaling_thread() const { return signaling_thread_; }
+		rtc::Thread* worker_thread() const { return worker_thread_.get(); }
+		rtc::Thread* network_thread() const { return network_thread_.get(); }
+
+	private:
+		SharedPeerConnectionFactory();
+		~SharedPeerConnectionFactory();
+
+		rtc::CriticalSection lock_;
+		rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> factory_ GUARDED_BY(&lock_);
+		rtc::Thread* signaling_thread_;
+		std::unique_ptr<rtc::Thread> worker_thread_;
+		std::unique_ptr<rtc::Thread> network_thread_;
+	};
+}
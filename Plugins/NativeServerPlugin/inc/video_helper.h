@@ -6,6 +6,8 @@
 #include "webrtc/modules/video_coding/codecs/h264/include/nvEncodeAPI.h"
 #include "webrtc/modules/video_coding/codecs/h264/include/nvCPUOPSys.h"
 
+#include <thread>
+
 #include "webrtc/modules/video_coding/codecs/h264/h264_encoder_impl.h"
 
 namespace Toolkit3DLibrary
@@ -35,5 +37,9 @@ namespace Toolkit3DLibrary
 		// The staging frame buffer.
 		ID3D11Texture2D*						m_stagingFrameBuffer;
 		D3D11_TEXTURE2D_DESC					m_stagingFrameBufferDesc;
+
+		// Creates the NvEnc session of the resolution while the client
+		// connects, joined before the next prewarm and on destruction.
+		std::thread								m_prewarmThread;
 	};
 }
@@ -17,25 +17,69 @@
 
 #include "conductor.h"
 #include "defaults.h"
+#include "input_message.h"
+#include "signaling_message.h"
 #include "webrtc/api/test/fakeconstraints.h"
 #include "webrtc/base/checks.h"
-#include "webrtc/base/json.h"
 #include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
 #include "webrtc/media/engine/webrtcvideocapturerfactory.h"
 #include "webrtc/modules/video_capture/video_capture_factory.h"
 #include "custom_video_capturer.h"
+#include "shared_peer_connection_factory.h"
 
-// Names used for a IceCandidate JSON object.
-const char kCandidateSdpMidName[] = "sdpMid";
-const char kCandidateSdpMlineIndexName[] = "sdpMLineIndex";
-const char kCandidateSdpName[] = "candidate";
+// Names used for data channels. The input channel is reliable and ordered,
+// for the discrete events, the pose channel unordered and without
+// retransmissions, for the camera and mouse updates.
+const char kInputDataChannelName[] = "inputDataChannel";
+const char kPoseDataChannelName[] = "poseDataChannel";
+
+// Polling of the send stats for the first encoded frame, given up after the
+// timeout.
+const int kFirstFrameStatsIntervalMs = 10;
+const int kFirstFrameStatsTimeoutMs = 10000;
+const uint32_t kFirstFrameStatsMessageId = 1;
+
+// Polling of the encode time and round trip time which make up the
+// pipeline latency, for the renderer's pose prediction. The client's decode
+// and presentation aren't reported back, they are assumed.
+const int kPipelineStatsIntervalMs = 1000;
+const uint32_t kPipelineStatsMessageId = 2;
+const int64_t kClientDecodeAndPresentUs = 10000;
+
+// Logs the traffic of a data channel, by InputMessage::Type.
+static void LogDataChannelStats(const char* label, const DefaultDataChannelObserver* observer)
+{
+	DataChannelStats stats = observer->GetStats();
+	if (stats.messages == 0)
+	{
+		return;
+	}
 
-// Names used for a SessionDescription JSON object.
-const char kSessionDescriptionTypeName[] = "type";
-const char kSessionDescriptionSdpName[] = "sdp";
+	LOG(INFO) << label << ": " << stats.messages << " messages, " << stats.bytes << " bytes";
+	if (stats.flow_control.pauses > 0)
+	{
+		LOG(INFO) << "  congested " << stats.flow_control.pauses << " times, " <<
+			stats.flow_control.dropped << " messages dropped, " <<
+			stats.flow_control.max_buffered_amount << " bytes buffered max";
+	}
 
-// Names used for data channels
-const char kInputDataChannelName[] = "inputDataChannel";
+	if (stats.payloads > 0)
+	{
+		LOG(INFO) << "  " << stats.payloads << " payloads sent in " << stats.payload_chunks <<
+			" chunks, " << stats.pending_payload_bytes << " bytes pending";
+	}
+
+	for (int type = 0; type < DataChannelStats::kMessageTypes; ++type)
+	{
+		const DataChannelTypeStats& type_stats = stats.types[type];
+		if (type_stats.messages > 0)
+		{
+			LOG(INFO) << "  type " << type << ": " << type_stats.messages << " messages, " <<
+				type_stats.stale << " stale, jitter " << type_stats.jitter_us << " us";
+		}
+	}
+}
 
 #define DTLS_ON  true
 #define DTLS_OFF false
@@ -63,6 +107,93 @@ protected:
 	~DummySetSessionDescriptionObserver() {}
 };
 
+class Conductor::FirstFrameStatsObserver : public webrtc::StatsObserver
+{
+public:
+	explicit FirstFrameStatsObserver(Conductor* conductor) : conductor_(conductor) {}
+
+	// Signaling thread.
+	void OnComplete(const webrtc::StatsReports& reports) override
+	{
+		for (const webrtc::StatsReport* report : reports)
+		{
+			if (report->type() != webrtc::StatsReport::kStatsReportTypeSsrc)
+			{
+				continue;
+			}
+
+			const webrtc::StatsReport::Value* frames_encoded =
+				report->FindValue(webrtc::StatsReport::kStatsValueNameFramesEncoded);
+
+			if (frames_encoded && frames_encoded->int_val() > 0)
+			{
+				conductor_->main_window_->QueueUIThreadCallback(FIRST_FRAME_ENCODED, NULL);
+				return;
+			}
+		}
+
+		rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kFirstFrameStatsIntervalMs,
+			conductor_.get(), kFirstFrameStatsMessageId);
+	}
+
+private:
+	rtc::scoped_refptr<Conductor> conductor_;
+};
+
+class Conductor::PipelineStatsObserver : public webrtc::StatsObserver
+{
+public:
+	explicit PipelineStatsObserver(Conductor* conductor) : conductor_(conductor) {}
+
+	// Signaling thread.
+	void OnComplete(const webrtc::StatsReports& reports) override
+	{
+		int64_t rtt_ms = -1;
+		int64_t encode_ms = -1;
+		for (const webrtc::StatsReport* report : reports)
+		{
+			if (report->type() == webrtc::StatsReport::kStatsReportTypeCandidatePair)
+			{
+				const webrtc::StatsReport::Value* active =
+					report->FindValue(webrtc::StatsReport::kStatsValueNameActiveConnection);
+
+				const webrtc::StatsReport::Value* rtt =
+					report->FindValue(webrtc::StatsReport::kStatsValueNameRtt);
+
+				if (active && active->ToString() == "true" && rtt)
+				{
+					rtt_ms = atoi(rtt->ToString().c_str());
+				}
+			}
+			else if (report->type() == webrtc::StatsReport::kStatsReportTypeSsrc)
+			{
+				const webrtc::StatsReport::Value* encode =
+					report->FindValue(webrtc::StatsReport::kStatsValueNameAvgEncodeMs);
+
+				if (encode)
+				{
+					encode_ms = atoi(encode->ToString().c_str());
+				}
+			}
+		}
+
+		// The frame travels one way, the round trip time includes the
+		// return of the acknowledgment.
+		if (rtt_ms >= 0 && encode_ms >= 0)
+		{
+			rtc::CritScope lock(&conductor_->pipeline_latency_lock_);
+			conductor_->pipeline_latency_us_ =
+				(encode_ms + rtt_ms / 2) * rtc::kNumMicrosecsPerMillisec + kClientDecodeAndPresentUs;
+		}
+
+		rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, kPipelineStatsIntervalMs,
+			conductor_.get(), kPipelineStatsMessageId);
+	}
+
+private:
+	rtc::scoped_refptr<Conductor> conductor_;
+};
+
 Conductor::Conductor(
 	PeerConnectionClient* client,
 	MainWindow* main_window,
@@ -72,13 +203,29 @@ Conductor::Conductor(
 		peer_id_(-1),
 		loopback_(false),
 		client_(client),
+		connect_time_ms_(0),
+		first_frame_pending_(false),
+		loopback_test_sessions_(0),
+		shared_factory_(true),
+		pipeline_latency_us_(0),
+		binary_input_(false),
 		main_window_(main_window),
 		frame_update_func_(frame_update_func),
 		input_update_func_(input_update_func),
 		video_helper_(video_helper)
 {
 	client_->RegisterObserver(this);
+	client_->RegisterPeerObserver(this);
 	main_window->RegisterObserver(this);
+
+	Toolkit3DLibrary::ConfigService* config_service = Toolkit3DLibrary::ConfigService::Instance();
+	config_service->Start();
+	config_service->SignalBitrateChanged.connect(this, &Conductor::OnBitrateChanged);
+
+	// Resolves the signaling and ICE server hosts while the session starts.
+	const Toolkit3DLibrary::WebRTCSettings webrtc = config_service->config().webrtc;
+	DnsCache::Instance()->PreResolve(
+		{ webrtc.server, webrtc.turn_server.uri, webrtc.stun_server.uri });
 }
 
 Conductor::~Conductor() 
@@ -91,6 +238,33 @@ bool Conductor::connection_active() const
 	return peer_connection_.get() != NULL;
 }
 
+void Conductor::SetBinaryInputEnabled(bool enabled)
+{
+	binary_input_ = enabled;
+}
+
+InputQueueStats Conductor::input_queue_stats() const
+{
+	return input_queue_.GetStats();
+}
+
+int64_t Conductor::pipeline_latency_us() const
+{
+	rtc::CritScope lock(&pipeline_latency_lock_);
+	return pipeline_latency_us_;
+}
+
+bool Conductor::SendPayload(const std::string& payload)
+{
+	if (payload.size() > MessageChunker::kMaxPayloadSize)
+	{
+		return false;
+	}
+
+	main_window_->QueueUIThreadCallback(SEND_PAYLOAD, new std::string(payload));
+	return true;
+}
+
 void Conductor::Close() 
 {
 	client_->SignOut();
@@ -106,6 +280,11 @@ void Conductor::Close()
 		data_channel_->Close();
 	}
 
+	if (pose_channel_ != nullptr)
+	{
+		pose_channel_->Close();
+	}
+
 	bool isopen = false;
 
 	if (data_channel_observer_ != nullptr)
@@ -121,7 +300,13 @@ bool Conductor::InitializePeerConnection()
 	RTC_DCHECK(peer_connection_factory_.get() == NULL);
 	RTC_DCHECK(peer_connection_.get() == NULL);
 
-	peer_connection_factory_  = webrtc::CreatePeerConnectionFactory();
+	// The factory and its threads are shared across sessions, only the peer
+	// connection itself is created per session. The loopback test may still
+	// create a factory per session, to compare the two.
+	int64_t start_time_ms = rtc::TimeMillis();
+	peer_connection_factory_ = shared_factory_ ?
+		Toolkit3DLibrary::SharedPeerConnectionFactory::Instance()->factory() :
+		webrtc::CreatePeerConnectionFactory();
 
 	if (!peer_connection_factory_.get())
 	{
@@ -141,6 +326,15 @@ bool Conductor::InitializePeerConnection()
 	}
 
 	AddStreams();
+	connect_time_ms_ = start_time_ms;
+	first_frame_pending_ = true;
+
+	// Bitrate changes are only published on change, the value loaded before
+	// this session started has to be applied to its new sender.
+	ApplyBitrate(Toolkit3DLibrary::ConfigService::Instance()->config().encoder.bitrate);
+	LOG(INFO) << "PeerConnection initialized in "
+		<< rtc::TimeMillis() - start_time_ms << " ms";
+
 	return peer_connection_.get() != NULL;
 }
 
@@ -158,6 +352,7 @@ bool Conductor::ReinitializePeerConnectionForLoopback()
 			peer_connection_->AddStream(streams->at(i));
 		}
 
+		ApplyBitrate(Toolkit3DLibrary::ConfigService::Instance()->config().encoder.bitrate);
 		peer_connection_->CreateOffer(this, NULL);
 	}
 
@@ -171,69 +366,34 @@ bool Conductor::CreatePeerConnection(bool dtls)
 
 	webrtc::PeerConnectionInterface::RTCConfiguration config;
 
-	// Try parsing config file.
-	std::string configFilePath = ExePath("webrtcConfig.json");
-	std::ifstream configFile(configFilePath);
-	Json::Reader reader;
-	Json::Value root = NULL;
+	Toolkit3DLibrary::WebRTCSettings settings =
+		Toolkit3DLibrary::ConfigService::Instance()->config().webrtc;
 
-	if (configFile.good())
+	if (settings.ice_configuration == "relay")
 	{
-
-		reader.parse(configFile, root, true);
-		if (root.isMember("iceConfiguration"))
+		webrtc::PeerConnectionInterface::IceServer turnServer;
+		turnServer.uri = settings.turn_server.uri;
+		turnServer.username = settings.turn_server.username;
+		turnServer.password = settings.turn_server.password;
+		turnServer.tls_cert_policy = webrtc::PeerConnectionInterface::kTlsCertPolicyInsecureNoCheck;
+		config.type = webrtc::PeerConnectionInterface::kRelay;
+		config.servers.push_back(turnServer);
+	}
+	else if (settings.ice_configuration == "stun")
+	{
+		if (!settings.stun_server.uri.empty())
 		{
-			Json::Value iceConfig = root.get("iceConfiguration", NULL);
-			if (iceConfig == "relay") 
-			{
-				webrtc::PeerConnectionInterface::IceServer turnServer;
-				turnServer.uri = "";
-				turnServer.username = "";
-				turnServer.password = "";
-
-
-				if (root.isMember("turnServer"))
-				{
-					Json::Value jsonTurnServer = root.get("turnServer", NULL);
-					if (!jsonTurnServer.isNull())
-					{
-						turnServer.uri = jsonTurnServer["uri"].asString();
-						turnServer.username = jsonTurnServer["username"].asString();
-						turnServer.password = jsonTurnServer["password"].asString();
-					}
-				}
-
-				turnServer.tls_cert_policy = webrtc::PeerConnectionInterface::kTlsCertPolicyInsecureNoCheck;
-				config.type = webrtc::PeerConnectionInterface::kRelay;
-				config.servers.push_back(turnServer);
-			}
-			else
-			{
-				if (iceConfig == "stun")
-				{
-					webrtc::PeerConnectionInterface::IceServer stunServer;
-					stunServer.uri = "";
-
-
-					if (root.isMember("stunServer"))
-					{
-						Json::Value jsonTurnServer = root.get("stunServer", NULL);
-						if (!jsonTurnServer.isNull())
-						{
-							stunServer.urls.push_back(jsonTurnServer["uri"].asString());
-							config.servers.push_back(stunServer);
-						}
-					}
-				}
-				else
-				{
-					webrtc::PeerConnectionInterface::IceServer stunServer;
-					stunServer.urls.push_back(GetPeerConnectionString());
-					config.servers.push_back(stunServer);
-				}
-			}	
+			webrtc::PeerConnectionInterface::IceServer stunServer;
+			stunServer.urls.push_back(settings.stun_server.uri);
+			config.servers.push_back(stunServer);
 		}
 	}
+	else if (!settings.ice_configuration.empty())
+	{
+		webrtc::PeerConnectionInterface::IceServer stunServer;
+		stunServer.urls.push_back(GetPeerConnectionString());
+		config.servers.push_back(stunServer);
+	}
 
 	webrtc::FakeConstraints constraints;
 	if (dtls) 
@@ -258,9 +418,35 @@ void Conductor::DeletePeerConnection()
 
 	main_window_->StopLocalRenderer();
 	main_window_->StopRemoteRenderer();
+
+	// Only drops our reference, the shared factory outlives the session.
 	peer_connection_factory_ = NULL;
 	peer_id_ = -1;
 	loopback_ = false;
+	first_frame_pending_ = false;
+
+	{
+		rtc::CritScope lock(&pipeline_latency_lock_);
+		pipeline_latency_us_ = 0;
+	}
+
+	if (data_channel_observer_)
+	{
+		LogDataChannelStats(kInputDataChannelName, data_channel_observer_.get());
+	}
+
+	if (pose_channel_observer_)
+	{
+		LogDataChannelStats(kPoseDataChannelName, pose_channel_observer_.get());
+	}
+
+	InputQueueStats stats = input_queue_.GetStats();
+	if (stats.drained > 0)
+	{
+		LOG(INFO) << "Input queue: " << stats.drained << " applied, " << stats.dropped <<
+			" dropped, latency " << stats.total_latency_us / stats.drained << " us average, " <<
+			stats.max_latency_us << " us max";
+	}
 }
 
 void Conductor::EnsureStreamingUI()
@@ -295,9 +481,28 @@ void Conductor::OnRemoveStream(rtc::scoped_refptr<webrtc::MediaStreamInterface>
 
 void Conductor::OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel)
 {
-	data_channel_ = channel;
-	data_channel_observer_.reset(
-		new DefaultDataChannelObserver(channel, input_update_func_));
+	// Both channels feed the same input callback, older clients only open
+	// the input channel.
+	if (channel->label() == kPoseDataChannelName)
+	{
+		pose_channel_ = channel;
+		pose_channel_observer_.reset(CreateDataChannelObserver(channel));
+	}
+	else
+	{
+		data_channel_ = channel;
+		data_channel_observer_.reset(CreateDataChannelObserver(channel));
+	}
+}
+
+void Conductor::OnIceConnectionChange(
+	webrtc::PeerConnectionInterface::IceConnectionState new_state)
+{
+	if (new_state == webrtc::PeerConnectionInterface::kIceConnectionConnected)
+	{
+		main_window_->QueueUIThreadCallback(REQUEST_FIRST_FRAME_STATS, NULL);
+		main_window_->QueueUIThreadCallback(REQUEST_PIPELINE_STATS, NULL);
+	}
 }
 
 void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate)
@@ -315,11 +520,6 @@ void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate)
 		return;
 	}
 
-	Json::StyledWriter writer;
-	Json::Value jmessage;
-
-	jmessage[kCandidateSdpMidName] = candidate->sdp_mid();
-	jmessage[kCandidateSdpMlineIndexName] = candidate->sdp_mline_index();
 	std::string sdp;
 	if (!candidate->ToString(&sdp))
 	{
@@ -327,8 +527,8 @@ void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate)
 		return;
 	}
 
-	jmessage[kCandidateSdpName] = sdp;
-	SendMessage(writer.write(jmessage));
+	SendMessage(SignalingMessageCodec::WriteCandidate(
+		candidate->sdp_mid(), candidate->sdp_mline_index(), sdp));
 }
 
 //
@@ -355,12 +555,6 @@ void Conductor::OnDisconnected()
 void Conductor::OnPeerConnected(int id, const std::string& name)
 {
 	LOG(INFO) << __FUNCTION__;
-
-	// Refresh the list if we're showing it.
-	if (main_window_->current_ui() == MainWindow::LIST_PEERS)
-	{
-		main_window_->SwitchToPeerList(client_->peers());
-	}
 }
 
 void Conductor::OnPeerDisconnected(int id)
@@ -371,13 +565,18 @@ void Conductor::OnPeerDisconnected(int id)
 		LOG(INFO) << "Our peer disconnected";
 		main_window_->QueueUIThreadCallback(PEER_CONNECTION_CLOSED, NULL);
 	}
-	else
+}
+
+//
+// PeerDirectoryObserver implementation.
+//
+
+void Conductor::OnPeersChanged(const PeerDirectoryDelta& delta)
+{
+	// Refresh the list if we're showing it, once per batch of changes.
+	if (main_window_->current_ui() == MainWindow::LIST_PEERS)
 	{
-		// Refresh the list if we're showing it.
-		if (main_window_->current_ui() == MainWindow::LIST_PEERS)
-		{
-			main_window_->SwitchToPeerList(client_->peers());
-		}
+		main_window_->SwitchToPeerList(client_->peers());
 	}
 }
 
@@ -406,18 +605,14 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 		return;
 	}
 
-	Json::Reader reader;
-	Json::Value jmessage;
-	if (!reader.parse(message, jmessage))
+	SignalingMessage signaling_message;
+	if (!SignalingMessageCodec::Parse(message, &signaling_message))
 	{
 		LOG(WARNING) << "Received unknown message. " << message;
 		return;
 	}
 
-	std::string type;
-	std::string json_object;
-
-	rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionTypeName, &type);
+	const std::string& type = signaling_message.type;
 	if (!type.empty()) 
 	{
 		if (type == "offer-loopback")
@@ -434,8 +629,7 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 			return;
 		}
 
-		std::string sdp;
-		if (!rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionSdpName, &sdp))
+		if (!signaling_message.has_sdp)
 		{
 			LOG(WARNING) << "Can't parse received session description message.";
 			return;
@@ -443,7 +637,7 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 
 		webrtc::SdpParseError error;
 		webrtc::SessionDescriptionInterface* session_description(
-			webrtc::CreateSessionDescription(type, sdp, &error));
+			webrtc::CreateSessionDescription(type, signaling_message.sdp, &error));
 
 		if (!session_description) 
 		{
@@ -467,12 +661,7 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 	}
 	else
 	{
-		std::string sdp_mid;
-		int sdp_mlineindex = 0;
-		std::string sdp;
-		if (!rtc::GetStringFromJsonObject(jmessage, kCandidateSdpMidName, &sdp_mid) ||
-			!rtc::GetIntFromJsonObject(jmessage, kCandidateSdpMlineIndexName, &sdp_mlineindex) ||
-			!rtc::GetStringFromJsonObject(jmessage, kCandidateSdpName, &sdp))
+		if (!signaling_message.is_candidate())
 		{
 			LOG(WARNING) << "Can't parse received message.";
 			return;
@@ -480,7 +669,8 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 
 		webrtc::SdpParseError error;
 		std::unique_ptr<webrtc::IceCandidateInterface> candidate(
-			webrtc::CreateIceCandidate(sdp_mid, sdp_mlineindex, sdp, &error));
+			webrtc::CreateIceCandidate(signaling_message.sdp_mid,
+				signaling_message.sdp_mline_index, signaling_message.candidate, &error));
 
 		if (!candidate.get()) 
 		{
@@ -503,8 +693,7 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 
 void Conductor::OnMessageSent(int err)
 {
-	// Process the next pending message if any.
-	main_window_->QueueUIThreadCallback(SEND_MESSAGE_TO_PEER, NULL);
+	// Pending messages are queued and sent by the signaling client.
 }
 
 void Conductor::OnServerConnectionFailure()
@@ -553,12 +742,15 @@ void Conductor::ConnectToPeer(int peer_id)
 	if (InitializePeerConnection())
 	{
 		peer_id_ = peer_id;
-		webrtc::DataChannelInit config;
-		config.ordered = false;
-		config.maxRetransmits = 0;
-		data_channel_ = peer_connection_->CreateDataChannel(kInputDataChannelName, &config);
-		data_channel_observer_.reset(
-			new DefaultDataChannelObserver(data_channel_, input_update_func_));
+		webrtc::DataChannelInit input_config;
+		data_channel_ = peer_connection_->CreateDataChannel(kInputDataChannelName, &input_config);
+		data_channel_observer_.reset(CreateDataChannelObserver(data_channel_));
+
+		webrtc::DataChannelInit pose_config;
+		pose_config.ordered = false;
+		pose_config.maxRetransmits = 0;
+		pose_channel_ = peer_connection_->CreateDataChannel(kPoseDataChannelName, &pose_config);
+		pose_channel_observer_.reset(CreateDataChannelObserver(pose_channel_));
 
 		peer_connection_->CreateOffer(this, NULL);
 	}
@@ -618,9 +810,142 @@ std::unique_ptr<cricket::VideoCapturer> Conductor::OpenFakeVideoCaptureDevice()
 		frame_update_func_,
 		video_helper_);
 
+	Toolkit3DLibrary::CustomVideoCapturer* custom_capturer =
+		static_cast<Toolkit3DLibrary::CustomVideoCapturer*>(capturer.get());
+
+	custom_capturer->SignalFrameUpdate.connect(this, &Conductor::OnFrameUpdate);
+	custom_capturer->SignalFrameCaptured.connect(this, &Conductor::OnFrameCaptured);
+
 	return capturer;
 }
 
+DefaultDataChannelObserver* Conductor::CreateDataChannelObserver(
+	webrtc::DataChannelInterface* channel)
+{
+	// The synthetic capturer drains the queue too, so its frames are tagged.
+	return new DefaultDataChannelObserver(channel, input_update_func_, binary_input_,
+		frame_update_func_ || !video_helper_ ? &input_queue_ : nullptr);
+}
+
+void Conductor::OnFrameUpdate()
+{
+	input_queue_.Drain(rtc::TimeMicros(), input_update_func_);
+}
+
+void Conductor::OnFrameCaptured(int64_t ntp_time_ms)
+{
+	FrameInput frame_input;
+	if (!frame_input_tagger_.OnFrameDelivered(ntp_time_ms, input_queue_.last_client_timestamp_us(),
+		input_queue_.last_client_push_time_us(), rtc::TimeMicros(), &frame_input))
+	{
+		return;
+	}
+
+	main_window_->QueueUIThreadCallback(SEND_FRAME_INPUT,
+		new std::string(InputMessageCodec::WriteFrameInputMessage(frame_input)));
+}
+
+void Conductor::RequestFirstFrameStats()
+{
+	if (!peer_connection_.get() || !first_frame_pending_)
+	{
+		return;
+	}
+
+	if (rtc::TimeMillis() - connect_time_ms_ > kFirstFrameStatsTimeoutMs)
+	{
+		LOG(WARNING) << "No frame encoded " << kFirstFrameStatsTimeoutMs << " ms after connect";
+		first_frame_pending_ = false;
+		if (loopback_test_sessions_ > 0)
+		{
+			FinishLoopbackSession(-1);
+		}
+
+		return;
+	}
+
+	peer_connection_->GetStats(new rtc::RefCountedObject<FirstFrameStatsObserver>(this),
+		nullptr, webrtc::PeerConnectionInterface::kStatsOutputLevelStandard);
+}
+
+void Conductor::RequestPipelineStats()
+{
+	// Stops with the session, the next one starts polling again.
+	if (!peer_connection_.get())
+	{
+		return;
+	}
+
+	peer_connection_->GetStats(new rtc::RefCountedObject<PipelineStatsObserver>(this),
+		nullptr, webrtc::PeerConnectionInterface::kStatsOutputLevelStandard);
+}
+
+void Conductor::RunLoopbackTest(int sessions, bool shared_factory)
+{
+	loopback_test_sessions_ = sessions;
+	shared_factory_ = shared_factory;
+	loopback_test_times_ms_.clear();
+	main_window_->QueueUIThreadCallback(RUN_LOOPBACK_SESSION, NULL);
+}
+
+void Conductor::FinishLoopbackSession(int64_t first_frame_ms)
+{
+	if (first_frame_ms >= 0)
+	{
+		loopback_test_times_ms_.push_back(first_frame_ms);
+	}
+
+	// The next session starts once this one is torn down.
+	DeletePeerConnection();
+	if (--loopback_test_sessions_ > 0)
+	{
+		main_window_->QueueUIThreadCallback(RUN_LOOPBACK_SESSION, NULL);
+		return;
+	}
+
+	const char* factory = shared_factory_ ? "shared" : "per session";
+	shared_factory_ = true;
+	if (loopback_test_times_ms_.empty())
+	{
+		LOG(WARNING) << "Loopback test, " << factory << " factory: no frame encoded";
+		return;
+	}
+
+	int64_t min_ms = loopback_test_times_ms_[0];
+	int64_t max_ms = min_ms;
+	int64_t total_ms = 0;
+	for (int64_t time_ms : loopback_test_times_ms_)
+	{
+		// No std::min/max, windows.h defines the macros.
+		min_ms = time_ms < min_ms ? time_ms : min_ms;
+		max_ms = time_ms > max_ms ? time_ms : max_ms;
+		total_ms += time_ms;
+	}
+
+	LOG(INFO) << "Loopback test, " << factory << " factory: first frame encoded " <<
+		min_ms << "/" << total_ms / static_cast<int64_t>(loopback_test_times_ms_.size()) <<
+		"/" << max_ms << " ms (min/avg/max) after connect, " <<
+		loopback_test_times_ms_.size() << " session(s)";
+}
+
+void Conductor::OnMessage(rtc::Message* msg)
+{
+	switch (msg->message_id)
+	{
+		case kFirstFrameStatsMessageId:
+			main_window_->QueueUIThreadCallback(REQUEST_FIRST_FRAME_STATS, NULL);
+			break;
+
+		case kPipelineStatsMessageId:
+			main_window_->QueueUIThreadCallback(REQUEST_PIPELINE_STATS, NULL);
+			break;
+
+		default:
+			RTC_NOTREACHED();
+			break;
+	}
+}
+
 void Conductor::AddStreams()
 {
 	if (active_streams_.find(kStreamLabel) != active_streams_.end())
@@ -653,6 +978,38 @@ void Conductor::AddStreams()
 	main_window_->SwitchToStreamingUI();
 }
 
+void Conductor::OnBitrateChanged(int bitrate)
+{
+	main_window_->QueueUIThreadCallback(ENCODER_BITRATE_CHANGED, new int(bitrate));
+}
+
+void Conductor::ApplyBitrate(int bitrate)
+{
+	if (!peer_connection_.get())
+	{
+		return;
+	}
+
+	for (const auto& sender : peer_connection_->GetSenders())
+	{
+		if (sender->media_type() != cricket::MEDIA_TYPE_VIDEO)
+		{
+			continue;
+		}
+
+		webrtc::RtpParameters parameters = sender->GetParameters();
+		for (auto& encoding : parameters.encodings)
+		{
+			encoding.max_bitrate_bps = rtc::Optional<int>(bitrate);
+		}
+
+		if (!sender->SetParameters(parameters))
+		{
+			LOG(WARNING) << "Failed to apply bitrate " << bitrate;
+		}
+	}
+}
+
 void Conductor::DisconnectFromCurrentPeer()
 {
 	LOG(INFO) << __FUNCTION__;
@@ -703,17 +1060,8 @@ void Conductor::UIThreadCallback(int msg_id, void* data)
 
 			if (msg)
 			{
-				// For convenience, we always run the message through the queue.
-				// This way we can be sure that messages are sent to the server
-				// in the same order they were signaled without much hassle.
-				pending_messages_.push_back(msg);
-			}
-
-			if (!pending_messages_.empty() && !client_->IsSendingMessage())
-			{
-				msg = pending_messages_.front();
-				pending_messages_.pop_front();
-
+				// The signaling client keeps its own ordered copy of the
+				// message until the server has acknowledged it.
 				if (!client_->SendToPeer(peer_id_, *msg) && peer_id_ != -1)
 				{
 					LOG(LS_ERROR) << "SendToPeer failed";
@@ -759,6 +1107,90 @@ void Conductor::UIThreadCallback(int msg_id, void* data)
 			break;
 		}
 
+		case ENCODER_BITRATE_CHANGED:
+		{
+			int* bitrate = reinterpret_cast<int*>(data);
+			ApplyBitrate(*bitrate);
+			delete bitrate;
+			break;
+		}
+
+		case SEND_FRAME_INPUT:
+		{
+			// Only informational, dropped while the channel is congested.
+			std::string* msg = reinterpret_cast<std::string*>(data);
+			if (data_channel_observer_ &&
+				data_channel_->state() == webrtc::DataChannelInterface::kOpen)
+			{
+				data_channel_observer_->Send(*msg, SendFlowControl::LOW_PRIORITY);
+			}
+
+			delete msg;
+			break;
+		}
+
+		case SEND_PAYLOAD:
+		{
+			std::string* payload = reinterpret_cast<std::string*>(data);
+			if (!data_channel_observer_ || !data_channel_observer_->SendPayload(*payload))
+			{
+				LOG(LS_WARNING) << "Dropped a payload of " << payload->size() << " bytes";
+			}
+
+			delete payload;
+			break;
+		}
+
+		case REQUEST_FIRST_FRAME_STATS:
+		{
+			RequestFirstFrameStats();
+			break;
+		}
+
+		case REQUEST_PIPELINE_STATS:
+		{
+			RequestPipelineStats();
+			break;
+		}
+
+		case FIRST_FRAME_ENCODED:
+		{
+			if (first_frame_pending_)
+			{
+				int64_t first_frame_ms = rtc::TimeMillis() - connect_time_ms_;
+				LOG(INFO) << "First frame encoded " << first_frame_ms <<
+					" ms after connect" << (loopback_ ? " (loopback)" : "");
+
+				first_frame_pending_ = false;
+				if (loopback_test_sessions_ > 0)
+				{
+					FinishLoopbackSession(first_frame_ms);
+				}
+			}
+
+			break;
+		}
+
+		case RUN_LOOPBACK_SESSION:
+		{
+			if (peer_connection_.get())
+			{
+				LOG(WARNING) << "Loopback test stopped, a session is active";
+				loopback_test_sessions_ = 0;
+				shared_factory_ = true;
+				break;
+			}
+
+			// Connects to itself, as on an offer-loopback message.
+			if (!InitializePeerConnection() || !ReinitializePeerConnectionForLoopback())
+			{
+				LOG(LS_ERROR) << "Failed to initialize the loopback session";
+				FinishLoopbackSession(-1);
+			}
+
+			break;
+		}
+
 		default:
 			RTC_NOTREACHED();
 			break;
@@ -786,11 +1218,7 @@ void Conductor::OnSuccess(webrtc::SessionDescriptionInterface* desc)
 		return;
 	}
 
-	Json::StyledWriter writer;
-	Json::Value jmessage;
-	jmessage[kSessionDescriptionTypeName] = desc->type();
-	jmessage[kSessionDescriptionSdpName] = sdp;
-	SendMessage(writer.write(jmessage));
+	SendMessage(SignalingMessageCodec::WriteSessionDescription(desc->type(), sdp));
 }
 
 void Conductor::OnFailure(const std::string& error)
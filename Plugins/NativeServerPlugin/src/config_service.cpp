@@ -0,0 +1,345 @@
+#include "pch.h"
+#include "config_service.h"
+
+#include <fstream>
+
+#include "webrtc/base/json.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/system_wrappers/include/metrics.h"
+
+// Interval between two checks of the configuration files.
+const int kConfigWatchIntervalMs = 1000;
+
+namespace Toolkit3DLibrary
+{
+	class ConfigService::WatchTask : public rtc::QueuedTask {
+	public:
+		explicit WatchTask(ConfigService* config_service)
+			: config_service_(config_service) {}
+
+	private:
+		bool Run() override {
+			{
+				rtc::CritScope cs(&config_service_->lock_);
+				if (!config_service_->watching_) {
+					// Watching stopped, the task can be deleted.
+					return true;
+				}
+			}
+
+			if (config_service_->HasChanged()) {
+				config_service_->Reload();
+			}
+
+			rtc::TaskQueue::Current()->PostDelayedTask(
+				std::unique_ptr<rtc::QueuedTask>(this), kConfigWatchIntervalMs);
+
+			// Repost of this instance, make sure it is not deleted.
+			return false;
+		}
+
+		ConfigService* const config_service_;
+	};
+
+	// Returns the last write time of a file, or 0 if the file is missing.
+	static uint64_t GetLastWriteTime(const std::string& path)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &data))
+		{
+			return 0;
+		}
+
+		return ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) |
+			data.ftLastWriteTime.dwLowDateTime;
+	}
+
+	ConfigService* ConfigService::Instance()
+	{
+		static ConfigService instance;
+		return &instance;
+	}
+
+	ConfigService::ConfigService() :
+		loaded_(false),
+		watching_(false),
+		encoder_config_write_time_(0),
+		webrtc_config_write_time_(0),
+		task_queue_("ConfigWatchQ",
+			rtc::TaskQueue::Priority::LOW)
+	{
+	}
+
+	ConfigService::~ConfigService()
+	{
+		Stop();
+	}
+
+	void ConfigService::Start()
+	{
+		{
+			rtc::CritScope cs(&lock_);
+			if (watching_)
+			{
+				return;
+			}
+
+			watching_ = true;
+		}
+
+		bool loaded;
+		{
+			rtc::CritScope cs(&reload_lock_);
+			loaded = loaded_;
+		}
+
+		if (!loaded)
+		{
+			Reload();
+		}
+
+		task_queue_.PostDelayedTask(
+			std::unique_ptr<rtc::QueuedTask>(new WatchTask(this)),
+			kConfigWatchIntervalMs);
+	}
+
+	void ConfigService::Stop()
+	{
+		rtc::CritScope cs(&lock_);
+		watching_ = false;
+	}
+
+	bool ConfigService::Reload()
+	{
+		rtc::CritScope reload_cs(&reload_lock_);
+		encoder_config_write_time_ = GetLastWriteTime(webrtc::ExePath("nvEncConfig.json"));
+		webrtc_config_write_time_ = GetLastWriteTime(webrtc::ExePath("webrtcConfig.json"));
+
+		ServerConfig previous = config();
+		ServerConfig current;
+
+		// Editors saving through delete-and-rename leave the file missing for a
+		// moment, which must not reset the live settings to the defaults. The
+		// settings of a missing file are carried over once loaded, the watch
+		// task reloads again when the file is back.
+		if (loaded_)
+		{
+			if (encoder_config_write_time_ == 0)
+			{
+				current.capture = previous.capture;
+				current.encoder = previous.encoder;
+			}
+
+			if (webrtc_config_write_time_ == 0)
+			{
+				current.webrtc = previous.webrtc;
+			}
+		}
+
+		if (!Load(&current) || !Validate(current))
+		{
+			LOG(WARNING) << "Invalid configuration, keeping version " << previous.version;
+			return false;
+		}
+
+		current.version = previous.version + 1;
+		{
+			rtc::CritScope cs(&lock_);
+			config_ = current;
+		}
+
+		// Also on the first load, so that the encoder never reads the file.
+		webrtc::H264EncoderImpl::SetEncoderSettings(current.encoder,
+			current.capture.use_software_encoding, current.version);
+		RTC_HISTOGRAM_COUNTS_1000("Toolkit3D.ConfigVersion", current.version);
+
+		// The first load only sets the defaults, nothing to apply yet.
+		if (loaded_)
+		{
+			Apply(previous, current);
+		}
+
+		loaded_ = true;
+		LOG(INFO) << "Configuration version " << current.version << " applied";
+		SignalConfigApplied(current.version);
+		return true;
+	}
+
+	ServerConfig ConfigService::config()
+	{
+		rtc::CritScope cs(&lock_);
+		return config_;
+	}
+
+	int ConfigService::version()
+	{
+		rtc::CritScope cs(&lock_);
+		return config_.version;
+	}
+
+	bool ConfigService::Load(ServerConfig* config)
+	{
+		return LoadEncoderConfig(webrtc::ExePath("nvEncConfig.json"), config) &&
+			LoadWebRTCConfig(webrtc::ExePath("webrtcConfig.json"), config);
+	}
+
+	bool ConfigService::LoadEncoderConfig(const std::string& path, ServerConfig* config)
+	{
+		Json::Reader reader;
+		Json::Value root = NULL;
+
+		// Defaults to 60 fps and hardware encoder in case of missing config file.
+		std::ifstream file(path);
+		if (!file.good())
+		{
+			return true;
+		}
+
+		if (!reader.parse(file, root, true))
+		{
+			LOG(WARNING) << "Failed to parse " << path << ": " << reader.getFormattedErrorMessages();
+			return false;
+		}
+
+		CaptureSettings& capture = config->capture;
+		capture.frame_capture_fps = root.get("serverFrameCaptureFPS", capture.frame_capture_fps).asInt();
+		capture.use_software_encoding = root.get("useSoftwareEncoding", capture.use_software_encoding).asBool();
+		capture.software_encoder_capacity_fps = root.get("softwareEncoderCapacityFps", capture.software_encoder_capacity_fps).asInt();
+
+		if (root.isMember("NvencodeSettings"))
+		{
+			Json::Value nvencodeRoot = root.get("NvencodeSettings", NULL);
+			EncoderSettings& encoder = config->encoder;
+			encoder.bitrate = nvencodeRoot.get("bitrate", encoder.bitrate).asInt();
+			encoder.min_bitrate = nvencodeRoot.get("minBitrate", encoder.min_bitrate).asInt();
+			encoder.fps = nvencodeRoot.get("fps", encoder.fps).asInt();
+			encoder.qp = nvencodeRoot.get("qp", encoder.qp).asInt();
+			encoder.intra_refresh_period = nvencodeRoot.get("intraRefreshPeriod", encoder.intra_refresh_period).asInt();
+			encoder.intra_refresh_enable = nvencodeRoot.get("intraRefreshEnableFlag", encoder.intra_refresh_enable).asBool();
+			encoder.intra_refresh_duration = nvencodeRoot.get("intraRefreshDuration", encoder.intra_refresh_duration).asInt();
+			encoder.enable_temporal_aq = nvencodeRoot.get("enableTemporalAQ", encoder.enable_temporal_aq).asBool();
+			encoder.invalidate_ref_frames = nvencodeRoot.get("invalidateRefFramesEnableFlag", encoder.invalidate_ref_frames).asBool();
+			encoder.profile = nvencodeRoot.get("nvEncodeProfile", encoder.profile).asInt();
+		}
+
+		return true;
+	}
+
+	bool ConfigService::LoadWebRTCConfig(const std::string& path, ServerConfig* config)
+	{
+		Json::Reader reader;
+		Json::Value root = NULL;
+
+		std::ifstream file(path);
+		if (!file.good())
+		{
+			return true;
+		}
+
+		if (!reader.parse(file, root, true))
+		{
+			LOG(WARNING) << "Failed to parse " << path << ": " << reader.getFormattedErrorMessages();
+			return false;
+		}
+
+		WebRTCSettings& webrtc = config->webrtc;
+		webrtc.ice_configuration = root.get("iceConfiguration", "").asString();
+		webrtc.server = root.get("server", "").asString();
+		webrtc.port = root.get("port", webrtc.port).asInt();
+		webrtc.heartbeat = root.get("heartbeat", webrtc.heartbeat).asInt();
+
+		if (root.isMember("turnServer"))
+		{
+			Json::Value jsonTurnServer = root.get("turnServer", NULL);
+			if (!jsonTurnServer.isNull())
+			{
+				webrtc.turn_server.uri = jsonTurnServer["uri"].asString();
+				webrtc.turn_server.username = jsonTurnServer["username"].asString();
+				webrtc.turn_server.password = jsonTurnServer["password"].asString();
+			}
+		}
+
+		if (root.isMember("stunServer"))
+		{
+			Json::Value jsonStunServer = root.get("stunServer", NULL);
+			if (!jsonStunServer.isNull())
+			{
+				webrtc.stun_server.uri = jsonStunServer["uri"].asString();
+			}
+		}
+
+		return true;
+	}
+
+	bool ConfigService::Validate(const ServerConfig& config)
+	{
+		const CaptureSettings& capture = config.capture;
+		const EncoderSettings& encoder = config.encoder;
+
+		if (capture.frame_capture_fps <= 0 || capture.frame_capture_fps > 240)
+		{
+			LOG(WARNING) << "serverFrameCaptureFPS out of range: " << capture.frame_capture_fps;
+			return false;
+		}
+
+		if (capture.software_encoder_capacity_fps < 0)
+		{
+			LOG(WARNING) << "Invalid softwareEncoderCapacityFps: " << capture.software_encoder_capacity_fps;
+			return false;
+		}
+
+		if (encoder.bitrate <= 0 || encoder.min_bitrate < 0 || encoder.min_bitrate > encoder.bitrate)
+		{
+			LOG(WARNING) << "Invalid bitrate range: " << encoder.min_bitrate << " - " << encoder.bitrate;
+			return false;
+		}
+
+		if (encoder.fps <= 0 || encoder.qp < 0 || encoder.qp > 51)
+		{
+			LOG(WARNING) << "Invalid encoder fps or qp";
+			return false;
+		}
+
+		if (encoder.intra_refresh_enable &&
+			(encoder.intra_refresh_period <= 0 ||
+			encoder.intra_refresh_duration <= 0 ||
+			encoder.intra_refresh_duration > encoder.intra_refresh_period))
+		{
+			LOG(WARNING) << "Invalid intra refresh period or duration";
+			return false;
+		}
+
+		if (encoder.profile < 0 || encoder.profile > 3)
+		{
+			LOG(WARNING) << "Invalid nvEncodeProfile: " << encoder.profile;
+			return false;
+		}
+
+		return true;
+	}
+
+	void ConfigService::Apply(const ServerConfig& previous, const ServerConfig& current)
+	{
+		if (current.capture.frame_capture_fps != previous.capture.frame_capture_fps)
+		{
+			SignalCaptureFramerateChanged(current.capture.frame_capture_fps);
+		}
+
+		if (current.encoder.bitrate != previous.encoder.bitrate)
+		{
+			SignalBitrateChanged(current.encoder.bitrate);
+		}
+
+		if (current.capture.use_software_encoding != previous.capture.use_software_encoding)
+		{
+			SignalEncoderModeChanged(current.capture.use_software_encoding);
+		}
+	}
+
+	bool ConfigService::HasChanged()
+	{
+		rtc::CritScope cs(&reload_lock_);
+		return GetLastWriteTime(webrtc::ExePath("nvEncConfig.json")) != encoder_config_write_time_ ||
+			GetLastWriteTime(webrtc::ExePath("webrtcConfig.json")) != webrtc_config_write_time_;
+	}
+}
@@ -1,6 +1,6 @@
 #include "pch.h"
 #include "custom_video_capturer.h"
-#include <fstream>
+#include "webrtc/base/logging.h"
 
 namespace Toolkit3DLibrary
 {
@@ -78,6 +78,7 @@ namespace Toolkit3DLibrary
 		frame_update_func_(frame_update_func),
 		video_helper_(video_helper),
 		first_frame_capture_time_(-1),
+		synthetic_frame_count_(0),
 		task_queue_("FrameGenCapQ",
 			rtc::TaskQueue::Priority::HIGH)
 	{
@@ -101,7 +102,8 @@ namespace Toolkit3DLibrary
 	}
 
 	bool CustomVideoCapturer::Init() {
-		if (frame_update_func_)
+		// Synthetic frames are pumped without any frame update callback.
+		if (frame_update_func_ || !video_helper_)
 		{
 			int framerate_fps = GetCurrentConfiguredFramerate();
 			task_queue_.PostDelayedTask(
@@ -116,31 +118,20 @@ namespace Toolkit3DLibrary
 	cricket::CaptureState CustomVideoCapturer::Start(const cricket::VideoFormat& format) {
 		SetCaptureFormat(&format);
 
-		Json::Reader reader;
-		Json::Value root = NULL;
-
-		auto encoderConfigPath = ExePath("nvEncConfig.json");
-		std::ifstream file(encoderConfigPath);
-		if (file.good())
+		ConfigService* config_service = ConfigService::Instance();
+		config_service->Start();
+		ServerConfig config = config_service->config();
 		{
-			file >> root;
-			reader.parse(file, root, true);
+			rtc::CritScope cs(&lock_);
+			target_fps_ = config.capture.frame_capture_fps;
+			use_software_encoder_ = config.capture.use_software_encoding;
+		}
 
-			if (root.isMember("serverFrameCaptureFPS")) 
-			{
-				target_fps_ = root.get("serverFrameCaptureFPS", 60).asInt();
-			}
+		config_service->SignalCaptureFramerateChanged.connect(
+			this, &CustomVideoCapturer::OnCaptureFramerateChanged);
 
-			if (root.isMember("useSoftwareEncoding")) 
-			{
-				use_software_encoder_ = root.get("useSoftwareEncoding", false).asBool();
-			}
-		}
-		else // default to 60 fps and hardward encoder in case of missing config file.
-		{
-			target_fps_ = 60;
-			use_software_encoder_ = false;
-		}
+		config_service->SignalEncoderModeChanged.connect(
+			this, &CustomVideoCapturer::OnEncoderModeChanged);
 
 		Init();
 		running_ = true;
@@ -152,11 +143,18 @@ namespace Toolkit3DLibrary
 	void CustomVideoCapturer::InsertFrame() {
 		rtc::CritScope cs(&lock_);
 		if (sending_) {
+			SignalFrameUpdate();
 			if (frame_update_func_)
 			{
 				frame_update_func_();
 			}
 
+			if (!video_helper_)
+			{
+				InsertSyntheticFrame();
+				return;
+			}
+
 			int width = 0;
 			int height = 0;
 
@@ -201,25 +199,74 @@ namespace Toolkit3DLibrary
 
 			frame.set_ntp_time_ms(clock_->CurrentNtpInMilliseconds());
 			frame.set_rotation(fake_rotation_);
-			if (first_frame_capture_time_ == -1) {
-				first_frame_capture_time_ = frame.ntp_time_ms();
-			}
+			DeliverFrame(frame, width, height);
+		}
+	}
 
-			if (sink_) {
-				sink_->OnFrame(frame);
-			}
-			else
-			{
-				OnFrame(frame, width, height);
-			}
+	void CustomVideoCapturer::InsertSyntheticFrame() {
+		const cricket::VideoFormat* format = GetCaptureFormat();
+		int width = format ? format->width : 1280;
+		int height = format ? format->height : 720;
+
+		// Scrolling luma gradient, so that the encoder has motion to work on.
+		rtc::scoped_refptr<webrtc::I420Buffer> buffer = webrtc::I420Buffer::Create(width, height);
+		int offset = static_cast<int>(synthetic_frame_count_++ * 4);
+		for (int y = 0; y < height; y++)
+		{
+			memset(buffer->MutableDataY() + y * buffer->StrideY(),
+				(y + offset) & 0xff, width);
+		}
+
+		int chroma_height = (height + 1) / 2;
+		memset(buffer->MutableDataU(), 128, buffer->StrideU() * chroma_height);
+		memset(buffer->MutableDataV(), 128, buffer->StrideV() * chroma_height);
+
+		auto timeStamp = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		auto frame = webrtc::VideoFrame(buffer, fake_rotation_, timeStamp);
+		frame.set_ntp_time_ms(clock_->CurrentNtpInMilliseconds());
+		DeliverFrame(frame, width, height);
+	}
+
+	void CustomVideoCapturer::DeliverFrame(const webrtc::VideoFrame& frame, int width, int height) {
+		if (first_frame_capture_time_ == -1) {
+			first_frame_capture_time_ = frame.ntp_time_ms();
+		}
+
+		if (sink_) {
+			sink_->OnFrame(frame);
+			SignalFrameCaptured(frame.ntp_time_ms());
+		}
+		else
+		{
+			// The base class may adapt the frame away, it isn't reported.
+			OnFrame(frame, width, height);
 		}
 	}
 
 	void CustomVideoCapturer::Stop() {
+		ConfigService* config_service = ConfigService::Instance();
+		config_service->SignalCaptureFramerateChanged.disconnect(this);
+		config_service->SignalEncoderModeChanged.disconnect(this);
+
 		rtc::CritScope cs(&lock_);
 		sending_ = false;
 	}
 
+	void CustomVideoCapturer::OnCaptureFramerateChanged(int fps) {
+		// InsertFrameTask picks up the new interval on its next run.
+		rtc::CritScope cs(&lock_);
+		target_fps_ = fps;
+	}
+
+	void CustomVideoCapturer::OnEncoderModeChanged(bool use_software_encoder) {
+		// The encoder reinitializes on its next frame with the same settings,
+		// it drops the frames captured for the other encoder meanwhile.
+		rtc::CritScope cs(&lock_);
+		use_software_encoder_ = use_software_encoder;
+		LOG(INFO) << "Encoder mode changed to "
+			<< (use_software_encoder ? "software" : "hardware");
+	}
+
 	void CustomVideoCapturer::SetSinkWantsObserver(SinkWantsObserver* observer) {
 		rtc::CritScope cs(&lock_);
 		RTC_DCHECK(!sink_wants_observer_);
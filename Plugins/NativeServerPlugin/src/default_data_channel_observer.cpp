@@ -11,55 +11,347 @@
 #include "pch.h"
 
 #include "default_data_channel_observer.h"
+#include "input_parser.h"
+#include "webrtc/base/checks.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+namespace
+{
+	// Weight of a new sample in the jitter estimate, per RFC 3550.
+	const int kJitterGain = 16;
+
+	// Interval between two payload chunks, which caps the payloads at
+	// 1.6 MB/s to leave the link to the video.
+	const int kChunkIntervalMs = 10;
+
+	// rtc::Message id of the payload chunks.
+	const uint32_t kSendChunkMessageId = 1;
+}
 
 DefaultDataChannelObserver::DefaultDataChannelObserver(
 	webrtc::DataChannelInterface* channel,
-	void (*input_update_func)(const std::string&)) : 
+	void (*input_update_func)(const std::string&),
+	bool binary_input,
+	InputQueue* input_queue) : 
 		channel_(channel),
-		input_update_func_(input_update_func)
+		input_update_func_(input_update_func),
+		binary_input_(binary_input),
+		input_queue_(input_queue),
+		signaling_thread_(rtc::Thread::Current()),
+		recent_messages_(kRecentMessages),
+		next_message_(0),
+		chunk_scheduled_(false),
+		stats_(),
+		second_start_us_(0),
+		second_bytes_(0),
+		last_second_bytes_(0),
+		last_arrival_us_(),
+		last_timestamp_us_()
 {
+	RTC_DCHECK(signaling_thread_ != nullptr);
 	channel_->RegisterObserver(this);
 	state_ = channel_->state();
 }
 
 DefaultDataChannelObserver::~DefaultDataChannelObserver() 
 {
+	signaling_thread_->Clear(this);
 	channel_->UnregisterObserver();
 }
 
 void DefaultDataChannelObserver::OnBufferedAmountChange(uint64_t previous_amount)
 {
+	// Not under the lock, Send() may call back into the observer.
+	uint64_t buffered_amount = channel_->buffered_amount();
+
+	rtc::CritScope cs(&lock_);
+	flow_control_.Update(buffered_amount);
 }
 
 void DefaultDataChannelObserver::OnStateChange()
 { 
 	state_ = channel_->state();
+	if (state_ == webrtc::DataChannelInterface::kClosed)
+	{
+		rtc::CritScope cs(&lock_);
+		chunker_.Clear();
+	}
 }
 
 void DefaultDataChannelObserver::OnMessage(const webrtc::DataBuffer& buffer) 
 {
-	if (input_update_func_ != NULL)
+	const int64_t now_us = rtc::TimeMicros();
+
+	// Answers the binary input offer, clients which get no answer keep
+	// sending JSON.
+	int version = 0;
+	if (InputMessageCodec::ParseProtocolMessage(
+		(const char*)buffer.data.data(), buffer.data.size(), &version))
+	{
+		Record(buffer, InputMessage::UNKNOWN, 0, now_us);
+		if (binary_input_ && version >= InputMessageCodec::kVersion)
+		{
+			Send(InputMessageCodec::WriteProtocolMessage(InputMessageCodec::kVersion),
+				SendFlowControl::HIGH_PRIORITY);
+		}
+
+		return;
+	}
+
+	// Parsed for the statistics, to drop stale messages and to tag the
+	// frames rendered after them.
+	InputMessage message;
+	if (!InputParser::Parse((const char*)buffer.data.data(), buffer.data.size(), &message))
+	{
+		message.type = InputMessage::UNKNOWN;
+		message.timestamp_us = 0;
+	}
+
+	int64_t timestamp_us = message.timestamp_us;
+	bool stale = timestamp_us != 0 && IsStale(message.type, timestamp_us);
+	Record(buffer, message.type, stale ? -1 : timestamp_us, now_us);
+	if (stale)
+	{
+		return;
+	}
+
+	if (input_queue_ != NULL)
+	{
+		input_queue_->Push((const char*)buffer.data.data(), buffer.data.size(), now_us,
+			timestamp_us);
+	}
+	else if (input_update_func_ != NULL)
 	{
 		input_update_func_(std::string((const char*)buffer.data.data(), buffer.data.size()));
 	}
 }
 
+bool DefaultDataChannelObserver::IsStale(InputMessage::Type type, int64_t timestamp_us)
+{
+	if (channel_->ordered())
+	{
+		return false;
+	}
+
+	int64_t& latest_timestamp_us = latest_timestamp_us_[type];
+	if (timestamp_us < latest_timestamp_us)
+	{
+		return true;
+	}
+
+	latest_timestamp_us = timestamp_us;
+	return false;
+}
+
+void DefaultDataChannelObserver::Record(const webrtc::DataBuffer& buffer,
+	InputMessage::Type type, int64_t timestamp_us, int64_t now_us)
+{
+	const size_t size = buffer.data.size();
+
+	rtc::CritScope cs(&lock_);
+	recent_messages_[next_message_ % kRecentMessages].assign(
+		(const char*)buffer.data.data(), size);
+	next_message_++;
+
+	stats_.messages++;
+	stats_.bytes += size;
+
+	// Restarts the current second, or both after a silence.
+	int64_t elapsed_us = now_us - second_start_us_;
+	if (elapsed_us >= rtc::kNumMicrosecsPerSec)
+	{
+		last_second_bytes_ = elapsed_us < 2 * rtc::kNumMicrosecsPerSec ? second_bytes_ : 0;
+		second_start_us_ = elapsed_us < 2 * rtc::kNumMicrosecsPerSec ?
+			second_start_us_ + rtc::kNumMicrosecsPerSec : now_us;
+		second_bytes_ = 0;
+	}
+
+	second_bytes_ += size;
+
+	DataChannelTypeStats& type_stats = stats_.types[type];
+	type_stats.messages++;
+	type_stats.bytes += size;
+	if (timestamp_us < 0)
+	{
+		// Overtaken, its timing would only distort the newer messages'.
+		type_stats.stale++;
+		return;
+	}
+
+	int64_t& last_arrival_us = last_arrival_us_[type];
+	int64_t& last_timestamp_us = last_timestamp_us_[type];
+	if (last_arrival_us != 0)
+	{
+		int64_t gap_ms = (now_us - last_arrival_us) / rtc::kNumMicrosecsPerMillisec;
+		int bucket = 0;
+		while (bucket < DataChannelTypeStats::kInterArrivalBuckets - 1 && gap_ms >= (1 << bucket))
+		{
+			bucket++;
+		}
+
+		type_stats.inter_arrival[bucket]++;
+
+		if (timestamp_us != 0 && last_timestamp_us != 0)
+		{
+			int64_t transit_change_us = (now_us - last_arrival_us) -
+				(timestamp_us - last_timestamp_us);
+			if (transit_change_us < 0)
+			{
+				transit_change_us = -transit_change_us;
+			}
+
+			type_stats.jitter_us += (transit_change_us - type_stats.jitter_us) / kJitterGain;
+		}
+	}
+
+	last_arrival_us = now_us;
+	last_timestamp_us = timestamp_us;
+}
+
+uint64_t DefaultDataChannelObserver::BytesPerSecond(int64_t now_us) const
+{
+	int64_t elapsed_us = now_us - second_start_us_;
+	if (elapsed_us >= 2 * rtc::kNumMicrosecsPerSec)
+	{
+		return 0;
+	}
+
+	return elapsed_us >= rtc::kNumMicrosecsPerSec ? second_bytes_ : last_second_bytes_;
+}
+
 bool DefaultDataChannelObserver::IsOpen() const
 { 
 	return state_ == webrtc::DataChannelInterface::kOpen;
 }
 
+bool DefaultDataChannelObserver::Send(const std::string& message,
+	SendFlowControl::Priority priority)
+{
+	uint64_t buffered_amount = channel_->buffered_amount();
+	{
+		rtc::CritScope cs(&lock_);
+		if (!flow_control_.ShouldSend(buffered_amount, priority))
+		{
+			return false;
+		}
+	}
+
+	return channel_->Send(webrtc::DataBuffer(message));
+}
+
+bool DefaultDataChannelObserver::SendPayload(const std::string& payload)
+{
+	if (!channel_->reliable() || state_ == webrtc::DataChannelInterface::kClosing ||
+		state_ == webrtc::DataChannelInterface::kClosed)
+	{
+		return false;
+	}
+
+	rtc::CritScope cs(&lock_);
+	if (!chunker_.Add(payload))
+	{
+		return false;
+	}
+
+	stats_.payloads++;
+	ScheduleChunk(0);
+	return true;
+}
+
+void DefaultDataChannelObserver::OnMessage(rtc::Message* msg)
+{
+	// Not under the lock, like in OnBufferedAmountChange().
+	uint64_t buffered_amount = channel_->buffered_amount();
+
+	std::string chunk;
+	{
+		rtc::CritScope cs(&lock_);
+		chunk_scheduled_ = false;
+
+		// Waits for the channel to open or to drain, a chunk queued behind
+		// another would delay the real-time messages further.
+		if (!IsOpen() || buffered_amount > 0)
+		{
+			if (!chunker_.empty())
+			{
+				ScheduleChunk(kChunkIntervalMs);
+			}
+
+			return;
+		}
+
+		if (!chunker_.Next(&chunk))
+		{
+			return;
+		}
+
+		stats_.payload_chunks++;
+		if (!chunker_.empty())
+		{
+			ScheduleChunk(kChunkIntervalMs);
+		}
+	}
+
+	if (!channel_->Send(webrtc::DataBuffer(rtc::CopyOnWriteBuffer(chunk.data(), chunk.size()), true)))
+	{
+		// The client drops the incomplete payload after a timeout.
+		LOG(LS_WARNING) << "Failed to send a payload chunk on " << channel_->label();
+	}
+}
+
+void DefaultDataChannelObserver::ScheduleChunk(int delay_ms)
+{
+	if (!chunk_scheduled_)
+	{
+		chunk_scheduled_ = true;
+		signaling_thread_->PostDelayed(RTC_FROM_HERE, delay_ms, this, kSendChunkMessageId);
+	}
+}
+
+DataChannelStats DefaultDataChannelObserver::GetStats() const
+{
+	rtc::CritScope cs(&lock_);
+	DataChannelStats stats = stats_;
+	stats.bytes_per_second = BytesPerSecond(rtc::TimeMicros());
+	stats.flow_control = flow_control_.stats();
+	stats.pending_payload_bytes = chunker_.pending_bytes();
+	return stats;
+}
+
+void DefaultDataChannelObserver::VisitRecentMessages(
+	void (*visitor)(const char* data, size_t length, void* context),
+	void* context) const
+{
+	rtc::CritScope cs(&lock_);
+	size_t count = next_message_ < kRecentMessages ? next_message_ : kRecentMessages;
+	for (size_t i = next_message_ - count; i < next_message_; ++i)
+	{
+		const std::string& message = recent_messages_[i % kRecentMessages];
+		visitor(message.data(), message.size(), context);
+	}
+}
+
 std::vector<std::string> DefaultDataChannelObserver::messages() const 
 { 
-	return messages_; 
+	std::vector<std::string> messages;
+	VisitRecentMessages([](const char* data, size_t length, void* context)
+	{
+		static_cast<std::vector<std::string>*>(context)->emplace_back(data, length);
+	}, &messages);
+
+	return messages;
 }
 
 std::string DefaultDataChannelObserver::last_message() const
 {
-	return messages_.empty() ? std::string() : messages_.back();
+	rtc::CritScope cs(&lock_);
+	return next_message_ == 0 ? std::string() :
+		recent_messages_[(next_message_ - 1) % kRecentMessages];
 }
 
 size_t DefaultDataChannelObserver::received_message_count() const 
 { 
-	return messages_.size(); 
+	rtc::CritScope cs(&lock_);
+	return next_message_;
 }
@@ -207,22 +207,28 @@ void DefaultMainWindow::SwitchToConnectUI()
 	}
 }
 
-void DefaultMainWindow::SwitchToPeerList(const Peers& peers)
+void DefaultMainWindow::SwitchToPeerList(const PeerDirectory& peers)
 {
 	LayoutConnectUI(false);
 
+	// Redrawn once, the list can hold thousands of peers.
+	::SendMessage(listbox_, WM_SETREDRAW, FALSE, 0);
 	::SendMessage(listbox_, LB_RESETCONTENT, 0, 0);
 
 	AddListBoxItem(listbox_, "List of currently connected peers:", -1);
-	Peers::const_iterator i = peers.begin();
-	for (; i != peers.end(); ++i)
-	AddListBoxItem(listbox_, i->second.c_str(), i->first);
+	for (const PeerInfo* peer : peers.Select())
+	{
+		AddListBoxItem(listbox_, peer->name.c_str(), peer->id);
+	}
+
+	::SendMessage(listbox_, WM_SETREDRAW, TRUE, 0);
+	::InvalidateRect(listbox_, NULL, TRUE);
 
 	ui_ = LIST_PEERS;
 	LayoutPeerListUI(true);
 	::SetFocus(listbox_);
 
-	if (auto_call_ && peers.begin() != peers.end())
+	if (auto_call_ && !peers.empty())
 	{
 		// Get the number of items in the list
 		LRESULT count = ::SendMessage(listbox_, LB_GETCOUNT, 0, 0);
@@ -0,0 +1,79 @@
+#include "pch.h"
+
+#include "headless_main_window.h"
+#include "webrtc/base/checks.h"
+#include "webrtc/base/location.h"
+#include "webrtc/base/logging.h"
+
+HeadlessMainWindow::HeadlessMainWindow(bool auto_call) :
+	callback_(nullptr),
+	ui_thread_(rtc::Thread::Current()),
+	ui_(CONNECT_TO_SERVER),
+	auto_call_(auto_call)
+{
+	RTC_DCHECK(ui_thread_);
+}
+
+HeadlessMainWindow::~HeadlessMainWindow()
+{
+	// Drops the callbacks still pending for this window.
+	ui_thread_->Clear(this);
+}
+
+void HeadlessMainWindow::RegisterObserver(MainWindowCallback* callback)
+{
+	callback_ = callback;
+}
+
+void HeadlessMainWindow::MessageBox(const char* caption, const char* text, bool is_error)
+{
+	if (is_error)
+	{
+		LOG(LS_ERROR) << caption << ": " << text;
+	}
+	else
+	{
+		LOG(INFO) << caption << ": " << text;
+	}
+}
+
+void HeadlessMainWindow::SwitchToConnectUI()
+{
+	ui_ = CONNECT_TO_SERVER;
+}
+
+void HeadlessMainWindow::SwitchToPeerList(const PeerDirectory& peers)
+{
+	ui_ = LIST_PEERS;
+
+	// Same as the default window, calls the most recently connected peer.
+	const PeerInfo* newest = peers.Newest();
+	if (auto_call_ && callback_ && newest)
+	{
+		callback_->ConnectToPeer(newest->id);
+	}
+}
+
+void HeadlessMainWindow::SwitchToStreamingUI()
+{
+	ui_ = STREAMING;
+}
+
+void HeadlessMainWindow::QueueUIThreadCallback(int msg_id, void* data)
+{
+	ui_thread_->Post(RTC_FROM_HERE, this, static_cast<uint32_t>(msg_id),
+		new rtc::TypedMessageData<void*>(data));
+}
+
+void HeadlessMainWindow::OnMessage(rtc::Message* msg)
+{
+	rtc::TypedMessageData<void*>* data =
+		static_cast<rtc::TypedMessageData<void*>*>(msg->pdata);
+
+	if (callback_)
+	{
+		callback_->UIThreadCallback(static_cast<int>(msg->message_id), data->data());
+	}
+
+	delete data;
+}
@@ -0,0 +1,210 @@
+#include "pch.h"
+#include "session_manager.h"
+
+#include "config_service.h"
+#include "EncoderCalibrationCache.h"
+#include "headless_main_window.h"
+#include "webrtc/base/checks.h"
+#include "webrtc/base/logging.h"
+#include "webrtc/system_wrappers/include/cpu_info.h"
+
+// Share of the measured encoder capacity sessions may use, the remainder is
+// kept as headroom for encoder latency spikes.
+const double kMaxEncoderLoad = 0.9;
+
+// 720p frames per second estimated per core for the software encoder, which
+// encodes each session on a single thread. Conservative, a 720p60 session
+// takes two cores.
+const int kSoftwareEncoderFpsPerCore = 30;
+
+namespace Toolkit3DLibrary
+{
+	SessionManager::SessionManager(int max_sessions) :
+		signaling_thread_(rtc::Thread::Current()),
+		max_sessions_(max_sessions),
+		next_session_id_(0),
+		encoder_load_(0.0)
+	{
+	}
+
+	SessionManager::~SessionManager()
+	{
+		DestroyAllSessions();
+	}
+
+	int SessionManager::CreateSession(const SessionParams& params)
+	{
+		RTC_DCHECK(signaling_thread_->IsCurrent());
+
+		if (!params.video_helper && !ConfigService::Instance()->config().capture.use_software_encoding)
+		{
+			// The hardware encoder only takes D3D textures, the session would
+			// never send a frame.
+			LOG(LS_ERROR) << "Session refused, synthetic frames are only encoded with useSoftwareEncoding enabled";
+			return -1;
+		}
+
+		if (!CanAdmit(params))
+		{
+			LOG(WARNING) << "Session refused, " << session_count() << " sessions active, encoder load "
+				<< encoder_load_;
+
+			return -1;
+		}
+
+		std::unique_ptr<Session> session(new Session());
+		session->params = params;
+		session->encoder_load = GetEncoderLoad(params);
+		session->client.reset(new PeerConnectionClient());
+		session->main_window.reset(new HeadlessMainWindow(params.auto_call));
+
+		if (params.heartbeat > 0)
+		{
+			session->client->SetHeartbeatMs(params.heartbeat);
+		}
+
+		session->conductor = new rtc::RefCountedObject<Conductor>(
+			session->client.get(),
+			session->main_window.get(),
+			params.frame_update_func,
+			params.input_update_func,
+			params.video_helper);
+
+		session->conductor->SetBinaryInputEnabled(params.binary_input);
+
+		MainWindowCallback* callback = session->conductor;
+		callback->StartLogin(params.server, params.port);
+
+		int session_id = next_session_id_++;
+		encoder_load_ += session->encoder_load;
+		sessions_[session_id] = std::move(session);
+
+		LOG(INFO) << "Session " << session_id << " created, " << session_count()
+			<< " sessions active, encoder load " << encoder_load_;
+
+		return session_id;
+	}
+
+	void SessionManager::DestroySession(int session_id)
+	{
+		RTC_DCHECK(signaling_thread_->IsCurrent());
+
+		auto it = sessions_.find(session_id);
+		if (it == sessions_.end())
+		{
+			return;
+		}
+
+		std::unique_ptr<Session> session = std::move(it->second);
+		sessions_.erase(it);
+		encoder_load_ -= session->encoder_load;
+		if (sessions_.empty())
+		{
+			// Avoids accumulating rounding errors.
+			encoder_load_ = 0.0;
+		}
+
+		// The conductor references the window and the client, release it first.
+		session->conductor->Close();
+		session->conductor = nullptr;
+		session->main_window.reset();
+		session->client.reset();
+
+		LOG(INFO) << "Session " << session_id << " destroyed, " << session_count()
+			<< " sessions active";
+	}
+
+	void SessionManager::DestroyAllSessions()
+	{
+		while (!sessions_.empty())
+		{
+			DestroySession(sessions_.begin()->first);
+		}
+	}
+
+	bool SessionManager::CanAdmit(const SessionParams& params)
+	{
+		if (max_sessions_ > 0 && session_count() >= max_sessions_)
+		{
+			return false;
+		}
+
+		return encoder_load_ + GetEncoderLoad(params) <= kMaxEncoderLoad;
+	}
+
+	int SessionManager::active_session_count() const
+	{
+		int count = 0;
+		for (const auto& session : sessions_)
+		{
+			if (session.second->conductor->connection_active())
+			{
+				count++;
+			}
+		}
+
+		return count;
+	}
+
+	double SessionManager::GetEncoderLoad(const SessionParams& params)
+	{
+		double capacity_fps = ConfigService::Instance()->config().capture.use_software_encoding ?
+			GetSoftwareEncoderCapacityFps(params.width, params.height) :
+			GetEncoderCapacityFps(params.width, params.height);
+
+		if (capacity_fps <= 0.0)
+		{
+			return 0.0;
+		}
+
+		return params.fps / capacity_fps;
+	}
+
+	double SessionManager::GetEncoderCapacityFps(int width, int height)
+	{
+		std::pair<int, int> resolution(width, height);
+		auto it = encoder_capacity_fps_.find(resolution);
+		if (it != encoder_capacity_fps_.end())
+		{
+			return it->second;
+		}
+
+		// Results of the calibration on this host, see EncoderCalibrator.
+		const EncoderSettings encoder = ConfigService::Instance()->config().encoder;
+		CalibrationResult calibration;
+		double capacity_fps = 0.0;
+		if (EncoderCalibrationCache::Load(CALIBRATION_CACHE_FILE, width, height, encoder.fps,
+			encoder.bitrate, CALIBRATION_LATENCY_BUDGET_MS, &calibration))
+		{
+			capacity_fps = calibration.encodeFps;
+		}
+
+		char section[MAX_PATH];
+		EncoderCalibrationCache::GetSection(width, height, encoder.fps, encoder.bitrate,
+			CALIBRATION_LATENCY_BUDGET_MS, section, sizeof(section));
+		if (capacity_fps <= 0.0)
+		{
+			LOG(INFO) << "No encoder calibration for " << section
+				<< ", sessions are only limited by count";
+		}
+		else
+		{
+			LOG(INFO) << "Encoder capacity for " << section << ": " << capacity_fps << " fps";
+		}
+
+		encoder_capacity_fps_[resolution] = capacity_fps;
+		return capacity_fps;
+	}
+
+	double SessionManager::GetSoftwareEncoderCapacityFps(int width, int height)
+	{
+		int capacity_fps = ConfigService::Instance()->config().capture.software_encoder_capacity_fps;
+		if (capacity_fps <= 0)
+		{
+			capacity_fps = webrtc::CpuInfo::DetectNumberOfCores() * kSoftwareEncoderFpsPerCore;
+		}
+
+		// Scaled from 720p by the pixel count.
+		return capacity_fps * (1280.0 * 720.0) / (width * height);
+	}
+}
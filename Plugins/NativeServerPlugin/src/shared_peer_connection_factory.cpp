@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "shared_peer_connection_factory.h"
+
+#include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
+
+namespace Toolkit3DLibrary
+{
+	SharedPeerConnectionFactory* SharedPeerConnectionFactory::Instance()
+	{
+		static SharedPeerConnectionFactory instance;
+		return &instance;
+	}
+
+	SharedPeerConnectionFactory::SharedPeerConnectionFactory() :
+		signaling_thread_(nullptr)
+	{
+	}
+
+	SharedPeerConnectionFactory::~SharedPeerConnectionFactory()
+	{
+		RTC_DCHECK(factory_.get() == nullptr);
+	}
+
+	bool SharedPeerConnectionFactory::Initialize()
+	{
+		rtc::CritScope cs(&lock_);
+		if (factory_.get())
+		{
+			return true;
+		}
+
+		int64_t start_time_ms = rtc::TimeMillis();
+
+		network_thread_ = rtc::Thread::CreateWithSocketServer();
+		network_thread_->SetName("pc_network_thread", nullptr);
+		network_thread_->Start();
+
+		worker_thread_ = rtc::Thread::Create();
+		worker_thread_->SetName("pc_worker_thread", nullptr);
+		worker_thread_->Start();
+
+		signaling_thread_ = rtc::Thread::Current();
+
+		factory_ = webrtc::CreatePeerConnectionFactory(
+			network_thread_.get(),
+			worker_thread_.get(),
+			signaling_thread_,
+			nullptr,
+			nullptr,
+			nullptr);
+
+		if (!factory_.get())
+		{
+			LOG(LS_ERROR) << "Failed to create the shared PeerConnectionFactory";
+			worker_thread_.reset();
+			network_thread_.reset();
+			signaling_thread_ = nullptr;
+			return false;
+		}
+
+		LOG(INFO) << "Shared PeerConnectionFactory created in "
+			<< rtc::TimeMillis() - start_time_ms << " ms";
+
+		return true;
+	}
+
+	void SharedPeerConnectionFactory::Shutdown()
+	{
+		rtc::CritScope cs(&lock_);
+		RTC_DCHECK(!signaling_thread_ || signaling_thread_->IsCurrent());
+
+		// The factory must be released before the threads it runs on.
+		factory_ = nullptr;
+		worker_thread_.reset();
+		network_thread_.reset();
+		signaling_thread_ = nullptr;
+	}
+
+	rtc::scoped_refptr<webrtc::PeerConnectionFactoryInterface> SharedPeerConnectionFactory::factory()
+	{
+		if (!Initialize())
+		{
+			return nullptr;
+		}
+
+		rtc::CritScope cs(&lock_);
+		return factory_;
+	}
+}
@@ -1,7 +1,11 @@
 ﻿#pragma once
 
 #include "pch.h"
+
 #include "video_helper.h"
+#include "config_service.h"
+#include "EncoderCalibrationCache.h"
+#include "webrtc/base/logging.h"
 #include "webrtc/modules/video_coding/codecs/h264/include/nvFileIO.h"
 #include "webrtc/modules/video_coding/codecs/h264/include/nvUtils.h"
 
@@ -29,6 +33,11 @@ VideoHelper::VideoHelper(ID3D11Device* device, ID3D11DeviceContext* context) :
 // Destructor for VideoHelper.
 VideoHelper::~VideoHelper()
 {
+	if (m_prewarmThread.joinable())
+	{
+		m_prewarmThread.join();
+	}
+
 	SAFE_RELEASE(m_stagingFrameBuffer);
 }
 
@@ -45,6 +54,39 @@ void VideoHelper::Initialize(DXGI_FORMAT format, int width, int height)
 	m_stagingFrameBufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
 	m_stagingFrameBufferDesc.Usage = D3D11_USAGE_STAGING;
 	m_d3dDevice->CreateTexture2D(&m_stagingFrameBufferDesc, nullptr, &m_stagingFrameBuffer);
+
+	// The settings below must not change under a prewarm in progress.
+	if (m_prewarmThread.joinable())
+	{
+		m_prewarmThread.join();
+	}
+
+	// Encodes with the preset the test runner calibrated for this host,
+	// resolution and encoder settings, if any, see EncoderCalibrator. The
+	// server only reads the cache, calibrating takes the GPU for seconds.
+	ConfigService* config_service = ConfigService::Instance();
+	config_service->Start();
+	const EncoderSettings encoder = config_service->config().encoder;
+	CalibrationResult calibration;
+	if (EncoderCalibrationCache::Load(CALIBRATION_CACHE_FILE, width, height, encoder.fps,
+		encoder.bitrate, CALIBRATION_LATENCY_BUDGET_MS, &calibration))
+	{
+		webrtc::H264EncoderImpl::SetEncoderPreset(calibration.encoderPreset, calibration.rcMode);
+		LOG(INFO) << "Encoder preset " << calibration.encoderPreset << ", rate control " <<
+			calibration.rcMode << " from the calibration of " << width << "x" << height;
+	}
+	else
+	{
+		LOG(INFO) << "No encoder calibration for " << width << "x" << height << " at " <<
+			encoder.fps << " fps and " << encoder.bitrate << " bps, run the test runner with -calibrate";
+	}
+
+	// Creates the NvEnc session of this resolution while the client connects,
+	// the encoder then leases it instead of creating one on the first frame.
+	m_prewarmThread = std::thread([width, height]()
+	{
+		webrtc::H264EncoderImpl::PrewarmSessions(width, height, 1);
+	});
 }
 
 void VideoHelper::Initialize(IDXGISwapChain* swapChain)
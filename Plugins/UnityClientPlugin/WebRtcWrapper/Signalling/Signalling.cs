@@ -508,10 +508,19 @@ namespace PeerConnectionClient.Signalling
                         else
                         {
                             string message = buffer.Substring(pos);
+                            JsonArray messages;
                             if (message == "BYE")
                             {
                                 OnPeerHangup(peer_id);
                             }
+                            else if (message.StartsWith("[") && JsonArray.TryParse(message, out messages))
+                            {
+                                // Candidates may be batched into a single JSON array.
+                                foreach (IJsonValue batchedMessage in messages)
+                                {
+                                    OnMessageFromPeer(peer_id, batchedMessage.Stringify());
+                                }
+                            }
                             else
                             {
                                 OnMessageFromPeer(peer_id, message);
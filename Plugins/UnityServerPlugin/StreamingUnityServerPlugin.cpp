@@ -19,6 +19,7 @@
 #include "default_main_window.h"
 #include "flagdefs.h"
 #include "peer_connection_client.h"
+#include "shared_peer_connection_factory.h"
 #include "webrtc/base/checks.h"
 #include "webrtc/base/ssladapter.h"
 #include "webrtc/base/win32socketinit.h"
@@ -102,6 +103,9 @@ void InitWebRTC()
 	rtc::Win32Thread w32_thread;
 	rtc::ThreadManager::Instance()->SetCurrentThread(&w32_thread);
 	rtc::InitializeSSL();
+
+	// Pre-warms the factory and threads shared by all the peer connections.
+	Toolkit3DLibrary::SharedPeerConnectionFactory::Instance()->Initialize();
 	
 	PeerConnectionClient client;
 
@@ -136,6 +140,8 @@ void InitWebRTC()
 			}
 		}
 	}
+
+	Toolkit3DLibrary::SharedPeerConnectionFactory::Instance()->Shutdown();
 }
 
 
@@ -224,11 +224,22 @@ void AppCallbacks::SendInputData(HolographicFrame^ holographicFrame)
 				}
 			}
 
+			// The display time the pose was predicted for, which lets the
+			// server extrapolate it to the time its frame will be displayed,
+			// and the send time on the same clock, both in microseconds.
+			int64_t targetTime = prediction->Timestamp->TargetTime.UniversalTime / 10;
+			FILETIME now;
+			GetSystemTimePreciseAsFileTime(&now);
+			int64_t timestamp =
+				((static_cast<int64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime) / 10;
+
 			String^ cameraTransformBody = leftCameraTransform + rightCameraTransform;
 			String^ msg =
 				"{" +
 				"  \"type\":\"camera-transform-stereo\"," +
-				"  \"body\":\"" + cameraTransformBody + "\"" +
+				"  \"body\":\"" + cameraTransformBody + "\"," +
+				"  \"timestamp\":" + timestamp.ToString() + "," +
+				"  \"targetTime\":" + targetTime.ToString() +
 				"}";
 
 			m_sendInputDataHandler(msg);
@@ -11,14 +11,16 @@
 #ifndef WEBRTC_CONDUCTOR_H_
 #define WEBRTC_CONDUCTOR_H_
 
-#include <deque>
 #include <map>
 #include <memory>
 #include <set>
 #include <string>
 
+#include "input_latency.h"
+#include "message_chunker.h"
 #include "peer_connection_client.h"
 #include "main_window.h"
+#include "send_flow_control.h"
 #include "webrtc/api/mediastreaminterface.h"
 #include "webrtc/api/peerconnectioninterface.h"
 
@@ -34,7 +36,10 @@ namespace cricket
 
 class Conductor : public webrtc::PeerConnectionObserver,
 	public webrtc::CreateSessionDescriptionObserver,
+	public webrtc::DataChannelObserver,
+	public webrtc::StatsObserver,
     public PeerConnectionClientObserver,
+	public PeerDirectoryObserver,
 	public MainWindowCallback
 {
 public:
@@ -51,6 +56,20 @@ public:
 
 	bool connection_active() const;
 
+	// Input to photon latency of the current connection.
+	InputLatencyStats GetInputLatencyStats() const;
+
+	// Buffer metrics of the input and pose channels.
+	SendFlowControlStats GetInputFlowControlStats() const;
+
+	SendFlowControlStats GetPoseFlowControlStats() const;
+
+	// Called on the signaling thread with each payload the server sends in
+	// chunks, see MessageChunker.
+	void SetPayloadHandler(void (*payload_func)(const std::string&));
+
+	const MessageReassemblerStats& GetPayloadStats() const;
+
 	virtual void Close();
 
 protected:
@@ -68,6 +87,17 @@ protected:
 
 	void AddStreams();
 
+	// Observes |channel| in place of the previous input channel, NULL
+	// detaches. The binary encoding is negotiated again for each channel and
+	// applies to the pose channel as well.
+	void SetDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel);
+
+	// Offers the binary input encoding to the server.
+	void OfferBinaryInput();
+
+	// Requests the connection stats at most once per kStatsIntervalMs.
+	void RequestStats();
+
 	//-------------------------------------------------------------------------
 	// PeerConnectionObserver implementation.
 	//-------------------------------------------------------------------------
@@ -96,6 +126,22 @@ protected:
 
 	void OnIceConnectionReceivingChange(bool receiving) override {}
 
+	//-------------------------------------------------------------------------
+	// DataChannelObserver implementation.
+	//-------------------------------------------------------------------------
+
+	void OnStateChange() override;
+
+	void OnMessage(const webrtc::DataBuffer& buffer) override;
+
+	void OnBufferedAmountChange(uint64_t previous_amount) override;
+
+	//-------------------------------------------------------------------------
+	// StatsObserver implementation.
+	//-------------------------------------------------------------------------
+
+	void OnComplete(const webrtc::StatsReports& reports) override;
+
 	//-------------------------------------------------------------------------
 	// PeerConnectionClientObserver implementation.
 	//-------------------------------------------------------------------------
@@ -114,6 +160,12 @@ protected:
 
 	void OnServerConnectionFailure() override;
 
+	//-------------------------------------------------------------------------
+	// PeerDirectoryObserver implementation.
+	//-------------------------------------------------------------------------
+
+	void OnPeersChanged(const PeerDirectoryDelta& delta) override;
+
 	//-------------------------------------------------------------------------
 	// MainWndCallback implementation.
 	//-------------------------------------------------------------------------
@@ -130,6 +182,18 @@ protected:
 
 	bool SendInputData(const std::string& message) override;
 
+	bool SendPoseData(const std::string& message) override;
+
+	bool IsPoseDataBlocked() override;
+
+	bool IsBinaryInputEnabled() override;
+
+	int GetRoundTripTimeMs() override;
+
+	int GetRemoteFrameRate() override;
+
+	void OnFramePresented(int64_t capture_ntp_ms, int64_t decoded_time_us) override;
+
 	// CreateSessionDescriptionObserver implementation.
 	void OnSuccess(webrtc::SessionDescriptionInterface* desc) override;
 
@@ -147,8 +211,19 @@ protected:
 
 	PeerConnectionClient* client_;
 	rtc::scoped_refptr<webrtc::DataChannelInterface> data_channel_;
+	rtc::scoped_refptr<webrtc::DataChannelInterface> pose_channel_;
+	bool binary_input_;
+	bool binary_input_offered_;
+	int64_t last_stats_request_ms_;
+	int rtt_ms_;
+	int remote_frame_rate_;
+	InputLatencyTracker latency_tracker_;
+	int64_t last_latency_log_ms_;
+	SendFlowControl input_flow_control_;
+	SendFlowControl pose_flow_control_;
+	MessageReassembler reassembler_;
+	void (*payload_func_)(const std::string&);
 	MainWindow* main_window_;
-	std::deque<std::string*> pending_messages_;
 	std::map<std::string, rtc::scoped_refptr<webrtc::MediaStreamInterface>>
 		active_streams_;
 
@@ -1,14 +1,43 @@
 #pragma once
 
+#include "input_coalescer.h"
+#include "webrtc/base/messagehandler.h"
+
 using namespace DirectX::SimpleMath;
 
 class DataChannelCallback
 {
 public:
+	// Sends on the reliable, ordered input channel.
 	virtual bool SendInputData(const std::string&) = 0;
+
+	// Sends on the unordered channel without retransmissions, or on the
+	// input channel if the server didn't open one.
+	virtual bool SendPoseData(const std::string&) = 0;
+
+	// The channel of the pose data is congested, see SendFlowControl.
+	virtual bool IsPoseDataBlocked() = 0;
+
+	// The server accepted the binary input encoding.
+	virtual bool IsBinaryInputEnabled() = 0;
+
+	// Round trip time to the server and frame rate of its stream, 0 while
+	// unknown.
+	virtual int GetRoundTripTimeMs() = 0;
+
+	virtual int GetRemoteFrameRate() = 0;
 };
 
-class DataChannelHandler
+// Encodes the input for the data channels. Every message carries the client
+// timestamp, camera updates and mouse moves are coalesced to the latest
+// value and sent on the InputCoalescer schedule over the pose channel,
+// where a lost value is soon replaced by the next one. Discrete events are
+// sent immediately over the reliable input channel.
+//
+// While the pose data is blocked, the values keep coalescing and the latest
+// ones are sent once the channel drains, instead of queuing behind the
+// stale ones.
+class DataChannelHandler : public rtc::MessageHandler
 {
 protected:
 	DataChannelHandler(DataChannelCallback* data_channel_callback);
@@ -22,12 +51,30 @@ protected:
 
 	bool SendCameraInput(float x, float y, float z, float yaw, float pitch, float roll);
 
-	bool SendKeyboardInput(const std::string& msg);
+	bool SendKeyboardInput(UINT message, WPARAM wParam);
 
-	bool SendMouseInput(const std::string& msg);
+	bool SendMouseInput(UINT message, WPARAM wParam, LPARAM lParam);
 
 	bool RequestStereoStream(bool stereo);
 
+	// Sends the coalesced input which is due.
+	void OnMessage(rtc::Message* msg) override;
+
 private:
+	std::string WriteJsonInput(const char* type, const std::string& body, int64_t timestamp_us);
+
+	// Replaces the pending value of |type| and schedules the next flush.
+	bool QueueInput(InputMessage::Type type, const std::string& message);
+
+	// Sends a discrete event, after the pending values so that it doesn't
+	// overtake them.
+	bool SendEvent(const std::string& message);
+
+	void ScheduleFlush();
+
+	void PostFlush(int64_t delay_ms);
+
 	DataChannelCallback* data_channel_callback_;
+	InputCoalescer coalescer_;
+	bool flush_scheduled_;
 };
@@ -59,7 +59,7 @@ public:
 
 	virtual void SwitchToConnectUI();
 
-	virtual void SwitchToPeerList(const Peers& peers);
+	virtual void SwitchToPeerList(const PeerDirectory& peers);
 
 	virtual void SwitchToStreamingUI();
 
@@ -114,6 +114,11 @@ public:
 			return image_.get();
 		}
 
+		// Capture NTP time, as estimated from the RTCP sender reports, and
+		// decode time of the image, if it wasn't taken since the last frame.
+		// Call with the lock held.
+		bool TakeFrameTiming(int64_t* capture_ntp_ms, int64_t* decoded_time_us);
+
 	protected:
 		void SetSize(int width, int height);
 
@@ -126,6 +131,9 @@ public:
 		HWND wnd_;
 		BITMAPINFO bmi_;
 		std::unique_ptr<uint8_t[]> image_;
+		int64_t capture_ntp_ms_;
+		int64_t decoded_time_us_;
+		bool frame_timing_taken_;
 		CRITICAL_SECTION buffer_lock_;
 		rtc::scoped_refptr<webrtc::VideoTrackInterface> rendered_track_;
 	};
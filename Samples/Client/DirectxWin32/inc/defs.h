@@ -1,8 +1,5 @@
 #pragma once
 
-#define KEYBOARD_DELAY					1
-#define MOUSE_DELAY						5
-
 #define DEFAULT_ZOOM					1.0f
 #define DEFAULT_DISTANCE				1.0f
 
@@ -40,6 +40,11 @@ public:
 
 	virtual bool SendInputData(const std::string& message) = 0;
 
+	// A remote frame was presented, |capture_ntp_ms| is its estimated
+	// capture time on the sender and |decoded_time_us| is on the
+	// rtc::TimeMicros() clock.
+	virtual void OnFramePresented(int64_t capture_ntp_ms, int64_t decoded_time_us) = 0;
+
 protected:
 	virtual ~MainWindowCallback() {}
 };
@@ -67,7 +72,7 @@ public:
 
 	virtual void SwitchToConnectUI() = 0;
 
-	virtual void SwitchToPeerList(const Peers& peers) = 0;
+	virtual void SwitchToPeerList(const PeerDirectory& peers) = 0;
 
 	virtual void SwitchToStreamingUI() = 0;
 
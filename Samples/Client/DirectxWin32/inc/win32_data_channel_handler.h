@@ -1,13 +1,14 @@
 /*
  *  Win32DataChannelHandler applies mouse and keyboard messages to calculate the
  *  camera state and forwards updates to the camera state to the data channel with
- *  a JSON message containing camera position, look at position, and up vector.
+ *  a message containing camera position, look at position, and up vector.
  *
  *  ArcBall is used to apply orientation changes from mouse events.
  *
  *  Arrow keys and 'A' 'W' 'D' 'S' keys are used to position the camera.
  *
- *  Keyboard and Mouse events are forwarded to the data channel as JSON messages.
+ *  Keyboard and Mouse events are forwarded to the data channel as well. Messages
+ *  are JSON, or binary once the server accepts the binary input encoding.
  */
 
 #pragma once
@@ -29,9 +30,6 @@ private:
 	int stereo_mode_;
 	int width_;
 	int height_;
-	int keyboardTick;
-	int mouseTick;
-	int mouseMoveTick;
 	std::unique_ptr<DirectX::Mouse> mouse_;
 	DirectX::Mouse::ButtonStateTracker mouse_button_tracker_;
 	ArcBall ball_camera_;
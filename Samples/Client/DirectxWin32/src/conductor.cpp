@@ -17,25 +17,47 @@
 
 #include "conductor.h"
 #include "defaults.h"
+#include "input_message.h"
+#include "signaling_message.h"
 #include "webrtc/api/test/fakeconstraints.h"
 #include "webrtc/base/checks.h"
 #include "webrtc/base/json.h"
 #include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
 #include "webrtc/media/engine/webrtcvideocapturerfactory.h"
 #include "webrtc/modules/video_capture/video_capture_factory.h"
 #include "webrtc/media/base/fakevideocapturer.h"
 
-// Names used for a IceCandidate JSON object.
-const char kCandidateSdpMidName[] = "sdpMid";
-const char kCandidateSdpMlineIndexName[] = "sdpMLineIndex";
-const char kCandidateSdpName[] = "candidate";
+// Names used for data channels. The input channel is reliable and ordered,
+// for the discrete events, the pose channel unordered and without
+// retransmissions, for the coalesced camera and mouse updates which a late
+// retransmission would only make stale.
+const char kInputDataChannelName[] = "inputDataChannel";
+const char kPoseDataChannelName[] = "poseDataChannel";
 
-// Names used for a SessionDescription JSON object.
-const char kSessionDescriptionTypeName[] = "type";
-const char kSessionDescriptionSdpName[] = "sdp";
+// Interval of the round trip time and frame rate updates while sending input.
+const int kStatsIntervalMs = 1000;
 
-// Names used for data channels
-const char kInputDataChannelName[] = "inputDataChannel";
+// Interval of the input latency logs.
+const int kLatencyLogIntervalMs = 10000;
+
+// "<p50>/<p90>/<p99> ms" of a latency component.
+static std::string FormatPercentiles(const LatencyPercentiles& percentiles)
+{
+	return std::to_string(percentiles.p50_us / 1000) + "/" +
+		std::to_string(percentiles.p90_us / 1000) + "/" +
+		std::to_string(percentiles.p99_us / 1000) + " ms";
+}
+
+// Logs the buffer metrics of a channel which got congested.
+static void LogFlowControlStats(const char* label, const SendFlowControlStats& stats)
+{
+	if (stats.pauses > 0)
+	{
+		LOG(INFO) << label << " congested " << stats.pauses << " times, " << stats.dropped <<
+			" messages dropped, " << stats.max_buffered_amount << " bytes buffered max";
+	}
+}
 
 #define DTLS_ON  true
 #define DTLS_OFF false
@@ -70,9 +92,17 @@ Conductor::Conductor(PeerConnectionClient* client, MainWindow* main_window) :
 	peer_id_(-1),
 	loopback_(false),
 	client_(client),
+	binary_input_(false),
+	binary_input_offered_(false),
+	last_stats_request_ms_(-1),
+	rtt_ms_(0),
+	remote_frame_rate_(0),
+	last_latency_log_ms_(-1),
+	payload_func_(nullptr),
 	main_window_(main_window)
 {
 	client_->RegisterObserver(this);
+	client_->RegisterPeerObserver(this);
 	main_window->RegisterObserver(this);
 }
 
@@ -86,6 +116,31 @@ bool Conductor::connection_active() const
 	return peer_connection_.get() != NULL;
 }
 
+InputLatencyStats Conductor::GetInputLatencyStats() const
+{
+	return latency_tracker_.GetStats();
+}
+
+SendFlowControlStats Conductor::GetInputFlowControlStats() const
+{
+	return input_flow_control_.stats();
+}
+
+SendFlowControlStats Conductor::GetPoseFlowControlStats() const
+{
+	return pose_flow_control_.stats();
+}
+
+void Conductor::SetPayloadHandler(void (*payload_func)(const std::string&))
+{
+	payload_func_ = payload_func;
+}
+
+const MessageReassemblerStats& Conductor::GetPayloadStats() const
+{
+	return reassembler_.stats();
+}
+
 void Conductor::Close() 
 {
 	client_->SignOut();
@@ -227,6 +282,16 @@ bool Conductor::CreatePeerConnection(bool dtls)
 
 void Conductor::DeletePeerConnection()
 {
+	LogFlowControlStats(kInputDataChannelName, input_flow_control_.stats());
+	LogFlowControlStats(kPoseDataChannelName, pose_flow_control_.stats());
+	if (reassembler_.stats().completed > 0 || reassembler_.stats().dropped > 0)
+	{
+		LOG(INFO) << "Payloads: " << reassembler_.stats().completed << " received, " <<
+			reassembler_.stats().dropped << " dropped";
+	}
+
+	SetDataChannel(NULL);
+	pose_channel_ = NULL;
 	peer_connection_ = NULL;
 	active_streams_.clear();
 	main_window_->StopLocalRenderer();
@@ -234,6 +299,12 @@ void Conductor::DeletePeerConnection()
 	peer_connection_factory_ = NULL;
 	peer_id_ = -1;
 	loopback_ = false;
+	last_stats_request_ms_ = -1;
+	rtt_ms_ = 0;
+	remote_frame_rate_ = 0;
+	latency_tracker_ = InputLatencyTracker();
+	last_latency_log_ms_ = -1;
+	reassembler_ = MessageReassembler();
 }
 
 void Conductor::EnsureStreamingUI()
@@ -268,7 +339,15 @@ void Conductor::OnRemoveStream(rtc::scoped_refptr<webrtc::MediaStreamInterface>
 
 void Conductor::OnDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel)
 {
-	data_channel_ = channel;
+	if (channel->label() == kPoseDataChannelName)
+	{
+		pose_channel_ = channel;
+		pose_flow_control_ = SendFlowControl();
+	}
+	else
+	{
+		SetDataChannel(channel);
+	}
 }
 
 void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate)
@@ -286,11 +365,6 @@ void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate)
 		return;
 	}
 
-	Json::StyledWriter writer;
-	Json::Value jmessage;
-
-	jmessage[kCandidateSdpMidName] = candidate->sdp_mid();
-	jmessage[kCandidateSdpMlineIndexName] = candidate->sdp_mline_index();
 	std::string sdp;
 	if (!candidate->ToString(&sdp))
 	{
@@ -298,8 +372,130 @@ void Conductor::OnIceCandidate(const webrtc::IceCandidateInterface* candidate)
 		return;
 	}
 
-	jmessage[kCandidateSdpName] = sdp;
-	SendMessage(writer.write(jmessage));
+	SendMessage(SignalingMessageCodec::WriteCandidate(
+		candidate->sdp_mid(), candidate->sdp_mline_index(), sdp));
+}
+
+void Conductor::SetDataChannel(rtc::scoped_refptr<webrtc::DataChannelInterface> channel)
+{
+	if (data_channel_)
+	{
+		data_channel_->UnregisterObserver();
+	}
+
+	data_channel_ = channel;
+	binary_input_ = false;
+	binary_input_offered_ = false;
+	input_flow_control_ = SendFlowControl();
+	if (data_channel_)
+	{
+		data_channel_->RegisterObserver(this);
+		if (data_channel_->state() == webrtc::DataChannelInterface::kOpen)
+		{
+			OfferBinaryInput();
+		}
+	}
+}
+
+void Conductor::OfferBinaryInput()
+{
+	binary_input_offered_ = true;
+	webrtc::DataBuffer buffer(InputMessageCodec::WriteProtocolMessage(InputMessageCodec::kVersion));
+	data_channel_->Send(buffer);
+}
+
+//-------------------------------------------------------------------------
+// DataChannelObserver implementation.
+//-------------------------------------------------------------------------
+
+void Conductor::OnStateChange()
+{
+	if (data_channel_ && data_channel_->state() == webrtc::DataChannelInterface::kOpen &&
+		!binary_input_offered_)
+	{
+		OfferBinaryInput();
+	}
+}
+
+void Conductor::OnMessage(const webrtc::DataBuffer& buffer)
+{
+	const char* data = (const char*)buffer.data.data();
+	int version = 0;
+	FrameInput frame_input;
+	std::string payload;
+	if (MessageReassembler::IsChunk(data, buffer.data.size()))
+	{
+		if (reassembler_.Add(data, buffer.data.size(), rtc::TimeMillis(), &payload) &&
+			payload_func_ != nullptr)
+		{
+			payload_func_(payload);
+		}
+	}
+	else if (InputMessageCodec::ParseFrameInputMessage(data, buffer.data.size(), &frame_input))
+	{
+		latency_tracker_.OnFrameInput(frame_input);
+	}
+	else if (InputMessageCodec::ParseProtocolMessage(data, buffer.data.size(), &version) &&
+		!binary_input_)
+	{
+		binary_input_ = version == InputMessageCodec::kVersion;
+		LOG(INFO) << "Binary input " << (binary_input_ ? "enabled" : "declined");
+	}
+}
+
+void Conductor::OnBufferedAmountChange(uint64_t previous_amount)
+{
+	// Only the input channel is observed, IsPoseDataBlocked() polls the pose
+	// channel.
+	input_flow_control_.Update(data_channel_->buffered_amount());
+}
+
+//-------------------------------------------------------------------------
+// StatsObserver implementation.
+//-------------------------------------------------------------------------
+
+void Conductor::OnComplete(const webrtc::StatsReports& reports)
+{
+	for (const webrtc::StatsReport* report : reports)
+	{
+		if (report->type() == webrtc::StatsReport::kStatsReportTypeCandidatePair)
+		{
+			const webrtc::StatsReport::Value* active =
+				report->FindValue(webrtc::StatsReport::kStatsValueNameActiveConnection);
+
+			const webrtc::StatsReport::Value* rtt =
+				report->FindValue(webrtc::StatsReport::kStatsValueNameRtt);
+
+			if (active && active->ToString() == "true" && rtt)
+			{
+				rtt_ms_ = atoi(rtt->ToString().c_str());
+			}
+		}
+		else if (report->type() == webrtc::StatsReport::kStatsReportTypeSsrc)
+		{
+			const webrtc::StatsReport::Value* frame_rate =
+				report->FindValue(webrtc::StatsReport::kStatsValueNameFrameRateReceived);
+
+			if (frame_rate)
+			{
+				remote_frame_rate_ = atoi(frame_rate->ToString().c_str());
+			}
+		}
+	}
+}
+
+void Conductor::RequestStats()
+{
+	int64_t now_ms = rtc::TimeMillis();
+	if (!peer_connection_ ||
+		(last_stats_request_ms_ >= 0 && now_ms - last_stats_request_ms_ < kStatsIntervalMs))
+	{
+		return;
+	}
+
+	last_stats_request_ms_ = now_ms;
+	peer_connection_->GetStats(
+		this, NULL, webrtc::PeerConnectionInterface::kStatsOutputLevelStandard);
 }
 
 //
@@ -326,12 +522,6 @@ void Conductor::OnDisconnected()
 void Conductor::OnPeerConnected(int id, const std::string& name)
 {
 	LOG(INFO) << __FUNCTION__;
-
-	// Refresh the list if we're showing it.
-	if (main_window_->current_ui() == MainWindow::LIST_PEERS)
-	{
-		main_window_->SwitchToPeerList(client_->peers());
-	}
 }
 
 void Conductor::OnPeerDisconnected(int id)
@@ -342,13 +532,18 @@ void Conductor::OnPeerDisconnected(int id)
 		LOG(INFO) << "Our peer disconnected";
 		main_window_->QueueUIThreadCallback(PEER_CONNECTION_CLOSED, NULL);
 	}
-	else
+}
+
+//
+// PeerDirectoryObserver implementation.
+//
+
+void Conductor::OnPeersChanged(const PeerDirectoryDelta& delta)
+{
+	// Refresh the list if we're showing it, once per batch of changes.
+	if (main_window_->current_ui() == MainWindow::LIST_PEERS)
 	{
-		// Refresh the list if we're showing it.
-		if (main_window_->current_ui() == MainWindow::LIST_PEERS)
-		{
-			main_window_->SwitchToPeerList(client_->peers());
-		}
+		main_window_->SwitchToPeerList(client_->peers());
 	}
 }
 
@@ -377,18 +572,14 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 		return;
 	}
 
-	Json::Reader reader;
-	Json::Value jmessage;
-	if (!reader.parse(message, jmessage))
+	SignalingMessage signaling_message;
+	if (!SignalingMessageCodec::Parse(message, &signaling_message))
 	{
 		LOG(WARNING) << "Received unknown message. " << message;
 		return;
 	}
 
-	std::string type;
-	std::string json_object;
-
-	rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionTypeName, &type);
+	const std::string& type = signaling_message.type;
 	if (!type.empty()) 
 	{
 		if (type == "offer-loopback")
@@ -405,8 +596,7 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 			return;
 		}
 
-		std::string sdp;
-		if (!rtc::GetStringFromJsonObject(jmessage, kSessionDescriptionSdpName, &sdp))
+		if (!signaling_message.has_sdp)
 		{
 			LOG(WARNING) << "Can't parse received session description message.";
 			return;
@@ -414,7 +604,7 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 
 		webrtc::SdpParseError error;
 		webrtc::SessionDescriptionInterface* session_description(
-			webrtc::CreateSessionDescription(type, sdp, &error));
+			webrtc::CreateSessionDescription(type, signaling_message.sdp, &error));
 
 		if (!session_description) 
 		{
@@ -438,12 +628,7 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 	}
 	else
 	{
-		std::string sdp_mid;
-		int sdp_mlineindex = 0;
-		std::string sdp;
-		if (!rtc::GetStringFromJsonObject(jmessage, kCandidateSdpMidName, &sdp_mid) ||
-			!rtc::GetIntFromJsonObject(jmessage, kCandidateSdpMlineIndexName, &sdp_mlineindex) ||
-			!rtc::GetStringFromJsonObject(jmessage, kCandidateSdpName, &sdp))
+		if (!signaling_message.is_candidate())
 		{
 			LOG(WARNING) << "Can't parse received message.";
 			return;
@@ -451,7 +636,8 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 
 		webrtc::SdpParseError error;
 		std::unique_ptr<webrtc::IceCandidateInterface> candidate(
-			webrtc::CreateIceCandidate(sdp_mid, sdp_mlineindex, sdp, &error));
+			webrtc::CreateIceCandidate(signaling_message.sdp_mid,
+				signaling_message.sdp_mline_index, signaling_message.candidate, &error));
 
 		if (!candidate.get()) 
 		{
@@ -474,8 +660,7 @@ void Conductor::OnMessageFromPeer(int peer_id, const std::string& message)
 
 void Conductor::OnMessageSent(int err)
 {
-	// Process the next pending message if any.
-	main_window_->QueueUIThreadCallback(SEND_MESSAGE_TO_PEER, NULL);
+	// Pending messages are queued and sent by the signaling client.
 }
 
 void Conductor::OnServerConnectionFailure()
@@ -524,10 +709,14 @@ void Conductor::ConnectToPeer(int peer_id)
 	if (InitializePeerConnection())
 	{
 		peer_id_ = peer_id;
-		webrtc::DataChannelInit config;
-		config.ordered = false;
-		config.maxRetransmits = 0;
-		data_channel_ = peer_connection_->CreateDataChannel(kInputDataChannelName, &config);
+		webrtc::DataChannelInit input_config;
+		SetDataChannel(peer_connection_->CreateDataChannel(kInputDataChannelName, &input_config));
+
+		webrtc::DataChannelInit pose_config;
+		pose_config.ordered = false;
+		pose_config.maxRetransmits = 0;
+		pose_channel_ = peer_connection_->CreateDataChannel(kPoseDataChannelName, &pose_config);
+		pose_flow_control_ = SendFlowControl();
 		peer_connection_->CreateOffer(this, NULL);
 	}
 	else
@@ -588,14 +777,103 @@ bool Conductor::SendInputData(const std::string& message)
 {
 	if (data_channel_ && data_channel_->state() == webrtc::DataChannelInterface::kOpen)
 	{
-		webrtc::DataBuffer buffer(message);
+		// Always sent, only tracked.
+		input_flow_control_.Update(data_channel_->buffered_amount());
+
+		bool binary = InputMessageCodec::IsBinary(message.data(), message.size());
+		webrtc::DataBuffer buffer(rtc::CopyOnWriteBuffer(message.data(), message.size()), binary);
 		data_channel_->Send(buffer);
+		RequestStats();
 		return true;
 	}
 	
 	return false;
 }
 
+bool Conductor::SendPoseData(const std::string& message)
+{
+	if (pose_channel_ && pose_channel_->state() == webrtc::DataChannelInterface::kOpen)
+	{
+		if (!pose_flow_control_.ShouldSend(pose_channel_->buffered_amount(),
+			SendFlowControl::LOW_PRIORITY))
+		{
+			return false;
+		}
+
+		bool binary = InputMessageCodec::IsBinary(message.data(), message.size());
+		webrtc::DataBuffer buffer(rtc::CopyOnWriteBuffer(message.data(), message.size()), binary);
+		pose_channel_->Send(buffer);
+		RequestStats();
+		return true;
+	}
+
+	// Still of low priority on the input channel.
+	if (data_channel_ && data_channel_->state() == webrtc::DataChannelInterface::kOpen &&
+		!input_flow_control_.ShouldSend(data_channel_->buffered_amount(),
+			SendFlowControl::LOW_PRIORITY))
+	{
+		return false;
+	}
+
+	return SendInputData(message);
+}
+
+bool Conductor::IsPoseDataBlocked()
+{
+	if (pose_channel_ && pose_channel_->state() == webrtc::DataChannelInterface::kOpen)
+	{
+		pose_flow_control_.Update(pose_channel_->buffered_amount());
+		return pose_flow_control_.paused();
+	}
+
+	if (data_channel_ && data_channel_->state() == webrtc::DataChannelInterface::kOpen)
+	{
+		input_flow_control_.Update(data_channel_->buffered_amount());
+		return input_flow_control_.paused();
+	}
+
+	return false;
+}
+
+bool Conductor::IsBinaryInputEnabled()
+{
+	return binary_input_;
+}
+
+int Conductor::GetRoundTripTimeMs()
+{
+	return rtt_ms_;
+}
+
+int Conductor::GetRemoteFrameRate()
+{
+	return remote_frame_rate_;
+}
+
+void Conductor::OnFramePresented(int64_t capture_ntp_ms, int64_t decoded_time_us)
+{
+	latency_tracker_.OnFramePresented(capture_ntp_ms, decoded_time_us, rtc::TimeMicros());
+
+	int64_t now_ms = rtc::TimeMillis();
+	if (last_latency_log_ms_ < 0)
+	{
+		last_latency_log_ms_ = now_ms;
+	}
+	else if (now_ms - last_latency_log_ms_ >= kLatencyLogIntervalMs)
+	{
+		InputLatencyStats stats = latency_tracker_.GetStats();
+		if (stats.samples > 0)
+		{
+			LOG(INFO) << "Input latency p50/p90/p99 over " << stats.samples << " frames: total " <<
+				FormatPercentiles(stats.total) << ", server " << FormatPercentiles(stats.server) <<
+				", transport " << FormatPercentiles(stats.transport) << ", present " <<
+				FormatPercentiles(stats.present);
+		}
+
+		last_latency_log_ms_ = now_ms;
+	}
+}
+
 void Conductor::UIThreadCallback(int msg_id, void* data)
 {
 	switch (msg_id)
@@ -631,17 +909,8 @@ void Conductor::UIThreadCallback(int msg_id, void* data)
 
 			if (msg)
 			{
-				// For convenience, we always run the message through the queue.
-				// This way we can be sure that messages are sent to the server
-				// in the same order they were signaled without much hassle.
-				pending_messages_.push_back(msg);
-			}
-
-			if (!pending_messages_.empty() && !client_->IsSendingMessage())
-			{
-				msg = pending_messages_.front();
-				pending_messages_.pop_front();
-
+				// The signaling client keeps its own ordered copy of the
+				// message until the server has acknowledged it.
 				if (!client_->SendToPeer(peer_id_, *msg) && peer_id_ != -1)
 				{
 					LOG(LS_ERROR) << "SendToPeer failed";
@@ -714,11 +983,7 @@ void Conductor::OnSuccess(webrtc::SessionDescriptionInterface* desc)
 		return;
 	}
 
-	Json::StyledWriter writer;
-	Json::Value jmessage;
-	jmessage[kSessionDescriptionTypeName] = desc->type();
-	jmessage[kSessionDescriptionSdpName] = sdp;
-	SendMessage(writer.write(jmessage));
+	SendMessage(SignalingMessageCodec::WriteSessionDescription(desc->type(), sdp));
 }
 
 void Conductor::OnFailure(const std::string& error)
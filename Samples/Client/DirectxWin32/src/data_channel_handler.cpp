@@ -1,6 +1,13 @@
 #include "pch.h"
+
+#include <algorithm>
+
 #include "data_channel_handler.h"
+#include "input_message.h"
+#include "webrtc/base/checks.h"
 #include "webrtc/base/json.h"
+#include "webrtc/base/thread.h"
+#include "webrtc/base/timeutils.h"
 
 // Data channel message types.
 const char kStereoRenderingType[]				= "stereo-rendering";
@@ -9,13 +16,20 @@ const char kCameraTransformMsgType[]			= "camera-transform";
 const char kKeyboardEventMsgType[]				= "keyboard-event";
 const char kMouseEventMsgType[]					= "mouse-event";
 
+// Message id of the coalesced input flush.
+const uint32_t kFlushInputId = 1;
+
 DataChannelHandler::DataChannelHandler(DataChannelCallback* data_channel_callback) :
-	data_channel_callback_(data_channel_callback)
+	data_channel_callback_(data_channel_callback),
+	flush_scheduled_(false)
 {
 }
 
 DataChannelHandler::~DataChannelHandler()
 {
+	// A delayed flush would be delivered to the deleted handler. Destroyed
+	// on the thread PostFlush() posts to.
+	rtc::Thread::Current()->Clear(this);
 }
 
 bool DataChannelHandler::SendCameraInput(
@@ -23,61 +37,178 @@ bool DataChannelHandler::SendCameraInput(
 	Vector3 camera_target,
 	Vector3 camera_up_vector)
 {
+	int64_t timestamp_us = rtc::TimeMicros();
+	if (data_channel_callback_->IsBinaryInputEnabled())
+	{
+		const float eye[] = { camera_position.x, camera_position.y, camera_position.z };
+		const float focus[] = { camera_target.x, camera_target.y, camera_target.z };
+		const float up[] = { camera_up_vector.x, camera_up_vector.y, camera_up_vector.z };
+		return QueueInput(InputMessage::CAMERA_TRANSFORM_LOOKAT,
+			InputMessageCodec::WriteCameraLookAt(eye, focus, up, timestamp_us));
+	}
+
 	char buffer[1024];
 	sprintf(buffer, "%f, %f, %f, %f, %f, %f, %f, %f, %f",
 		camera_position.x, camera_position.y, camera_position.z,
 		camera_target.x, camera_target.y, camera_target.z,
 		camera_up_vector.x, camera_up_vector.y, camera_up_vector.z);
 
-	Json::StyledWriter writer;
-	Json::Value jmessage;
-	jmessage["type"] = kCameraTransformLookAtMsgType;
-	jmessage["body"] = buffer;
-
-	return data_channel_callback_->SendInputData(writer.write(jmessage));
+	return QueueInput(InputMessage::CAMERA_TRANSFORM_LOOKAT,
+		WriteJsonInput(kCameraTransformLookAtMsgType, buffer, timestamp_us));
 }
 
 bool DataChannelHandler::SendCameraInput(
 	float x, float y, float z, float yaw, float pitch, float roll)
 {
+	int64_t timestamp_us = rtc::TimeMicros();
+	if (data_channel_callback_->IsBinaryInputEnabled())
+	{
+		return QueueInput(InputMessage::CAMERA_TRANSFORM,
+			InputMessageCodec::WriteCameraTransform(x, y, z, yaw, pitch, roll, timestamp_us));
+	}
+
 	char buffer[1024];
 	sprintf(buffer, "%f, %f, %f, %f, %f, %f",
 		x, y, z, yaw, pitch, roll);
 
-	Json::StyledWriter writer;
-	Json::Value jmessage;
-	jmessage["type"] = kCameraTransformMsgType;
-	jmessage["body"] = buffer;
-
-	return data_channel_callback_->SendInputData(writer.write(jmessage));
+	return QueueInput(InputMessage::CAMERA_TRANSFORM,
+		WriteJsonInput(kCameraTransformMsgType, buffer, timestamp_us));
 }
 
-bool DataChannelHandler::SendKeyboardInput(const std::string& msg)
+bool DataChannelHandler::SendKeyboardInput(UINT message, WPARAM wParam)
 {
+	int64_t timestamp_us = rtc::TimeMicros();
+	if (data_channel_callback_->IsBinaryInputEnabled())
+	{
+		return SendEvent(InputMessageCodec::WriteWindowEvent(InputMessage::KEYBOARD_EVENT,
+			message, static_cast<uint32_t>(wParam), 0, timestamp_us));
+	}
+
 	Json::StyledWriter writer;
 	Json::Value jmessage;
-	jmessage["type"] = kKeyboardEventMsgType;
-	jmessage["body"] = msg;
+	jmessage["message"] = message;
+	jmessage["wParam"] = wParam;
 
-	return data_channel_callback_->SendInputData(writer.write(jmessage));
+	return SendEvent(WriteJsonInput(kKeyboardEventMsgType, writer.write(jmessage), timestamp_us));
 }
 
-bool DataChannelHandler::SendMouseInput(const std::string& msg)
+bool DataChannelHandler::SendMouseInput(UINT message, WPARAM wParam, LPARAM lParam)
 {
-	Json::StyledWriter writer;
-	Json::Value jmessage;
-	jmessage["type"] = kMouseEventMsgType;
-	jmessage["body"] = msg;
+	int64_t timestamp_us = rtc::TimeMicros();
+	std::string data;
+	if (data_channel_callback_->IsBinaryInputEnabled())
+	{
+		data = InputMessageCodec::WriteWindowEvent(InputMessage::MOUSE_EVENT, message,
+			static_cast<uint32_t>(wParam), static_cast<int32_t>(lParam), timestamp_us);
+	}
+	else
+	{
+		Json::StyledWriter writer;
+		Json::Value jmessage;
+		jmessage["message"] = message;
+		jmessage["wParam"] = wParam;
+		jmessage["lParam"] = lParam;
+		data = WriteJsonInput(kMouseEventMsgType, writer.write(jmessage), timestamp_us);
+	}
 
-	return data_channel_callback_->SendInputData(writer.write(jmessage));
+	// Only the latest position matters, button changes are events.
+	if (message == WM_MOUSEMOVE)
+	{
+		return QueueInput(InputMessage::MOUSE_EVENT, data);
+	}
+
+	return SendEvent(data);
 }
 
 bool DataChannelHandler::RequestStereoStream(bool stereo)
+{
+	int64_t timestamp_us = rtc::TimeMicros();
+	if (data_channel_callback_->IsBinaryInputEnabled())
+	{
+		return SendEvent(InputMessageCodec::WriteStereoRendering(stereo, timestamp_us));
+	}
+
+	return SendEvent(WriteJsonInput(kStereoRenderingType, stereo ? "1" : "0", timestamp_us));
+}
+
+void DataChannelHandler::OnMessage(rtc::Message* msg)
+{
+	RTC_DCHECK(msg->message_id == kFlushInputId);
+	flush_scheduled_ = false;
+
+	// Checks again an interval later, there is no notification when the
+	// pose channel drains.
+	if (data_channel_callback_->IsPoseDataBlocked())
+	{
+		PostFlush(coalescer_.stats().interval_ms);
+		return;
+	}
+
+	std::vector<std::string> messages;
+	coalescer_.Flush(rtc::TimeMillis(), &messages);
+	for (const std::string& message : messages)
+	{
+		data_channel_callback_->SendPoseData(message);
+	}
+
+	ScheduleFlush();
+}
+
+std::string DataChannelHandler::WriteJsonInput(
+	const char* type, const std::string& body, int64_t timestamp_us)
 {
 	Json::StyledWriter writer;
 	Json::Value jmessage;
-	jmessage["type"] = kStereoRenderingType;
-	jmessage["body"] = stereo ? "1" : "0";
+	jmessage["type"] = type;
+	jmessage["body"] = body;
+	jmessage["timestamp"] = static_cast<Json::Int64>(timestamp_us);
+
+	return writer.write(jmessage);
+}
+
+bool DataChannelHandler::QueueInput(InputMessage::Type type, const std::string& message)
+{
+	coalescer_.SetRoundTripTimeMs(data_channel_callback_->GetRoundTripTimeMs());
+	coalescer_.SetFrameRate(data_channel_callback_->GetRemoteFrameRate());
+	coalescer_.Update(type, message);
+	ScheduleFlush();
+	return true;
+}
+
+bool DataChannelHandler::SendEvent(const std::string& message)
+{
+	// Blocked values stay pending, the event carries its own state.
+	std::vector<std::string> messages;
+	if (!data_channel_callback_->IsPoseDataBlocked())
+	{
+		coalescer_.FlushNow(rtc::TimeMillis(), &messages);
+	}
 
-	return data_channel_callback_->SendInputData(writer.write(jmessage));
-}
\ No newline at end of file
+	for (const std::string& pending : messages)
+	{
+		data_channel_callback_->SendPoseData(pending);
+	}
+
+	return data_channel_callback_->SendInputData(message);
+}
+
+void DataChannelHandler::ScheduleFlush()
+{
+	int64_t due_ms = coalescer_.NextFlushMs();
+	if (flush_scheduled_ || due_ms < 0)
+	{
+		return;
+	}
+
+	// Posted even when already due, so a burst of window messages still
+	// coalesces into one update.
+	PostFlush(std::max<int64_t>(due_ms - rtc::TimeMillis(), 0));
+}
+
+void DataChannelHandler::PostFlush(int64_t delay_ms)
+{
+	rtc::Thread::Current()->PostDelayed(RTC_FROM_HERE, static_cast<int>(delay_ms), this,
+		kFlushInputId);
+
+	flush_scheduled_ = true;
+}
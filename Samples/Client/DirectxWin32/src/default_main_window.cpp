@@ -21,6 +21,7 @@
 #include "webrtc/base/arraysize.h"
 #include "webrtc/base/checks.h"
 #include "webrtc/base/logging.h"
+#include "webrtc/base/timeutils.h"
 
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
@@ -261,22 +262,28 @@ void DefaultMainWindow::SwitchToConnectUI()
 	}
 }
 
-void DefaultMainWindow::SwitchToPeerList(const Peers& peers)
+void DefaultMainWindow::SwitchToPeerList(const PeerDirectory& peers)
 {
 	LayoutConnectUI(false);
 
+	// Redrawn once, the list can hold thousands of peers.
+	::SendMessage(listbox_, WM_SETREDRAW, FALSE, 0);
 	::SendMessage(listbox_, LB_RESETCONTENT, 0, 0);
 
 	AddListBoxItem(listbox_, "List of currently connected peers:", -1);
-	Peers::const_iterator i = peers.begin();
-	for (; i != peers.end(); ++i)
-	AddListBoxItem(listbox_, i->second.c_str(), i->first);
+	for (const PeerInfo* peer : peers.Select())
+	{
+		AddListBoxItem(listbox_, peer->name.c_str(), peer->id);
+	}
+
+	::SendMessage(listbox_, WM_SETREDRAW, TRUE, 0);
+	::InvalidateRect(listbox_, NULL, TRUE);
 
 	ui_ = LIST_PEERS;
 	LayoutPeerListUI(true);
 	::SetFocus(listbox_);
 
-	if (auto_call_ && peers.begin() != peers.end())
+	if (auto_call_ && !peers.empty())
 	{
 		// Get the number of items in the list
 		LRESULT count = ::SendMessage(listbox_, LB_GETCOUNT, 0, 0);
@@ -387,6 +394,13 @@ void DefaultMainWindow::OnPaint()
 			render_target_->DrawBitmap(bitmap, desRect);
 			render_target_->EndDraw();
 
+			int64_t capture_ntp_ms = 0;
+			int64_t decoded_time_us = 0;
+			if (callback_ && remote_renderer->TakeFrameTiming(&capture_ntp_ms, &decoded_time_us))
+			{
+				callback_->OnFramePresented(capture_ntp_ms, decoded_time_us);
+			}
+
 			// Releases the bitmap.
 			SAFE_RELEASE(bitmap);
 		}
@@ -777,6 +791,9 @@ void DefaultMainWindow::HandleTabbing()
 DefaultMainWindow::VideoRenderer::VideoRenderer(HWND wnd, int width, int height,
     webrtc::VideoTrackInterface* track_to_render) :
 		wnd_(wnd),
+		capture_ntp_ms_(0),
+		decoded_time_us_(0),
+		frame_timing_taken_(true),
 		rendered_track_(track_to_render)
 {
 	::InitializeCriticalSection(&buffer_lock_);
@@ -835,5 +852,22 @@ void DefaultMainWindow::VideoRenderer::OnFrame(const webrtc::VideoFrame& video_f
 		bmi_.bmiHeader.biBitCount / 8,
 		buffer->width(), buffer->height());
 
+	capture_ntp_ms_ = video_frame.ntp_time_ms();
+	decoded_time_us_ = rtc::TimeMicros();
+	frame_timing_taken_ = false;
 	InvalidateRect(wnd_, NULL, TRUE);
 }
+
+bool DefaultMainWindow::VideoRenderer::TakeFrameTiming(
+	int64_t* capture_ntp_ms, int64_t* decoded_time_us)
+{
+	if (frame_timing_taken_)
+	{
+		return false;
+	}
+
+	*capture_ntp_ms = capture_ntp_ms_;
+	*decoded_time_us = decoded_time_us_;
+	frame_timing_taken_ = true;
+	return true;
+}
@@ -4,6 +4,7 @@
 #include <shellapi.h>
 #include <fstream>
 
+#include "defaults.h"
 #include "webrtc.h"
 #include "third_party/jsoncpp/source/include/json/json.h"
 
@@ -42,6 +43,9 @@ int InitWebRTC(char* server, int port, int heartbeat)
 	rtc::Win32Thread w32_thread;
 	rtc::ThreadManager::Instance()->SetCurrentThread(&w32_thread);
 
+	// Resolves the signaling and STUN server hosts while the window opens.
+	DnsCache::Instance()->PreResolve({ server, GetPeerConnectionString() });
+
 	DefaultMainWindow wnd(server, port, FLAG_autoconnect, FLAG_autocall, false, 1280, 720);
 
 	if (!wnd.Create())
@@ -5,8 +5,6 @@
 #include "win32_data_channel_handler.h"
 #include "minwindef.h"
 
-#include "webrtc/base/json.h"
-
 using namespace DirectX;
 using namespace DirectX::SimpleMath;
 
@@ -17,8 +15,6 @@ Win32DataChannelHandler::Win32DataChannelHandler(DataChannelCallback* data_chann
 	stereo_mode_(-1),
 	width_(0),
 	height_(0),
-	keyboardTick(0),
-	mouseTick(0),
 	zoom_(DEFAULT_ZOOM),
 	distance_(DEFAULT_DISTANCE)
 {
@@ -41,7 +37,6 @@ void Win32DataChannelHandler::ProcessMessage(UINT message, WPARAM wParam, LPARAM
 	Vector3 move = Vector3::Zero;
 	float scale = distance_;
 	bool sendMessage = false;
-	bool sendMouseEvent = false;
 
 	// Requests mono stream.
 	if (stereo_mode_ == -1 && RequestStereoStream(false))
@@ -57,13 +52,7 @@ void Win32DataChannelHandler::ProcessMessage(UINT message, WPARAM wParam, LPARAM
 
 	case WM_CHAR:
 	case WM_KEYDOWN:
-	{
-		Json::StyledWriter writer;
-		Json::Value jmessage;
-		jmessage["message"] = message;
-		jmessage["wParam"] = wParam;
-		SendKeyboardInput(writer.write(jmessage));
-	}
+		SendKeyboardInput(message, wParam);
 
 	switch (wParam)
 	{
@@ -109,11 +98,7 @@ void Win32DataChannelHandler::ProcessMessage(UINT message, WPARAM wParam, LPARAM
 		view_.Invert(im);
 		move = Vector3::TransformNormal(move, im);
 		camera_focus_ += move;
-		if (++keyboardTick == KEYBOARD_DELAY)
-		{
-			sendMessage = true;
-			keyboardTick = 0;
-		}
+		sendMessage = true;
 	}
 
 	break;
@@ -130,25 +115,9 @@ void Win32DataChannelHandler::ProcessMessage(UINT message, WPARAM wParam, LPARAM
 	case WM_RBUTTONDBLCLK:
 	case WM_RBUTTONDOWN:
 	case WM_RBUTTONUP:
-		sendMouseEvent = true;
-		// fall through
 	case WM_MOUSEMOVE:
-		// thottle mouse move events
-		if (wParam = WM_MOUSEMOVE && ++mouseMoveTick == MOUSE_DELAY)
-		{
-			sendMouseEvent = true;
-			mouseMoveTick = 0;
-		}
-
-		if (sendMouseEvent)
-		{
-			Json::StyledWriter writer;
-			Json::Value jmessage;
-			jmessage["message"] = message;
-			jmessage["wParam"] = wParam;
-			jmessage["lParam"] = lParam;
-			SendMouseInput(writer.write(jmessage));
-		}
+		// Moves are coalesced, see DataChannelHandler.
+		SendMouseInput(message, wParam, lParam);
 
 		// Mouse
 		mouse_->ProcessMessage(message, wParam, lParam);
@@ -161,11 +130,7 @@ void Win32DataChannelHandler::ProcessMessage(UINT message, WPARAM wParam, LPARAM
 			ball_camera_.OnMove(mouse.x, mouse.y);
 			Quaternion q = ball_camera_.GetQuat();
 			q.Inverse(camera_rot_);
-			if (++mouseTick == MOUSE_DELAY)
-			{
-				sendMessage = true;
-				mouseTick = 0;
-			}
+			sendMessage = true;
 
 			if (mouse_button_tracker_.leftButton == Mouse::ButtonStateTracker::RELEASED)
 			{
@@ -377,6 +377,8 @@ SceneParamsStatic           g_StaticParamsMirror[g_iNumMirrors];
 VideoTestRunner*			g_videoTestRunner = nullptr;
 #else
 VideoHelper*				g_videoHelper = nullptr;
+PoseExtrapolator			g_poseExtrapolator;
+Conductor*					g_conductor = nullptr;
 #endif // TEST_RUNNER
 
 
@@ -437,97 +439,70 @@ inline bool IsRenderDeferred()
 
 void FrameUpdate()
 {
+#ifndef TEST_RUNNER
+	// Renders the stereo pose the client will have when the frame is
+	// displayed.
+	// Predicts over the latency measured on the session, the default until
+	// its first stats.
+	const int64_t pipelineLatencyUs = g_conductor ? g_conductor->pipeline_latency_us() : 0;
+	g_poseExtrapolator.SetPipelineLatencyUs(pipelineLatencyUs > 0 ?
+		pipelineLatencyUs : PoseExtrapolator::kDefaultPipelineLatencyUs);
+
+	float left[16];
+	float right[16];
+	if (g_poseExtrapolator.Extrapolate(rtc::TimeMicros(), left, right))
+	{
+		XMFLOAT4X4 id;
+		XMStoreFloat4x4(&id, XMMatrixIdentity());
+		g_Camera.SetViewMatrixStereo(id);
+		g_Camera.SetProjMatrixStereo(XMFLOAT4X4(left), XMFLOAT4X4(right));
+		g_Camera.FrameMove(0);
+	}
+#endif // TEST_RUNNER
+
 	DXUTRender3DEnvironment();
 }
 
 #ifndef TEST_RUNNER
 
-// Handles input from client.
-void InputUpdate(const std::string& message)
+// Applies the input of the client to the camera.
+class CameraInputHandler : public InputHandler
 {
-	char type[256];
-	char body[1024];
-	Json::Reader reader;
-	Json::Value msg = NULL;
-	reader.parse(message, msg, false);
-
-	if (msg.isMember("type") && msg.isMember("body"))
+public:
+	void OnStereoRendering(bool stereo) override
 	{
-		strcpy(type, msg.get("type", "").asCString());
-		strcpy(body, msg.get("body", "").asCString());
-		std::istringstream datastream(body);
-		std::string token;
-
-		if (strcmp(type, "stereo-rendering") == 0)
+		if (!stereo)
 		{
-			getline(datastream, token, ',');
-			int stereo = stoi(token);
-			DXUTSetStereo(stereo == 1);
+			g_poseExtrapolator.Reset();
 		}
-		else if (strcmp(type, "camera-transform-lookat") == 0)
-		{
-			// Eye point.
-			getline(datastream, token, ',');
-			float eyeX = stof(token);
-			getline(datastream, token, ',');
-			float eyeY = stof(token);
-			getline(datastream, token, ',');
-			float eyeZ = stof(token);
-
-			// Focus point.
-			getline(datastream, token, ',');
-			float focusX = stof(token);
-			getline(datastream, token, ',');
-			float focusY = stof(token);
-			getline(datastream, token, ',');
-			float focusZ = stof(token);
-
-			// Up vector.
-			getline(datastream, token, ',');
-			float upX = stof(token);
-			getline(datastream, token, ',');
-			float upY = stof(token);
-			getline(datastream, token, ',');
-			float upZ = stof(token);
-
-			const DirectX::XMVECTORF32 lookAt = { focusX, focusY, focusZ, 0.f };
-			const DirectX::XMVECTORF32 up = { upX, upY, upZ, 0.f };
-			const DirectX::XMVECTORF32 eye = { eyeX, eyeY, eyeZ, 0.f };
-			g_Camera.SetViewParams(eye, lookAt, up);
-			g_Camera.FrameMove(0);
-		}
-		else if (strcmp(type, "camera-transform-stereo") == 0)
-		{
-			// Parses the left view projection matrix.
-			DirectX::XMFLOAT4X4 viewProjectionLeft;
-			for (int i = 0; i < 4; i++)
-			{
-				for (int j = 0; j < 4; j++)
-				{
-					getline(datastream, token, ',');
-					viewProjectionLeft.m[i][j] = stof(token);
-				}
-			}
 
-			// Parses the right view projection matrix.
-			DirectX::XMFLOAT4X4 viewProjectionRight;
-			for (int i = 0; i < 4; i++)
-			{
-				for (int j = 0; j < 4; j++)
-				{
-					getline(datastream, token, ',');
-					viewProjectionRight.m[i][j] = stof(token);
-				}
-			}
+		DXUTSetStereo(stereo);
+	}
 
-			// Updates the camera's matrices.
-			XMFLOAT4X4 id;
-			XMStoreFloat4x4(&id, XMMatrixIdentity());
-			g_Camera.SetViewMatrixStereo(id);
-			g_Camera.SetProjMatrixStereo(viewProjectionLeft, viewProjectionRight);
-			g_Camera.FrameMove(0);
-		}
+	void OnCameraLookAt(const float eye[3], const float focus[3], const float up[3]) override
+	{
+		g_poseExtrapolator.Reset();
+
+		const DirectX::XMVECTORF32 eyeVector = { eye[0], eye[1], eye[2], 0.f };
+		const DirectX::XMVECTORF32 lookAt = { focus[0], focus[1], focus[2], 0.f };
+		const DirectX::XMVECTORF32 upVector = { up[0], up[1], up[2], 0.f };
+		g_Camera.SetViewParams(eyeVector, lookAt, upVector);
+		g_Camera.FrameMove(0);
+	}
+
+	// Applied by FrameUpdate().
+	void OnCameraStereo(const float left[16], const float right[16], int64_t target_time_us) override
+	{
+		g_poseExtrapolator.AddSample(target_time_us, rtc::TimeMicros(), left, right);
 	}
+};
+
+CameraInputHandler g_inputHandler;
+
+// Handles input from client.
+void InputUpdate(const std::string& message)
+{
+	InputParser::Dispatch(message.data(), message.size(), &g_inputHandler);
 }
 
 //--------------------------------------------------------------------------------------
@@ -570,6 +545,10 @@ int InitWebRTC(char* server, int port, int heartbeat)
 	g_videoHelper->Initialize(DXUTGetDXGISwapChain());
 
 	rtc::InitializeSSL();
+
+	// Pre-warms the factory and threads shared by all the peer connections.
+	Toolkit3DLibrary::SharedPeerConnectionFactory::Instance()->Initialize();
+
 	PeerConnectionClient client;
 
 	client.SetHeartbeatMs(heartbeat);
@@ -578,6 +557,10 @@ int InitWebRTC(char* server, int port, int heartbeat)
 		new rtc::RefCountedObject<Conductor>(
 			&client, &wnd, &FrameUpdate, &InputUpdate, g_videoHelper));
 
+	// InputUpdate decodes the binary input messages.
+	conductor->SetBinaryInputEnabled(true);
+	g_conductor = conductor.get();
+
 	// Main loop.
 	MSG msg;
 	BOOL gm;
@@ -597,6 +580,9 @@ int InitWebRTC(char* server, int port, int heartbeat)
 		}
 	}
 
+	g_conductor = nullptr;
+
+	Toolkit3DLibrary::SharedPeerConnectionFactory::Instance()->Shutdown();
 	rtc::CleanupSSL();
 
 	return 0;
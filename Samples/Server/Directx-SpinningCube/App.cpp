@@ -38,6 +38,8 @@ CubeRenderer*		g_cubeRenderer = nullptr;
 VideoTestRunner*	g_videoTestRunner = nullptr;
 #else // TEST_RUNNER
 VideoHelper*		g_videoHelper = nullptr;
+PoseExtrapolator	g_poseExtrapolator;
+Conductor*			g_conductor = nullptr;
 #endif // TESTRUNNER
 
 //--------------------------------------------------------------------------------------
@@ -45,94 +47,66 @@ VideoHelper*		g_videoHelper = nullptr;
 //--------------------------------------------------------------------------------------
 void FrameUpdate()
 {
+#ifndef TEST_RUNNER
+	// Renders the stereo pose the client will have when the frame is
+	// displayed.
+	// Predicts over the latency measured on the session, the default until
+	// its first stats.
+	const int64_t pipelineLatencyUs = g_conductor ? g_conductor->pipeline_latency_us() : 0;
+	g_poseExtrapolator.SetPipelineLatencyUs(pipelineLatencyUs > 0 ?
+		pipelineLatencyUs : PoseExtrapolator::kDefaultPipelineLatencyUs);
+
+	float left[16];
+	float right[16];
+	if (g_poseExtrapolator.Extrapolate(rtc::TimeMicros(), left, right))
+	{
+		g_cubeRenderer->UpdateView(DirectX::XMFLOAT4X4(left), DirectX::XMFLOAT4X4(right));
+	}
+#endif // TEST_RUNNER
+
 	g_cubeRenderer->Update();
 	g_cubeRenderer->Render();
 }
 
 #ifndef TEST_RUNNER
 
-// Handles input from client.
-void InputUpdate(const std::string& message)
+// Applies the input of the client to the cube renderer.
+class CubeInputHandler : public InputHandler
 {
-	char type[256];
-	char body[1024];
-	Json::Reader reader;
-	Json::Value msg = NULL;
-	reader.parse(message, msg, false);
-
-	if (msg.isMember("type") && msg.isMember("body"))
+public:
+	void OnStereoRendering(bool stereo) override
 	{
-		strcpy(type, msg.get("type", "").asCString());
-		strcpy(body, msg.get("body", "").asCString());
-		std::istringstream datastream(body);
-		std::string token;
-
-		if (strcmp(type, "stereo-rendering") == 0)
+		if (!stereo)
 		{
-			getline(datastream, token, ',');
-			int stereo = stoi(token);
-			g_deviceResources->SetStereo(stereo == 1);
+			g_poseExtrapolator.Reset();
 		}
-		else if (strcmp(type, "camera-transform-lookat") == 0)
-		{			
-			// Eye point.
-			getline(datastream, token, ',');
-			float eyeX = stof(token);
-			getline(datastream, token, ',');
-			float eyeY = stof(token);
-			getline(datastream, token, ',');
-			float eyeZ = stof(token);
-
-			// Focus point.
-			getline(datastream, token, ',');
-			float focusX = stof(token);
-			getline(datastream, token, ',');
-			float focusY = stof(token);
-			getline(datastream, token, ',');
-			float focusZ = stof(token);
-
-			// Up vector.
-			getline(datastream, token, ',');
-			float upX = stof(token);
-			getline(datastream, token, ',');
-			float upY = stof(token);
-			getline(datastream, token, ',');
-			float upZ = stof(token);
-
-			const DirectX::XMVECTORF32 lookAt = { focusX, focusY, focusZ, 0.f };
-			const DirectX::XMVECTORF32 up = { upX, upY, upZ, 0.f };
-			const DirectX::XMVECTORF32 eye = { eyeX, eyeY, eyeZ, 0.f };
-			g_cubeRenderer->UpdateView(eye, lookAt, up);
-		}
-		else if (strcmp(type, "camera-transform-stereo") == 0)
-		{
-			// Parses the left view projection matrix.
-			DirectX::XMFLOAT4X4 viewProjectionLeft;
-			for (int i = 0; i < 4; i++)
-			{
-				for (int j = 0; j < 4; j++)
-				{
-					getline(datastream, token, ',');
-					viewProjectionLeft.m[i][j] = stof(token);
-				}
-			}
 
-			// Parses the right view projection matrix.
-			DirectX::XMFLOAT4X4 viewProjectionRight;
-			for (int i = 0; i < 4; i++)
-			{
-				for (int j = 0; j < 4; j++)
-				{
-					getline(datastream, token, ',');
-					viewProjectionRight.m[i][j] = stof(token);
-				}
-			}
+		g_deviceResources->SetStereo(stereo);
+	}
 
-			// Updates the cube's matrices.
-			g_cubeRenderer->UpdateView(
-				viewProjectionLeft, viewProjectionRight);
-		}
+	void OnCameraLookAt(const float eye[3], const float focus[3], const float up[3]) override
+	{
+		g_poseExtrapolator.Reset();
+
+		const DirectX::XMVECTORF32 eyeVector = { eye[0], eye[1], eye[2], 0.f };
+		const DirectX::XMVECTORF32 lookAt = { focus[0], focus[1], focus[2], 0.f };
+		const DirectX::XMVECTORF32 upVector = { up[0], up[1], up[2], 0.f };
+		g_cubeRenderer->UpdateView(eyeVector, lookAt, upVector);
+	}
+
+	// Applied by FrameUpdate().
+	void OnCameraStereo(const float left[16], const float right[16], int64_t target_time_us) override
+	{
+		g_poseExtrapolator.AddSample(target_time_us, rtc::TimeMicros(), left, right);
 	}
+};
+
+CubeInputHandler g_inputHandler;
+
+// Handles input from client.
+void InputUpdate(const std::string& message)
+{
+	InputParser::Dispatch(message.data(), message.size(), &g_inputHandler);
 }
 
 //--------------------------------------------------------------------------------------
@@ -171,6 +145,10 @@ int InitWebRTC(char* server, int port, int heartbeat)
 	g_videoHelper->Initialize(g_deviceResources->GetSwapChain());
 
 	rtc::InitializeSSL();
+
+	// Pre-warms the factory and threads shared by all the peer connections.
+	Toolkit3DLibrary::SharedPeerConnectionFactory::Instance()->Initialize();
+
 	PeerConnectionClient client;
 
 	client.SetHeartbeatMs(heartbeat);
@@ -179,6 +157,15 @@ int InitWebRTC(char* server, int port, int heartbeat)
 		new rtc::RefCountedObject<Conductor>(
 			&client, &wnd, &FrameUpdate, &InputUpdate, g_videoHelper));
 
+	// InputUpdate decodes the binary input messages.
+	conductor->SetBinaryInputEnabled(true);
+	g_conductor = conductor.get();
+
+	if (FLAG_loopbacktest > 0)
+	{
+		conductor->RunLoopbackTest(FLAG_loopbacktest, FLAG_sharedfactory);
+	}
+
 	// Main loop.
 	MSG msg;
 	BOOL gm;
@@ -196,6 +183,9 @@ int InitWebRTC(char* server, int port, int heartbeat)
 		}
 	}
 
+	g_conductor = nullptr;
+
+	Toolkit3DLibrary::SharedPeerConnectionFactory::Instance()->Shutdown();
 	rtc::CleanupSSL();
 
 	// Cleanup.
@@ -206,6 +196,51 @@ int InitWebRTC(char* server, int port, int heartbeat)
 	return 0;
 }
 
+#ifdef HEADLESS_SESSIONS
+//--------------------------------------------------------------------------------------
+// Load test mode, hosts |sessions| streaming sessions fed by synthetic frames,
+// without any window or D3D device.
+//--------------------------------------------------------------------------------------
+int RunHeadlessSessions(char* server, int port, int heartbeat, int sessions)
+{
+	rtc::EnsureWinsockInit();
+	rtc::Win32Thread w32_thread;
+	rtc::ThreadManager::Instance()->SetCurrentThread(&w32_thread);
+	rtc::InitializeSSL();
+	Toolkit3DLibrary::SharedPeerConnectionFactory::Instance()->Initialize();
+
+	{
+		SessionManager sessionManager(sessions);
+		SessionParams params;
+		params.server = server;
+		params.port = port;
+		params.heartbeat = heartbeat;
+		for (int i = 0; i < sessions; i++)
+		{
+			if (sessionManager.CreateSession(params) < 0)
+			{
+				break;
+			}
+		}
+
+		// Main loop, none without a session to host.
+		MSG msg;
+		BOOL gm;
+		while (sessionManager.session_count() > 0 &&
+			(gm = ::GetMessage(&msg, NULL, 0, 0)) != 0 && gm != -1)
+		{
+			::TranslateMessage(&msg);
+			::DispatchMessage(&msg);
+		}
+	}
+
+	Toolkit3DLibrary::SharedPeerConnectionFactory::Instance()->Shutdown();
+	rtc::CleanupSSL();
+
+	return 0;
+}
+#endif // HEADLESS_SESSIONS
+
 #else // TEST_RUNNER
 
 //--------------------------------------------------------------------------------------
@@ -331,7 +366,28 @@ int WINAPI wWinMain(
 	// Creates and initializes the video test runner library.
 	g_videoTestRunner = new VideoTestRunner(
 		g_deviceResources->GetD3DDevice(),
-		g_deviceResources->GetD3DDeviceContext()); 
+		g_deviceResources->GetD3DDeviceContext());
+
+	// Optional encoder calibration, results are cached per host and settings
+	// and applied by VideoHelper when the streaming build encodes at this
+	// resolution with the default nvEncConfig.json frame rate and bitrate.
+	if (lpCmdLine && wcsstr(lpCmdLine, L"-calibrate"))
+	{
+		CalibrationResult calibrationResult;
+		EncoderCalibrator calibrator(
+			g_deviceResources->GetD3DDevice(),
+			g_deviceResources->GetD3DDeviceContext());
+
+		if (calibrator.LoadOrCalibrate(CALIBRATION_CACHE_FILE, width, height, 60, 5500000,
+			CALIBRATION_LATENCY_BUDGET_MS, &calibrationResult))
+		{
+			char message[128];
+			sprintf_s(message, "Encoder calibrated for %ux%u: %s, rate control %d\n",
+				width, height, calibrationResult.encoderPreset, calibrationResult.rcMode);
+
+			OutputDebugStringA(message);
+		}
+	}
 
 	g_videoTestRunner->StartTestRunner(g_deviceResources->GetSwapChain());
 	
@@ -406,6 +462,10 @@ int WINAPI wWinMain(
 		}
 	}
 
+#ifdef HEADLESS_SESSIONS
+	return RunHeadlessSessions(server, port, heartbeat, HEADLESS_SESSIONS);
+#else // HEADLESS_SESSIONS
 	return InitWebRTC(server, port, heartbeat);
+#endif // HEADLESS_SESSIONS
 #endif // TEST_RUNNER
 }
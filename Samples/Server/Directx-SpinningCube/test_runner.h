@@ -1,2 +1,3 @@
 #pragma once
-#include "VideoTestRunner.h"
\ No newline at end of file
+#include "VideoTestRunner.h"
+#include "EncoderCalibrator.h"
\ No newline at end of file
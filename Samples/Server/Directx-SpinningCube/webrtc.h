@@ -8,9 +8,14 @@
 #include "conductor.h"
 #include "default_main_window.h"
 #include "flagdefs.h"
+#include "input_parser.h"
 #include "peer_connection_client.h"
+#include "pose_extrapolator.h"
+#include "session_manager.h"
+#include "shared_peer_connection_factory.h"
 #include "webrtc/base/checks.h"
 #include "webrtc/base/ssladapter.h"
+#include "webrtc/base/timeutils.h"
 #include "webrtc/base/win32socketinit.h"
 #include "webrtc/base/win32socketserver.h"
 
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+#include <map>
+#include <unordered_map>
+
+// Single threaded epoll loop with millisecond timers.
+//
+// Descriptors are registered edge triggered, handlers must read and write
+// until EAGAIN. A descriptor removed while events are being dispatched
+// doesn't get the events left in the batch, even if its number is reused.
+class EventLoop
+{
+public:
+	typedef std::function<void(uint32_t events)> IoHandler;
+	typedef std::function<void()> TimerHandler;
+
+	EventLoop();
+	~EventLoop();
+
+	bool is_valid() const { return epoll_fd_ >= 0; }
+
+	// Watches |fd| for |events| (EPOLLIN, EPOLLOUT...), EPOLLET is implied.
+	bool Add(int fd, uint32_t events, const IoHandler& handler);
+	void Remove(int fd);
+
+	// Returns the timer id, ids are never reused.
+	int64_t AddTimer(int64_t delay_ms, const TimerHandler& handler);
+	void CancelTimer(int64_t timer_id);
+
+	void Run();
+	void Stop() { running_ = false; }
+
+	static int64_t NowMs();
+	static int64_t NowUs();
+
+private:
+	struct Watch
+	{
+		uint32_t generation;
+		IoHandler handler;
+	};
+
+	struct Timer
+	{
+		int64_t id;
+		TimerHandler handler;
+	};
+
+	// Runs the expired timers, returns the epoll timeout until the next one.
+	int RunTimers();
+
+	int epoll_fd_;
+	bool running_;
+	uint32_t next_generation_;
+	int64_t next_timer_id_;
+	std::unordered_map<int, Watch> watches_;
+	std::multimap<int64_t, Timer> timers_;
+	std::unordered_map<int64_t, std::multimap<int64_t, Timer>::iterator> timer_ids_;
+};
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <string>
+
+// Request received by the signaling server.
+struct HttpRequest
+{
+	std::string method;
+	std::string path;
+	std::string query;
+	int minor_version;
+	bool keep_alive;
+	std::string body;
+
+	// Set for WebSocket upgrade requests.
+	bool upgrade_websocket;
+	std::string websocket_key;
+
+	// Returns the decoded value of |name| in the query string, or |fallback|.
+	std::string GetQueryParam(const char* name, const std::string& fallback = std::string()) const;
+	int GetQueryParamInt(const char* name, int fallback) const;
+};
+
+// Incremental parser of the requests at the front of a connection buffer.
+class HttpRequestParser
+{
+public:
+	enum Result
+	{
+		NEED_MORE_DATA,
+		COMPLETE,
+		PARSE_ERROR,
+	};
+
+	// Limits protecting the server from oversized requests.
+	static const size_t kMaxHeaderSize = 16 * 1024;
+	static const size_t kMaxBodySize = 1024 * 1024;
+
+	HttpRequestParser();
+
+	// Parses the request at the front of |data| and removes it once
+	// complete, pipelined requests are left in |data|.
+	Result Parse(std::string* data, HttpRequest* request);
+
+private:
+	bool ParseHead(const std::string& data, size_t head_length, HttpRequest* request);
+
+	// Where the search for the end of the headers resumes.
+	size_t scan_offset_;
+
+	// Set once the headers of the current request are parsed.
+	bool have_head_;
+	size_t head_length_;
+	size_t content_length_;
+	HttpRequest head_;
+};
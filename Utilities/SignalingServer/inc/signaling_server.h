@@ -0,0 +1,194 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "event_loop.h"
+#include "http_request.h"
+#include "websocket_codec.h"
+
+// Counters exposed by the /stats endpoint.
+struct SignalingServerStats
+{
+	int peers;
+	int connections;
+	int waiting;
+	int64_t sign_ins;
+
+	// Sign ins which got their previous peer id back.
+	int64_t resumes;
+	int64_t messages;
+	int64_t queued_messages;
+	int64_t rss_bytes;
+};
+
+// Signaling server speaking the protocol of PeerConnectionClient and the
+// WebClient:
+//
+//   /sign_in?peer_name=<name>   Pragma: <new id>, body "name,id,1" of every peer.
+//     [&peer_id=<id>]           Resumes the peer |id| if it still exists under
+//                               the same name, without notifying the others.
+//   /wait?peer_id=<id>          Hanging GET, answered with the next message
+//                               (Pragma: sender) or notification (Pragma: id).
+//   /message?peer_id=<id>&to=<id>  POST forwarded to the wait of |to|.
+//   /heartbeat?peer_id=<id>     Keeps the peer alive.
+//   /sign_out?peer_id=<id>
+//   /ws?peer_name=<name>        Same messages as WebSocket text frames
+//     [&peer_id=<id>]           "<peer id>\n<body>".
+//   /stats                      SignalingServerStats as JSON.
+//   /admin/drop?down_ms=<ms>    With Options::admin only. Closes every
+//     [&forget=1]               connection and stops listening for |ms|, to
+//                               test reconnects. |forget| also drops the
+//                               peers, like a restart.
+//
+// Every connection is non blocking on a single EventLoop, a parked wait
+// only costs its connection and peer entries.
+class SignalingServer
+{
+public:
+	struct Options
+	{
+		Options() : port(8888), heartbeat_timeout_ms(0), presence(true), admin(false) {}
+
+		int port;
+
+		// Peers that sent a heartbeat and then stay silent for longer are
+		// signed out, 0 disables the check.
+		int heartbeat_timeout_ms;
+
+		// Lists the peers at sign in and notifies every peer of sign ins and
+		// sign outs. Both are quadratic in the number of peers, turning them
+		// off isolates the cost of the hanging GETs and messages in load
+		// tests.
+		bool presence;
+
+		// Serves /admin/drop.
+		bool admin;
+	};
+
+	// Peers without a wait or WebSocket for this long are signed out, they
+	// can resume their id until then.
+	static const int64_t kPeerTimeoutMs = 30 * 1000;
+
+	// Messages queued for a peer that isn't waiting before the senders get
+	// 503 responses.
+	static const size_t kMaxQueuedBytes = 1024 * 1024;
+
+	SignalingServer(EventLoop* loop, const Options& options);
+	~SignalingServer();
+
+	bool Start();
+
+	SignalingServerStats GetStats() const;
+
+private:
+	struct Connection
+	{
+		Connection() : fd(-1), serial(0), peer_id(-1), parked(false), keep_alive(true),
+			close_after_write(false), closed(false), websocket(false) {}
+
+		int fd;
+
+		// Tells connections apart when a descriptor number is reused.
+		uint64_t serial;
+		std::string input;
+		std::string output;
+		HttpRequestParser parser;
+
+		// Peer whose wait is parked here, or owning the WebSocket.
+		int peer_id;
+		bool parked;
+
+		// Keep-alive of the request being answered.
+		bool keep_alive;
+		bool close_after_write;
+
+		// Set once CloseConnection() ran, the descriptor and the object are
+		// released by Reap() so that handlers up the stack stay valid.
+		bool closed;
+
+		bool websocket;
+		WebSocketCodec codec;
+	};
+
+	struct PendingMessage
+	{
+		int from_id;
+		std::string body;
+	};
+
+	struct Peer
+	{
+		Peer() : id(-1), wait_fd(-1), websocket_fd(-1), last_seen_ms(0), heartbeats(false), queued_bytes(0) {}
+
+		int id;
+		std::string name;
+		int wait_fd;
+		int websocket_fd;
+		int64_t last_seen_ms;
+		bool heartbeats;
+		std::deque<PendingMessage> queue;
+		size_t queued_bytes;
+	};
+
+	void OnAccept();
+	void OnConnectionEvent(int fd, uint32_t events);
+	void ProcessInput(Connection* connection);
+	void HandleRequest(Connection* connection, const HttpRequest& request);
+	void HandleSignIn(Connection* connection, const HttpRequest& request);
+	void HandleWait(Connection* connection, Peer* peer);
+	void HandleMessage(Connection* connection, const HttpRequest& request, Peer* peer);
+	void HandleSignOut(Connection* connection, Peer* peer);
+	void HandleStats(Connection* connection);
+	void HandleDrop(Connection* connection, const HttpRequest& request);
+	void HandleWebSocketUpgrade(Connection* connection, const HttpRequest& request);
+	void ProcessWebSocketInput(Connection* connection);
+
+	bool Listen();
+
+	Peer* AddPeer(const std::string& name);
+
+	// The peer of the "peer_id" query parameter when it has |name|, null
+	// otherwise.
+	Peer* FindResumablePeer(const HttpRequest& request, const std::string& name);
+	void RemovePeer(int peer_id);
+	std::string GetPeerList(const Peer& peer) const;
+
+	// Sends |body| from |from_id| to |peer|, now or at its next wait.
+	bool Deliver(Peer* peer, int from_id, const std::string& body);
+	void AnswerWait(Peer* peer);
+	void Broadcast(const Peer& peer, bool connected);
+
+	void SendResponse(Connection* connection, const char* status, const std::string& extra_headers,
+		const std::string& body);
+	void SendWebSocketMessage(Connection* connection, int peer_id, const std::string& body);
+	void Write(Connection* connection, const char* data, size_t length);
+	void Flush(Connection* connection);
+	void CloseConnection(int fd);
+	void Reap();
+
+	// Resumes the requests pipelined after a wait, from a fresh stack.
+	void ScheduleResume(Connection* connection);
+
+	void SweepPeers();
+
+	EventLoop* loop_;
+	Options options_;
+	int listen_fd_;
+	int next_peer_id_;
+	uint64_t next_serial_;
+	std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+	std::vector<std::unique_ptr<Connection>> closing_;
+	std::unordered_map<int, Peer> peers_;
+
+	int64_t sign_ins_;
+	int64_t resumes_;
+	int64_t messages_;
+	int64_t queued_messages_;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+// Server side of the RFC 6455 framing used by the WebSocket signaling
+// transport. Client frames must be masked, server frames never are.
+class WebSocketCodec
+{
+public:
+	enum Opcode
+	{
+		CONTINUATION = 0x0,
+		TEXT = 0x1,
+		BINARY = 0x2,
+		CLOSE = 0x8,
+		PING = 0x9,
+		PONG = 0xA,
+	};
+
+	enum Result
+	{
+		NEED_MORE_DATA,
+		COMPLETE,
+		PARSE_ERROR,
+	};
+
+	// Largest message accepted from a client.
+	static const size_t kMaxMessageSize = 1024 * 1024;
+
+	WebSocketCodec();
+
+	// Removes the next complete message from the front of |data|, data
+	// messages split in fragments are reassembled.
+	Result ReadMessage(std::string* data, Opcode* opcode, std::string* payload);
+
+	static void WriteFrame(Opcode opcode, const char* payload, size_t length, std::string* frame);
+
+	// Sec-WebSocket-Accept value answering the client |key|.
+	static std::string ComputeAccept(const std::string& key);
+
+private:
+	std::string message_;
+	Opcode message_opcode_;
+	bool in_message_;
+};
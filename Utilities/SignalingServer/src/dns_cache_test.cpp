@@ -0,0 +1,183 @@
+// Checks DnsCache: the hosts GetUriHost extracts from the signaling and ICE
+// server URIs, and the connection order of the cached addresses, with the
+// families interleaved and the one which last connected first. Built with
+// the stand-ins of test/, which let the test complete the resolutions.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "dns_cache.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	rtc::IPAddress Ip(const char* address)
+	{
+		rtc::IPAddress ip;
+		Check(rtc::IPFromString(address, &ip), "test address parses");
+		return ip;
+	}
+
+	std::string Join(const std::vector<rtc::IPAddress>& addresses)
+	{
+		std::string joined;
+		for (const rtc::IPAddress& address : addresses)
+		{
+			joined += (joined.empty() ? "" : " ") + address.ToString();
+		}
+
+		return joined;
+	}
+
+	// Resolves |host| to |addresses| and returns them in the order of the
+	// cache.
+	std::string Resolve(const std::string& host, const std::vector<rtc::IPAddress>& addresses)
+	{
+		std::string result;
+		DnsCache::Instance()->Resolve(host, [&result](int error, const std::vector<rtc::IPAddress>& sorted)
+		{
+			result = error == 0 ? Join(sorted) : "error";
+		});
+
+		rtc::AsyncResolver::started().back()->Complete(0, addresses);
+		return result;
+	}
+
+	std::string Lookup(const std::string& host)
+	{
+		std::vector<rtc::IPAddress> addresses;
+		int error = 0;
+		if (!DnsCache::Instance()->Lookup(host, &addresses, &error))
+		{
+			return "miss";
+		}
+
+		return error == 0 ? Join(addresses) : "error";
+	}
+
+	void TestUriHost()
+	{
+		Check(DnsCache::GetUriHost("turns:turn.example.com:443") == "turn.example.com", "ICE URI with port");
+		Check(DnsCache::GetUriHost("https://user@turn.example.com/path") == "turn.example.com",
+			"URL with user and path");
+		Check(DnsCache::GetUriHost("turn:user@turn.example.com:3478?transport=tcp") == "turn.example.com",
+			"ICE URI with user and query");
+		Check(DnsCache::GetUriHost("STUN:Stun.Example.COM") == "stun.example.com", "host lowercased");
+		Check(DnsCache::GetUriHost("http://signaling.example.com#fragment") == "signaling.example.com",
+			"URL with fragment");
+
+		// The signaling server is configured without a scheme.
+		Check(DnsCache::GetUriHost("signaling.example.com") == "signaling.example.com", "bare host");
+		Check(DnsCache::GetUriHost("signaling.example.com:8888") == "signaling.example.com",
+			"bare host with port");
+
+		// Nothing to resolve.
+		Check(DnsCache::GetUriHost("stun:10.0.0.1:3478").empty(), "IPv4 literal");
+		Check(DnsCache::GetUriHost("http://192.168.1.2").empty(), "IPv4 literal URL");
+		Check(DnsCache::GetUriHost("turn:[2001:db8::1]:3478").empty(), "IPv6 literal");
+		Check(DnsCache::GetUriHost("").empty() && DnsCache::GetUriHost("https://").empty() &&
+			DnsCache::GetUriHost("turn:").empty(), "no host");
+	}
+
+	void TestSortAddresses()
+	{
+		const rtc::IPAddress v4a = Ip("192.0.2.1");
+		const rtc::IPAddress v4b = Ip("192.0.2.2");
+		const rtc::IPAddress v4c = Ip("192.0.2.3");
+		const rtc::IPAddress v6a = Ip("2001:db8::1");
+		const rtc::IPAddress v6b = Ip("2001:db8::2");
+
+		// IPv6 first, the families alternate while both have addresses.
+		Check(Resolve("dual.example.com", { v4a, v4b, v4c, v6a }) ==
+			"2001:db8::1 192.0.2.1 192.0.2.2 192.0.2.3", "IPv6 first");
+		Check(Resolve("alternate.example.com", { v4a, v4b, v6a, v6b }) ==
+			"2001:db8::1 192.0.2.1 2001:db8::2 192.0.2.2", "families interleaved");
+		Check(Resolve("v4.example.com", { v4c, v4a, v4b }) == "192.0.2.3 192.0.2.1 192.0.2.2",
+			"single family keeps its order");
+
+		// The family which connected goes first, a failed one behind the
+		// other.
+		DnsCache* cache = DnsCache::Instance();
+		cache->ReportConnectResult("dual.example.com", v4a, true);
+		Check(Lookup("dual.example.com") == "192.0.2.1 2001:db8::1 192.0.2.2 192.0.2.3", "IPv4 connected");
+		cache->ReportConnectResult("DUAL.example.com", v4a, false);
+		Check(Lookup("dual.example.com") == "2001:db8::1 192.0.2.1 192.0.2.2 192.0.2.3", "IPv4 failed");
+
+		cache->ReportConnectResult("alternate.example.com", v6a, false);
+		Check(Lookup("alternate.example.com") == "192.0.2.1 2001:db8::1 192.0.2.2 2001:db8::2",
+			"IPv6 failed before any success");
+
+		// A failure of the other family doesn't change the preference.
+		cache->ReportConnectResult("alternate.example.com", v6b, false);
+		Check(Lookup("alternate.example.com") == "192.0.2.1 2001:db8::1 192.0.2.2 2001:db8::2",
+			"preference kept");
+
+		// The preference outlives a refresh of the addresses.
+		Check(Resolve("alternate.example.com", { v6a, v4b, v6b, v4a }) ==
+			"192.0.2.2 2001:db8::1 192.0.2.1 2001:db8::2", "preference applied to new addresses");
+	}
+
+	void TestSharedResolution()
+	{
+		DnsCache* cache = DnsCache::Instance();
+		const int resolutions = cache->GetStats().resolutions;
+
+		int calls = 0;
+		DnsCallback callback = [&calls](int error, const std::vector<rtc::IPAddress>& addresses)
+		{
+			calls += error == 0 && addresses.size() == 1;
+		};
+
+		cache->Resolve("shared.example.com", callback);
+		cache->Resolve("Shared.Example.com", callback);
+		int cancelled = cache->Resolve("shared.example.com", callback);
+		cache->Cancel(cancelled);
+		Check(cache->GetStats().resolutions == resolutions + 1 && rtc::AsyncResolver::started().size() == 1,
+			"one resolution per host");
+
+		rtc::AsyncResolver::started().back()->Complete(0, { Ip("198.51.100.7") });
+		Check(calls == 2 && rtc::AsyncResolver::started().empty(), "every request answered once");
+		Check(Lookup("shared.example.com") == "198.51.100.7", "result cached");
+
+		// Failures are cached too.
+		std::string result;
+		cache->Resolve("missing.example.com", [&result](int error, const std::vector<rtc::IPAddress>&)
+		{
+			result = error != 0 ? "error" : "resolved";
+		});
+
+		rtc::AsyncResolver::started().back()->Complete(0, std::vector<rtc::IPAddress>());
+		Check(result == "error" && Lookup("missing.example.com") == "error" &&
+			cache->GetStats().negative_hits == 1, "failure cached");
+		Check(Lookup("unknown.example.com") == "miss", "unknown host");
+	}
+}
+
+int main()
+{
+	TestUriHost();
+	TestSortAddresses();
+	TestSharedResolution();
+
+	if (failures)
+	{
+		fprintf(stderr, "dns_cache_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("dns_cache_test: passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,164 @@
+#include "event_loop.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace
+{
+	// Events handled per epoll_wait call.
+	const int kMaxEvents = 256;
+
+	uint64_t PackEventData(int fd, uint32_t generation)
+	{
+		return (static_cast<uint64_t>(generation) << 32) | static_cast<uint32_t>(fd);
+	}
+}
+
+EventLoop::EventLoop() :
+	epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+	running_(false),
+	next_generation_(1),
+	next_timer_id_(1)
+{
+	if (epoll_fd_ < 0)
+	{
+		fprintf(stderr, "epoll_create1 failed: %s\n", strerror(errno));
+	}
+}
+
+EventLoop::~EventLoop()
+{
+	if (epoll_fd_ >= 0)
+	{
+		close(epoll_fd_);
+	}
+}
+
+bool EventLoop::Add(int fd, uint32_t events, const IoHandler& handler)
+{
+	Watch watch;
+	watch.generation = next_generation_++;
+	watch.handler = handler;
+
+	epoll_event event;
+	memset(&event, 0, sizeof(event));
+	event.events = events | EPOLLET;
+	event.data.u64 = PackEventData(fd, watch.generation);
+	if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0)
+	{
+		fprintf(stderr, "epoll_ctl(ADD, %d) failed: %s\n", fd, strerror(errno));
+		return false;
+	}
+
+	watches_[fd] = watch;
+	return true;
+}
+
+void EventLoop::Remove(int fd)
+{
+	if (watches_.erase(fd) > 0)
+	{
+		epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+	}
+}
+
+int64_t EventLoop::AddTimer(int64_t delay_ms, const TimerHandler& handler)
+{
+	Timer timer;
+	timer.id = next_timer_id_++;
+	timer.handler = handler;
+
+	auto it = timers_.insert(std::make_pair(NowMs() + delay_ms, timer));
+	timer_ids_[timer.id] = it;
+	return timer.id;
+}
+
+void EventLoop::CancelTimer(int64_t timer_id)
+{
+	auto it = timer_ids_.find(timer_id);
+	if (it != timer_ids_.end())
+	{
+		timers_.erase(it->second);
+		timer_ids_.erase(it);
+	}
+}
+
+void EventLoop::Run()
+{
+	epoll_event events[kMaxEvents];
+	running_ = true;
+	while (running_)
+	{
+		int timeout = RunTimers();
+		if (!running_)
+		{
+			break;
+		}
+
+		int count = epoll_wait(epoll_fd_, events, kMaxEvents, timeout);
+		if (count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+
+			fprintf(stderr, "epoll_wait failed: %s\n", strerror(errno));
+			break;
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			int fd = static_cast<int>(events[i].data.u64 & 0xFFFFFFFF);
+			uint32_t generation = static_cast<uint32_t>(events[i].data.u64 >> 32);
+
+			// Skips descriptors closed, or closed and reopened, by a previous
+			// handler of this batch.
+			auto it = watches_.find(fd);
+			if (it == watches_.end() || it->second.generation != generation)
+			{
+				continue;
+			}
+
+			// The handler may remove itself.
+			IoHandler handler = it->second.handler;
+			handler(events[i].events);
+		}
+	}
+}
+
+int EventLoop::RunTimers()
+{
+	int64_t now = NowMs();
+	while (!timers_.empty() && timers_.begin()->first <= now)
+	{
+		Timer timer = timers_.begin()->second;
+		timer_ids_.erase(timer.id);
+		timers_.erase(timers_.begin());
+		timer.handler();
+	}
+
+	if (timers_.empty())
+	{
+		return -1;
+	}
+
+	int64_t timeout = timers_.begin()->first - NowMs();
+	return timeout < 0 ? 0 : static_cast<int>(timeout);
+}
+
+int64_t EventLoop::NowMs()
+{
+	return NowUs() / 1000;
+}
+
+int64_t EventLoop::NowUs()
+{
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+}
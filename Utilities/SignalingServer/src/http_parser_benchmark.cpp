@@ -0,0 +1,369 @@
+// Compares HttpResponseParser with the find() and atoi() header scraping
+// PeerConnectionClient did before, on the responses of the signaling server:
+// the sign in with its peer list, a relayed session description and a
+// chunked body. Every sample is parsed at each split point first, the result
+// must not depend on how the bytes arrive.
+//
+// --fuzz feeds it mutated responses instead: truncated, with flipped,
+// inserted or deleted bytes, parsed in two reads at a random split point.
+// Each one is copied to a buffer of its exact size, build with
+// -fsanitize=address to catch reads past the end.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "http_response_parser.h"
+
+namespace
+{
+	const char kCommonHeaders[] =
+		"Server: SignalingServer\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Content-Type: text/plain\r\n"
+		"Access-Control-Allow-Origin: *\r\n"
+		"Access-Control-Expose-Headers: Pragma, X-Message-Batching\r\n";
+
+	// A response as SignalingServer::SendResponse writes it.
+	std::string WriteResponse(const char* status, const std::string& extra_headers,
+		const std::string& body)
+	{
+		return std::string("HTTP/1.1 ") + status + "\r\n" + kCommonHeaders +
+			"Connection: keep-alive\r\n" + "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+			extra_headers + "\r\n" + body;
+	}
+
+	std::string WriteChunked(const std::string& body, size_t chunk_size)
+	{
+		std::string response = std::string("HTTP/1.1 200 OK\r\n") + kCommonHeaders +
+			"Pragma: 7\r\nTransfer-Encoding: chunked\r\n\r\n";
+
+		char size[32];
+		for (size_t i = 0; i < body.size(); i += chunk_size)
+		{
+			std::string chunk = body.substr(i, chunk_size);
+			snprintf(size, sizeof(size), "%zx\r\n", chunk.size());
+			response += size + chunk + "\r\n";
+		}
+
+		return response + "0\r\n\r\n";
+	}
+
+	struct Sample
+	{
+		const char* name;
+		std::string response;
+		std::string body;
+		int64_t pragma;
+	};
+
+	std::vector<Sample> CreateSamples()
+	{
+		std::vector<Sample> samples;
+
+		std::string peers;
+		for (int i = 1; i <= 40; ++i)
+		{
+			peers += "renderingserver_" + std::to_string(i) + "@host," + std::to_string(i) + ",1\n";
+		}
+
+		samples.push_back({ "sign_in", WriteResponse("200 Added", "Pragma: 41\r\nX-Message-Batching: 1\r\n",
+			peers), peers, 41 });
+
+		std::string sdp = "{\"sdp\":\"v=0\\r\\no=- 4611731400430051336 2 IN IP4 127.0.0.1\\r\\n";
+		for (int i = 0; i < 60; ++i)
+		{
+			sdp += "a=rtcp-fb:" + std::to_string(96 + i % 8) + " goog-remb\\r\\n";
+		}
+
+		sdp += "\",\"type\":\"offer\"}";
+		samples.push_back({ "wait (offer)", WriteResponse("200 OK", "Pragma: 3\r\n", sdp), sdp, 3 });
+
+		samples.push_back({ "wait (chunked)", WriteChunked(sdp, 256), sdp, 7 });
+		return samples;
+	}
+
+	// The GetHeaderValue and ReadIntoBuffer code PeerConnectionClient used,
+	// returning the body size of a complete response.
+	size_t LegacyParse(const std::string& data)
+	{
+		size_t eoh = data.find("\r\n\r\n");
+		if (eoh == std::string::npos)
+		{
+			return 0;
+		}
+
+		const char kContentLength[] = "\r\nContent-Length: ";
+		size_t found = data.find(kContentLength);
+		if (found == std::string::npos || found >= eoh)
+		{
+			return 0;
+		}
+
+		size_t content_length = atoi(&data[found + strlen(kContentLength)]);
+		if (data.length() < eoh + 4 + content_length)
+		{
+			return 0;
+		}
+
+		size_t peer_id = 0;
+		const char kPragma[] = "\r\nPragma: ";
+		found = data.find(kPragma);
+		if (found != std::string::npos && found < eoh)
+		{
+			peer_id = atoi(&data[found + strlen(kPragma)]);
+		}
+
+		std::string should_close;
+		const char kConnection[] = "\r\nConnection: ";
+		found = data.find(kConnection);
+		if (found != std::string::npos && found < eoh)
+		{
+			size_t begin = found + strlen(kConnection);
+			should_close = data.substr(begin, data.find("\r\n", begin) - begin);
+		}
+
+		std::string body = data.substr(eoh + 4, content_length);
+		return body.size() + peer_id + (should_close == "close");
+	}
+
+	// Parses |response| as received in |segment| bytes reads, from a buffer
+	// the reads are appended to like the client's.
+	HttpResponseParser::Result Parse(const std::string& response, size_t segment,
+		std::string* buffer, HttpResponseParser* parser)
+	{
+		buffer->clear();
+		parser->Reset();
+
+		HttpResponseParser::Result result = HttpResponseParser::NEED_MORE_DATA;
+		for (size_t i = 0; i < response.size() && result == HttpResponseParser::NEED_MORE_DATA; i += segment)
+		{
+			buffer->append(response, i, segment);
+			result = parser->Parse(&(*buffer)[0], buffer->size());
+		}
+
+		return result;
+	}
+
+	bool Check(const Sample& sample)
+	{
+		std::string buffer;
+		HttpResponseParser parser;
+		for (size_t segment = 1; segment <= sample.response.size(); ++segment)
+		{
+			int64_t pragma = -1;
+			if (Parse(sample.response, segment, &buffer, &parser) != HttpResponseParser::COMPLETE ||
+				parser.status_code() != 200 || !parser.keep_alive() ||
+				parser.consumed() != sample.response.size() ||
+				!parser.GetHeaderInt(buffer.data(), "pragma", &pragma) || pragma != sample.pragma ||
+				buffer.compare(parser.body().offset, parser.body().length, sample.body) != 0)
+			{
+				fprintf(stderr, "%s: mismatch with %zu bytes reads\n", sample.name, segment);
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// Runs |operation| |iterations| times and prints the time per call.
+	void Measure(const char* name, int iterations, const std::function<size_t()>& operation)
+	{
+		size_t sink = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			sink += operation();
+		}
+
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+		printf("  %-36s %10.0f ns  (%zu)\n", name, ns, sink / iterations);
+	}
+
+	void Benchmark(int iterations)
+	{
+		std::string buffer;
+		HttpResponseParser parser;
+		for (const Sample& sample : CreateSamples())
+		{
+			if (!Check(sample))
+			{
+				exit(1);
+			}
+
+			printf("%s, %zu bytes, %zu bytes body\n", sample.name, sample.response.size(),
+				sample.body.size());
+
+			// The chunked sample is the only one the old code couldn't read.
+			if (sample.response.find("chunked") == std::string::npos)
+			{
+				Measure("find() + atoi() (one read)", iterations, [&sample]()
+				{
+					return LegacyParse(sample.response);
+				});
+
+				// Rescans the whole buffer after every read, as the old code did.
+				Measure("find() + atoi() (536 bytes reads)", iterations, [&]()
+				{
+					size_t result = 0;
+					buffer.clear();
+					for (size_t i = 0; i < sample.response.size() && !result; i += 536)
+					{
+						buffer.append(sample.response, i, 536);
+						result = LegacyParse(buffer);
+					}
+
+					return result;
+				});
+			}
+
+			Measure("HttpResponseParser (one read)", iterations, [&]()
+			{
+				Parse(sample.response, sample.response.size(), &buffer, &parser);
+				return parser.body().length;
+			});
+
+			Measure("HttpResponseParser (536 bytes reads)", iterations, [&]()
+			{
+				Parse(sample.response, 536, &buffer, &parser);
+				return parser.body().length;
+			});
+		}
+	}
+
+	std::string Mutate(const std::string& input, std::mt19937* random)
+	{
+		std::string output = input;
+		std::uniform_int_distribution<int> mutations(1, 4);
+		for (int i = mutations(*random); i > 0; --i)
+		{
+			std::uniform_int_distribution<size_t> position(0, output.empty() ? 0 : output.size() - 1);
+			std::uniform_int_distribution<int> byte(0, 255);
+			switch (std::uniform_int_distribution<int>(0, 3)(*random))
+			{
+			case 0:
+				output.resize(position(*random));
+				break;
+
+			case 1:
+				if (!output.empty())
+				{
+					output[position(*random)] = static_cast<char>(byte(*random));
+				}
+
+				break;
+
+			case 2:
+				output.insert(position(*random), 1, "\r\n :;,-0123456789abcdef"[byte(*random) % 23]);
+				break;
+
+			case 3:
+				if (!output.empty())
+				{
+					output.erase(position(*random), 1);
+				}
+
+				break;
+			}
+		}
+
+		return output;
+	}
+
+	int Fuzz(int iterations)
+	{
+		std::vector<std::string> corpus;
+		for (const Sample& sample : CreateSamples())
+		{
+			corpus.push_back(sample.response);
+		}
+
+		corpus.push_back(WriteResponse("500 Internal Server Error", "", "Peer most likely gone."));
+		corpus.push_back("HTTP/1.0 200 OK\r\nPragma: 2\r\n\r\nclose delimited");
+		corpus.push_back(WriteChunked("5\r\nnested", 3) + WriteResponse("200 OK", "Pragma: 1\r\n", "next"));
+
+		std::mt19937 random(12345);
+		int complete = 0;
+		int errors = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			std::string input = Mutate(corpus[i % corpus.size()], &random);
+
+			// Exactly sized, so the sanitizers see any read past the end.
+			std::unique_ptr<char[]> buffer(new char[input.size() ? input.size() : 1]);
+			memcpy(buffer.get(), input.data(), input.size());
+
+			size_t split = std::uniform_int_distribution<size_t>(0, input.size())(random);
+			HttpResponseParser parser;
+			HttpResponseParser::Result result = parser.Parse(buffer.get(), split);
+			if (result == HttpResponseParser::NEED_MORE_DATA)
+			{
+				result = parser.Parse(buffer.get(), input.size());
+			}
+
+			if (result == HttpResponseParser::NEED_MORE_DATA)
+			{
+				result = parser.Finish();
+			}
+
+			if (result == HttpResponseParser::COMPLETE)
+			{
+				HttpSpan body = parser.body();
+				if (parser.consumed() > input.size() || body.offset + body.length > input.size())
+				{
+					fprintf(stderr, "span past the end of the input %d\n", i);
+					return 1;
+				}
+
+				HttpSpan value;
+				parser.GetHeader(buffer.get(), "pragma", &value);
+				complete++;
+			}
+			else if (result == HttpResponseParser::PARSE_ERROR)
+			{
+				errors++;
+			}
+		}
+
+		printf("%d mutated responses, %d complete, %d rejected\n", iterations, complete, errors);
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = 20000;
+	bool fuzz = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+		{
+			iterations = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--fuzz") == 0)
+		{
+			fuzz = true;
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [--iterations <count>] [--fuzz]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (fuzz)
+	{
+		return Fuzz(iterations);
+	}
+
+	Benchmark(iterations);
+	return 0;
+}
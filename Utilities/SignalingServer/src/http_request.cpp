@@ -0,0 +1,288 @@
+#include "http_request.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+	char ToLower(char c)
+	{
+		return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+	}
+
+	bool EqualsIgnoreCase(const char* data, size_t length, const char* value)
+	{
+		size_t i = 0;
+		for (; i < length && value[i] != '\0'; ++i)
+		{
+			if (ToLower(data[i]) != ToLower(value[i]))
+			{
+				return false;
+			}
+		}
+
+		return i == length && value[i] == '\0';
+	}
+
+	bool ContainsIgnoreCase(const std::string& value, const char* token)
+	{
+		size_t token_length = strlen(token);
+		for (size_t i = 0; i + token_length <= value.size(); ++i)
+		{
+			if (EqualsIgnoreCase(value.data() + i, token_length, token))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	std::string Trim(const char* begin, const char* end)
+	{
+		while (begin < end && (*begin == ' ' || *begin == '\t'))
+		{
+			begin++;
+		}
+
+		while (end > begin && (end[-1] == ' ' || end[-1] == '\t'))
+		{
+			end--;
+		}
+
+		return std::string(begin, end);
+	}
+
+	int HexValue(char c)
+	{
+		if (c >= '0' && c <= '9')
+		{
+			return c - '0';
+		}
+
+		c = ToLower(c);
+		return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+	}
+
+	// Decodes %XX escapes and '+' of a query string value.
+	std::string UrlDecode(const char* begin, const char* end)
+	{
+		std::string result;
+		result.reserve(end - begin);
+		for (const char* it = begin; it < end; ++it)
+		{
+			if (*it == '%' && end - it > 2 && HexValue(it[1]) >= 0 && HexValue(it[2]) >= 0)
+			{
+				result += static_cast<char>(HexValue(it[1]) * 16 + HexValue(it[2]));
+				it += 2;
+			}
+			else
+			{
+				result += (*it == '+') ? ' ' : *it;
+			}
+		}
+
+		return result;
+	}
+
+	// Parses a non negative decimal integer, rejecting any other character.
+	bool ParseSize(const std::string& value, size_t* result)
+	{
+		if (value.empty() || value.size() > 18)
+		{
+			return false;
+		}
+
+		uint64_t parsed = 0;
+		for (char c : value)
+		{
+			if (c < '0' || c > '9')
+			{
+				return false;
+			}
+
+			parsed = parsed * 10 + (c - '0');
+		}
+
+		*result = static_cast<size_t>(parsed);
+		return true;
+	}
+}
+
+std::string HttpRequest::GetQueryParam(const char* name, const std::string& fallback) const
+{
+	size_t name_length = strlen(name);
+	const char* pos = query.data();
+	const char* end = pos + query.size();
+	while (pos < end)
+	{
+		const char* amp = static_cast<const char*>(memchr(pos, '&', end - pos));
+		const char* param_end = amp ? amp : end;
+		const char* eq = static_cast<const char*>(memchr(pos, '=', param_end - pos));
+		const char* key_end = eq ? eq : param_end;
+		if (static_cast<size_t>(key_end - pos) == name_length && memcmp(pos, name, name_length) == 0)
+		{
+			return eq ? UrlDecode(eq + 1, param_end) : std::string();
+		}
+
+		pos = param_end + 1;
+	}
+
+	return fallback;
+}
+
+int HttpRequest::GetQueryParamInt(const char* name, int fallback) const
+{
+	size_t value = 0;
+	if (!ParseSize(GetQueryParam(name), &value) || value > INT32_MAX)
+	{
+		return fallback;
+	}
+
+	return static_cast<int>(value);
+}
+
+HttpRequestParser::HttpRequestParser() :
+	scan_offset_(0),
+	have_head_(false),
+	head_length_(0),
+	content_length_(0)
+{
+}
+
+HttpRequestParser::Result HttpRequestParser::Parse(std::string* data, HttpRequest* request)
+{
+	if (!have_head_)
+	{
+		// Only the bytes received since the previous call are searched.
+		size_t begin = scan_offset_ > 3 ? scan_offset_ - 3 : 0;
+		size_t end_of_head = data->find("\r\n\r\n", begin);
+		if (end_of_head == std::string::npos)
+		{
+			scan_offset_ = data->size();
+			return data->size() > kMaxHeaderSize ? PARSE_ERROR : NEED_MORE_DATA;
+		}
+
+		head_length_ = end_of_head + 4;
+		if (head_length_ > kMaxHeaderSize || !ParseHead(*data, end_of_head, &head_))
+		{
+			return PARSE_ERROR;
+		}
+
+		have_head_ = true;
+	}
+
+	if (data->size() < head_length_ + content_length_)
+	{
+		return NEED_MORE_DATA;
+	}
+
+	*request = head_;
+	request->body.assign(*data, head_length_, content_length_);
+	data->erase(0, head_length_ + content_length_);
+
+	scan_offset_ = 0;
+	have_head_ = false;
+	head_length_ = 0;
+	content_length_ = 0;
+	return COMPLETE;
+}
+
+bool HttpRequestParser::ParseHead(const std::string& data, size_t head_length, HttpRequest* request)
+{
+	*request = HttpRequest();
+	content_length_ = 0;
+
+	// "METHOD /path?query HTTP/1.x"
+	const char* pos = data.data();
+	const char* end = pos + head_length;
+	const char* eol = static_cast<const char*>(memchr(pos, '\r', end - pos));
+	const char* line_end = eol ? eol : end;
+
+	const char* space = static_cast<const char*>(memchr(pos, ' ', line_end - pos));
+	if (!space || space == pos)
+	{
+		return false;
+	}
+
+	request->method.assign(pos, space);
+	const char* target = space + 1;
+	space = static_cast<const char*>(memchr(target, ' ', line_end - target));
+	if (!space || space == target)
+	{
+		return false;
+	}
+
+	const char* question = static_cast<const char*>(memchr(target, '?', space - target));
+	request->path.assign(target, question ? question : space);
+	if (question)
+	{
+		request->query.assign(question + 1, space);
+	}
+
+	const char kVersionPrefix[] = "HTTP/1.";
+	const char* version = space + 1;
+	if (line_end - version != sizeof(kVersionPrefix) ||
+		memcmp(version, kVersionPrefix, sizeof(kVersionPrefix) - 1) != 0 ||
+		version[sizeof(kVersionPrefix) - 1] < '0' || version[sizeof(kVersionPrefix) - 1] > '9')
+	{
+		return false;
+	}
+
+	request->minor_version = version[sizeof(kVersionPrefix) - 1] - '0';
+	bool connection_close = false;
+	bool connection_keep_alive = false;
+	bool connection_upgrade = false;
+	std::string upgrade;
+
+	pos = eol ? eol + 2 : end;
+	while (pos < end)
+	{
+		eol = static_cast<const char*>(memchr(pos, '\r', end - pos));
+		line_end = eol ? eol : end;
+		const char* colon = static_cast<const char*>(memchr(pos, ':', line_end - pos));
+		if (!colon || colon == pos)
+		{
+			return false;
+		}
+
+		std::string value = Trim(colon + 1, line_end);
+		size_t name_length = colon - pos;
+		if (EqualsIgnoreCase(pos, name_length, "Content-Length"))
+		{
+			if (!ParseSize(value, &content_length_) || content_length_ > kMaxBodySize)
+			{
+				return false;
+			}
+		}
+		else if (EqualsIgnoreCase(pos, name_length, "Transfer-Encoding"))
+		{
+			// Our clients always send a Content-Length.
+			return false;
+		}
+		else if (EqualsIgnoreCase(pos, name_length, "Connection"))
+		{
+			connection_close |= ContainsIgnoreCase(value, "close");
+			connection_keep_alive |= ContainsIgnoreCase(value, "keep-alive");
+			connection_upgrade |= ContainsIgnoreCase(value, "upgrade");
+		}
+		else if (EqualsIgnoreCase(pos, name_length, "Upgrade"))
+		{
+			upgrade = value;
+		}
+		else if (EqualsIgnoreCase(pos, name_length, "Sec-WebSocket-Key"))
+		{
+			request->websocket_key = value;
+		}
+
+		pos = eol ? eol + 2 : end;
+	}
+
+	request->keep_alive = request->minor_version >= 1 ? !connection_close : connection_keep_alive;
+	request->upgrade_websocket = connection_upgrade &&
+		EqualsIgnoreCase(upgrade.data(), upgrade.size(), "websocket") &&
+		!request->websocket_key.empty();
+
+	return true;
+}
@@ -0,0 +1,356 @@
+// Compares InputParser with the Json::Reader, strcpy and istringstream
+// parsing the server samples used before, on the input messages of the
+// clients in both encodings.
+//
+// --fuzz feeds it mutated messages instead: truncated, with flipped,
+// inserted or deleted bytes. Each one is copied to a buffer of its exact
+// size, build with -fsanitize=address to catch reads past the end.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <json/json.h>
+
+#include "input_message.h"
+#include "input_parser.h"
+
+namespace
+{
+	// Sums what it receives so the calls can't be optimized away.
+	class SummingHandler : public InputHandler
+	{
+	public:
+		SummingHandler() : sum(0), calls(0) {}
+
+		void OnStereoRendering(bool stereo) override
+		{
+			Add(stereo ? 1.f : 0.f);
+		}
+
+		void OnCameraLookAt(const float eye[3], const float focus[3], const float up[3]) override
+		{
+			Add(eye, 3);
+			Add(focus, 3);
+			Add(up, 3);
+		}
+
+		void OnCameraTransform(const float transform[6]) override
+		{
+			Add(transform, 6);
+		}
+
+		void OnCameraStereo(const float left[16], const float right[16], int64_t) override
+		{
+			Add(left, 16);
+			Add(right, 16);
+		}
+
+		void OnKeyboardEvent(uint32_t message, uint32_t wparam) override
+		{
+			Add(static_cast<float>(message + wparam));
+		}
+
+		void OnMouseEvent(uint32_t message, uint32_t wparam, int32_t lparam) override
+		{
+			Add(static_cast<float>(message + wparam + lparam));
+		}
+
+		double sum;
+		int calls;
+
+	private:
+		void Add(float value)
+		{
+			sum += value;
+			calls++;
+		}
+
+		void Add(const float* values, int count)
+		{
+			for (int i = 0; i < count; ++i)
+			{
+				sum += values[i];
+			}
+
+			calls++;
+		}
+	};
+
+	// The InputUpdate of the server samples, minus the rendering.
+	size_t LegacyParse(const std::string& message)
+	{
+		char type[256];
+		char body[1024];
+		Json::Reader reader;
+		Json::Value msg = Json::nullValue;
+		reader.parse(message, msg, false);
+
+		size_t count = 0;
+		if (msg.isMember("type") && msg.isMember("body"))
+		{
+			strcpy(type, msg.get("type", "").asCString());
+			strcpy(body, msg.get("body", "").asCString());
+			std::istringstream datastream(body);
+			std::string token;
+
+			int values = strcmp(type, "camera-transform-lookat") == 0 ? 9 :
+				strcmp(type, "camera-transform-stereo") == 0 ? 32 : 0;
+
+			for (int i = 0; i < values; i++)
+			{
+				getline(datastream, token, ',');
+				count += stof(token) != 0;
+			}
+		}
+
+		return count;
+	}
+
+	std::string WriteJson(const char* type, const std::string& body)
+	{
+		Json::StyledWriter writer;
+		Json::Value jmessage;
+		jmessage["type"] = type;
+		jmessage["body"] = body;
+		return writer.write(jmessage);
+	}
+
+	std::string FormatFloats(const float* values, int count)
+	{
+		std::string body;
+		char buffer[32];
+		for (int i = 0; i < count; ++i)
+		{
+			snprintf(buffer, sizeof(buffer), i == 0 ? "%f" : ", %f", values[i]);
+			body += buffer;
+		}
+
+		return body;
+	}
+
+	struct Sample
+	{
+		const char* name;
+		std::string json;
+		std::string binary;
+		std::vector<float> values;
+	};
+
+	std::vector<Sample> CreateSamples()
+	{
+		std::vector<Sample> samples;
+
+		const float look_at[] = { 0.f, 0.7f, 1.5f, 0.f, -0.1f, 0.f, 0.f, 1.f, 0.f };
+		samples.push_back({ "camera-transform-lookat", WriteJson("camera-transform-lookat",
+			FormatFloats(look_at, 9)), InputMessageCodec::WriteCameraLookAt(&look_at[0], &look_at[3],
+			&look_at[6]), std::vector<float>(look_at, look_at + 9) });
+
+		float stereo[32];
+		for (int i = 0; i < 32; ++i)
+		{
+			stereo[i] = (i % 5 == 0) ? 1.f : -0.0125f * (i + 1);
+		}
+
+		samples.push_back({ "camera-transform-stereo", WriteJson("camera-transform-stereo",
+			FormatFloats(stereo, 32)), InputMessageCodec::WriteCameraStereo(&stereo[0], &stereo[16]),
+			std::vector<float>(stereo, stereo + 32) });
+
+		Json::StyledWriter writer;
+		Json::Value mouse;
+		mouse["message"] = 0x200;
+		mouse["wParam"] = 1;
+		mouse["lParam"] = (300 << 16) | 640;
+		samples.push_back({ "mouse-event", WriteJson("mouse-event", writer.write(mouse)),
+			InputMessageCodec::WriteWindowEvent(InputMessage::MOUSE_EVENT, 0x200, 1, (300 << 16) | 640),
+			std::vector<float>() });
+
+		return samples;
+	}
+
+	// Runs |operation| |iterations| times and prints the time per call.
+	void Measure(const char* name, int iterations, const std::function<size_t()>& operation)
+	{
+		size_t sink = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			sink += operation();
+		}
+
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+		printf("  %-36s %10.0f ns  (%zu)\n", name, ns, sink / iterations);
+	}
+
+	// Both encodings decode to the values which were written, within the
+	// precision of the %f formatting.
+	bool Check(const Sample& sample)
+	{
+		InputMessage json;
+		InputMessage binary;
+		if (!InputParser::Parse(sample.json.data(), sample.json.size(), &json) ||
+			!InputParser::Parse(sample.binary.data(), sample.binary.size(), &binary) ||
+			json.type != binary.type || json.value_count != static_cast<int>(sample.values.size()) ||
+			binary.value_count != json.value_count || json.message != binary.message ||
+			json.wparam != binary.wparam || json.lparam != binary.lparam)
+		{
+			return false;
+		}
+
+		for (size_t i = 0; i < sample.values.size(); ++i)
+		{
+			if (binary.values[i] != sample.values[i] || fabsf(json.values[i] - sample.values[i]) > 1e-6f)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	void Benchmark(int iterations)
+	{
+		for (const Sample& sample : CreateSamples())
+		{
+			if (!Check(sample))
+			{
+				fprintf(stderr, "%s: parsed values don't match\n", sample.name);
+				exit(1);
+			}
+
+			printf("%s, %zu bytes styled, %zu bytes binary\n", sample.name, sample.json.size(),
+				sample.binary.size());
+
+			if (!sample.values.empty())
+			{
+				Measure("Json::Reader + istringstream", iterations, [&sample]()
+				{
+					return LegacyParse(sample.json);
+				});
+			}
+
+			Measure("InputParser (styled)", iterations, [&sample]()
+			{
+				SummingHandler handler;
+				InputParser::Dispatch(sample.json.data(), sample.json.size(), &handler);
+				return static_cast<size_t>(handler.calls);
+			});
+
+			Measure("InputParser (binary)", iterations, [&sample]()
+			{
+				SummingHandler handler;
+				InputParser::Dispatch(sample.binary.data(), sample.binary.size(), &handler);
+				return static_cast<size_t>(handler.calls);
+			});
+		}
+	}
+
+	std::string Mutate(const std::string& input, std::mt19937* random)
+	{
+		std::string output = input;
+		std::uniform_int_distribution<int> mutations(1, 4);
+		for (int i = mutations(*random); i > 0; --i)
+		{
+			std::uniform_int_distribution<size_t> position(0, output.empty() ? 0 : output.size() - 1);
+			std::uniform_int_distribution<int> byte(0, 255);
+			switch (std::uniform_int_distribution<int>(0, 3)(*random))
+			{
+			case 0:
+				output.resize(position(*random));
+				break;
+
+			case 1:
+				if (!output.empty())
+				{
+					output[position(*random)] = static_cast<char>(byte(*random));
+				}
+
+				break;
+
+			case 2:
+				output.insert(position(*random), 1, "\"\\,:{}-.e0123456789 "[byte(*random) % 20]);
+				break;
+
+			case 3:
+				if (!output.empty())
+				{
+					output.erase(position(*random), 1);
+				}
+
+				break;
+			}
+		}
+
+		return output;
+	}
+
+	int Fuzz(int iterations)
+	{
+		std::vector<std::string> corpus;
+		for (const Sample& sample : CreateSamples())
+		{
+			corpus.push_back(sample.json);
+			corpus.push_back(sample.binary);
+		}
+
+		corpus.push_back(WriteJson("stereo-rendering", "1"));
+		corpus.push_back("{\"type\":\"camera-transform\",\"body\":\"1e3,-2.5E-2,+3,.5,0,1e-40\"}");
+
+		std::mt19937 random(12345);
+		int accepted = 0;
+		for (int i = 0; i < iterations; ++i)
+		{
+			std::string input = Mutate(corpus[i % corpus.size()], &random);
+
+			// Exactly sized, so the sanitizers see any read past the end.
+			std::unique_ptr<char[]> buffer(new char[input.size() ? input.size() : 1]);
+			memcpy(buffer.get(), input.data(), input.size());
+
+			SummingHandler handler;
+			accepted += InputParser::Dispatch(buffer.get(), input.size(), &handler);
+		}
+
+		printf("%d mutated messages, %d accepted\n", iterations, accepted);
+		return 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = 20000;
+	bool fuzz = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--iterations") == 0 && i + 1 < argc)
+		{
+			iterations = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--fuzz") == 0)
+		{
+			fuzz = true;
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [--iterations <count>] [--fuzz]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (fuzz)
+	{
+		return Fuzz(iterations);
+	}
+
+	Benchmark(iterations);
+	return 0;
+}
@@ -0,0 +1,108 @@
+// Checks the send schedule of InputCoalescer, which the client's data
+// channel handler follows for the camera and mouse updates.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "input_coalescer.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	void TestInterval()
+	{
+		InputCoalescer coalescer;
+		Check(coalescer.stats().interval_ms == 16, "one server frame at 60 fps");
+
+		coalescer.SetFrameRate(30);
+		Check(coalescer.stats().interval_ms == 33, "one server frame at 30 fps");
+
+		// A quarter of the round trip time on slow links, up to 100 ms.
+		coalescer.SetRoundTripTimeMs(100);
+		Check(coalescer.stats().interval_ms == 33, "fast link");
+		coalescer.SetRoundTripTimeMs(200);
+		Check(coalescer.stats().interval_ms == 50, "slow link");
+		coalescer.SetRoundTripTimeMs(1000);
+		Check(coalescer.stats().interval_ms == 100, "interval capped");
+
+		coalescer.SetFrameRate(0);
+		coalescer.SetRoundTripTimeMs(-1);
+		Check(coalescer.stats().interval_ms == 16, "defaults restored");
+	}
+
+	void TestSchedule()
+	{
+		InputCoalescer coalescer;
+		std::vector<std::string> messages;
+		Check(coalescer.NextFlushMs() == -1, "nothing pending");
+
+		// Idle until now, sent right away.
+		coalescer.Update(InputMessage::CAMERA_TRANSFORM, "camera 0");
+		Check(coalescer.NextFlushMs() == 0, "first update due");
+		coalescer.Flush(1000, &messages);
+		Check(messages.size() == 1 && messages[0] == "camera 0", "first update sent");
+		Check(coalescer.NextFlushMs() == -1, "nothing pending after the flush");
+
+		// The following ones once per interval, the latest value of each
+		// type.
+		messages.clear();
+		coalescer.Update(InputMessage::CAMERA_TRANSFORM, "camera 1");
+		coalescer.Update(InputMessage::MOUSE_EVENT, "mouse 1");
+		coalescer.Update(InputMessage::CAMERA_TRANSFORM, "camera 2");
+		coalescer.Update(InputMessage::CAMERA_TRANSFORM, "camera 3");
+		Check(coalescer.NextFlushMs() == 1016, "due after the interval");
+		coalescer.Flush(1015, &messages);
+		Check(messages.empty(), "not due yet");
+		coalescer.Flush(1016, &messages);
+		Check(messages.size() == 2 && messages[0] == "camera 3" && messages[1] == "mouse 1",
+			"latest values sent");
+		Check(coalescer.stats().updates == 5 && coalescer.stats().sent == 3, "coalesced values counted");
+
+		// A flush a little late keeps the schedule.
+		messages.clear();
+		coalescer.Update(InputMessage::CAMERA_TRANSFORM, "camera 4");
+		coalescer.Flush(1035, &messages);
+		coalescer.Update(InputMessage::CAMERA_TRANSFORM, "camera 5");
+		Check(messages.size() == 1 && coalescer.NextFlushMs() == 1048, "schedule kept");
+
+		// A longer gap restarts it.
+		coalescer.Flush(1100, &messages);
+		coalescer.Update(InputMessage::CAMERA_TRANSFORM, "camera 6");
+		Check(messages.size() == 2 && coalescer.NextFlushMs() == 1116, "schedule restarted");
+
+		// Before a discrete event, whatever the schedule.
+		coalescer.FlushNow(1105, &messages);
+		Check(messages.size() == 3 && messages[2] == "camera 6", "flushed before an event");
+		coalescer.FlushNow(1110, &messages);
+		coalescer.Update(InputMessage::CAMERA_TRANSFORM, "camera 7");
+		Check(messages.size() == 3 && coalescer.NextFlushMs() == 1121, "interval from the forced flush");
+	}
+}
+
+int main()
+{
+	TestInterval();
+	TestSchedule();
+
+	if (failures)
+	{
+		fprintf(stderr, "input_coalescer_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("input_coalescer_test: passed\n");
+	return EXIT_SUCCESS;
+}
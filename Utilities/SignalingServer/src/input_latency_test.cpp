@@ -0,0 +1,302 @@
+// Runs the input to photon measurement end to end on a simulated loopback
+// session: a scripted client sends camera input, the server queues it,
+// drains it once per synthetic frame and tags the delivered frames with
+// FrameInputTagger, and the client matches the "input-frame" messages with
+// the presented frames through InputLatencyTracker.
+//
+// The transport is modeled after WebRTC: the encoder drops some frames, the
+// RTP timestamps carry a random per-stream offset, and the receiver only
+// knows the capture NTP time of a frame from the RTCP sender reports, with
+// a millisecond of estimation error. Every latency component is fixed
+// except the wait for the next frame, so the measurement can be checked
+// exactly.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <functional>
+#include <map>
+#include <random>
+#include <string>
+
+#include "input_latency.h"
+#include "input_message.h"
+#include "input_queue.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	const int64_t kFramePeriodUs = 16667;
+	const int64_t kInputPeriodUs = 50000;
+	const int64_t kNetworkDelayUs = 20000;
+	const int64_t kEncodeUs = 5000;
+	const int64_t kDecodeUs = 3000;
+	const int64_t kPresentUs = 4000;
+	const int64_t kSenderReportPeriodUs = 500000;
+	const int64_t kDurationUs = 10000000;
+
+	// Everything after the capture except the presentation, the transport
+	// component of every measurement.
+	const int64_t kTransportUs = 2 * kNetworkDelayUs + kEncodeUs + kDecodeUs;
+
+	// The server clock, and its NTP clock, are unrelated to the client's.
+	const int64_t kServerClockOffsetUs = 7777777777;
+	const int64_t kNtpOffsetMs = 3700000000000;
+
+	void IgnoreInput(const std::string&)
+	{
+	}
+
+	// Events on the client clock.
+	class Simulation
+	{
+	public:
+		void Post(int64_t time_us, const std::function<void()>& event)
+		{
+			events_.insert(std::make_pair(time_us, event));
+		}
+
+		void Run(int64_t end_us)
+		{
+			while (!events_.empty() && events_.begin()->first < end_us)
+			{
+				auto event = events_.begin();
+				now_us_ = event->first;
+				std::function<void()> run = event->second;
+				events_.erase(event);
+				run();
+			}
+		}
+
+		int64_t now_us() const { return now_us_; }
+
+	private:
+		std::multimap<int64_t, std::function<void()>> events_;
+		int64_t now_us_ = 0;
+	};
+
+	struct Loopback
+	{
+		Simulation simulation;
+		std::mt19937 random{ 46 };
+
+		// Server.
+		InputQueue input_queue;
+		FrameInputTagger tagger;
+		uint32_t rtp_offset = 0;
+		int frames = 0;
+		int tags = 0;
+		int legacy_matches = 0;
+
+		// Client.
+		InputLatencyTracker tracker;
+		bool has_sender_report = false;
+		int64_t report_ntp_ms = 0;
+		uint32_t report_rtp = 0;
+		int inputs = 0;
+		int inputs_after_report = 0;
+
+		int64_t ServerNowUs() const { return simulation.now_us() + kServerClockOffsetUs; }
+		int64_t ServerNtpMs() const { return ServerNowUs() / 1000 + kNtpOffsetMs; }
+
+		void SendInput()
+		{
+			const int64_t timestamp_us = simulation.now_us();
+			std::string message = InputMessageCodec::WriteCameraTransform(0, 1.6f,
+				static_cast<float>(inputs), 0, 0, 0, timestamp_us);
+			inputs++;
+			inputs_after_report += has_sender_report;
+
+			simulation.Post(timestamp_us + kNetworkDelayUs, [this, message, timestamp_us]()
+			{
+				input_queue.Push(message.data(), message.size(), ServerNowUs(), timestamp_us);
+			});
+
+			simulation.Post(timestamp_us + kInputPeriodUs, [this]() { SendInput(); });
+		}
+
+		void CaptureFrame()
+		{
+			const int64_t capture_ntp_ms = ServerNtpMs();
+			input_queue.Drain(ServerNowUs(), &IgnoreInput);
+
+			// The capturer delivered it, which doesn't mean it is encoded.
+			FrameInput frame_input;
+			if (tagger.OnFrameDelivered(capture_ntp_ms, input_queue.last_client_timestamp_us(),
+				input_queue.last_client_push_time_us(), ServerNowUs(), &frame_input))
+			{
+				tags++;
+				std::string message = InputMessageCodec::WriteFrameInputMessage(frame_input);
+				simulation.Post(simulation.now_us() + kNetworkDelayUs, [this, message]()
+				{
+					FrameInput received;
+					Check(InputMessageCodec::ParseFrameInputMessage(message.data(), message.size(), &received),
+						"tag parses");
+					tracker.OnFrameInput(received);
+				});
+			}
+
+			if (frames++ % 7 != 3)
+			{
+				// The RTP sender offsets the timestamp the encoder derives from
+				// the NTP time, tags keyed by the latter never match.
+				const uint32_t rtp_timestamp = rtp_offset + static_cast<uint32_t>(90 * capture_ntp_ms);
+				legacy_matches += rtp_timestamp == static_cast<uint32_t>(90 * capture_ntp_ms);
+
+				const int64_t decoded_us = simulation.now_us() + kEncodeUs + kNetworkDelayUs + kDecodeUs;
+				simulation.Post(decoded_us, [this, rtp_timestamp, decoded_us]()
+				{
+					int64_t estimated_ntp_ms = 0;
+					if (has_sender_report)
+					{
+						std::uniform_int_distribution<int> error(-1, 1);
+						estimated_ntp_ms = report_ntp_ms +
+							static_cast<int32_t>(rtp_timestamp - report_rtp) / 90 + error(random);
+					}
+
+					simulation.Post(decoded_us + kPresentUs, [this, estimated_ntp_ms, decoded_us]()
+					{
+						tracker.OnFramePresented(estimated_ntp_ms, decoded_us, simulation.now_us());
+					});
+				});
+			}
+
+			simulation.Post(simulation.now_us() + kFramePeriodUs, [this]() { CaptureFrame(); });
+		}
+
+		void SendSenderReport()
+		{
+			const int64_t ntp_ms = ServerNtpMs();
+			const uint32_t rtp = rtp_offset + static_cast<uint32_t>(90 * ntp_ms);
+			simulation.Post(simulation.now_us() + kNetworkDelayUs, [this, ntp_ms, rtp]()
+			{
+				has_sender_report = true;
+				report_ntp_ms = ntp_ms;
+				report_rtp = rtp;
+			});
+
+			simulation.Post(simulation.now_us() + kSenderReportPeriodUs, [this]() { SendSenderReport(); });
+		}
+	};
+
+	void TestLoopback()
+	{
+		Loopback loopback;
+		loopback.rtp_offset = std::uniform_int_distribution<uint32_t>()(loopback.random);
+
+		// The first sender report follows the first frames, as in a session.
+		loopback.simulation.Post(1000000, [&loopback]() { loopback.SendInput(); });
+		loopback.simulation.Post(1003000, [&loopback]() { loopback.CaptureFrame(); });
+		loopback.simulation.Post(1500000, [&loopback]() { loopback.SendSenderReport(); });
+		loopback.simulation.Run(1000000 + kDurationUs);
+
+		InputLatencyStats stats = loopback.tracker.GetStats();
+		printf("  %d inputs, %d frames, %d tags, %d measured, total p50 %lld us p99 %lld us\n",
+			loopback.inputs, loopback.frames, loopback.tags, stats.samples,
+			static_cast<long long>(stats.total.p50_us), static_cast<long long>(stats.total.p99_us));
+
+		Check(loopback.legacy_matches == 0, "RTP timestamps don't match the encoder's");
+
+		// Each input once, the frames in flight at the end and those before
+		// the first sender report aside, even when the encoder dropped the
+		// first frame rendered with it.
+		Check(stats.samples >= loopback.inputs_after_report - 3 && stats.samples <= loopback.inputs,
+			"one measurement per input");
+		Check(loopback.tags <= FrameInputTagger::kMaxTaggedFrames * loopback.inputs, "tags per input");
+
+		Check(stats.transport.p50_us == kTransportUs && stats.transport.max_us == kTransportUs,
+			"transport latency");
+		Check(stats.present.p50_us == kPresentUs && stats.present.max_us == kPresentUs, "present latency");
+
+		// The input waits for the next frame, two when the encoder dropped
+		// it.
+		Check(stats.server.max_us <= 2 * kFramePeriodUs && stats.server.p50_us <= kFramePeriodUs,
+			"server latency");
+		Check(stats.total.p50_us >= kTransportUs + kPresentUs &&
+			stats.total.max_us <= kTransportUs + kPresentUs + 2 * kFramePeriodUs,
+			"total latency");
+	}
+
+	void TestMatching()
+	{
+		InputLatencyTracker tracker;
+		FrameInput tag = { 5000, 1000, 2000 };
+
+		// Before the first sender report, no NTP time to match.
+		tracker.OnFramePresented(0, 60000, 64000);
+		tracker.OnFrameInput(tag);
+		Check(tracker.GetStats().samples == 0, "frame without NTP time");
+
+		// The closest frame within the estimation error.
+		tracker.OnFramePresented(5017, 70000, 74000);
+		tracker.OnFramePresented(4997, 60000, 63000);
+		Check(tracker.GetStats().samples == 1 && tracker.GetStats().present.max_us == 3000,
+			"closest frame matches");
+
+		// Later frames with the same input aren't measured again.
+		FrameInput again = { 5017, 1000, 18000 };
+		tracker.OnFrameInput(again);
+		Check(tracker.GetStats().samples == 1, "input measured once");
+
+		// Too far from any frame.
+		FrameInput late = { 5100, 2000, 2000 };
+		tracker.OnFrameInput(late);
+		tracker.OnFramePresented(5100 + InputLatencyTracker::kMaxNtpErrorMs + 1, 90000, 91000);
+		Check(tracker.GetStats().samples == 1, "distant frame doesn't match");
+	}
+
+	void TestTagger()
+	{
+		FrameInputTagger tagger;
+		FrameInput frame_input;
+		Check(!tagger.OnFrameDelivered(100, 0, 0, 10, &frame_input), "no input, no tag");
+
+		int tagged = 0;
+		for (int i = 0; i < 10; ++i)
+		{
+			tagged += tagger.OnFrameDelivered(100 + i, 5000, 7000, 9000, &frame_input);
+		}
+
+		Check(tagged == FrameInputTagger::kMaxTaggedFrames, "input tagged on a few frames");
+		Check(tagger.OnFrameDelivered(200, 6000, 8000, 9000, &frame_input) &&
+			frame_input.capture_ntp_ms == 200 && frame_input.timestamp_us == 6000 &&
+			frame_input.server_delay_us == 1000, "new input tagged");
+
+		std::string message = InputMessageCodec::WriteFrameInputMessage(frame_input);
+		FrameInput parsed = {};
+		Check(InputMessageCodec::ParseFrameInputMessage(message.data(), message.size(), &parsed) &&
+			parsed.capture_ntp_ms == 200 && parsed.timestamp_us == 6000 && parsed.server_delay_us == 1000,
+			"tag round trip");
+
+		FrameInput ntp = { 3700000000123, 1, 2 };
+		message = InputMessageCodec::WriteFrameInputMessage(ntp);
+		Check(InputMessageCodec::ParseFrameInputMessage(message.data(), message.size(), &parsed) &&
+			parsed.capture_ntp_ms == ntp.capture_ntp_ms, "NTP time round trip");
+	}
+}
+
+int main()
+{
+	TestTagger();
+	TestMatching();
+	TestLoopback();
+
+	if (failures)
+	{
+		fprintf(stderr, "input_latency_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("input_latency_test: passed\n");
+	return EXIT_SUCCESS;
+}
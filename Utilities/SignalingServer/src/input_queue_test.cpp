@@ -0,0 +1,183 @@
+// Drives InputQueue, the queue of the input messages from the data channel
+// threads to the render loop.
+//
+// Checks the order and the counters of both overflow policies, that a full
+// DROP_OLDEST queue keeps taking messages without allocating, and that
+// concurrent producers lose no message the consumer doesn't account for.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "input_queue.h"
+
+namespace
+{
+	std::atomic<int> allocations(0);
+}
+
+void* operator new(size_t size)
+{
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	void* memory = malloc(size ? size : 1);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	// Longer than the small string buffer, so each copy needs the heap.
+	std::string Message(int index)
+	{
+		std::string message = "{\"type\":\"camera-transform\",\"body\":\"" + std::to_string(index) + "\"}";
+		message.resize(80, ' ');
+		return message;
+	}
+
+	std::vector<std::string> drained;
+
+	void Collect(const std::string& message)
+	{
+		drained.push_back(message);
+	}
+
+	void TestOverflow()
+	{
+		InputQueue newest(4, InputQueue::DROP_NEWEST);
+		InputQueue oldest(4, InputQueue::DROP_OLDEST);
+		for (int i = 0; i < 6; ++i)
+		{
+			std::string message = Message(i);
+			Check(newest.Push(message.data(), message.size(), i) == (i < 4), "drop newest reports the drop");
+			Check(oldest.Push(message.data(), message.size(), i) == (i < 4), "drop oldest reports the drop");
+		}
+
+		drained.clear();
+		Check(newest.Drain(10, &Collect) == 4, "drop newest keeps the capacity");
+		Check(drained.front() == Message(0) && drained.back() == Message(3), "drop newest keeps the first");
+
+		drained.clear();
+		Check(oldest.Drain(10, &Collect) == 4, "drop oldest keeps the capacity");
+		Check(drained.front() == Message(2) && drained.back() == Message(5), "drop oldest keeps the latest");
+
+		InputQueueStats stats = oldest.GetStats();
+		Check(stats.pushed == 6 && stats.dropped == 2 && stats.drained == 4, "counters");
+		Check(stats.max_latency_us == 8 && stats.total_latency_us == 8 + 7 + 6 + 5, "latency");
+	}
+
+	void TestOverflowDoesNotAllocate()
+	{
+		InputQueue queue(16, InputQueue::DROP_OLDEST);
+		std::vector<std::string> messages;
+		for (int i = 0; i < 64; ++i)
+		{
+			messages.push_back(Message(i));
+		}
+
+		// The first lap gives every slot its buffer.
+		for (int i = 0; i < 16; ++i)
+		{
+			queue.Push(messages[i].data(), messages[i].size(), i);
+		}
+
+		int before = allocations.load();
+		for (int i = 16; i < 64; ++i)
+		{
+			queue.Push(messages[i].data(), messages[i].size(), i);
+		}
+
+		Check(allocations.load() == before, "overflowing queue reuses the slot buffers");
+		Check(queue.GetStats().dropped == 48, "overflow drops the oldest");
+
+		drained.clear();
+		queue.Drain(64, &Collect);
+		Check(drained.size() == 16 && drained.front() == messages[48], "latest messages kept");
+	}
+
+	void TestConcurrentProducers()
+	{
+		const int kProducers = 4;
+		const int kMessages = 20000;
+		InputQueue queue(64, InputQueue::DROP_OLDEST);
+		std::atomic<int> running(kProducers);
+
+		std::vector<std::thread> producers;
+		for (int p = 0; p < kProducers; ++p)
+		{
+			producers.emplace_back([&queue, &running]()
+			{
+				std::string message = Message(0);
+				for (int i = 0; i < kMessages; ++i)
+				{
+					queue.Push(message.data(), message.size(), i);
+				}
+
+				running--;
+			});
+		}
+
+		size_t count = 0;
+		while (running.load() > 0)
+		{
+			count += queue.Drain(0, nullptr);
+		}
+
+		for (std::thread& producer : producers)
+		{
+			producer.join();
+		}
+
+		count += queue.Drain(0, nullptr);
+
+		InputQueueStats stats = queue.GetStats();
+		Check(stats.pushed == kProducers * kMessages, "every push counted");
+		Check(stats.drained == count && stats.drained + stats.dropped == stats.pushed,
+			"every message drained or dropped");
+	}
+}
+
+int main()
+{
+	TestOverflow();
+	TestOverflowDoesNotAllocate();
+	TestConcurrentProducers();
+
+	if (failures)
+	{
+		fprintf(stderr, "input_queue_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("input_queue_test: passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,994 @@
+// Drives a signaling server with simulated PeerConnectionClients.
+//
+// Each peer signs in on a keep-alive control connection, then keeps a
+// hanging GET on /wait, reconnecting after every response like the client
+// does, and sends "load <timestamp>" messages to its partner. Reports the
+// sign in rate, message latency percentiles and the memory per peer of the
+// server (from its /stats endpoint).
+//
+// --close-per-request sends the control requests with Connection: close, one
+// connection each, as PeerConnectionClient did before keep-alive, to compare
+// the request latency and connection count of both.
+//
+// Peers whose wait fails twice in a row, or is answered with an error,
+// reconnect like the client, with ReconnectController backoff and their
+// previous peer id. --drop-after makes a server started with --admin drop
+// every connection mid-run.
+
+#include <errno.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "event_loop.h"
+#include "http_response_parser.h"
+#include "reconnect_controller.h"
+
+namespace
+{
+	const size_t kReadChunkSize = 16 * 1024;
+
+	// Sign ins are started in batches on this period to follow --rate.
+	const int64_t kRampTickMs = 10;
+
+	// Time given to in flight messages after the message phase.
+	const int64_t kDrainMs = 2000;
+
+	const char kMessagePrefix[] = "load ";
+
+	// Consecutive failed waits which make a peer reconnect, as in
+	// PeerConnectionClient.
+	const int kMaxWaitFailures = 2;
+
+	struct Options
+	{
+		Options() :
+			host("127.0.0.1"),
+			port(8888),
+			peers(100),
+			rate(0),
+			duration_s(10),
+			interval_ms(1000),
+			message_size(64),
+			drop_after_s(-1),
+			down_ms(1000),
+			forget(false),
+			close_per_request(false)
+		{
+		}
+
+		std::string host;
+		int port;
+		int peers;
+
+		// Sign ins started per second, 0 starts them all at once.
+		int rate;
+
+		int duration_s;
+		int interval_ms;
+		int message_size;
+
+		// Seconds into the message phase at which the server drops every
+		// connection for |down_ms|, -1 never does.
+		int drop_after_s;
+		int down_ms;
+
+		// The server also forgets the peers, so none can resume.
+		bool forget;
+
+		// Opens a control connection per request instead of keeping it.
+		bool close_per_request;
+	};
+
+	struct Counters
+	{
+		Counters() :
+			sign_in_failures(0),
+			messages_sent(0),
+			messages_received(0),
+			messages_skipped(0),
+			notifications(0),
+			errors(0),
+			control_requests(0),
+			control_connections(0),
+			lost_sessions(0)
+		{
+		}
+
+		int sign_in_failures;
+		int64_t messages_sent;
+		int64_t messages_received;
+		int64_t messages_skipped;
+		int64_t notifications;
+		int64_t errors;
+		int64_t control_requests;
+		int64_t control_connections;
+
+		// Peers which had to reconnect.
+		int lost_sessions;
+	};
+
+	// Connection of a simulated peer, one request at a time.
+	struct Channel
+	{
+		Channel() : fd(-1), connected(false) {}
+
+		int fd;
+		bool connected;
+		std::string output;
+		std::string input;
+		HttpResponseParser parser;
+	};
+
+	struct SimulatedPeer
+	{
+		enum Request
+		{
+			NONE,
+			SIGN_IN,
+			MESSAGE,
+			SIGN_OUT,
+		};
+
+		SimulatedPeer() : index(0), id(-1), request(NONE), sign_in_start_us(0), request_start_us(0),
+			reconnecting(false), lost_us(0), wait_failures(0) {}
+
+		int index;
+		int id;
+		Request request;
+		int64_t sign_in_start_us;
+		int64_t request_start_us;
+		Channel control;
+		Channel wait;
+
+		// Signing in again to resume |id|.
+		bool reconnecting;
+		int64_t lost_us;
+		int wait_failures;
+		ReconnectController reconnect;
+	};
+
+	void PrintUsage(const char* program)
+	{
+		fprintf(stderr,
+			"Usage: %s [--host <address>] [--port <port>] [--peers <count>]\n"
+			"          [--rate <sign ins per second>] [--duration <seconds>]\n"
+			"          [--interval <ms between messages per peer>] [--message-size <bytes>]\n"
+			"          [--drop-after <seconds> [--down <ms>] [--forget]]\n"
+			"          [--close-per-request]\n",
+			program);
+	}
+
+	void RaiseDescriptorLimit()
+	{
+		rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+		{
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+	}
+
+	bool Resolve(const std::string& host, int port, sockaddr_in* address)
+	{
+		addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+
+		addrinfo* result = nullptr;
+		if (getaddrinfo(host.c_str(), nullptr, &hints, &result) != 0 || !result)
+		{
+			return false;
+		}
+
+		*address = *reinterpret_cast<sockaddr_in*>(result->ai_addr);
+		address->sin_port = htons(static_cast<uint16_t>(port));
+		freeaddrinfo(result);
+		return true;
+	}
+
+	// Blocking GET of |path|, returns the body of a 200 response.
+	bool HttpGet(const sockaddr_in& address, const std::string& path, std::string* body)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if (fd < 0 || connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+		{
+			if (fd >= 0)
+			{
+				close(fd);
+			}
+
+			return false;
+		}
+
+		std::string request = "GET " + path + " HTTP/1.0\r\n\r\n";
+		send(fd, request.data(), request.size(), MSG_NOSIGNAL);
+
+		std::string data;
+		HttpResponseParser parser;
+		HttpResponseParser::Result result = HttpResponseParser::NEED_MORE_DATA;
+		char buffer[4096];
+		while (result == HttpResponseParser::NEED_MORE_DATA)
+		{
+			ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+			if (received <= 0)
+			{
+				result = parser.Finish();
+				break;
+			}
+
+			data.append(buffer, received);
+			result = parser.Parse(&data[0], data.size());
+		}
+
+		close(fd);
+		if (result != HttpResponseParser::COMPLETE || parser.status_code() != 200)
+		{
+			return false;
+		}
+
+		HttpSpan span = parser.body();
+		*body = data.substr(span.offset, span.length);
+		return true;
+	}
+
+	// Resident set size of the server, from its /stats.
+	bool FetchServerRss(const sockaddr_in& address, int64_t* rss_bytes)
+	{
+		std::string json;
+		if (!HttpGet(address, "/stats", &json))
+		{
+			return false;
+		}
+
+		size_t pos = json.find("\"rss_bytes\":");
+		if (pos == std::string::npos)
+		{
+			return false;
+		}
+
+		*rss_bytes = atoll(json.c_str() + pos + strlen("\"rss_bytes\":"));
+		return true;
+	}
+
+	int64_t Percentile(const std::vector<int64_t>& sorted, double percentile)
+	{
+		if (sorted.empty())
+		{
+			return 0;
+		}
+
+		size_t index = static_cast<size_t>(percentile / 100.0 * (sorted.size() - 1) + 0.5);
+		return sorted[(std::min)(index, sorted.size() - 1)];
+	}
+
+	void PrintLatencies(const char* name, std::vector<int64_t>* latencies_us)
+	{
+		std::sort(latencies_us->begin(), latencies_us->end());
+		printf("%s latency (ms): p50 %.2f, p90 %.2f, p99 %.2f, max %.2f (%zu samples)\n", name,
+			Percentile(*latencies_us, 50) / 1000.0, Percentile(*latencies_us, 90) / 1000.0,
+			Percentile(*latencies_us, 99) / 1000.0,
+			latencies_us->empty() ? 0.0 : latencies_us->back() / 1000.0, latencies_us->size());
+	}
+
+	class LoadGenerator
+	{
+	public:
+		LoadGenerator(EventLoop* loop, const Options& options, const sockaddr_in& address) :
+			loop_(loop),
+			options_(options),
+			address_(address),
+			peers_(options.peers),
+			started_(0),
+			signed_in_(0),
+			baseline_rss_(0),
+			sign_in_begin_us_(0),
+			sign_in_end_us_(0),
+			message_end_ms_(0),
+			stopping_(false)
+		{
+			for (int i = 0; i < options_.peers; ++i)
+			{
+				peers_[i].index = i;
+			}
+		}
+
+		void Start()
+		{
+			if (!FetchServerRss(address_, &baseline_rss_))
+			{
+				fprintf(stderr, "Unable to read /stats, the memory per peer won't be reported\n");
+			}
+
+			printf("Signing in %d peers...\n", options_.peers);
+			fflush(stdout);
+			sign_in_begin_us_ = EventLoop::NowUs();
+			RampSignIns();
+		}
+
+		void PrintReport()
+		{
+			printf("\nMessages: %lld sent, %lld received, %lld skipped (previous request in flight), "
+				"%lld notifications, %lld errors\n",
+				static_cast<long long>(counters_.messages_sent),
+				static_cast<long long>(counters_.messages_received),
+				static_cast<long long>(counters_.messages_skipped),
+				static_cast<long long>(counters_.notifications),
+				static_cast<long long>(counters_.errors));
+
+			PrintLatencies("Message", &message_latencies_us_);
+
+			// The time to post a message, including the connection setup
+			// without keep-alive.
+			printf("\nControl requests: %lld on %lld connections (%s)\n",
+				static_cast<long long>(counters_.control_requests),
+				static_cast<long long>(counters_.control_connections),
+				options_.close_per_request ? "one per request" : "keep-alive");
+
+			PrintLatencies("Message request", &request_latencies_us_);
+
+			ReconnectStats reconnects = ReconnectStats();
+			int reconnecting = 0;
+			for (const SimulatedPeer& peer : peers_)
+			{
+				const ReconnectStats& stats = peer.reconnect.stats();
+				reconnects.attempts += stats.attempts;
+				reconnects.resumed += stats.resumed;
+				reconnects.new_sessions += stats.new_sessions;
+				reconnecting += peer.reconnecting ? 1 : 0;
+			}
+
+			if (counters_.lost_sessions > 0)
+			{
+				printf("\nReconnects: %d peers lost the server, %d attempts, %d resumed, %d new sessions, "
+					"%d still reconnecting\n", counters_.lost_sessions, reconnects.attempts,
+					reconnects.resumed, reconnects.new_sessions, reconnecting);
+
+				// The spread shows whether the peers came back in lockstep.
+				PrintLatencies("Reconnect", &reconnect_latencies_us_);
+			}
+		}
+
+	private:
+		enum ChannelKind
+		{
+			CONTROL,
+			WAIT,
+		};
+
+		void RampSignIns()
+		{
+			int64_t elapsed_ms = (EventLoop::NowUs() - sign_in_begin_us_) / 1000;
+			int target = options_.rate > 0 ?
+				static_cast<int>((elapsed_ms + kRampTickMs) * options_.rate / 1000) : options_.peers;
+
+			while (started_ < (std::min)(target, options_.peers))
+			{
+				SimulatedPeer& peer = peers_[started_++];
+				peer.sign_in_start_us = EventLoop::NowUs();
+				SendRequest(&peer, SimulatedPeer::SIGN_IN,
+					"GET /sign_in?peer_name=load_" + std::to_string(peer.index) + " HTTP/1.1\r\n" +
+					ControlHeaders() + "\r\n");
+			}
+
+			if (started_ < options_.peers)
+			{
+				loop_->AddTimer(kRampTickMs, [this]() { RampSignIns(); });
+			}
+		}
+
+		void OnSignInDone()
+		{
+			if (signed_in_ + counters_.sign_in_failures < options_.peers)
+			{
+				return;
+			}
+
+			sign_in_end_us_ = EventLoop::NowUs();
+			double seconds = (sign_in_end_us_ - sign_in_begin_us_) / 1000000.0;
+			printf("Signed in %d peers (%d failures) in %.2f s, %.0f sign ins/s\n", signed_in_,
+				counters_.sign_in_failures, seconds, seconds > 0 ? signed_in_ / seconds : 0.0);
+
+			PrintLatencies("Sign in", &sign_in_latencies_us_);
+
+			int64_t rss = 0;
+			if (baseline_rss_ > 0 && signed_in_ > 0 && FetchServerRss(address_, &rss))
+			{
+				printf("Server memory: %.1f MB, %.0f bytes per peer\n", rss / (1024.0 * 1024.0),
+					static_cast<double>(rss - baseline_rss_) / signed_in_);
+			}
+
+			printf("Sending messages for %d s...\n", options_.duration_s);
+			fflush(stdout);
+
+			message_end_ms_ = EventLoop::NowMs() + options_.duration_s * 1000;
+			for (SimulatedPeer& peer : peers_)
+			{
+				if (peer.id != -1)
+				{
+					int index = peer.index;
+					loop_->AddTimer(rand() % (std::max)(options_.interval_ms, 1),
+						[this, index]() { SendMessage(index); });
+				}
+			}
+
+			if (options_.drop_after_s >= 0)
+			{
+				loop_->AddTimer(options_.drop_after_s * 1000, [this]() { DropServerConnections(); });
+			}
+
+			loop_->AddTimer(options_.duration_s * 1000 + kDrainMs, [this]() { SignOut(); });
+		}
+
+		void DropServerConnections()
+		{
+			std::string body;
+			std::string path = "/admin/drop?down_ms=" + std::to_string(options_.down_ms) +
+				(options_.forget ? "&forget=1" : "");
+
+			if (!HttpGet(address_, path, &body))
+			{
+				fprintf(stderr, "Unable to drop the server connections, is it running with --admin?\n");
+				return;
+			}
+
+			printf("Server dropped every connection for %d ms\n", options_.down_ms);
+			fflush(stdout);
+		}
+
+		void SendMessage(int index)
+		{
+			if (EventLoop::NowMs() >= message_end_ms_)
+			{
+				return;
+			}
+
+			SimulatedPeer& peer = peers_[index];
+			const SimulatedPeer& partner = peers_[index ^ 1];
+			if (peer.id != -1 && !peer.reconnecting && (index ^ 1) < options_.peers && partner.id != -1)
+			{
+				if (peer.request != SimulatedPeer::NONE)
+				{
+					counters_.messages_skipped++;
+				}
+				else
+				{
+					std::string body = kMessagePrefix + std::to_string(EventLoop::NowUs());
+					if (body.size() < static_cast<size_t>(options_.message_size))
+					{
+						body.append(options_.message_size - body.size(), ' ');
+					}
+
+					SendRequest(&peer, SimulatedPeer::MESSAGE,
+						"POST /message?peer_id=" + std::to_string(peer.id) +
+						"&to=" + std::to_string(partner.id) + " HTTP/1.1\r\n" +
+						ControlHeaders() +
+						"Content-Type: text/plain\r\n"
+						"Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body);
+
+					counters_.messages_sent++;
+				}
+			}
+
+			loop_->AddTimer(options_.interval_ms, [this, index]() { SendMessage(index); });
+		}
+
+		void SignOut()
+		{
+			stopping_ = true;
+			for (SimulatedPeer& peer : peers_)
+			{
+				CloseChannel(&peer.wait);
+				if (peer.reconnecting)
+				{
+					CloseChannel(&peer.control);
+				}
+				else if (peer.id != -1)
+				{
+					SendRequest(&peer, SimulatedPeer::SIGN_OUT,
+						"GET /sign_out?peer_id=" + std::to_string(peer.id) + " HTTP/1.1\r\n" +
+						ControlHeaders() + "\r\n");
+
+					peer.id = -1;
+				}
+			}
+
+			loop_->AddTimer(kDrainMs, [this]() { loop_->Stop(); });
+		}
+
+		std::string ControlHeaders() const
+		{
+			return "Host: " + options_.host + "\r\n" +
+				(options_.close_per_request ? "Connection: close\r\n" : "");
+		}
+
+		void SendRequest(SimulatedPeer* peer, SimulatedPeer::Request request, const std::string& data)
+		{
+			peer->request = request;
+			peer->request_start_us = EventLoop::NowUs();
+			peer->control.output += data;
+			counters_.control_requests++;
+			if (peer->control.fd == -1)
+			{
+				if (!Connect(peer, CONTROL))
+				{
+					OnControlFailure(peer);
+					return;
+				}
+
+				counters_.control_connections++;
+			}
+
+			Flush(peer, CONTROL);
+		}
+
+		void StartWait(SimulatedPeer* peer)
+		{
+			peer->wait.output = "GET /wait?peer_id=" + std::to_string(peer->id) + " HTTP/1.0\r\n\r\n";
+			if (!Connect(peer, WAIT))
+			{
+				OnWaitFailure(peer);
+				return;
+			}
+
+			Flush(peer, WAIT);
+		}
+
+		// Waits again after a first failure, reconnects after the next one.
+		void OnWaitFailure(SimulatedPeer* peer)
+		{
+			CloseChannel(&peer->wait);
+			counters_.errors++;
+			if (peer->id == -1 || peer->reconnecting || stopping_)
+			{
+				return;
+			}
+
+			if (++peer->wait_failures < kMaxWaitFailures)
+			{
+				StartWait(peer);
+				return;
+			}
+
+			OnSessionLost(peer);
+		}
+
+		void OnSessionLost(SimulatedPeer* peer)
+		{
+			peer->reconnecting = true;
+			peer->lost_us = EventLoop::NowUs();
+			counters_.lost_sessions++;
+			CloseChannel(&peer->control);
+			peer->request = SimulatedPeer::NONE;
+			ScheduleReconnect(peer);
+		}
+
+		void ScheduleReconnect(SimulatedPeer* peer)
+		{
+			int index = peer->index;
+			loop_->AddTimer(peer->reconnect.NextDelayMs(), [this, index]()
+			{
+				SimulatedPeer& peer = peers_[index];
+				if (!stopping_)
+				{
+					SendRequest(&peer, SimulatedPeer::SIGN_IN,
+						"GET /sign_in?peer_name=load_" + std::to_string(peer.index) +
+						"&peer_id=" + std::to_string(peer.id) + " HTTP/1.1\r\n" +
+						ControlHeaders() + "\r\n");
+				}
+			});
+		}
+
+		void OnReconnectResponse(SimulatedPeer* peer, int peer_id)
+		{
+			if (peer_id <= 0)
+			{
+				ScheduleReconnect(peer);
+				return;
+			}
+
+			peer->reconnect.OnConnected();
+			peer->reconnect.OnResumed(peer_id == peer->id);
+			peer->id = peer_id;
+			peer->reconnecting = false;
+			peer->wait_failures = 0;
+			reconnect_latencies_us_.push_back(EventLoop::NowUs() - peer->lost_us);
+			StartWait(peer);
+		}
+
+		bool Connect(SimulatedPeer* peer, ChannelKind kind)
+		{
+			Channel* channel = kind == CONTROL ? &peer->control : &peer->wait;
+			int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+			if (fd < 0)
+			{
+				return false;
+			}
+
+			int enable = 1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+			if (connect(fd, reinterpret_cast<const sockaddr*>(&address_), sizeof(address_)) != 0 &&
+				errno != EINPROGRESS)
+			{
+				close(fd);
+				return false;
+			}
+
+			int index = peer->index;
+			if (!loop_->Add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP,
+				[this, index, kind](uint32_t events) { OnEvent(index, kind, events); }))
+			{
+				close(fd);
+				return false;
+			}
+
+			channel->fd = fd;
+			channel->connected = false;
+			channel->input.clear();
+			channel->parser.Reset();
+			return true;
+		}
+
+		void CloseChannel(Channel* channel)
+		{
+			if (channel->fd != -1)
+			{
+				loop_->Remove(channel->fd);
+				close(channel->fd);
+				channel->fd = -1;
+			}
+
+			channel->connected = false;
+			channel->output.clear();
+			channel->input.clear();
+			channel->parser.Reset();
+		}
+
+		void Flush(SimulatedPeer* peer, ChannelKind kind)
+		{
+			Channel* channel = kind == CONTROL ? &peer->control : &peer->wait;
+			if (!channel->connected)
+			{
+				// Sent once EPOLLOUT reports the connection.
+				return;
+			}
+
+			while (!channel->output.empty())
+			{
+				ssize_t sent = send(channel->fd, channel->output.data(), channel->output.size(), MSG_NOSIGNAL);
+				if (sent > 0)
+				{
+					channel->output.erase(0, sent);
+				}
+				else if (sent < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				else
+				{
+					if (sent < 0 && errno != EAGAIN && errno != EWOULDBLOCK)
+					{
+						OnChannelClosed(peer, kind);
+					}
+
+					return;
+				}
+			}
+		}
+
+		void OnEvent(int index, ChannelKind kind, uint32_t events)
+		{
+			SimulatedPeer* peer = &peers_[index];
+			Channel* channel = kind == CONTROL ? &peer->control : &peer->wait;
+			if (events & EPOLLERR)
+			{
+				OnChannelClosed(peer, kind);
+				return;
+			}
+
+			if ((events & EPOLLOUT) && !channel->connected)
+			{
+				channel->connected = true;
+				Flush(peer, kind);
+				if (channel->fd == -1)
+				{
+					return;
+				}
+			}
+
+			if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)))
+			{
+				return;
+			}
+
+			char buffer[kReadChunkSize];
+			while (true)
+			{
+				ssize_t received = recv(channel->fd, buffer, sizeof(buffer), 0);
+				if (received > 0)
+				{
+					channel->input.append(buffer, received);
+					HttpResponseParser::Result result =
+						channel->parser.Parse(&channel->input[0], channel->input.size());
+
+					if (result != HttpResponseParser::NEED_MORE_DATA)
+					{
+						OnResponse(peer, kind, result);
+						return;
+					}
+				}
+				else if (received < 0 && errno == EINTR)
+				{
+					continue;
+				}
+				else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+				{
+					return;
+				}
+				else
+				{
+					HttpResponseParser::Result result = channel->input.empty() ?
+						HttpResponseParser::PARSE_ERROR : channel->parser.Finish();
+
+					if (result == HttpResponseParser::COMPLETE)
+					{
+						OnResponse(peer, kind, result);
+					}
+					else
+					{
+						OnChannelClosed(peer, kind);
+					}
+
+					return;
+				}
+			}
+		}
+
+		void OnResponse(SimulatedPeer* peer, ChannelKind kind, HttpResponseParser::Result result)
+		{
+			Channel* channel = kind == CONTROL ? &peer->control : &peer->wait;
+			int status = result == HttpResponseParser::COMPLETE ? channel->parser.status_code() : -1;
+			int64_t pragma = -1;
+			channel->parser.GetHeaderInt(channel->input.data(), "Pragma", &pragma);
+			HttpSpan body = channel->parser.body();
+			std::string data = status == 200 ? channel->input.substr(body.offset, body.length) : std::string();
+			bool keep_alive = result == HttpResponseParser::COMPLETE && channel->parser.keep_alive() &&
+				channel->parser.consumed() == channel->input.size();
+
+			if (kind == WAIT)
+			{
+				// Each wait is answered once.
+				CloseChannel(channel);
+				if (status == -1)
+				{
+					OnWaitFailure(peer);
+					return;
+				}
+
+				if (ReconnectController::ActionForResponse(SIGNALING_WAIT, status) != RESPONSE_PROCESS)
+				{
+					// E.g. the server forgot the peer.
+					counters_.errors++;
+					if (peer->id != -1 && !peer->reconnecting && !stopping_)
+					{
+						OnSessionLost(peer);
+					}
+
+					return;
+				}
+
+				peer->wait_failures = 0;
+				if (pragma == peer->id)
+				{
+					counters_.notifications++;
+				}
+				else if (data.compare(0, strlen(kMessagePrefix), kMessagePrefix) == 0)
+				{
+					int64_t sent_us = atoll(data.c_str() + strlen(kMessagePrefix));
+					message_latencies_us_.push_back(EventLoop::NowUs() - sent_us);
+					counters_.messages_received++;
+				}
+
+				if (peer->id != -1)
+				{
+					StartWait(peer);
+				}
+
+				return;
+			}
+
+			if (keep_alive)
+			{
+				channel->input.clear();
+				channel->parser.Reset();
+			}
+			else
+			{
+				CloseChannel(channel);
+			}
+
+			SimulatedPeer::Request request = peer->request;
+			peer->request = SimulatedPeer::NONE;
+			if (request == SimulatedPeer::SIGN_IN && peer->reconnecting)
+			{
+				OnReconnectResponse(peer, status == 200 ? static_cast<int>(pragma) : -1);
+			}
+			else if (request == SimulatedPeer::SIGN_IN)
+			{
+				if (status == 200 && pragma > 0)
+				{
+					peer->id = static_cast<int>(pragma);
+					sign_in_latencies_us_.push_back(EventLoop::NowUs() - peer->sign_in_start_us);
+					signed_in_++;
+					StartWait(peer);
+				}
+				else
+				{
+					counters_.sign_in_failures++;
+				}
+
+				OnSignInDone();
+			}
+			else if (status != 200)
+			{
+				counters_.errors++;
+			}
+			else if (request == SimulatedPeer::MESSAGE)
+			{
+				request_latencies_us_.push_back(EventLoop::NowUs() - peer->request_start_us);
+			}
+		}
+
+		void OnChannelClosed(SimulatedPeer* peer, ChannelKind kind)
+		{
+			if (kind == WAIT)
+			{
+				OnWaitFailure(peer);
+				return;
+			}
+
+			OnControlFailure(peer);
+		}
+
+		void OnControlFailure(SimulatedPeer* peer)
+		{
+			CloseChannel(&peer->control);
+			SimulatedPeer::Request request = peer->request;
+			peer->request = SimulatedPeer::NONE;
+			if (request == SimulatedPeer::SIGN_IN && peer->reconnecting)
+			{
+				if (!stopping_)
+				{
+					ScheduleReconnect(peer);
+				}
+			}
+			else if (request == SimulatedPeer::SIGN_IN)
+			{
+				counters_.sign_in_failures++;
+				OnSignInDone();
+			}
+			else if (request != SimulatedPeer::NONE)
+			{
+				counters_.errors++;
+			}
+		}
+
+		EventLoop* loop_;
+		Options options_;
+		sockaddr_in address_;
+		std::vector<SimulatedPeer> peers_;
+		int started_;
+		int signed_in_;
+		int64_t baseline_rss_;
+		int64_t sign_in_begin_us_;
+		int64_t sign_in_end_us_;
+		int64_t message_end_ms_;
+		bool stopping_;
+		Counters counters_;
+		std::vector<int64_t> sign_in_latencies_us_;
+		std::vector<int64_t> message_latencies_us_;
+		std::vector<int64_t> request_latencies_us_;
+
+		// From the second failed wait until signed in again.
+		std::vector<int64_t> reconnect_latencies_us_;
+	};
+}
+
+int main(int argc, char* argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; ++i)
+	{
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--host") == 0 && has_value)
+		{
+			options.host = argv[++i];
+		}
+		else if (strcmp(argv[i], "--port") == 0 && has_value)
+		{
+			options.port = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--peers") == 0 && has_value)
+		{
+			options.peers = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--rate") == 0 && has_value)
+		{
+			options.rate = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--duration") == 0 && has_value)
+		{
+			options.duration_s = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--interval") == 0 && has_value)
+		{
+			options.interval_ms = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--message-size") == 0 && has_value)
+		{
+			options.message_size = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--drop-after") == 0 && has_value)
+		{
+			options.drop_after_s = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--down") == 0 && has_value)
+		{
+			options.down_ms = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--forget") == 0)
+		{
+			options.forget = true;
+		}
+		else if (strcmp(argv[i], "--close-per-request") == 0)
+		{
+			options.close_per_request = true;
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (options.peers <= 0 || options.interval_ms <= 0)
+	{
+		PrintUsage(argv[0]);
+		return 1;
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	RaiseDescriptorLimit();
+
+	sockaddr_in address;
+	if (!Resolve(options.host, options.port, &address))
+	{
+		fprintf(stderr, "Unable to resolve %s\n", options.host.c_str());
+		return 1;
+	}
+
+	EventLoop loop;
+	if (!loop.is_valid())
+	{
+		return 1;
+	}
+
+	LoadGenerator generator(&loop, options, address);
+	generator.Start();
+	loop.Run();
+	generator.PrintReport();
+	return 0;
+}
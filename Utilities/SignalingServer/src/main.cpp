@@ -0,0 +1,100 @@
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "event_loop.h"
+#include "signaling_server.h"
+
+namespace
+{
+	void PrintUsage(const char* program)
+	{
+		fprintf(stderr,
+			"Usage: %s [--port <port>] [--heartbeat-timeout <ms>] [--no-presence]\n"
+			"          [--stats-interval <seconds>] [--admin]\n",
+			program);
+	}
+
+	// Every hanging GET holds a descriptor.
+	void RaiseDescriptorLimit()
+	{
+		rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max)
+		{
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+	}
+
+	void PrintStats(EventLoop* loop, const SignalingServer* server, int interval_ms)
+	{
+		SignalingServerStats stats = server->GetStats();
+		printf("peers %d, connections %d, waiting %d, sign ins %lld, resumes %lld, messages %lld, "
+			"queued %lld, rss %.1f MB\n",
+			stats.peers, stats.connections, stats.waiting,
+			static_cast<long long>(stats.sign_ins), static_cast<long long>(stats.resumes),
+			static_cast<long long>(stats.messages),
+			static_cast<long long>(stats.queued_messages), stats.rss_bytes / (1024.0 * 1024.0));
+
+		fflush(stdout);
+		loop->AddTimer(interval_ms, [loop, server, interval_ms]() { PrintStats(loop, server, interval_ms); });
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	SignalingServer::Options options;
+	int stats_interval_s = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--port") == 0 && has_value)
+		{
+			options.port = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--heartbeat-timeout") == 0 && has_value)
+		{
+			options.heartbeat_timeout_ms = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--no-presence") == 0)
+		{
+			options.presence = false;
+		}
+		else if (strcmp(argv[i], "--stats-interval") == 0 && has_value)
+		{
+			stats_interval_s = atoi(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--admin") == 0)
+		{
+			options.admin = true;
+		}
+		else
+		{
+			PrintUsage(argv[0]);
+			return 1;
+		}
+	}
+
+	signal(SIGPIPE, SIG_IGN);
+	RaiseDescriptorLimit();
+
+	EventLoop loop;
+	SignalingServer server(&loop, options);
+	if (!loop.is_valid() || !server.Start())
+	{
+		return 1;
+	}
+
+	printf("Signaling server listening on port %d\n", options.port);
+	fflush(stdout);
+
+	if (stats_interval_s > 0)
+	{
+		PrintStats(&loop, &server, stats_interval_s * 1000);
+	}
+
+	loop.Run();
+	return 0;
+}
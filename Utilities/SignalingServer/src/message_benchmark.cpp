@@ -0,0 +1,171 @@
+// Compares SignalingMessageCodec with the jsoncpp StyledWriter and Reader
+// the conductors used before, on a session description and a candidate of
+// typical size. Also parses the styled output with the codec, the format
+// older peers still send.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <functional>
+#include <string>
+
+#include <json/json.h>
+
+#include "signaling_message.h"
+
+namespace
+{
+	const char kCandidate[] = "candidate:842163049 1 udp 1677729535 203.0.113.7 54400 typ srflx "
+		"raddr 192.168.1.10 rport 54400 generation 0 ufrag EsAw network-id 1 network-cost 10";
+
+	// Offer with an audio, a video and a data section, about 3 KB.
+	std::string CreateSdp()
+	{
+		std::string sdp =
+			"v=0\r\n"
+			"o=- 4611731400430051336 2 IN IP4 127.0.0.1\r\n"
+			"s=-\r\n"
+			"t=0 0\r\n"
+			"a=group:BUNDLE audio video data\r\n"
+			"a=msid-semantic: WMS stream_label\r\n";
+
+		const char* media[] = { "audio", "video", "data" };
+		for (const char* mid : media)
+		{
+			sdp += std::string("m=") + mid + " 9 UDP/TLS/RTP/SAVPF 111 103 104 9 0 8 106 105 13 110\r\n"
+				"c=IN IP4 0.0.0.0\r\n"
+				"a=rtcp:9 IN IP4 0.0.0.0\r\n"
+				"a=ice-ufrag:EsAw\r\n"
+				"a=ice-pwd:P2uYro0UCOQ4zxjKXaWCBui1\r\n"
+				"a=fingerprint:sha-256 D2:FA:0E:C3:22:59:5E:14:95:69:92:3D:13:B4:84:24:2C:C2:A2:C0:"
+				"3E:FD:34:8E:5E:EA:6F:AF:52:CE:E6:0F\r\n"
+				"a=setup:actpass\r\n"
+				"a=mid:" + mid + "\r\n"
+				"a=extmap:1 urn:ietf:params:rtp-hdrext:ssrc-audio-level\r\n"
+				"a=extmap:3 http://www.webrtc.org/experiments/rtp-hdrext/abs-send-time\r\n"
+				"a=sendrecv\r\n"
+				"a=rtcp-mux\r\n"
+				"a=rtpmap:111 opus/48000/2\r\n"
+				"a=rtcp-fb:111 transport-cc\r\n"
+				"a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+				"a=rtpmap:103 ISAC/16000\r\n"
+				"a=rtpmap:104 ISAC/32000\r\n"
+				"a=rtpmap:9 G722/8000\r\n"
+				"a=ssrc:1001 cname:zhCs8ocNbQ+dr6Ea\r\n"
+				"a=ssrc:1001 msid:stream_label audio_label\r\n";
+		}
+
+		return sdp;
+	}
+
+	// Runs |operation| |iterations| times and prints the time per call.
+	void Measure(const char* name, int iterations, const std::function<size_t()>& operation)
+	{
+		size_t sink = 0;
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; ++i)
+		{
+			sink += operation();
+		}
+
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		double ns = std::chrono::duration<double, std::nano>(elapsed).count() / iterations;
+		printf("  %-36s %10.0f ns  (%zu)\n", name, ns, sink / iterations);
+	}
+
+	void Run(const char* title, const Json::Value& value, const std::string& compact, int iterations,
+		const std::function<bool(const SignalingMessage&)>& check)
+	{
+		Json::StyledWriter styled_writer;
+		std::string styled = styled_writer.write(value);
+
+		SignalingMessage message;
+		if (!SignalingMessageCodec::Parse(compact, &message) || !check(message) ||
+			!SignalingMessageCodec::Parse(styled, &message) || !check(message))
+		{
+			fprintf(stderr, "%s: codec output doesn't round trip\n", title);
+			exit(1);
+		}
+
+		printf("%s, %zu bytes styled, %zu bytes compact\n", title, styled.size(), compact.size());
+
+		Measure("Json::StyledWriter", iterations, [&value]()
+		{
+			Json::StyledWriter writer;
+			return writer.write(value).size();
+		});
+
+		Measure("SignalingMessageCodec::Write", iterations, [&message]()
+		{
+			if (message.is_session_description())
+			{
+				return SignalingMessageCodec::WriteSessionDescription(message.type, message.sdp).size();
+			}
+
+			return SignalingMessageCodec::WriteCandidate(message.sdp_mid, message.sdp_mline_index,
+				message.candidate).size();
+		});
+
+		Measure("Json::Reader (styled)", iterations, [&styled]()
+		{
+			Json::Reader reader;
+			Json::Value parsed;
+			reader.parse(styled, parsed);
+			return parsed.size();
+		});
+
+		Measure("SignalingMessageCodec::Parse (styled)", iterations, [&styled]()
+		{
+			SignalingMessage parsed;
+			SignalingMessageCodec::Parse(styled, &parsed);
+			return parsed.sdp.size() + parsed.candidate.size();
+		});
+
+		Measure("SignalingMessageCodec::Parse (compact)", iterations, [&compact]()
+		{
+			SignalingMessage parsed;
+			SignalingMessageCodec::Parse(compact, &parsed);
+			return parsed.sdp.size() + parsed.candidate.size();
+		});
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int iterations = 20000;
+	if (argc == 3 && strcmp(argv[1], "--iterations") == 0)
+	{
+		iterations = atoi(argv[2]);
+	}
+	else if (argc != 1)
+	{
+		fprintf(stderr, "Usage: %s [--iterations <count>]\n", argv[0]);
+		return 1;
+	}
+
+	std::string sdp = CreateSdp();
+	Json::Value description;
+	description["type"] = "offer";
+	description["sdp"] = sdp;
+	Run("Session description", description,
+		SignalingMessageCodec::WriteSessionDescription("offer", sdp), iterations,
+		[&sdp](const SignalingMessage& message)
+		{
+			return message.type == "offer" && message.sdp == sdp;
+		});
+
+	Json::Value candidate;
+	candidate["sdpMid"] = "video";
+	candidate["sdpMLineIndex"] = 1;
+	candidate["candidate"] = kCandidate;
+	Run("Candidate", candidate, SignalingMessageCodec::WriteCandidate("video", 1, kCandidate),
+		iterations, [](const SignalingMessage& message)
+		{
+			return message.is_candidate() && message.sdp_mid == "video" &&
+				message.sdp_mline_index == 1 && message.candidate == kCandidate;
+		});
+
+	return 0;
+}
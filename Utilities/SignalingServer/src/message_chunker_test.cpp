@@ -0,0 +1,272 @@
+// Checks MessageReassembler::Add on the chunks of MessageChunker: messages
+// interleaved on the channel, chunks out of order or malformed, and the
+// eviction and timeout which bound the memory of incomplete messages.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "message_chunker.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	const size_t kChunkSize = MessageChunker::kHeaderSize + 16;
+
+	std::string Payload(size_t length, char seed)
+	{
+		std::string payload(length, 0);
+		for (size_t i = 0; i < length; ++i)
+		{
+			payload[i] = static_cast<char>(seed + i * 7);
+		}
+
+		return payload;
+	}
+
+	// Chunks of |payloads|, grouped by message, in the order of the
+	// chunker.
+	std::vector<std::vector<std::string>> Split(const std::vector<std::string>& payloads)
+	{
+		MessageChunker chunker(kChunkSize);
+		for (const std::string& payload : payloads)
+		{
+			chunker.Add(payload);
+		}
+
+		std::vector<std::vector<std::string>> chunks(payloads.size());
+		std::string chunk;
+		while (chunker.Next(&chunk))
+		{
+			chunks[static_cast<uint8_t>(chunk[2])].push_back(chunk);
+		}
+
+		return chunks;
+	}
+
+	bool Add(MessageReassembler* reassembler, const std::string& chunk, int64_t now_ms,
+		std::string* payload)
+	{
+		return reassembler->Add(chunk.data(), chunk.size(), now_ms, payload);
+	}
+
+	void TestInterleaving()
+	{
+		std::vector<std::string> payloads;
+		payloads.push_back(Payload(100, 'a'));
+		payloads.push_back(Payload(16, 'b'));
+		payloads.push_back(std::string());
+		payloads.push_back(Payload(37, 'c'));
+
+		// In the order of the chunker, which interleaves the messages.
+		MessageChunker chunker(kChunkSize);
+		for (const std::string& payload : payloads)
+		{
+			Check(chunker.Add(payload), "payload queued");
+		}
+
+		MessageReassembler reassembler;
+		std::vector<std::string> received;
+		std::string chunk;
+		std::string payload;
+		while (chunker.Next(&chunk))
+		{
+			Check(MessageReassembler::IsChunk(chunk.data(), chunk.size()), "chunk magic");
+			Check(chunk.size() <= kChunkSize, "chunk size");
+			if (Add(&reassembler, chunk, 0, &payload))
+			{
+				received.push_back(payload);
+			}
+		}
+
+		Check(received.size() == 4 && received[0] == payloads[1] && received[1] == payloads[2] &&
+			received[2] == payloads[3] && received[3] == payloads[0], "interleaved messages complete");
+
+		// Another interleaving, the last message first.
+		std::vector<std::vector<std::string>> chunks = Split(payloads);
+		received.clear();
+		for (size_t i = chunks.size(); i-- > 0;)
+		{
+			for (const std::string& part : chunks[i])
+			{
+				if (Add(&reassembler, part, 0, &payload))
+				{
+					received.push_back(payload);
+				}
+			}
+		}
+
+		Check(received.size() == 4 && received[0] == payloads[3] && received[3] == payloads[0],
+			"messages complete in any order");
+		Check(reassembler.stats().completed == 8 && reassembler.stats().dropped == 0 &&
+			reassembler.stats().buffered_bytes == 0, "stats after completion");
+	}
+
+	void TestOutOfOrder()
+	{
+		std::vector<std::vector<std::string>> chunks = Split({ Payload(64, 'a') });
+		Check(chunks[0].size() == 4, "message in four chunks");
+
+		MessageReassembler reassembler;
+		std::string payload;
+		Add(&reassembler, chunks[0][0], 0, &payload);
+		Check(reassembler.stats().buffered_bytes == 64, "length reserved on the first chunk");
+
+		// The message is dropped, and its later chunks with it.
+		Check(!Add(&reassembler, chunks[0][2], 0, &payload), "skipped chunk");
+		Check(!Add(&reassembler, chunks[0][1], 0, &payload) &&
+			!Add(&reassembler, chunks[0][3], 0, &payload), "chunks after the drop");
+		Check(reassembler.stats().completed == 0 && reassembler.stats().buffered_bytes == 0,
+			"out of order message dropped");
+
+		// Only a first chunk starts a message.
+		MessageReassembler late;
+		Check(!Add(&late, chunks[0][1], 0, &payload) && late.stats().dropped == 1, "missing first chunk");
+
+		// A restarted message replaces its incomplete copy.
+		MessageReassembler restarted;
+		Add(&restarted, chunks[0][0], 0, &payload);
+		Add(&restarted, chunks[0][1], 0, &payload);
+		bool completed = false;
+		for (const std::string& chunk : chunks[0])
+		{
+			completed = Add(&restarted, chunk, 0, &payload);
+		}
+
+		Check(completed && payload == Payload(64, 'a') && restarted.stats().dropped == 1 &&
+			restarted.stats().buffered_bytes == 0, "restarted message");
+	}
+
+	void TestMalformed()
+	{
+		std::vector<std::vector<std::string>> chunks = Split({ Payload(20, 'a') });
+		const std::string first = chunks[0][0];
+		const std::string last = chunks[0][1];
+
+		MessageReassembler reassembler;
+		std::string payload;
+		Check(!Add(&reassembler, first.substr(0, MessageChunker::kHeaderSize - 1), 0, &payload),
+			"truncated header");
+		Check(!Add(&reassembler, std::string(), 0, &payload), "empty chunk");
+		Check(!Add(&reassembler, "{\"type\":\"offer\"}", 0, &payload), "not a chunk");
+		Check(reassembler.stats().dropped == 3, "malformed chunks counted");
+
+		// The last chunk flag must match the length received.
+		std::string early_last = first;
+		early_last[1] = MessageChunker::kLastChunkFlag;
+		Check(!Add(&reassembler, early_last, 0, &payload), "last flag before the end");
+
+		std::string no_last = last;
+		no_last[1] = 0;
+		Add(&reassembler, first, 0, &payload);
+		Check(!Add(&reassembler, no_last, 0, &payload), "no last flag at the end");
+
+		// More data than the length announced.
+		std::string longer = last + "x";
+		Add(&reassembler, first, 0, &payload);
+		Check(!Add(&reassembler, longer, 0, &payload), "chunk past the length");
+
+		// Another length than the first chunk.
+		std::string other_length = last;
+		other_length[10] = 21;
+		Add(&reassembler, first, 0, &payload);
+		Check(!Add(&reassembler, other_length, 0, &payload), "length changed");
+
+		// Larger than the reassembler may buffer.
+		MessageReassembler small(8, 16);
+		Check(!Add(&small, first, 0, &payload) && small.stats().buffered_bytes == 0, "message too large");
+
+		Check(reassembler.stats().completed == 0 && reassembler.stats().buffered_bytes == 0,
+			"malformed messages dropped");
+
+		// The reassembler still works after them.
+		Check(!Add(&reassembler, first, 0, &payload) && Add(&reassembler, last, 0, &payload) &&
+			payload == Payload(20, 'a'), "message after malformed chunks");
+	}
+
+	void TestEviction()
+	{
+		std::vector<std::string> payloads;
+		for (int i = 0; i < 3; ++i)
+		{
+			payloads.push_back(Payload(48, static_cast<char>('a' + i)));
+		}
+
+		std::vector<std::vector<std::string>> chunks = Split(payloads);
+		std::string payload;
+
+		// The message which waited the longest makes room for a new one.
+		MessageReassembler by_count(2);
+		Add(&by_count, chunks[0][0], 0, &payload);
+		Add(&by_count, chunks[1][0], 10, &payload);
+		Add(&by_count, chunks[0][1], 20, &payload);
+		Add(&by_count, chunks[2][0], 30, &payload);
+		Check(by_count.stats().dropped == 1 && by_count.stats().buffered_bytes == 96,
+			"message evicted by count");
+		Check(!Add(&by_count, chunks[1][1], 40, &payload), "evicted message");
+		Check(Add(&by_count, chunks[0][2], 40, &payload) && payload == payloads[0], "kept message completes");
+
+		// The same with the buffered bytes.
+		MessageReassembler by_bytes(8, 100);
+		Add(&by_bytes, chunks[0][0], 0, &payload);
+		Add(&by_bytes, chunks[1][0], 10, &payload);
+		Add(&by_bytes, chunks[2][0], 20, &payload);
+		Check(by_bytes.stats().dropped == 1 && by_bytes.stats().buffered_bytes == 96,
+			"message evicted by bytes");
+		Check(!Add(&by_bytes, chunks[0][1], 30, &payload), "evicted message by bytes");
+		Check(!Add(&by_bytes, chunks[1][1], 30, &payload) && Add(&by_bytes, chunks[1][2], 30, &payload) &&
+			payload == payloads[1], "kept message completes by bytes");
+	}
+
+	void TestTimeout()
+	{
+		std::vector<std::vector<std::string>> chunks = Split({ Payload(48, 'a'), Payload(48, 'b') });
+		MessageReassembler reassembler;
+		std::string payload;
+
+		Add(&reassembler, chunks[0][0], 0, &payload);
+		Add(&reassembler, chunks[1][0], 5000, &payload);
+
+		// Each chunk restarts the timeout of its message.
+		Add(&reassembler, chunks[1][1], 10000, &payload);
+		Check(reassembler.stats().dropped == 0, "no timeout yet");
+
+		// Any chunk times the stale messages out, here one of the other.
+		Check(Add(&reassembler, chunks[1][2], 10001, &payload) && payload == Payload(48, 'b'),
+			"active message completes");
+		Check(reassembler.stats().dropped == 1 && reassembler.stats().buffered_bytes == 0,
+			"stale message timed out");
+		Check(!Add(&reassembler, chunks[0][1], 10001, &payload) && reassembler.stats().dropped == 2,
+			"chunk of the timed out message");
+	}
+}
+
+int main()
+{
+	TestInterleaving();
+	TestOutOfOrder();
+	TestMalformed();
+	TestEviction();
+	TestTimeout();
+
+	if (failures)
+	{
+		fprintf(stderr, "message_chunker_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("message_chunker_test: passed\n");
+	return EXIT_SUCCESS;
+}
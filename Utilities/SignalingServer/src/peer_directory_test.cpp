@@ -0,0 +1,217 @@
+// Checks PeerDirectory: the filter matching of names and tags, the lookups
+// on the name index, and the batches of changes handed to the observers,
+// where the changes within a batch which cancel out are not reported.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+#include <vector>
+
+#include "peer_directory.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	class RecordingObserver : public PeerDirectoryObserver
+	{
+	public:
+		void OnPeersChanged(const PeerDirectoryDelta& delta) override
+		{
+			deltas.push_back(delta);
+			if (directory_to_leave)
+			{
+				directory_to_leave->RemoveObserver(this);
+			}
+		}
+
+		std::vector<PeerDirectoryDelta> deltas;
+		PeerDirectory* directory_to_leave = nullptr;
+	};
+
+	std::string Names(const std::vector<PeerInfo>& peers)
+	{
+		std::string names;
+		for (const PeerInfo& peer : peers)
+		{
+			names += (names.empty() ? "" : ",") + std::to_string(peer.id) + ":" + peer.name;
+		}
+
+		return names;
+	}
+
+	void TestFilter()
+	{
+		PeerInfo peer = { 1, "renderingserver_user@host" };
+		Check(peer.tag() == "renderingserver", "tag before the first '_'");
+		PeerInfo untagged = { 2, "client" };
+		Check(untagged.tag() == "client", "whole name without '_'");
+
+		PeerFilter everything;
+		Check(everything.Matches("anything") && everything.Matches(""), "empty filter matches everything");
+
+		PeerFilter by_tag;
+		by_tag.tag = "renderingserver";
+		Check(by_tag.Matches("renderingserver_user@host") && by_tag.Matches("renderingserver"),
+			"tag matches");
+		Check(!by_tag.Matches("renderingserver2_user@host") && !by_tag.Matches("rendering_user@host"),
+			"tag must end at '_'");
+
+		PeerFilter by_prefix;
+		by_prefix.name_prefix = "renderingserver_al";
+		Check(by_prefix.Matches("renderingserver_alice@host") && !by_prefix.Matches("renderingserver_bob@host"),
+			"name prefix matches");
+
+		PeerFilter both = by_prefix;
+		both.tag = "renderingserver";
+		Check(both.Matches("renderingserver_alice@host") && !both.Matches("renderingserver_bob@host"),
+			"prefix and tag match");
+
+		PeerFilter short_prefix;
+		short_prefix.name_prefix = "ren";
+		short_prefix.tag = "renderingserver";
+		Check(short_prefix.Matches("renderingserver_alice@host") && !short_prefix.Matches("renderer_alice@host"),
+			"tag longer than the prefix");
+	}
+
+	void TestSelect()
+	{
+		PeerDirectory directory;
+		directory.Add(7, "renderingserver_alice@host");
+		directory.Add(3, "renderingserver_bob@host");
+		directory.Add(5, "client_alice@host");
+		directory.Add(9, "renderingserver2_carol@host");
+
+		PeerFilter servers;
+		servers.tag = "renderingserver";
+		std::vector<const PeerInfo*> selected = directory.Select(servers);
+		Check(selected.size() == 2 && selected[0]->id == 3 && selected[1]->id == 7, "selected by tag, by id");
+		Check(directory.Select().size() == 4, "everything selected");
+		Check(directory.Newest(servers)->id == 7 && directory.Newest()->id == 9, "newest peer");
+
+		PeerFilter none;
+		none.name_prefix = "renderingserver_zed";
+		Check(directory.Select(none).empty() && !directory.Newest(none), "nothing matches");
+
+		Check(directory.Find(5) && directory.Find(5)->name == "client_alice@host" && !directory.Find(4),
+			"find by id");
+	}
+
+	void TestDeltas()
+	{
+		PeerDirectory directory;
+		RecordingObserver observer;
+		directory.AddObserver(&observer);
+
+		directory.Add(1, "client_a");
+		directory.Add(2, "client_b");
+		directory.FlushChanges();
+		Check(observer.deltas.size() == 1 && !observer.deltas[0].reset &&
+			Names(observer.deltas[0].added) == "1:client_a,2:client_b" && observer.deltas[0].removed.empty(),
+			"additions delivered");
+
+		// A peer added and removed within a batch is never reported.
+		directory.Add(3, "client_c");
+		directory.Remove(3);
+		Check(!directory.has_pending_changes(), "addition and removal cancel out");
+		directory.FlushChanges();
+		Check(observer.deltas.size() == 1, "nothing delivered");
+
+		// Nor the names it had before the flush.
+		directory.Add(4, "client_d");
+		directory.Add(4, "client_e");
+		directory.FlushChanges();
+		Check(observer.deltas.size() == 2 && Names(observer.deltas[1].added) == "4:client_e" &&
+			observer.deltas[1].removed.empty(), "renamed before the flush");
+
+		// A reported peer renamed is removed and added.
+		directory.Add(4, "client_f");
+		Check(!directory.Add(4, "client_f") && !directory.Remove(8), "no change");
+		directory.FlushChanges();
+		Check(observer.deltas.size() == 3 && Names(observer.deltas[2].removed) == "4:client_e" &&
+			Names(observer.deltas[2].added) == "4:client_f", "renamed after the flush");
+
+		// Signed out and back in within a batch.
+		directory.Remove(1);
+		directory.Add(1, "client_a");
+		directory.FlushChanges();
+		Check(observer.deltas.size() == 4 && Names(observer.deltas[3].removed) == "1:client_a" &&
+			Names(observer.deltas[3].added) == "1:client_a", "signed in again");
+
+		// A reset replaces everything, the removals before it don't matter.
+		directory.Remove(2);
+		std::vector<PeerInfo> peers = { { 6, "client_g" }, { 5, "client_h" } };
+		directory.Reset(peers);
+		directory.Add(7, "client_i");
+		directory.Remove(7);
+		directory.FlushChanges();
+		Check(observer.deltas.size() == 5 && observer.deltas[4].reset && observer.deltas[4].removed.empty() &&
+			Names(observer.deltas[4].added) == "5:client_h,6:client_g", "reset delivered");
+		Check(directory.size() == 2 && !directory.has_pending_changes(), "directory after the reset");
+	}
+
+	void TestFilteredObservers()
+	{
+		PeerDirectory directory;
+		RecordingObserver servers;
+		RecordingObserver leaving;
+		PeerFilter filter;
+		filter.tag = "renderingserver";
+		directory.AddObserver(&servers, filter);
+		directory.AddObserver(&leaving, filter);
+		leaving.directory_to_leave = &directory;
+
+		directory.Add(1, "renderingserver_a");
+		directory.Add(2, "client_b");
+		directory.FlushChanges();
+		Check(servers.deltas.size() == 1 && Names(servers.deltas[0].added) == "1:renderingserver_a",
+			"only matching peers delivered");
+		Check(leaving.deltas.size() == 1, "observer leaving while notified");
+
+		// Nothing matching, no notification.
+		directory.Remove(2);
+		directory.Add(3, "client_c");
+		directory.FlushChanges();
+		Check(servers.deltas.size() == 1, "no matching change");
+
+		// Renamed out of the filter, only the removal matches.
+		directory.Add(1, "client_a");
+		directory.FlushChanges();
+		Check(servers.deltas.size() == 2 && Names(servers.deltas[1].removed) == "1:renderingserver_a" &&
+			servers.deltas[1].added.empty(), "renamed out of the filter");
+
+		// A reset is delivered even without a match.
+		directory.Reset(std::vector<PeerInfo>());
+		directory.FlushChanges();
+		Check(servers.deltas.size() == 3 && servers.deltas[2].reset && servers.deltas[2].added.empty(),
+			"reset without a match");
+		Check(leaving.deltas.size() == 1, "removed observer not notified");
+	}
+}
+
+int main()
+{
+	TestFilter();
+	TestSelect();
+	TestDeltas();
+	TestFilteredObservers();
+
+	if (failures)
+	{
+		fprintf(stderr, "peer_directory_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("peer_directory_test: passed\n");
+	return EXIT_SUCCESS;
+}
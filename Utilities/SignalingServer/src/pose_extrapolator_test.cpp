@@ -0,0 +1,373 @@
+// Replays head pose traces through InputParser and PoseExtrapolator the way
+// the stereo server samples receive them, as the camera-transform-stereo
+// messages of the HoloLens client with their "timestamp" send time and
+// "targetTime" prediction target.
+//
+// The traces are generated at 60 fps with the arrival jitter of a data
+// channel, so the extrapolated pose can be compared with the true pose at
+// the horizon it was extrapolated to. Also checks the cases where the
+// latest pose is used as is: a client which stopped sending poses, a new
+// projection and a client clock going backwards.
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+#include "input_parser.h"
+#include "pose_extrapolator.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	const int64_t kFramePeriodUs = 16667;
+
+	// DateTime::UniversalTime / 10 of a 2018 target time, as the client
+	// sends it.
+	const int64_t kClientStartUs = 13160000000000000;
+
+	// The server's clock, unrelated to the client's.
+	const int64_t kServerStartUs = 5000000000;
+
+	typedef double Matrix[4][4];
+
+	void Multiply(const Matrix a, const Matrix b, Matrix result)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				result[i][j] = 0;
+				for (int k = 0; k < 4; ++k)
+				{
+					result[i][j] += a[i][k] * b[k][j];
+				}
+			}
+		}
+	}
+
+	void Identity(Matrix m)
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				m[i][j] = i == j ? 1 : 0;
+			}
+		}
+	}
+
+	void Translation(double x, double y, double z, Matrix m)
+	{
+		Identity(m);
+		m[0][3] = x;
+		m[1][3] = y;
+		m[2][3] = z;
+	}
+
+	// Rotation of |angle| around the unit |axis|, for column vectors.
+	void Rotation(const double axis[3], double angle, Matrix m)
+	{
+		const double c = cos(angle);
+		const double s = sin(angle);
+		const double x = axis[0], y = axis[1], z = axis[2];
+		Identity(m);
+		m[0][0] = c + x * x * (1 - c);
+		m[0][1] = x * y * (1 - c) - z * s;
+		m[0][2] = x * z * (1 - c) + y * s;
+		m[1][0] = y * x * (1 - c) + z * s;
+		m[1][1] = c + y * y * (1 - c);
+		m[1][2] = y * z * (1 - c) - x * s;
+		m[2][0] = z * x * (1 - c) - y * s;
+		m[2][1] = z * y * (1 - c) + x * s;
+		m[2][2] = c + z * z * (1 - c);
+	}
+
+	// Right handed perspective projection with a depth range of [0, 1].
+	void Perspective(double vertical_fov, Matrix m)
+	{
+		const double near_plane = 0.1;
+		const double far_plane = 20;
+		const double scale = 1 / tan(vertical_fov / 2);
+		for (int i = 0; i < 4; ++i)
+		{
+			for (int j = 0; j < 4; ++j)
+			{
+				m[i][j] = 0;
+			}
+		}
+
+		m[0][0] = scale / (16. / 9.);
+		m[1][1] = scale;
+		m[2][2] = far_plane / (near_plane - far_plane);
+		m[2][3] = near_plane * far_plane / (near_plane - far_plane);
+		m[3][2] = -1;
+	}
+
+	// A head at |position| turning around |axis| at |angular_velocity|
+	// radians per second while moving at |velocity| meters per second.
+	struct Motion
+	{
+		double axis[3];
+		double angular_velocity;
+		double position[3];
+		double velocity[3];
+		double vertical_fov;
+	};
+
+	// The view projection matrix of one eye |time_us| after the start of the
+	// trace, row major as in the messages.
+	void EyeMatrix(const Motion& motion, int64_t time_us, double eye_offset, float values[16])
+	{
+		const double seconds = time_us / 1e6;
+		Matrix rotation, to_head, to_eye, projection, view, temp, result;
+		Rotation(motion.axis, -motion.angular_velocity * seconds, rotation);
+		Translation(-(motion.position[0] + motion.velocity[0] * seconds),
+			-(motion.position[1] + motion.velocity[1] * seconds),
+			-(motion.position[2] + motion.velocity[2] * seconds), to_head);
+		Translation(-eye_offset, 0, 0, to_eye);
+		Perspective(motion.vertical_fov, projection);
+
+		Multiply(rotation, to_head, temp);
+		Multiply(to_eye, temp, view);
+		Multiply(projection, view, result);
+		for (int i = 0; i < 16; ++i)
+		{
+			values[i] = static_cast<float>(result[i / 4][i % 4]);
+		}
+	}
+
+	void Pose(const Motion& motion, int64_t time_us, float left[16], float right[16])
+	{
+		EyeMatrix(motion, time_us, -0.032, left);
+		EyeMatrix(motion, time_us, 0.032, right);
+	}
+
+	// The message AppCallbacks::SendInputData writes.
+	std::string WriteMessage(const float left[16], const float right[16], int64_t timestamp_us,
+		int64_t target_time_us)
+	{
+		std::string body;
+		char value[32];
+		for (int i = 0; i < 32; ++i)
+		{
+			snprintf(value, sizeof(value), i ? ",%.7g" : "%.7g", i < 16 ? left[i] : right[i - 16]);
+			body += value;
+		}
+
+		return "{  \"type\":\"camera-transform-stereo\",  \"body\":\"" + body + "\"," +
+			"  \"timestamp\":" + std::to_string(timestamp_us) + "," +
+			"  \"targetTime\":" + std::to_string(target_time_us) + "}";
+	}
+
+	// What the stereo server samples do with the messages.
+	class PoseHandler : public InputHandler
+	{
+	public:
+		PoseHandler(PoseExtrapolator* extrapolator) :
+			extrapolator_(extrapolator),
+			now_us_(0)
+		{
+		}
+
+		void OnCameraStereo(const float left[16], const float right[16], int64_t target_time_us) override
+		{
+			extrapolator_->AddSample(target_time_us, now_us_, left, right);
+		}
+
+		void set_now_us(int64_t now_us) { now_us_ = now_us; }
+
+	private:
+		PoseExtrapolator* extrapolator_;
+		int64_t now_us_;
+	};
+
+	// Sends |frames| poses of |motion| starting at |first_frame|, predicted
+	// for the display 40 ms after they are sent and arriving 2 to 10 ms
+	// later. Returns the server time the last one arrived.
+	int64_t Replay(const Motion& motion, int first_frame, int frames, std::mt19937* random,
+		PoseHandler* handler)
+	{
+		std::uniform_int_distribution<int> send_jitter(-1500, 1500);
+		std::uniform_int_distribution<int> transit(2000, 10000);
+		int64_t received_us = 0;
+		for (int i = first_frame; i < first_frame + frames; ++i)
+		{
+			float left[16], right[16];
+			const int64_t target_us = i * kFramePeriodUs;
+			Pose(motion, target_us, left, right);
+
+			const int64_t sent_us = target_us - 40000 + send_jitter(*random);
+			std::string message = WriteMessage(left, right, kClientStartUs + sent_us,
+				kClientStartUs + target_us);
+
+			received_us = kServerStartUs + sent_us + transit(*random);
+			handler->set_now_us(received_us);
+			Check(InputParser::Dispatch(message.data(), message.size(), handler), "trace message parses");
+		}
+
+		return received_us;
+	}
+
+	float MaxDifference(const float a[16], const float b[16])
+	{
+		float difference = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			difference = (std::max)(difference, fabsf(a[i] - b[i]));
+		}
+
+		return difference;
+	}
+
+	// Replays |motion| then extrapolates a frame rendered 3 ms after the
+	// last pose arrived, which must be |precision| times closer to the true
+	// pose than the latest one.
+	void TestTrace(const char* name, const Motion& motion, float precision)
+	{
+		std::mt19937 random(42);
+		PoseExtrapolator extrapolator;
+		PoseHandler handler(&extrapolator);
+		const int frames = 30;
+		const int64_t received_us = Replay(motion, 0, frames, &random, &handler);
+
+		float left[16], right[16];
+		Check(extrapolator.Extrapolate(received_us + 3000, left, right), "trace extrapolates");
+
+		const PoseExtrapolatorStats& stats = extrapolator.stats();
+		Check(stats.samples == frames && stats.extrapolated == 1 && stats.discontinuities == 0,
+			"trace stats");
+
+		// The target time of the latest pose maps to its arrival time at the
+		// latest, so the horizon covers at least the pipeline latency.
+		Check(stats.horizon_us >= PoseExtrapolator::kDefaultPipelineLatencyUs &&
+			stats.horizon_us <= 100000, "trace horizon");
+		Check(fabs(stats.angular_velocity - motion.angular_velocity) < 0.05 * motion.angular_velocity,
+			"trace angular velocity");
+
+		float latest_left[16], latest_right[16], true_left[16], true_right[16];
+		const int64_t latest_us = (frames - 1) * kFramePeriodUs;
+		Pose(motion, latest_us, latest_left, latest_right);
+		Pose(motion, latest_us + stats.horizon_us, true_left, true_right);
+
+		const float held = MaxDifference(latest_left, true_left);
+		const float error = (std::max)(MaxDifference(left, true_left), MaxDifference(right, true_right));
+		printf("  %s: %.2f rad/s, %lld us horizon, error %.5f, %.5f without extrapolation\n", name,
+			stats.angular_velocity, static_cast<long long>(stats.horizon_us), error, held);
+		Check(error * precision < held, name);
+	}
+
+	const Motion kTurningInPlace =
+	{
+		{ 0, 1, 0 }, 1.5, { 0.2, 1.6, -0.5 }, { 0, 0, 0 }, 1.2
+	};
+
+	// Looking down to the right while walking forward.
+	const Motion kWalking =
+	{
+		{ 0.36, 0.8, 0.48 }, 0.8, { 0, 1.6, 0 }, { 0.3, 0, -1.2 }, 1.2
+	};
+
+	void TestStaleHistory()
+	{
+		std::mt19937 random(7);
+		PoseExtrapolator extrapolator;
+		PoseHandler handler(&extrapolator);
+		const int64_t received_us = Replay(kTurningInPlace, 0, 30, &random, &handler);
+
+		float left[16], right[16], latest_left[16], latest_right[16];
+		Pose(kTurningInPlace, 29 * kFramePeriodUs, latest_left, latest_right);
+
+		// The client paused 300 ms ago.
+		Check(extrapolator.Extrapolate(received_us + 300000, left, right), "stale history");
+		Check(MaxDifference(left, latest_left) < 1e-6f && MaxDifference(right, latest_right) < 1e-6f,
+			"stale history keeps the latest pose");
+		Check(extrapolator.stats().extrapolated == 0, "stale history isn't extrapolated");
+
+		// Extrapolates again once the client resumes.
+		const int64_t resumed_us = Replay(kTurningInPlace, 60, 10, &random, &handler);
+		extrapolator.Extrapolate(resumed_us + 3000, left, right);
+		Check(extrapolator.stats().extrapolated == 1, "resumed client extrapolates");
+	}
+
+	void TestDiscontinuities()
+	{
+		std::mt19937 random(3);
+		PoseExtrapolator extrapolator;
+		PoseHandler handler(&extrapolator);
+		Replay(kTurningInPlace, 0, 30, &random, &handler);
+
+		// A new projection isn't a head motion.
+		Motion zoomed = kTurningInPlace;
+		zoomed.vertical_fov = 0.9;
+		int64_t received_us = Replay(zoomed, 30, 1, &random, &handler);
+		Check(extrapolator.stats().discontinuities == 1, "new projection is a discontinuity");
+
+		float left[16], right[16], latest_left[16], latest_right[16];
+		extrapolator.Extrapolate(received_us + 3000, left, right);
+		Pose(zoomed, 30 * kFramePeriodUs, latest_left, latest_right);
+		Check(extrapolator.stats().extrapolated == 0 && MaxDifference(left, latest_left) < 1e-6f,
+			"new projection restarts the history");
+
+		// A client clock going backwards, a restarted client for instance,
+		// restarts it as well without being a discontinuity.
+		Replay(zoomed, 31, 10, &random, &handler);
+		received_us = Replay(zoomed, 5, 1, &random, &handler);
+		extrapolator.Extrapolate(received_us + 3000, left, right);
+		Pose(zoomed, 5 * kFramePeriodUs, latest_left, latest_right);
+		Check(extrapolator.stats().discontinuities == 1, "clock going backwards isn't a discontinuity");
+		Check(extrapolator.stats().extrapolated == 0 && MaxDifference(left, latest_left) < 1e-6f,
+			"clock going backwards restarts the history");
+	}
+
+	void TestTimestamps()
+	{
+		float left[16], right[16];
+		Pose(kTurningInPlace, 0, left, right);
+
+		InputMessage message;
+		std::string json = WriteMessage(left, right, kClientStartUs, kClientStartUs + 40000);
+		Check(InputParser::Parse(json.data(), json.size(), &message) &&
+			message.type == InputMessage::CAMERA_TRANSFORM_STEREO && message.timestamp_us == kClientStartUs &&
+			message.target_time_us == kClientStartUs + 40000, "send and target times");
+
+		// The other clients only send the sample time.
+		json = "{\"type\":\"camera-transform\",\"body\":\"0,0,0,0,0,0\",\"timestamp\":12}";
+		Check(InputParser::Parse(json.data(), json.size(), &message) && message.timestamp_us == 12 &&
+			message.target_time_us == 0, "no target time");
+
+		json = "{\"type\":\"camera-transform\",\"body\":\"0,0,0,0,0,0\",\"targetTime\":1.5}";
+		Check(!InputParser::Parse(json.data(), json.size(), &message), "malformed target time");
+	}
+}
+
+int main()
+{
+	TestTrace("turning in place", kTurningInPlace, 20);
+	TestTrace("walking", kWalking, 4);
+	TestStaleHistory();
+	TestDiscontinuities();
+	TestTimestamps();
+
+	if (failures)
+	{
+		fprintf(stderr, "pose_extrapolator_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("pose_extrapolator_test: passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,220 @@
+// Checks how PeerConnectionClient answers the errors of the signaling
+// server, through ReconnectController::ActionForResponse which it defers to.
+//
+// Besides the table itself, drives the signaling_server built next to it
+// with the client's HttpResponseParser: a peer the server forgot gets
+// "500 Peer most likely gone." on its wait and heartbeat, which must sign it
+// in again rather than end the session, while a refused sign in ends it.
+
+#include <arpa/inet.h>
+#include <libgen.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "http_response_parser.h"
+#include "reconnect_controller.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	void TestActions()
+	{
+		for (SignalingRequest request : { SIGNALING_SIGN_IN, SIGNALING_MESSAGE, SIGNALING_SIGN_OUT,
+			SIGNALING_WAIT, SIGNALING_HEARTBEAT })
+		{
+			Check(ReconnectController::ActionForResponse(request, 200) == RESPONSE_PROCESS, "200 is processed");
+		}
+
+		for (int status : { 500, 503, 404, 400 })
+		{
+			Check(ReconnectController::ActionForResponse(SIGNALING_WAIT, status) == RESPONSE_RECONNECT,
+				"failed wait signs in again");
+			Check(ReconnectController::ActionForResponse(SIGNALING_HEARTBEAT, status) == RESPONSE_RECONNECT,
+				"failed heartbeat signs in again");
+			Check(ReconnectController::ActionForResponse(SIGNALING_SIGN_OUT, status) == RESPONSE_DISCONNECT,
+				"failed sign out still disconnects");
+		}
+
+		Check(ReconnectController::ActionForResponse(SIGNALING_SIGN_IN, 400) == RESPONSE_DISCONNECT,
+			"refused sign in disconnects");
+	}
+
+	int ConnectSocket(int port)
+	{
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(static_cast<uint16_t>(port));
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+		{
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+
+	int PickPort()
+	{
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		socklen_t length = sizeof(address);
+		bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+		getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+		close(fd);
+		return ntohs(address.sin_port);
+	}
+
+	struct Response
+	{
+		int status;
+		int64_t peer_id;
+	};
+
+	// Sends |path| in its own HTTP/1.0 request, as the client's wait does.
+	Response Get(int port, const std::string& path)
+	{
+		Response response = { -1, -1 };
+		int fd = ConnectSocket(port);
+		if (fd < 0)
+		{
+			return response;
+		}
+
+		std::string request = "GET " + path + " HTTP/1.0\r\n\r\n";
+		send(fd, request.data(), request.size(), 0);
+
+		std::string data;
+		HttpResponseParser parser;
+		HttpResponseParser::Result result = HttpResponseParser::NEED_MORE_DATA;
+		char buffer[4096];
+		while (result == HttpResponseParser::NEED_MORE_DATA)
+		{
+			ssize_t bytes = recv(fd, buffer, sizeof(buffer), 0);
+			if (bytes <= 0)
+			{
+				result = parser.Finish();
+				break;
+			}
+
+			data.append(buffer, bytes);
+			result = parser.Parse(&data[0], data.size());
+		}
+
+		close(fd);
+		if (result == HttpResponseParser::COMPLETE)
+		{
+			response.status = parser.status_code();
+			parser.GetHeaderInt(data.data(), "Pragma", &response.peer_id);
+		}
+
+		return response;
+	}
+
+	void TestServerErrors(const std::string& server)
+	{
+		int port = PickPort();
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			freopen("/dev/null", "w", stdout);
+			execl(server.c_str(), server.c_str(), "--port", std::to_string(port).c_str(),
+				static_cast<char*>(nullptr));
+			_exit(127);
+		}
+
+		Response signed_in = { -1, -1 };
+		for (int i = 0; i < 500 && signed_in.status == -1; ++i)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			signed_in = Get(port, "/sign_in?peer_name=reconnect_test");
+		}
+
+		Check(ReconnectController::ActionForResponse(SIGNALING_SIGN_IN, signed_in.status) == RESPONSE_PROCESS &&
+			signed_in.peer_id > 0, "sign in");
+
+		std::string peer = "peer_id=" + std::to_string(signed_in.peer_id);
+		Response heartbeat = Get(port, "/heartbeat?" + peer);
+		Check(ReconnectController::ActionForResponse(SIGNALING_HEARTBEAT, heartbeat.status) == RESPONSE_PROCESS,
+			"heartbeat of a known peer");
+
+		// The server forgets the peer, as after a restart or a timeout.
+		Response signed_out = Get(port, "/sign_out?" + peer);
+		Check(ReconnectController::ActionForResponse(SIGNALING_SIGN_OUT, signed_out.status) == RESPONSE_PROCESS,
+			"sign out");
+
+		Response wait = Get(port, "/wait?" + peer);
+		Check(wait.status == 500, "wait of a forgotten peer fails");
+		Check(ReconnectController::ActionForResponse(SIGNALING_WAIT, wait.status) == RESPONSE_RECONNECT,
+			"wait of a forgotten peer signs in again");
+
+		heartbeat = Get(port, "/heartbeat?" + peer);
+		Check(ReconnectController::ActionForResponse(SIGNALING_HEARTBEAT, heartbeat.status) == RESPONSE_RECONNECT,
+			"heartbeat of a forgotten peer signs in again");
+
+		// What the reconnect sends, the previous id is gone so a new one is
+		// assigned.
+		Response resumed = Get(port, "/sign_in?peer_name=reconnect_test&" + peer);
+		Check(ReconnectController::ActionForResponse(SIGNALING_SIGN_IN, resumed.status) == RESPONSE_PROCESS &&
+			resumed.peer_id > 0 && resumed.peer_id != signed_in.peer_id, "sign in again");
+
+		Response refused = Get(port, "/sign_in?peer_name=");
+		Check(ReconnectController::ActionForResponse(SIGNALING_SIGN_IN, refused.status) == RESPONSE_DISCONNECT,
+			"refused sign in ends the session");
+
+		kill(pid, SIGTERM);
+		waitpid(pid, nullptr, 0);
+	}
+}
+
+int main(int, char* argv[])
+{
+	signal(SIGPIPE, SIG_IGN);
+	TestActions();
+
+	// Built in the same directory by "make all".
+	std::string path = argv[0];
+	std::string server = std::string(dirname(&path[0])) + "/signaling_server";
+	if (access(server.c_str(), X_OK) == 0)
+	{
+		TestServerErrors(server);
+	}
+	else
+	{
+		printf("reconnect_test: %s not built, only checking the actions\n", server.c_str());
+	}
+
+	if (failures)
+	{
+		fprintf(stderr, "reconnect_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("reconnect_test: passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,104 @@
+// Checks the hysteresis of SendFlowControl, which holds back the low
+// priority messages of a data channel between its water marks.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "send_flow_control.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	void TestHysteresis()
+	{
+		SendFlowControl flow_control(1000, 200);
+		Check(!flow_control.paused(), "starts sending");
+
+		flow_control.Update(999);
+		Check(!flow_control.paused(), "below the high water mark");
+
+		flow_control.Update(1000);
+		Check(flow_control.paused() && flow_control.stats().pauses == 1, "pauses at the high water mark");
+
+		// Draining between the marks doesn't resume.
+		flow_control.Update(500);
+		flow_control.Update(201);
+		Check(flow_control.paused(), "paused between the marks");
+
+		flow_control.Update(200);
+		Check(!flow_control.paused(), "resumes at the low water mark");
+
+		// Filling between the marks doesn't pause again.
+		flow_control.Update(999);
+		Check(!flow_control.paused() && flow_control.stats().pauses == 1, "sending between the marks");
+
+		// Each crossing of the high water mark counts once.
+		flow_control.Update(5000);
+		flow_control.Update(3000);
+		flow_control.Update(6000);
+		Check(flow_control.stats().pauses == 2, "one pause per crossing");
+		Check(flow_control.stats().buffered_amount == 6000 &&
+			flow_control.stats().max_buffered_amount == 6000, "buffered amount tracked");
+	}
+
+	void TestPriorities()
+	{
+		SendFlowControl flow_control(1000, 200);
+		Check(flow_control.ShouldSend(0, SendFlowControl::LOW_PRIORITY), "low priority sent");
+
+		Check(!flow_control.ShouldSend(1500, SendFlowControl::LOW_PRIORITY), "low priority held back");
+		Check(flow_control.ShouldSend(1500, SendFlowControl::HIGH_PRIORITY), "high priority always sent");
+		Check(!flow_control.ShouldSend(800, SendFlowControl::LOW_PRIORITY), "held back until drained");
+		Check(flow_control.stats().dropped == 2, "held back messages counted");
+
+		Check(flow_control.ShouldSend(100, SendFlowControl::LOW_PRIORITY), "low priority after draining");
+		Check(flow_control.stats().dropped == 2 && flow_control.stats().max_buffered_amount == 1500,
+			"stats after draining");
+	}
+
+	void TestMarks()
+	{
+		// A low water mark above the high one is clamped to it, the sender
+		// resumes on the next update at or below it.
+		SendFlowControl inverted(1000, 4000);
+		inverted.Update(1000);
+		Check(inverted.paused(), "inverted marks pause");
+		inverted.Update(1000);
+		Check(!inverted.paused(), "inverted marks resume at the high water mark");
+
+		SendFlowControl defaults;
+		defaults.Update(SendFlowControl::kDefaultHighWaterMark - 1);
+		Check(!defaults.paused(), "default high water mark");
+		defaults.Update(SendFlowControl::kDefaultHighWaterMark);
+		defaults.Update(SendFlowControl::kDefaultLowWaterMark + 1);
+		Check(defaults.paused(), "default low water mark");
+		defaults.Update(SendFlowControl::kDefaultLowWaterMark);
+		Check(!defaults.paused(), "default marks resume");
+	}
+}
+
+int main()
+{
+	TestHysteresis();
+	TestPriorities();
+	TestMarks();
+
+	if (failures)
+	{
+		fprintf(stderr, "send_flow_control_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("send_flow_control_test: passed\n");
+	return EXIT_SUCCESS;
+}
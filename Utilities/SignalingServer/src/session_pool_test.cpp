@@ -0,0 +1,254 @@
+// Drives CNvEncoderSessionPool, the pool of warm NvEnc sessions of the
+// streaming encoder, with a mock encoder session so it runs without NvEnc.
+//
+// Checks the lease hits and misses, the reset of returned sessions, the idle
+// limit, the limit of sessions the GPU runs at once, that sessions of stale
+// encode settings are never leased, and that concurrent prewarms and returns
+// never keep more idle sessions than the limit.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "NvEncoderSessionPool.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	class MockEncoderSession : public INvEncoderSession
+	{
+	public:
+		explicit MockEncoderSession(const EncoderSessionKey& key) :
+			key(key),
+			resets(0),
+			fail_reset(false)
+		{
+		}
+
+		NVENCSTATUS Reset() override
+		{
+			resets++;
+			return fail_reset ? NV_ENC_ERR_GENERIC : NV_ENC_SUCCESS;
+		}
+
+		EncoderSessionKey key;
+		int resets;
+		bool fail_reset;
+	};
+
+	class MockEncoderSessionFactory : public INvEncoderSessionFactory
+	{
+	public:
+		MockEncoderSessionFactory() : created(0), destroyed(0), fail_create(false) {}
+
+		INvEncoderSession* CreateSession(const EncoderSessionKey& key) override
+		{
+			if (fail_create)
+			{
+				return nullptr;
+			}
+
+			// Leaves time for the other threads to race the insert.
+			std::this_thread::yield();
+			created++;
+			return new MockEncoderSession(key);
+		}
+
+		void DestroySession(INvEncoderSession* session) override
+		{
+			destroyed++;
+			delete session;
+		}
+
+		std::atomic<int> created;
+		std::atomic<int> destroyed;
+		bool fail_create;
+	};
+
+	const EncoderSessionKey kKey720p = { 1280, 720, 2, 0 };
+	const EncoderSessionKey kKey1080p = { 1920, 1080, 2, 0 };
+
+	// Enough sessions for the tests which don't check the session limit.
+	const uint32_t kMaxSessions = 8;
+
+	void TestLease()
+	{
+		MockEncoderSessionFactory factory;
+		{
+			CNvEncoderSessionPool pool(&factory, 2, kMaxSessions);
+			Check(pool.Prewarm(kKey720p, 2) == NV_ENC_SUCCESS, "prewarm succeeds");
+			Check(pool.GetIdleCount(kKey720p) == 2, "prewarm fills the pool");
+			Check(pool.GetIdleCount(kKey1080p) == 0, "prewarm is per key");
+
+			INvEncoderSession* warm = pool.Lease(kKey720p);
+			INvEncoderSession* cold = pool.Lease(kKey1080p);
+			Check(warm != nullptr && cold != nullptr, "lease returns a session");
+			Check(static_cast<MockEncoderSession*>(cold)->key.width == 1920, "miss creates for the key");
+
+			EncoderSessionPoolStats stats = pool.GetStats();
+			Check(stats.uLeaseHits == 1 && stats.uLeaseMisses == 1, "hits and misses counted");
+			Check(stats.uIdleSessions == 1 && stats.uLeasedSessions == 2, "idle and leased counted");
+
+			pool.Return(kKey720p, warm);
+			Check(static_cast<MockEncoderSession*>(warm)->resets == 1, "return resets the session");
+			Check(pool.Lease(kKey720p) == warm, "returned session is leased again");
+			pool.Return(kKey720p, warm);
+
+			// A session failing to reset is destroyed, not kept.
+			static_cast<MockEncoderSession*>(cold)->fail_reset = true;
+			pool.Return(kKey1080p, cold);
+			Check(pool.GetIdleCount(kKey1080p) == 0, "failed reset is not kept");
+			Check(pool.GetStats().uResetFailures == 1, "reset failure counted");
+			Check(factory.destroyed == 1, "failed reset is destroyed");
+		}
+
+		Check(factory.created == factory.destroyed, "pool destroys its idle sessions");
+	}
+
+	void TestIdleLimit()
+	{
+		MockEncoderSessionFactory factory;
+		CNvEncoderSessionPool pool(&factory, 1, kMaxSessions);
+		Check(pool.Prewarm(kKey720p, 4) == NV_ENC_SUCCESS, "prewarm over the limit succeeds");
+		Check(pool.GetIdleCount(kKey720p) == 1, "prewarm is capped by the limit");
+
+		INvEncoderSession* first = pool.Lease(kKey720p);
+		INvEncoderSession* second = pool.Lease(kKey720p);
+		pool.Return(kKey720p, first);
+		pool.Return(kKey720p, second);
+		Check(pool.GetIdleCount(kKey720p) == 1, "return is capped by the limit");
+		Check(factory.destroyed == 1, "sessions over the limit are destroyed");
+
+		factory.fail_create = true;
+		pool.Clear();
+		Check(pool.Prewarm(kKey720p, 1) == NV_ENC_ERR_OUT_OF_MEMORY, "prewarm reports a failed create");
+		Check(pool.GetStats().uIdleSessions == 0, "clear empties the pool");
+	}
+
+	void TestSessionLimit()
+	{
+		MockEncoderSessionFactory factory;
+		{
+			CNvEncoderSessionPool pool(&factory, 2, 2);
+			Check(pool.Prewarm(kKey720p, 2) == NV_ENC_SUCCESS, "prewarm up to the session limit");
+			Check(pool.Prewarm(kKey1080p, 1) == NV_ENC_ERR_ENCODER_BUSY, "prewarm stops at the session limit");
+			Check(pool.GetIdleCount(kKey1080p) == 0, "nothing prewarmed past the limit");
+
+			// A stream of another resolution takes the slot of an idle session.
+			INvEncoderSession* session = pool.Lease(kKey1080p);
+			Check(session != nullptr, "lease at the session limit");
+			Check(pool.GetIdleCount(kKey720p) == 1, "lease evicts an idle session");
+			Check(pool.GetStats().uEvictedSessions == 1 && factory.destroyed == 1, "eviction counted");
+
+			Check(pool.Prewarm(kKey720p, 2) == NV_ENC_ERR_ENCODER_BUSY, "leased sessions count against the limit");
+			pool.Return(kKey1080p, session);
+			Check(pool.GetStats().uIdleSessions == 2 && pool.GetStats().uLeasedSessions == 0, "sessions counted");
+		}
+
+		Check(factory.created == factory.destroyed, "pool destroys its idle sessions");
+	}
+
+	void TestConfigVersion()
+	{
+		const EncoderSessionKey kKeyVersion1 = { 1280, 720, 2, 1 };
+
+		MockEncoderSessionFactory factory;
+		CNvEncoderSessionPool pool(&factory, 2, kMaxSessions);
+		Check(pool.Prewarm(kKey720p, 2) == NV_ENC_SUCCESS, "prewarm version 0");
+		INvEncoderSession* stale = pool.Lease(kKey720p);
+
+		// The settings changed, the idle sessions of version 0 are destroyed.
+		pool.SetConfigVersion(1);
+		Check(pool.GetIdleCount(kKey720p) == 0 && factory.destroyed == 1, "change destroys the idle sessions");
+		Check(pool.GetStats().uEvictedSessions == 1, "stale sessions counted");
+
+		INvEncoderSession* current = pool.Lease(kKeyVersion1);
+		Check(current != nullptr && current != stale, "lease never returns a stale session");
+		Check(pool.GetStats().uLeaseMisses == 1, "new version misses");
+
+		// The leased session of version 0 isn't kept when the stream stops.
+		pool.Return(kKey720p, stale);
+		Check(pool.GetIdleCount(kKey720p) == 0 && factory.destroyed == 2, "stale return destroyed");
+
+		pool.Return(kKeyVersion1, current);
+		Check(pool.GetIdleCount(kKeyVersion1) == 1, "current return kept");
+
+		// A prewarm racing the change doesn't create stale sessions.
+		const int created = factory.created;
+		Check(pool.Prewarm(kKey720p, 1) == NV_ENC_SUCCESS && factory.created == created, "stale prewarm ignored");
+	}
+
+	void TestConcurrentPrewarm()
+	{
+		const uint32_t kMaxIdle = 3;
+		for (int round = 0; round < 200; ++round)
+		{
+			MockEncoderSessionFactory factory;
+			CNvEncoderSessionPool pool(&factory, kMaxIdle, kMaxSessions);
+
+			std::vector<std::thread> threads;
+			for (int i = 0; i < 4; ++i)
+			{
+				threads.emplace_back([&pool]()
+				{
+					pool.Prewarm(kKey720p, kMaxIdle);
+				});
+			}
+
+			threads.emplace_back([&pool]()
+			{
+				pool.Return(kKey720p, pool.Lease(kKey720p));
+			});
+
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+
+			if (pool.GetIdleCount(kKey720p) > kMaxIdle ||
+				pool.GetStats().uIdleSessions > kMaxIdle)
+			{
+				Check(false, "concurrent prewarm keeps the idle limit");
+				return;
+			}
+
+			pool.Clear();
+			if (factory.created != factory.destroyed)
+			{
+				Check(false, "concurrent prewarm destroys the extra sessions");
+				return;
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestLease();
+	TestIdleLimit();
+	TestSessionLimit();
+	TestConfigVersion();
+	TestConcurrentPrewarm();
+
+	if (failures)
+	{
+		fprintf(stderr, "session_pool_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("session_pool_test: passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,902 @@
+#include "signaling_server.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+namespace
+{
+	const int kListenBacklog = 4096;
+	const size_t kReadChunkSize = 16 * 1024;
+	const int64_t kSweepIntervalMs = 1000;
+
+	// Input buffered on a connection whose requests aren't being processed,
+	// e.g. behind a parked wait.
+	const size_t kMaxInputSize = HttpRequestParser::kMaxHeaderSize + HttpRequestParser::kMaxBodySize;
+
+	// Headers of every HTTP response, the WebClient reads Pragma and
+	// X-Message-Batching from another origin.
+	const char kCommonHeaders[] =
+		"Server: SignalingServer\r\n"
+		"Cache-Control: no-cache\r\n"
+		"Content-Type: text/plain\r\n"
+		"Access-Control-Allow-Origin: *\r\n"
+		"Access-Control-Expose-Headers: Pragma, X-Message-Batching\r\n";
+
+	const char kCorsPreflightHeaders[] =
+		"Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+		"Access-Control-Allow-Headers: Content-Type, Content-Length, Connection, Cache-Control\r\n";
+
+	int64_t ReadResidentSetSize()
+	{
+		FILE* statm = fopen("/proc/self/statm", "r");
+		if (!statm)
+		{
+			return 0;
+		}
+
+		long size = 0;
+		long resident = 0;
+		int fields = fscanf(statm, "%ld %ld", &size, &resident);
+		fclose(statm);
+		return fields == 2 ? static_cast<int64_t>(resident) * sysconf(_SC_PAGESIZE) : 0;
+	}
+}
+
+SignalingServer::SignalingServer(EventLoop* loop, const Options& options) :
+	loop_(loop),
+	options_(options),
+	listen_fd_(-1),
+	next_peer_id_(1),
+	next_serial_(1),
+	sign_ins_(0),
+	resumes_(0),
+	messages_(0),
+	queued_messages_(0)
+{
+}
+
+SignalingServer::~SignalingServer()
+{
+	for (auto& entry : connections_)
+	{
+		loop_->Remove(entry.first);
+		close(entry.first);
+	}
+
+	for (auto& connection : closing_)
+	{
+		close(connection->fd);
+	}
+
+	if (listen_fd_ >= 0)
+	{
+		loop_->Remove(listen_fd_);
+		close(listen_fd_);
+	}
+}
+
+bool SignalingServer::Start()
+{
+	if (!Listen())
+	{
+		return false;
+	}
+
+	loop_->AddTimer(kSweepIntervalMs, [this]() { SweepPeers(); });
+	return true;
+}
+
+bool SignalingServer::Listen()
+{
+	listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listen_fd_ < 0)
+	{
+		fprintf(stderr, "socket failed: %s\n", strerror(errno));
+		return false;
+	}
+
+	int enable = 1;
+	setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+	sockaddr_in address;
+	memset(&address, 0, sizeof(address));
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_ANY);
+	address.sin_port = htons(static_cast<uint16_t>(options_.port));
+	if (bind(listen_fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+		listen(listen_fd_, kListenBacklog) != 0)
+	{
+		fprintf(stderr, "Unable to listen on port %d: %s\n", options_.port, strerror(errno));
+		return false;
+	}
+
+	return loop_->Add(listen_fd_, EPOLLIN, [this](uint32_t) { OnAccept(); });
+}
+
+SignalingServerStats SignalingServer::GetStats() const
+{
+	SignalingServerStats stats;
+	stats.peers = static_cast<int>(peers_.size());
+	stats.connections = static_cast<int>(connections_.size());
+	stats.waiting = 0;
+	for (const auto& entry : peers_)
+	{
+		stats.waiting += (entry.second.wait_fd != -1 || entry.second.websocket_fd != -1) ? 1 : 0;
+	}
+
+	stats.sign_ins = sign_ins_;
+	stats.resumes = resumes_;
+	stats.messages = messages_;
+	stats.queued_messages = queued_messages_;
+	stats.rss_bytes = ReadResidentSetSize();
+	return stats;
+}
+
+void SignalingServer::OnAccept()
+{
+	// Edge triggered, accepts until the backlog is empty.
+	while (true)
+	{
+		int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			if (errno == EINTR || errno == ECONNABORTED)
+			{
+				continue;
+			}
+
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				// Typically EMFILE, raise the descriptor limit.
+				fprintf(stderr, "accept failed: %s\n", strerror(errno));
+			}
+
+			return;
+		}
+
+		int enable = 1;
+		setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+		std::unique_ptr<Connection> connection(new Connection());
+		connection->fd = fd;
+		connection->serial = next_serial_++;
+		if (!loop_->Add(fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP,
+			[this, fd](uint32_t events) { OnConnectionEvent(fd, events); }))
+		{
+			close(fd);
+			continue;
+		}
+
+		connections_[fd] = std::move(connection);
+	}
+}
+
+void SignalingServer::OnConnectionEvent(int fd, uint32_t events)
+{
+	auto it = connections_.find(fd);
+	if (it == connections_.end())
+	{
+		return;
+	}
+
+	Connection* connection = it->second.get();
+	if (events & EPOLLOUT)
+	{
+		Flush(connection);
+	}
+
+	if (connection->closed || !(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)))
+	{
+		return;
+	}
+
+	bool eof = false;
+	char buffer[kReadChunkSize];
+	while (true)
+	{
+		ssize_t received = recv(fd, buffer, sizeof(buffer), 0);
+		if (received > 0)
+		{
+			connection->input.append(buffer, received);
+			continue;
+		}
+
+		if (received < 0 && errno == EINTR)
+		{
+			continue;
+		}
+
+		eof = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+		break;
+	}
+
+	if (connection->websocket)
+	{
+		ProcessWebSocketInput(connection);
+	}
+	else
+	{
+		ProcessInput(connection);
+	}
+
+	if (eof || connection->input.size() > kMaxInputSize)
+	{
+		CloseConnection(fd);
+	}
+}
+
+void SignalingServer::ProcessInput(Connection* connection)
+{
+	HttpRequest request;
+	while (!connection->closed && !connection->parked && !connection->websocket &&
+		!connection->close_after_write)
+	{
+		HttpRequestParser::Result result = connection->parser.Parse(&connection->input, &request);
+		if (result == HttpRequestParser::NEED_MORE_DATA)
+		{
+			return;
+		}
+
+		if (result == HttpRequestParser::PARSE_ERROR)
+		{
+			connection->keep_alive = false;
+			connection->input.clear();
+			SendResponse(connection, "400 Bad Request", "", "");
+			return;
+		}
+
+		connection->keep_alive = request.keep_alive;
+		HandleRequest(connection, request);
+	}
+
+	if (connection->websocket && !connection->closed)
+	{
+		// Frames sent right behind the upgrade request.
+		ProcessWebSocketInput(connection);
+	}
+}
+
+void SignalingServer::HandleRequest(Connection* connection, const HttpRequest& request)
+{
+	if (request.method == "OPTIONS")
+	{
+		SendResponse(connection, "200 OK", kCorsPreflightHeaders, "");
+		return;
+	}
+
+	if (request.path == "/sign_in")
+	{
+		HandleSignIn(connection, request);
+		return;
+	}
+
+	if (request.path == "/ws")
+	{
+		HandleWebSocketUpgrade(connection, request);
+		return;
+	}
+
+	if (request.path == "/stats")
+	{
+		HandleStats(connection);
+		return;
+	}
+
+	if (request.path == "/admin/drop" && options_.admin)
+	{
+		HandleDrop(connection, request);
+		return;
+	}
+
+	auto it = peers_.find(request.GetQueryParamInt("peer_id", -1));
+	if (it == peers_.end())
+	{
+		SendResponse(connection, "500 Error", "", "Peer most likely gone.");
+		return;
+	}
+
+	Peer* peer = &it->second;
+	peer->last_seen_ms = EventLoop::NowMs();
+	if (request.path == "/wait")
+	{
+		HandleWait(connection, peer);
+	}
+	else if (request.path == "/message")
+	{
+		HandleMessage(connection, request, peer);
+	}
+	else if (request.path == "/heartbeat")
+	{
+		peer->heartbeats = true;
+		SendResponse(connection, "200 OK", "", "");
+	}
+	else if (request.path == "/sign_out")
+	{
+		HandleSignOut(connection, peer);
+	}
+	else
+	{
+		SendResponse(connection, "404 Not Found", "", "");
+	}
+}
+
+void SignalingServer::HandleSignIn(Connection* connection, const HttpRequest& request)
+{
+	// The WebClient sends the name as the whole query string.
+	std::string name = request.GetQueryParam("peer_name", request.query);
+	if (name.empty() || name.find_first_of(",\r\n") != std::string::npos)
+	{
+		SendResponse(connection, "400 Bad Request", "", "Invalid peer name.");
+		return;
+	}
+
+	Peer* peer = FindResumablePeer(request, name);
+	bool resumed = peer != nullptr;
+	if (!resumed)
+	{
+		peer = AddPeer(name);
+	}
+
+	SendResponse(connection, "200 Added",
+		"Pragma: " + std::to_string(peer->id) + "\r\nX-Message-Batching: 1\r\n", GetPeerList(*peer));
+
+	if (!resumed)
+	{
+		Broadcast(*peer, true);
+	}
+}
+
+void SignalingServer::HandleWait(Connection* connection, Peer* peer)
+{
+	if (peer->wait_fd != -1 && peer->wait_fd != connection->fd)
+	{
+		// Only one wait per peer, the newest wins.
+		CloseConnection(peer->wait_fd);
+	}
+
+	if (!peer->queue.empty())
+	{
+		PendingMessage message = std::move(peer->queue.front());
+		peer->queue.pop_front();
+		peer->queued_bytes -= message.body.size();
+		queued_messages_--;
+		SendResponse(connection, "200 OK", "Pragma: " + std::to_string(message.from_id) + "\r\n",
+			message.body);
+		return;
+	}
+
+	peer->wait_fd = connection->fd;
+	connection->peer_id = peer->id;
+	connection->parked = true;
+}
+
+void SignalingServer::HandleMessage(Connection* connection, const HttpRequest& request, Peer* peer)
+{
+	auto it = peers_.find(request.GetQueryParamInt("to", -1));
+	if (it == peers_.end() || it->first == peer->id)
+	{
+		SendResponse(connection, "500 Error", "", "Peer most likely gone.");
+		return;
+	}
+
+	if (!Deliver(&it->second, peer->id, request.body))
+	{
+		SendResponse(connection, "503 Service Unavailable", "", "Peer is not reading its messages.");
+		return;
+	}
+
+	messages_++;
+	SendResponse(connection, "200 OK", "", "");
+}
+
+void SignalingServer::HandleSignOut(Connection* connection, Peer* peer)
+{
+	RemovePeer(peer->id);
+	SendResponse(connection, "200 OK", "", "");
+}
+
+void SignalingServer::HandleStats(Connection* connection)
+{
+	SignalingServerStats stats = GetStats();
+	std::string body = "{\"peers\":" + std::to_string(stats.peers) +
+		",\"connections\":" + std::to_string(stats.connections) +
+		",\"waiting\":" + std::to_string(stats.waiting) +
+		",\"sign_ins\":" + std::to_string(stats.sign_ins) +
+		",\"resumes\":" + std::to_string(stats.resumes) +
+		",\"messages\":" + std::to_string(stats.messages) +
+		",\"queued_messages\":" + std::to_string(stats.queued_messages) +
+		",\"rss_bytes\":" + std::to_string(stats.rss_bytes) + "}";
+
+	SendResponse(connection, "200 OK", "", body);
+}
+
+void SignalingServer::HandleDrop(Connection* connection, const HttpRequest& request)
+{
+	int down_ms = (std::max)(request.GetQueryParamInt("down_ms", 0), 0);
+	bool forget = request.GetQueryParamInt("forget", 0) != 0;
+	printf("Dropping every connection, down for %d ms%s\n", down_ms, forget ? ", forgetting the peers" : "");
+	fflush(stdout);
+
+	connection->keep_alive = false;
+	SendResponse(connection, "200 OK", "", "");
+
+	std::vector<int> fds;
+	for (const auto& entry : connections_)
+	{
+		if (entry.second.get() != connection)
+		{
+			fds.push_back(entry.first);
+		}
+	}
+
+	for (int fd : fds)
+	{
+		CloseConnection(fd);
+	}
+
+	if (forget)
+	{
+		peers_.clear();
+		queued_messages_ = 0;
+	}
+
+	// Connection attempts are refused until the server listens again.
+	if (listen_fd_ >= 0)
+	{
+		loop_->Remove(listen_fd_);
+		close(listen_fd_);
+		listen_fd_ = -1;
+	}
+
+	loop_->AddTimer(down_ms, [this]()
+	{
+		if (listen_fd_ < 0 && !Listen())
+		{
+			fprintf(stderr, "Unable to listen again after the drop\n");
+		}
+	});
+}
+
+void SignalingServer::HandleWebSocketUpgrade(Connection* connection, const HttpRequest& request)
+{
+	std::string name = request.GetQueryParam("peer_name");
+	if (!request.upgrade_websocket || name.empty() || name.find_first_of(",\r\n") != std::string::npos)
+	{
+		SendResponse(connection, "400 Bad Request", "", "Invalid WebSocket request.");
+		return;
+	}
+
+	std::string response =
+		"HTTP/1.1 101 Switching Protocols\r\n"
+		"Upgrade: websocket\r\n"
+		"Connection: Upgrade\r\n"
+		"Sec-WebSocket-Accept: " + WebSocketCodec::ComputeAccept(request.websocket_key) + "\r\n\r\n";
+
+	Write(connection, response.data(), response.size());
+	if (connection->closed)
+	{
+		return;
+	}
+
+	Peer* peer = FindResumablePeer(request, name);
+	bool resumed = peer != nullptr;
+	if (!resumed)
+	{
+		peer = AddPeer(name);
+	}
+	else if (peer->websocket_fd != -1)
+	{
+		// The previous connection is still open on our side.
+		CloseConnection(peer->websocket_fd);
+	}
+
+	peer->websocket_fd = connection->fd;
+	connection->peer_id = peer->id;
+	connection->websocket = true;
+
+	// The first message carries our id and the peer list, like the sign in
+	// response.
+	SendWebSocketMessage(connection, peer->id, GetPeerList(*peer));
+	if (!resumed)
+	{
+		Broadcast(*peer, true);
+		return;
+	}
+
+	// Messages which arrived while the peer was away.
+	while (!peer->queue.empty() && !connection->closed)
+	{
+		PendingMessage message = std::move(peer->queue.front());
+		peer->queue.pop_front();
+		peer->queued_bytes -= message.body.size();
+		queued_messages_--;
+		SendWebSocketMessage(connection, message.from_id, message.body);
+	}
+}
+
+void SignalingServer::ProcessWebSocketInput(Connection* connection)
+{
+	auto peer = peers_.find(connection->peer_id);
+	if (peer == peers_.end())
+	{
+		CloseConnection(connection->fd);
+		return;
+	}
+
+	peer->second.last_seen_ms = EventLoop::NowMs();
+
+	WebSocketCodec::Opcode opcode;
+	std::string payload;
+	WebSocketCodec::Result result;
+	while (!connection->closed && !connection->close_after_write &&
+		(result = connection->codec.ReadMessage(&connection->input, &opcode, &payload)) ==
+		WebSocketCodec::COMPLETE)
+	{
+		switch (opcode)
+		{
+		case WebSocketCodec::TEXT:
+		{
+			// "<to>\n<message>"
+			size_t eol = payload.find('\n');
+			int to = eol == std::string::npos ? -1 : atoi(payload.substr(0, eol).c_str());
+			auto target = peers_.find(to);
+			if (target != peers_.end() && to != connection->peer_id &&
+				Deliver(&target->second, connection->peer_id, payload.substr(eol + 1)))
+			{
+				messages_++;
+			}
+
+			break;
+		}
+
+		case WebSocketCodec::PING:
+		{
+			// Client heartbeat.
+			peer->second.heartbeats = true;
+			std::string frame;
+			WebSocketCodec::WriteFrame(WebSocketCodec::PONG, payload.data(), payload.size(), &frame);
+			Write(connection, frame.data(), frame.size());
+			break;
+		}
+
+		case WebSocketCodec::CLOSE:
+		{
+			// Echoes the close frame, then signs the peer out.
+			std::string frame;
+			WebSocketCodec::WriteFrame(WebSocketCodec::CLOSE, payload.data(),
+				(std::min)(payload.size(), static_cast<size_t>(2)), &frame);
+
+			int peer_id = connection->peer_id;
+			peer->second.websocket_fd = -1;
+			connection->peer_id = -1;
+			connection->close_after_write = true;
+			Write(connection, frame.data(), frame.size());
+			RemovePeer(peer_id);
+			return;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	if (!connection->closed && result == WebSocketCodec::PARSE_ERROR)
+	{
+		CloseConnection(connection->fd);
+	}
+}
+
+SignalingServer::Peer* SignalingServer::AddPeer(const std::string& name)
+{
+	Peer& peer = peers_[next_peer_id_];
+	peer.id = next_peer_id_++;
+	peer.name = name;
+	peer.last_seen_ms = EventLoop::NowMs();
+	sign_ins_++;
+	return &peer;
+}
+
+SignalingServer::Peer* SignalingServer::FindResumablePeer(const HttpRequest& request,
+	const std::string& name)
+{
+	auto it = peers_.find(request.GetQueryParamInt("peer_id", -1));
+	if (it == peers_.end() || it->second.name != name)
+	{
+		return nullptr;
+	}
+
+	it->second.last_seen_ms = EventLoop::NowMs();
+	resumes_++;
+	return &it->second;
+}
+
+void SignalingServer::RemovePeer(int peer_id)
+{
+	auto it = peers_.find(peer_id);
+	if (it == peers_.end())
+	{
+		return;
+	}
+
+	Peer peer = std::move(it->second);
+	peers_.erase(it);
+	queued_messages_ -= peer.queue.size();
+
+	if (peer.wait_fd != -1)
+	{
+		CloseConnection(peer.wait_fd);
+	}
+
+	if (peer.websocket_fd != -1)
+	{
+		CloseConnection(peer.websocket_fd);
+	}
+
+	Broadcast(peer, false);
+}
+
+std::string SignalingServer::GetPeerList(const Peer& peer) const
+{
+	std::string list = peer.name + "," + std::to_string(peer.id) + ",1\n";
+	if (!options_.presence)
+	{
+		return list;
+	}
+
+	for (const auto& entry : peers_)
+	{
+		if (entry.first == peer.id)
+		{
+			continue;
+		}
+
+		list += entry.second.name + "," + std::to_string(entry.first) + ",1\n";
+	}
+
+	return list;
+}
+
+bool SignalingServer::Deliver(Peer* peer, int from_id, const std::string& body)
+{
+	if (peer->websocket_fd != -1)
+	{
+		auto it = connections_.find(peer->websocket_fd);
+		if (it != connections_.end())
+		{
+			SendWebSocketMessage(it->second.get(), from_id, body);
+		}
+
+		return true;
+	}
+
+	// Notifications (from the peer itself) are never refused.
+	if (from_id != peer->id && peer->queued_bytes + body.size() > kMaxQueuedBytes)
+	{
+		return false;
+	}
+
+	PendingMessage message;
+	message.from_id = from_id;
+	message.body = body;
+	peer->queue.push_back(std::move(message));
+	peer->queued_bytes += body.size();
+	queued_messages_++;
+
+	if (peer->wait_fd != -1)
+	{
+		AnswerWait(peer);
+	}
+
+	return true;
+}
+
+void SignalingServer::AnswerWait(Peer* peer)
+{
+	auto it = connections_.find(peer->wait_fd);
+	peer->wait_fd = -1;
+	if (it == connections_.end())
+	{
+		return;
+	}
+
+	Connection* connection = it->second.get();
+	connection->parked = false;
+	connection->peer_id = -1;
+
+	PendingMessage message = std::move(peer->queue.front());
+	peer->queue.pop_front();
+	peer->queued_bytes -= message.body.size();
+	queued_messages_--;
+	SendResponse(connection, "200 OK", "Pragma: " + std::to_string(message.from_id) + "\r\n",
+		message.body);
+
+	if (!connection->closed && !connection->input.empty())
+	{
+		ScheduleResume(connection);
+	}
+}
+
+void SignalingServer::Broadcast(const Peer& peer, bool connected)
+{
+	if (!options_.presence)
+	{
+		return;
+	}
+
+	// Delivering never adds or removes peers, requests unblocked by it are
+	// resumed from a timer.
+	std::string notification = peer.name + "," + std::to_string(peer.id) + (connected ? ",1\n" : ",0\n");
+	for (auto& entry : peers_)
+	{
+		if (entry.first != peer.id)
+		{
+			Deliver(&entry.second, entry.first, notification);
+		}
+	}
+}
+
+void SignalingServer::SendResponse(Connection* connection, const char* status,
+	const std::string& extra_headers, const std::string& body)
+{
+	std::string response = std::string("HTTP/1.1 ") + status + "\r\n" + kCommonHeaders +
+		(connection->keep_alive ? "Connection: keep-alive\r\n" : "Connection: close\r\n") +
+		"Content-Length: " + std::to_string(body.size()) + "\r\n" +
+		extra_headers + "\r\n" + body;
+
+	if (!connection->keep_alive)
+	{
+		connection->close_after_write = true;
+	}
+
+	Write(connection, response.data(), response.size());
+}
+
+void SignalingServer::SendWebSocketMessage(Connection* connection, int peer_id, const std::string& body)
+{
+	std::string payload = std::to_string(peer_id) + "\n" + body;
+	std::string frame;
+	WebSocketCodec::WriteFrame(WebSocketCodec::TEXT, payload.data(), payload.size(), &frame);
+	Write(connection, frame.data(), frame.size());
+}
+
+void SignalingServer::Write(Connection* connection, const char* data, size_t length)
+{
+	if (connection->closed)
+	{
+		return;
+	}
+
+	connection->output.append(data, length);
+	Flush(connection);
+}
+
+void SignalingServer::Flush(Connection* connection)
+{
+	size_t sent = 0;
+	while (sent < connection->output.size())
+	{
+		ssize_t result = send(connection->fd, connection->output.data() + sent,
+			connection->output.size() - sent, MSG_NOSIGNAL);
+
+		if (result > 0)
+		{
+			sent += result;
+		}
+		else if (result < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+		{
+			// EPOLLOUT calls back once there is room.
+			break;
+		}
+		else
+		{
+			CloseConnection(connection->fd);
+			return;
+		}
+	}
+
+	connection->output.erase(0, sent);
+	if (connection->output.empty() && connection->close_after_write)
+	{
+		CloseConnection(connection->fd);
+	}
+}
+
+void SignalingServer::CloseConnection(int fd)
+{
+	auto it = connections_.find(fd);
+	if (it == connections_.end())
+	{
+		return;
+	}
+
+	Connection* connection = it->second.get();
+	connection->closed = true;
+	loop_->Remove(fd);
+
+	auto peer = peers_.find(connection->peer_id);
+	if (peer != peers_.end())
+	{
+		if (peer->second.wait_fd == fd)
+		{
+			// The peer has kPeerTimeoutMs to come back with a new wait.
+			peer->second.wait_fd = -1;
+			peer->second.last_seen_ms = EventLoop::NowMs();
+		}
+		else if (peer->second.websocket_fd == fd)
+		{
+			// Dropped without a close frame, the peer has kPeerTimeoutMs to
+			// resume.
+			peer->second.websocket_fd = -1;
+			peer->second.last_seen_ms = EventLoop::NowMs();
+		}
+	}
+
+	if (closing_.empty())
+	{
+		loop_->AddTimer(0, [this]() { Reap(); });
+	}
+
+	closing_.push_back(std::move(it->second));
+	connections_.erase(it);
+}
+
+void SignalingServer::Reap()
+{
+	std::vector<std::unique_ptr<Connection>> closing;
+	closing.swap(closing_);
+	for (auto& connection : closing)
+	{
+		close(connection->fd);
+	}
+}
+
+void SignalingServer::ScheduleResume(Connection* connection)
+{
+	int fd = connection->fd;
+	uint64_t serial = connection->serial;
+	loop_->AddTimer(0, [this, fd, serial]()
+	{
+		auto it = connections_.find(fd);
+		if (it != connections_.end() && it->second->serial == serial)
+		{
+			ProcessInput(it->second.get());
+		}
+	});
+}
+
+void SignalingServer::SweepPeers()
+{
+	int64_t now = EventLoop::NowMs();
+	std::vector<int> expired;
+	for (const auto& entry : peers_)
+	{
+		const Peer& peer = entry.second;
+		bool connected = peer.wait_fd != -1 || peer.websocket_fd != -1;
+		int64_t idle_ms = now - peer.last_seen_ms;
+		if ((!connected && idle_ms > kPeerTimeoutMs) ||
+			(options_.heartbeat_timeout_ms > 0 && peer.heartbeats && idle_ms > options_.heartbeat_timeout_ms))
+		{
+			expired.push_back(entry.first);
+		}
+	}
+
+	for (int peer_id : expired)
+	{
+		RemovePeer(peer_id);
+	}
+
+	loop_->AddTimer(kSweepIntervalMs, [this]() { SweepPeers(); });
+}
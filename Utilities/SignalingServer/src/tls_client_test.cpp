@@ -0,0 +1,310 @@
+// Connects to openssl s_server the way TlsClientAdapter does, through
+// TlsSessionCache, to check the certificate verification of servers given by
+// name and by IP address, and the session resumption of reconnects.
+//
+// Needs the openssl command line tool, the test is skipped without it.
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include "tls_session_cache.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	// Writes a self-signed certificate for |subject_alt_name| and its key to
+	// <dir>/<name>.pem and <dir>/<name>.key, returns the certificate.
+	X509* CreateCertificate(const std::string& dir, const char* name, const char* subject_alt_name)
+	{
+		EVP_PKEY* key = nullptr;
+		EVP_PKEY_CTX* key_ctx = EVP_PKEY_CTX_new_id(EVP_PKEY_EC, nullptr);
+		EVP_PKEY_keygen_init(key_ctx);
+		EVP_PKEY_CTX_set_ec_paramgen_curve_nid(key_ctx, NID_X9_62_prime256v1);
+		EVP_PKEY_keygen(key_ctx, &key);
+		EVP_PKEY_CTX_free(key_ctx);
+
+		X509* cert = X509_new();
+		X509_set_version(cert, 2);
+		ASN1_INTEGER_set(X509_get_serialNumber(cert), 1);
+		X509_gmtime_adj(X509_get_notBefore(cert), -60);
+		X509_gmtime_adj(X509_get_notAfter(cert), 3600);
+		X509_NAME_add_entry_by_txt(X509_get_subject_name(cert), "CN", MBSTRING_ASC,
+			reinterpret_cast<const unsigned char*>(name), -1, -1, 0);
+		X509_set_issuer_name(cert, X509_get_subject_name(cert));
+		X509_set_pubkey(cert, key);
+
+		X509V3_CTX ctx;
+		X509V3_set_ctx(&ctx, cert, cert, nullptr, nullptr, 0);
+		X509_EXTENSION* extension = X509V3_EXT_conf_nid(nullptr, &ctx, NID_subject_alt_name,
+			const_cast<char*>(subject_alt_name));
+		X509_add_ext(cert, extension, -1);
+		X509_EXTENSION_free(extension);
+		X509_sign(cert, key, EVP_sha256());
+
+		FILE* file = fopen((dir + "/" + name + ".pem").c_str(), "w");
+		PEM_write_X509(file, cert);
+		fclose(file);
+
+		file = fopen((dir + "/" + name + ".key").c_str(), "w");
+		PEM_write_PrivateKey(file, key, nullptr, nullptr, 0, nullptr, nullptr);
+		fclose(file);
+
+		EVP_PKEY_free(key);
+		return cert;
+	}
+
+	int ConnectSocket(int port)
+	{
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons(static_cast<uint16_t>(port));
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+		{
+			close(fd);
+			return -1;
+		}
+
+		return fd;
+	}
+
+	// An unused loopback port, for the server to listen on.
+	int PickPort()
+	{
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		socklen_t length = sizeof(address);
+		bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address));
+		getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length);
+		close(fd);
+		return ntohs(address.sin_port);
+	}
+
+	// openssl s_server answering HTTP requests with its connection status.
+	class OpenSslServer
+	{
+	public:
+		OpenSslServer(const std::string& dir, const char* name) :
+			port_(PickPort()),
+			pid_(fork())
+		{
+			if (pid_ == 0)
+			{
+				std::string accept = "127.0.0.1:" + std::to_string(port_);
+				std::string cert = dir + "/" + name + ".pem";
+				std::string key = dir + "/" + name + ".key";
+				freopen("/dev/null", "w", stdout);
+				freopen("/dev/null", "w", stderr);
+				execlp("openssl", "openssl", "s_server", "-accept", accept.c_str(), "-cert", cert.c_str(),
+					"-key", key.c_str(), "-www", "-quiet", static_cast<char*>(nullptr));
+				_exit(127);
+			}
+		}
+
+		~OpenSslServer()
+		{
+			kill(pid_, SIGTERM);
+			waitpid(pid_, nullptr, 0);
+		}
+
+		// Waits for the server to listen, false if it exited.
+		bool WaitUntilListening()
+		{
+			for (int i = 0; i < 500; ++i)
+			{
+				if (waitpid(pid_, nullptr, WNOHANG) == pid_)
+				{
+					pid_ = -1;
+					return false;
+				}
+
+				int fd = ConnectSocket(port_);
+				if (fd >= 0)
+				{
+					close(fd);
+					return true;
+				}
+
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			}
+
+			return false;
+		}
+
+		int port() const { return port_; }
+
+	private:
+		int port_;
+		pid_t pid_;
+	};
+
+	enum ConnectResult
+	{
+		FAILED,
+		FULL_HANDSHAKE,
+		RESUMED,
+	};
+
+	// TlsClientAdapter::BeginHandshake over a blocking socket.
+	ConnectResult Connect(const std::string& host, int port)
+	{
+		int fd = ConnectSocket(port);
+		if (fd < 0)
+		{
+			return FAILED;
+		}
+
+		TlsSessionCache* cache = TlsSessionCache::Instance();
+		std::string session_key = host + ":" + std::to_string(port);
+		SSL* ssl = SSL_new(cache->ssl_ctx());
+		SSL_set_fd(ssl, fd);
+		SSL_set_app_data(ssl, &session_key);
+		SSL_set_connect_state(ssl);
+
+		ConnectResult result = FAILED;
+		if (TlsSessionCache::SetPeerName(ssl, host))
+		{
+			SSL_SESSION* session = cache->Lookup(session_key);
+			if (session)
+			{
+				SSL_set_session(ssl, session);
+				SSL_SESSION_free(session);
+			}
+
+			if (SSL_connect(ssl) == 1)
+			{
+				bool resumed = SSL_session_reused(ssl) != 0;
+				cache->OnHandshakeComplete(resumed);
+				result = resumed ? RESUMED : FULL_HANDSHAKE;
+
+				// Reading the response also takes the TLS 1.3 session tickets.
+				const char request[] = "GET / HTTP/1.0\r\n\r\n";
+				SSL_write(ssl, request, sizeof(request) - 1);
+
+				char buffer[4096];
+				while (SSL_read(ssl, buffer, sizeof(buffer)) > 0)
+				{
+				}
+
+				SSL_shutdown(ssl);
+			}
+			else
+			{
+				cache->OnHandshakeFailed();
+			}
+		}
+
+		ERR_clear_error();
+		SSL_free(ssl);
+		close(fd);
+		return result;
+	}
+
+	void Trust(X509* cert)
+	{
+		X509_STORE_add_cert(SSL_CTX_get_cert_store(TlsSessionCache::Instance()->ssl_ctx()), cert);
+	}
+}
+
+int main()
+{
+	signal(SIGPIPE, SIG_IGN);
+
+	char dir[] = "/tmp/tls_client_test.XXXXXX";
+	if (!mkdtemp(dir))
+	{
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+
+	X509* by_address = CreateCertificate(dir, "by_address", "IP:127.0.0.1");
+	X509* by_name = CreateCertificate(dir, "by_name", "DNS:localhost");
+	X509* untrusted = CreateCertificate(dir, "untrusted", "IP:127.0.0.1, DNS:localhost");
+	Trust(by_address);
+	Trust(by_name);
+
+	{
+		OpenSslServer server(dir, "by_address");
+		if (!server.WaitUntilListening())
+		{
+			printf("tls_client_test: skipped, openssl s_server didn't start\n");
+			return EXIT_SUCCESS;
+		}
+
+		Check(Connect("127.0.0.1", server.port()) == FULL_HANDSHAKE, "address matching the certificate");
+		Check(Connect("127.0.0.1", server.port()) == RESUMED, "reconnect resumes the session");
+		Check(Connect("localhost", server.port()) == FAILED, "name missing from the certificate");
+		Check(Connect("", server.port()) == FAILED, "server without a name nor address");
+	}
+
+	{
+		OpenSslServer server(dir, "by_name");
+		Check(server.WaitUntilListening(), "second server starts");
+		Check(Connect("127.0.0.1", server.port()) == FAILED, "address missing from the certificate");
+		Check(Connect("localhost", server.port()) == FULL_HANDSHAKE, "name matching the certificate");
+		Check(Connect("localhost", server.port()) == RESUMED, "reconnect by name resumes the session");
+	}
+
+	{
+		OpenSslServer server(dir, "untrusted");
+		Check(server.WaitUntilListening(), "third server starts");
+		Check(Connect("127.0.0.1", server.port()) == FAILED, "untrusted certificate by address");
+		Check(Connect("localhost", server.port()) == FAILED, "untrusted certificate by name");
+	}
+
+	TlsHandshakeStats stats = TlsSessionCache::Instance()->GetStats();
+	Check(stats.full_handshakes == 2 && stats.resumed_handshakes == 2 && stats.failed_handshakes == 4 &&
+		stats.cached_sessions == 2, "session cache stats");
+
+	X509_free(by_address);
+	X509_free(by_name);
+	X509_free(untrusted);
+	for (const char* file : { "by_address.pem", "by_address.key", "by_name.pem", "by_name.key",
+		"untrusted.pem", "untrusted.key" })
+	{
+		unlink((std::string(dir) + "/" + file).c_str());
+	}
+
+	rmdir(dir);
+
+	if (failures)
+	{
+		fprintf(stderr, "tls_client_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("tls_client_test: passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,253 @@
+#include "websocket_codec.h"
+
+#include <string.h>
+
+namespace
+{
+	// Appended to the key before hashing, see RFC 6455 section 1.3.
+	const char kAcceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+	uint32_t RotateLeft(uint32_t value, int bits)
+	{
+		return (value << bits) | (value >> (32 - bits));
+	}
+
+	// SHA-1 of |input|, only used for the handshake so the server doesn't
+	// depend on a crypto library.
+	void Sha1(const std::string& input, uint8_t digest[20])
+	{
+		uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+		std::string message = input;
+		uint64_t bit_length = static_cast<uint64_t>(input.size()) * 8;
+		message += static_cast<char>(0x80);
+		while (message.size() % 64 != 56)
+		{
+			message += static_cast<char>(0);
+		}
+
+		for (int shift = 56; shift >= 0; shift -= 8)
+		{
+			message += static_cast<char>((bit_length >> shift) & 0xFF);
+		}
+
+		for (size_t chunk = 0; chunk < message.size(); chunk += 64)
+		{
+			const uint8_t* block = reinterpret_cast<const uint8_t*>(message.data() + chunk);
+			uint32_t w[80];
+			for (int i = 0; i < 16; ++i)
+			{
+				w[i] = (block[i * 4] << 24) | (block[i * 4 + 1] << 16) |
+					(block[i * 4 + 2] << 8) | block[i * 4 + 3];
+			}
+
+			for (int i = 16; i < 80; ++i)
+			{
+				w[i] = RotateLeft(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+			}
+
+			uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+			for (int i = 0; i < 80; ++i)
+			{
+				uint32_t f, k;
+				if (i < 20)
+				{
+					f = (b & c) | (~b & d);
+					k = 0x5A827999;
+				}
+				else if (i < 40)
+				{
+					f = b ^ c ^ d;
+					k = 0x6ED9EBA1;
+				}
+				else if (i < 60)
+				{
+					f = (b & c) | (b & d) | (c & d);
+					k = 0x8F1BBCDC;
+				}
+				else
+				{
+					f = b ^ c ^ d;
+					k = 0xCA62C1D6;
+				}
+
+				uint32_t temp = RotateLeft(a, 5) + f + e + k + w[i];
+				e = d;
+				d = c;
+				c = RotateLeft(b, 30);
+				b = a;
+				a = temp;
+			}
+
+			h[0] += a;
+			h[1] += b;
+			h[2] += c;
+			h[3] += d;
+			h[4] += e;
+		}
+
+		for (int i = 0; i < 5; ++i)
+		{
+			digest[i * 4] = static_cast<uint8_t>(h[i] >> 24);
+			digest[i * 4 + 1] = static_cast<uint8_t>(h[i] >> 16);
+			digest[i * 4 + 2] = static_cast<uint8_t>(h[i] >> 8);
+			digest[i * 4 + 3] = static_cast<uint8_t>(h[i]);
+		}
+	}
+
+	std::string Base64Encode(const uint8_t* data, size_t length)
+	{
+		const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+		std::string result;
+		for (size_t i = 0; i < length; i += 3)
+		{
+			uint32_t value = data[i] << 16;
+			value |= (i + 1 < length) ? data[i + 1] << 8 : 0;
+			value |= (i + 2 < length) ? data[i + 2] : 0;
+			result += kAlphabet[(value >> 18) & 0x3F];
+			result += kAlphabet[(value >> 12) & 0x3F];
+			result += (i + 1 < length) ? kAlphabet[(value >> 6) & 0x3F] : '=';
+			result += (i + 2 < length) ? kAlphabet[value & 0x3F] : '=';
+		}
+
+		return result;
+	}
+}
+
+WebSocketCodec::WebSocketCodec() :
+	message_opcode_(TEXT),
+	in_message_(false)
+{
+}
+
+WebSocketCodec::Result WebSocketCodec::ReadMessage(std::string* data, Opcode* opcode,
+	std::string* payload)
+{
+	while (true)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data->data());
+		size_t length = data->size();
+		if (length < 2)
+		{
+			return NEED_MORE_DATA;
+		}
+
+		bool fin = (bytes[0] & 0x80) != 0;
+		int frame_opcode = bytes[0] & 0x0F;
+		if ((bytes[0] & 0x70) != 0 || (bytes[1] & 0x80) == 0)
+		{
+			// Reserved bits set, or an unmasked client frame.
+			return PARSE_ERROR;
+		}
+
+		size_t header_length = 2;
+		uint64_t payload_length = bytes[1] & 0x7F;
+		if (payload_length == 126)
+		{
+			header_length += 2;
+			if (length < header_length)
+			{
+				return NEED_MORE_DATA;
+			}
+
+			payload_length = (bytes[2] << 8) | bytes[3];
+		}
+		else if (payload_length == 127)
+		{
+			header_length += 8;
+			if (length < header_length)
+			{
+				return NEED_MORE_DATA;
+			}
+
+			payload_length = 0;
+			for (int i = 0; i < 8; ++i)
+			{
+				payload_length = (payload_length << 8) | bytes[2 + i];
+			}
+		}
+
+		bool control = (frame_opcode & 0x8) != 0;
+		if ((frame_opcode == CONTINUATION && !in_message_) ||
+			((frame_opcode == TEXT || frame_opcode == BINARY) && in_message_) ||
+			(control && (!fin || payload_length > 125)) ||
+			(frame_opcode > BINARY && frame_opcode < CLOSE) || frame_opcode > PONG ||
+			payload_length > kMaxMessageSize - message_.size())
+		{
+			return PARSE_ERROR;
+		}
+
+		header_length += 4;
+		size_t frame_length = header_length + static_cast<size_t>(payload_length);
+		if (length < frame_length)
+		{
+			return NEED_MORE_DATA;
+		}
+
+		// Unmasks in place.
+		char* frame_payload = &(*data)[header_length];
+		const char* mask = data->data() + header_length - 4;
+		for (size_t i = 0; i < payload_length; ++i)
+		{
+			frame_payload[i] ^= mask[i & 3];
+		}
+
+		if (control)
+		{
+			*opcode = static_cast<Opcode>(frame_opcode);
+			payload->assign(frame_payload, static_cast<size_t>(payload_length));
+			data->erase(0, frame_length);
+			return COMPLETE;
+		}
+
+		if (frame_opcode != CONTINUATION)
+		{
+			message_opcode_ = static_cast<Opcode>(frame_opcode);
+			in_message_ = true;
+		}
+
+		message_.append(frame_payload, static_cast<size_t>(payload_length));
+		data->erase(0, frame_length);
+		if (fin)
+		{
+			*opcode = message_opcode_;
+			payload->swap(message_);
+			message_.clear();
+			in_message_ = false;
+			return COMPLETE;
+		}
+	}
+}
+
+void WebSocketCodec::WriteFrame(Opcode opcode, const char* payload, size_t length, std::string* frame)
+{
+	frame->push_back(static_cast<char>(0x80 | opcode));
+	if (length < 126)
+	{
+		frame->push_back(static_cast<char>(length));
+	}
+	else if (length <= 0xFFFF)
+	{
+		frame->push_back(static_cast<char>(126));
+		frame->push_back(static_cast<char>((length >> 8) & 0xFF));
+		frame->push_back(static_cast<char>(length & 0xFF));
+	}
+	else
+	{
+		frame->push_back(static_cast<char>(127));
+		uint64_t length64 = length;
+		for (int shift = 56; shift >= 0; shift -= 8)
+		{
+			frame->push_back(static_cast<char>((length64 >> shift) & 0xFF));
+		}
+	}
+
+	frame->append(payload, length);
+}
+
+std::string WebSocketCodec::ComputeAccept(const std::string& key)
+{
+	uint8_t digest[20];
+	Sha1(key + kAcceptGuid, digest);
+	return Base64Encode(digest, sizeof(digest));
+}
@@ -0,0 +1,288 @@
+// Checks WebSocketFramer, the client side of the WebSocket signaling
+// transport, against the server's WebSocketCodec: messages of each length
+// encoding both ways, fragmented messages with control frames between the
+// fragments, and the frames a client must refuse. Built with the stand-ins
+// of test/ on the system OpenSSL.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "websocket_codec.h"
+#include "websocket_framer.h"
+
+namespace
+{
+	int failures = 0;
+
+	void Check(bool condition, const char* what)
+	{
+		if (!condition)
+		{
+			fprintf(stderr, "FAILED: %s\n", what);
+			failures++;
+		}
+	}
+
+	std::string Payload(size_t length, char seed)
+	{
+		std::string payload(length, 0);
+		for (size_t i = 0; i < length; ++i)
+		{
+			payload[i] = static_cast<char>(seed + i * 7);
+		}
+
+		return payload;
+	}
+
+	// Unmasked frame as a server sends it, without the single frame
+	// restriction of WebSocketCodec::WriteFrame.
+	std::string ServerFrame(bool fin, int opcode, const std::string& payload)
+	{
+		std::string frame;
+		frame.push_back(static_cast<char>((fin ? 0x80 : 0) | opcode));
+		size_t length = payload.size();
+		if (length < 126)
+		{
+			frame.push_back(static_cast<char>(length));
+		}
+		else if (length <= 0xFFFF)
+		{
+			frame.push_back(static_cast<char>(126));
+			frame.push_back(static_cast<char>(length >> 8));
+			frame.push_back(static_cast<char>(length & 0xFF));
+		}
+		else
+		{
+			frame.push_back(static_cast<char>(127));
+			for (int shift = 56; shift >= 0; shift -= 8)
+			{
+				frame.push_back(static_cast<char>((static_cast<uint64_t>(length) >> shift) & 0xFF));
+			}
+		}
+
+		return frame + payload;
+	}
+
+	// Reads |data| one byte at a time, returns the result of the last read.
+	WebSocketFramer::Result ReadBytewise(WebSocketFramer* framer, const std::string& data,
+		WebSocketFramer::Opcode* opcode, std::string* payload, int* complete_reads)
+	{
+		std::string input;
+		WebSocketFramer::Result result = WebSocketFramer::NEED_MORE_DATA;
+		*complete_reads = 0;
+		for (char byte : data)
+		{
+			input.push_back(byte);
+			result = framer->ReadMessage(&input, opcode, payload);
+			*complete_reads += result == WebSocketFramer::COMPLETE;
+		}
+
+		return result;
+	}
+
+	void TestHandshake()
+	{
+		// The example of RFC 6455 section 1.3.
+		Check(WebSocketFramer::ComputeAccept("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=",
+			"accept of the RFC key");
+
+		std::string key = WebSocketFramer::CreateKey();
+		Check(key.size() == 24 && key[22] == '=' && key[23] == '=', "key encodes 16 bytes");
+		Check(key != WebSocketFramer::CreateKey(), "keys are random");
+		Check(WebSocketFramer::ComputeAccept(key) == WebSocketCodec::ComputeAccept(key),
+			"accept matches the server");
+	}
+
+	void TestClientFrames()
+	{
+		// 7 bit, 16 bit and 64 bit lengths, and the limits between them.
+		const size_t lengths[] = { 0, 1, 125, 126, 0xFFFF, 0x10000, 200000 };
+		for (size_t length : lengths)
+		{
+			std::string payload = Payload(length, 'a');
+			std::string frame;
+			WebSocketFramer::WriteFrame(WebSocketFramer::BINARY, payload.data(), payload.size(), &frame);
+
+			size_t header_length = length < 126 ? 6 : length <= 0xFFFF ? 8 : 14;
+			uint8_t length_bits = length < 126 ? static_cast<uint8_t>(length) : length <= 0xFFFF ? 126 : 127;
+			Check(frame.size() == header_length + length && static_cast<uint8_t>(frame[0]) == 0x82 &&
+				static_cast<uint8_t>(frame[1]) == (0x80 | length_bits), "header of the length");
+			Check(length < 16 || frame.compare(header_length, length, payload) != 0, "payload masked");
+
+			WebSocketCodec codec;
+			WebSocketCodec::Opcode opcode = WebSocketCodec::TEXT;
+			std::string received;
+			Check(codec.ReadMessage(&frame, &opcode, &received) == WebSocketCodec::COMPLETE &&
+				opcode == WebSocketCodec::BINARY && received == payload && frame.empty(),
+				"read by the server");
+		}
+
+		// Control frames.
+		std::string frames;
+		WebSocketFramer::WriteFrame(WebSocketFramer::PING, "ping", 4, &frames);
+		WebSocketFramer::WriteCloseFrame(WebSocketFramer::kCloseNormal, &frames);
+		WebSocketFramer::WriteFrame(WebSocketFramer::PONG, "", 0, &frames);
+
+		WebSocketCodec codec;
+		WebSocketCodec::Opcode opcode = WebSocketCodec::TEXT;
+		std::string received;
+		Check(codec.ReadMessage(&frames, &opcode, &received) == WebSocketCodec::COMPLETE &&
+			opcode == WebSocketCodec::PING && received == "ping", "ping read by the server");
+		Check(codec.ReadMessage(&frames, &opcode, &received) == WebSocketCodec::COMPLETE &&
+			opcode == WebSocketCodec::CLOSE && received == std::string("\x03\xE8", 2), "close status 1000");
+		Check(codec.ReadMessage(&frames, &opcode, &received) == WebSocketCodec::COMPLETE &&
+			opcode == WebSocketCodec::PONG && received.empty() && frames.empty(), "empty pong");
+	}
+
+	void TestServerFrames()
+	{
+		const size_t lengths[] = { 0, 125, 126, 0xFFFF, 0x10000, WebSocketFramer::kMaxMessageSize };
+		for (size_t length : lengths)
+		{
+			std::string payload = Payload(length, 'b');
+			std::string frame;
+			WebSocketCodec::WriteFrame(WebSocketCodec::TEXT, payload.data(), payload.size(), &frame);
+			frame += ServerFrame(true, WebSocketFramer::PING, "next");
+
+			WebSocketFramer framer;
+			WebSocketFramer::Opcode opcode = WebSocketFramer::BINARY;
+			std::string received;
+			Check(framer.ReadMessage(&frame, &opcode, &received) == WebSocketFramer::COMPLETE &&
+				opcode == WebSocketFramer::TEXT && received == payload, "server message read");
+			Check(framer.ReadMessage(&frame, &opcode, &received) == WebSocketFramer::COMPLETE &&
+				opcode == WebSocketFramer::PING && received == "next" && frame.empty(),
+				"following frame read");
+		}
+
+		// Incomplete headers and payloads of each length encoding wait for
+		// more data.
+		const size_t partial_lengths[] = { 10, 300, 70000 };
+		for (size_t length : partial_lengths)
+		{
+			WebSocketFramer framer;
+			WebSocketFramer::Opcode opcode = WebSocketFramer::BINARY;
+			std::string received;
+			int complete_reads = 0;
+			Check(ReadBytewise(&framer, ServerFrame(true, WebSocketFramer::TEXT, Payload(length, 'c')),
+				&opcode, &received, &complete_reads) == WebSocketFramer::COMPLETE &&
+				complete_reads == 1 && received == Payload(length, 'c'), "message read byte by byte");
+		}
+	}
+
+	void TestFragmentation()
+	{
+		// Control frames between the fragments are returned on their own,
+		// the fragments are reassembled, each with its own length encoding.
+		std::string data = ServerFrame(false, WebSocketFramer::BINARY, Payload(100, 'd')) +
+			ServerFrame(true, WebSocketFramer::PING, "p1") +
+			ServerFrame(false, WebSocketFramer::CONTINUATION, Payload(1000, 'e')) +
+			ServerFrame(true, WebSocketFramer::PONG, "") +
+			ServerFrame(false, WebSocketFramer::CONTINUATION, std::string()) +
+			ServerFrame(true, WebSocketFramer::CONTINUATION, Payload(70000, 'f')) +
+			ServerFrame(true, WebSocketFramer::TEXT, "after");
+
+		const std::string message = Payload(100, 'd') + Payload(1000, 'e') + Payload(70000, 'f');
+
+		WebSocketFramer framer;
+		WebSocketFramer::Opcode opcode = WebSocketFramer::TEXT;
+		std::string received;
+		Check(framer.ReadMessage(&data, &opcode, &received) == WebSocketFramer::COMPLETE &&
+			opcode == WebSocketFramer::PING && received == "p1", "ping between fragments");
+		Check(framer.ReadMessage(&data, &opcode, &received) == WebSocketFramer::COMPLETE &&
+			opcode == WebSocketFramer::PONG && received.empty(), "pong between fragments");
+		Check(framer.ReadMessage(&data, &opcode, &received) == WebSocketFramer::COMPLETE &&
+			opcode == WebSocketFramer::BINARY && received == message, "fragments reassembled");
+		Check(framer.ReadMessage(&data, &opcode, &received) == WebSocketFramer::COMPLETE &&
+			opcode == WebSocketFramer::TEXT && received == "after" && data.empty(), "next message");
+
+		// The same byte by byte.
+		std::string bytewise = ServerFrame(false, WebSocketFramer::TEXT, "Hel") +
+			ServerFrame(true, WebSocketFramer::CLOSE, std::string("\x03\xE8", 2)) +
+			ServerFrame(true, WebSocketFramer::CONTINUATION, "lo");
+
+		int complete_reads = 0;
+		Check(ReadBytewise(&framer, bytewise, &opcode, &received, &complete_reads) ==
+			WebSocketFramer::COMPLETE && complete_reads == 2 && opcode == WebSocketFramer::TEXT &&
+			received == "Hello", "fragments read byte by byte");
+
+		// Reset drops the message being reassembled.
+		std::string first = ServerFrame(false, WebSocketFramer::TEXT, "stale");
+		Check(framer.ReadMessage(&first, &opcode, &received) == WebSocketFramer::NEED_MORE_DATA &&
+			first.empty(), "first fragment buffered");
+		framer.Reset();
+		std::string next = ServerFrame(true, WebSocketFramer::TEXT, "fresh");
+		Check(framer.ReadMessage(&next, &opcode, &received) == WebSocketFramer::COMPLETE &&
+			received == "fresh", "message after a reset");
+	}
+
+	WebSocketFramer::Result ReadOnce(const std::string& frames)
+	{
+		WebSocketFramer framer;
+		std::string data = frames;
+		WebSocketFramer::Opcode opcode = WebSocketFramer::TEXT;
+		std::string payload;
+		WebSocketFramer::Result result;
+		do
+		{
+			result = framer.ReadMessage(&data, &opcode, &payload);
+		} while (result == WebSocketFramer::COMPLETE && !data.empty());
+
+		return result;
+	}
+
+	void TestErrors()
+	{
+		const WebSocketFramer::Result kError = WebSocketFramer::PARSE_ERROR;
+		Check(ReadOnce(ServerFrame(true, WebSocketFramer::CONTINUATION, "x")) == kError,
+			"continuation without a message");
+		Check(ReadOnce(ServerFrame(false, WebSocketFramer::TEXT, "a") +
+			ServerFrame(true, WebSocketFramer::TEXT, "b")) == kError, "new message before the last fragment");
+		Check(ReadOnce(ServerFrame(false, WebSocketFramer::PING, "")) == kError, "fragmented control frame");
+		Check(ReadOnce(ServerFrame(true, WebSocketFramer::CLOSE, Payload(126, 'g'))) == kError,
+			"control frame over 125 bytes");
+		Check(ReadOnce(ServerFrame(true, 0x3, "x")) == kError &&
+			ReadOnce(ServerFrame(true, 0xB, "x")) == kError, "reserved opcodes");
+
+		std::string reserved_bits = ServerFrame(true, WebSocketFramer::TEXT, "x");
+		reserved_bits[0] |= 0x40;
+		Check(ReadOnce(reserved_bits) == kError, "reserved bits");
+
+		std::string masked;
+		WebSocketFramer::WriteFrame(WebSocketFramer::TEXT, "x", 1, &masked);
+		Check(ReadOnce(masked) == kError, "masked server frame");
+
+		// Too large, refused from the header alone.
+		std::string too_large("\x82\x7F", 2);
+		uint64_t length = WebSocketFramer::kMaxMessageSize + 1;
+		for (int shift = 56; shift >= 0; shift -= 8)
+		{
+			too_large.push_back(static_cast<char>((length >> shift) & 0xFF));
+		}
+
+		Check(ReadOnce(too_large) == kError, "message over the maximum size");
+		std::string largest = Payload(WebSocketFramer::kMaxMessageSize, 'h');
+		Check(ReadOnce(ServerFrame(false, WebSocketFramer::BINARY, largest) +
+			ServerFrame(true, WebSocketFramer::CONTINUATION, "x")) == kError,
+			"fragments over the maximum size");
+	}
+}
+
+int main()
+{
+	TestHandshake();
+	TestClientFrames();
+	TestServerFrames();
+	TestFragmentation();
+	TestErrors();
+
+	if (failures)
+	{
+		fprintf(stderr, "websocket_framer_test: %d check(s) failed\n", failures);
+		return EXIT_FAILURE;
+	}
+
+	printf("websocket_framer_test: passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,13 @@
+// Linux test stand-in for the WebRTC header of the same name.
+
+#ifndef WEBRTC_BASE_ARRAYSIZE_H_
+#define WEBRTC_BASE_ARRAYSIZE_H_
+
+#include <stddef.h>
+
+template <typename T, size_t N>
+char (&ArraySizeHelper(T (&array)[N]))[N];
+
+#define arraysize(array) (sizeof(ArraySizeHelper(array)))
+
+#endif  // WEBRTC_BASE_ARRAYSIZE_H_
@@ -0,0 +1,29 @@
+// Linux test stand-in for the WebRTC header of the same name, on the system
+// OpenSSL.
+
+#ifndef WEBRTC_BASE_BASE64_H_
+#define WEBRTC_BASE_BASE64_H_
+
+#include <stddef.h>
+
+#include <string>
+
+#include <openssl/evp.h>
+
+namespace rtc
+{
+	class Base64
+	{
+	public:
+		static void EncodeFromArray(const void* data, size_t len, std::string* result)
+		{
+			std::string encoded(4 * ((len + 2) / 3) + 1, '\0');
+			int length = EVP_EncodeBlock(reinterpret_cast<unsigned char*>(&encoded[0]),
+				static_cast<const unsigned char*>(data), static_cast<int>(len));
+
+			result->assign(encoded.data(), length);
+		}
+	};
+}
+
+#endif  // WEBRTC_BASE_BASE64_H_
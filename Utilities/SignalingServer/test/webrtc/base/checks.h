@@ -0,0 +1,21 @@
+// Linux test stand-in for the WebRTC header of the same name.
+
+#ifndef WEBRTC_BASE_CHECKS_H_
+#define WEBRTC_BASE_CHECKS_H_
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define RTC_CHECK(condition) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			abort(); \
+		} \
+	} while (0)
+
+#define RTC_DCHECK(condition) RTC_CHECK(condition)
+
+#endif  // WEBRTC_BASE_CHECKS_H_
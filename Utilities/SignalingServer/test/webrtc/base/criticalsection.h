@@ -0,0 +1,34 @@
+// Linux test stand-in for the WebRTC header of the same name, enough for the
+// signaling client sources built by the Makefile.
+
+#ifndef WEBRTC_BASE_CRITICALSECTION_H_
+#define WEBRTC_BASE_CRITICALSECTION_H_
+
+#include <mutex>
+
+#define GUARDED_BY(x)
+
+namespace rtc
+{
+	class CriticalSection
+	{
+	public:
+		void Enter() const { mutex_.lock(); }
+		void Leave() const { mutex_.unlock(); }
+
+	private:
+		mutable std::recursive_mutex mutex_;
+	};
+
+	class CritScope
+	{
+	public:
+		explicit CritScope(const CriticalSection* cs) : cs_(cs) { cs_->Enter(); }
+		~CritScope() { cs_->Leave(); }
+
+	private:
+		const CriticalSection* cs_;
+	};
+}
+
+#endif  // WEBRTC_BASE_CRITICALSECTION_H_
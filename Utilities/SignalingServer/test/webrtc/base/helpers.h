@@ -0,0 +1,53 @@
+// Linux test stand-in for the WebRTC header of the same name, on the system
+// OpenSSL.
+
+#ifndef WEBRTC_BASE_HELPERS_H_
+#define WEBRTC_BASE_HELPERS_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include <openssl/rand.h>
+
+namespace rtc
+{
+	inline bool CreateRandomData(size_t length, std::string* data)
+	{
+		data->resize(length);
+		return length == 0 ||
+			RAND_bytes(reinterpret_cast<unsigned char*>(&(*data)[0]), static_cast<int>(length)) == 1;
+	}
+
+	inline std::string CreateRandomString(size_t length)
+	{
+		static const char kTable[] =
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		std::string bytes;
+		CreateRandomData(length, &bytes);
+		std::string result(length, 'A');
+		for (size_t i = 0; i < length; ++i)
+		{
+			result[i] = kTable[static_cast<uint8_t>(bytes[i]) & 63];
+		}
+
+		return result;
+	}
+
+	inline uint32_t CreateRandomId()
+	{
+		std::string bytes;
+		CreateRandomData(sizeof(uint32_t), &bytes);
+		uint32_t id = 0;
+		for (char byte : bytes)
+		{
+			id = (id << 8) | static_cast<uint8_t>(byte);
+		}
+
+		return id;
+	}
+}
+
+#endif  // WEBRTC_BASE_HELPERS_H_
@@ -0,0 +1,80 @@
+// Linux test stand-in for the WebRTC header of the same name, enough for the
+// signaling client sources built by the Makefile.
+
+#ifndef WEBRTC_BASE_IPADDRESS_H_
+#define WEBRTC_BASE_IPADDRESS_H_
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+
+#include <string>
+
+namespace rtc
+{
+	class IPAddress
+	{
+	public:
+		IPAddress() : family_(AF_UNSPEC) { memset(&u_, 0, sizeof(u_)); }
+
+		explicit IPAddress(const in_addr& ip4) : family_(AF_INET)
+		{
+			memset(&u_, 0, sizeof(u_));
+			u_.ip4 = ip4;
+		}
+
+		explicit IPAddress(const in6_addr& ip6) : family_(AF_INET6)
+		{
+			u_.ip6 = ip6;
+		}
+
+		int family() const { return family_; }
+
+		std::string ToString() const
+		{
+			char buffer[INET6_ADDRSTRLEN] = { 0 };
+			if (family_ != AF_UNSPEC)
+			{
+				inet_ntop(family_, &u_, buffer, sizeof(buffer));
+			}
+
+			return buffer;
+		}
+
+		bool operator==(const IPAddress& other) const
+		{
+			return family_ == other.family_ && ToString() == other.ToString();
+		}
+
+	private:
+		int family_;
+		union
+		{
+			in_addr ip4;
+			in6_addr ip6;
+		} u_;
+	};
+
+	inline bool IPFromString(const std::string& str, IPAddress* out)
+	{
+		in_addr ip4;
+		in6_addr ip6;
+		if (inet_pton(AF_INET, str.c_str(), &ip4) == 1)
+		{
+			*out = IPAddress(ip4);
+			return true;
+		}
+
+		if (inet_pton(AF_INET6, str.c_str(), &ip6) == 1)
+		{
+			*out = IPAddress(ip6);
+			return true;
+		}
+
+		*out = IPAddress();
+		return false;
+	}
+}
+
+#endif  // WEBRTC_BASE_IPADDRESS_H_
@@ -0,0 +1,21 @@
+// Linux test stand-in for the WebRTC header of the same name, logs to stderr.
+
+#ifndef WEBRTC_BASE_LOGGING_H_
+#define WEBRTC_BASE_LOGGING_H_
+
+#include <iostream>
+
+namespace rtc
+{
+	// Ends the line once the streaming expression is complete.
+	class LogLine
+	{
+	public:
+		~LogLine() { std::cerr << std::endl; }
+		std::ostream& stream() { return std::cerr; }
+	};
+}
+
+#define LOG(severity) rtc::LogLine().stream() << #severity ": "
+
+#endif  // WEBRTC_BASE_LOGGING_H_
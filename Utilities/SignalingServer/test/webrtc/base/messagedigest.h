@@ -0,0 +1,32 @@
+// Linux test stand-in for the WebRTC header of the same name, only SHA-1, on
+// the system OpenSSL.
+
+#ifndef WEBRTC_BASE_MESSAGEDIGEST_H_
+#define WEBRTC_BASE_MESSAGEDIGEST_H_
+
+#include <stddef.h>
+
+#include <string>
+
+#include <openssl/sha.h>
+
+namespace rtc
+{
+	static const char DIGEST_SHA_1[] = "sha-1";
+
+	// Returns the length of the digest written to |output|, 0 if the
+	// algorithm is unknown or |output| too small.
+	inline size_t ComputeDigest(const std::string& alg, const void* input, size_t in_len,
+		void* output, size_t out_len)
+	{
+		if (alg != DIGEST_SHA_1 || out_len < SHA_DIGEST_LENGTH)
+		{
+			return 0;
+		}
+
+		SHA1(static_cast<const unsigned char*>(input), in_len, static_cast<unsigned char*>(output));
+		return SHA_DIGEST_LENGTH;
+	}
+}
+
+#endif  // WEBRTC_BASE_MESSAGEDIGEST_H_
@@ -0,0 +1,88 @@
+// Linux test stand-in for the WebRTC header of the same name. The test
+// completes the resolutions itself, see AsyncResolver::started().
+
+#ifndef WEBRTC_BASE_NETHELPERS_H_
+#define WEBRTC_BASE_NETHELPERS_H_
+
+#include <string>
+#include <vector>
+
+#include "webrtc/base/ipaddress.h"
+#include "webrtc/base/sigslot.h"
+
+namespace rtc
+{
+	class SocketAddress
+	{
+	public:
+		SocketAddress(const std::string& hostname, int port) : hostname_(hostname), port_(port) {}
+
+		const std::string& hostname() const { return hostname_; }
+		int port() const { return port_; }
+
+	private:
+		std::string hostname_;
+		int port_;
+	};
+
+	class AsyncResolverInterface
+	{
+	public:
+		virtual ~AsyncResolverInterface() {}
+
+		sigslot::signal1<AsyncResolverInterface*> SignalDone;
+	};
+
+	class AsyncResolver : public AsyncResolverInterface
+	{
+	public:
+		// Resolvers started and not destroyed yet, in start order.
+		static std::vector<AsyncResolver*>& started()
+		{
+			static std::vector<AsyncResolver*> resolvers;
+			return resolvers;
+		}
+
+		AsyncResolver() : address_("", 0), error_(0) {}
+
+		void Start(const SocketAddress& address)
+		{
+			address_ = address;
+			started().push_back(this);
+		}
+
+		// Test hook, signals the result.
+		void Complete(int error, const std::vector<IPAddress>& addresses)
+		{
+			error_ = error;
+			addresses_ = addresses;
+			SignalDone(this);
+		}
+
+		const SocketAddress& address() const { return address_; }
+		int GetError() const { return error_; }
+		const std::vector<IPAddress>& addresses() const { return addresses_; }
+
+		void Destroy(bool)
+		{
+			std::vector<AsyncResolver*>& resolvers = started();
+			for (auto it = resolvers.begin(); it != resolvers.end(); ++it)
+			{
+				if (*it == this)
+				{
+					resolvers.erase(it);
+					break;
+				}
+			}
+
+			delete this;
+		}
+
+	private:
+		SocketAddress address_;
+		int error_;
+		std::vector<IPAddress> addresses_;
+	};
+}
+
+#endif  // WEBRTC_BASE_NETHELPERS_H_
@@ -0,0 +1,40 @@
+// Linux test stand-in for the WebRTC header of the same name, single
+// threaded signals without disconnection.
+
+#ifndef WEBRTC_BASE_SIGSLOT_H_
+#define WEBRTC_BASE_SIGSLOT_H_
+
+#include <functional>
+#include <vector>
+
+namespace sigslot
+{
+	template <class mt_policy = void>
+	class has_slots
+	{
+	};
+
+	template <class arg1_type>
+	class signal1
+	{
+	public:
+		template <class desttype>
+		void connect(desttype* pclass, void (desttype::*pmemfun)(arg1_type))
+		{
+			slots_.push_back([pclass, pmemfun](arg1_type a1) { (pclass->*pmemfun)(a1); });
+		}
+
+		void operator()(arg1_type a1)
+		{
+			for (const auto& slot : slots_)
+			{
+				slot(a1);
+			}
+		}
+
+	private:
+		std::vector<std::function<void(arg1_type)>> slots_;
+	};
+}
+
+#endif  // WEBRTC_BASE_SIGSLOT_H_
@@ -0,0 +1,8 @@
+// Linux test stand-in for the WebRTC header of the same name.
+
+#ifndef WEBRTC_BASE_SOCKET_H_
+#define WEBRTC_BASE_SOCKET_H_
+
+#define SOCKET_ERROR (-1)
+
+#endif  // WEBRTC_BASE_SOCKET_H_
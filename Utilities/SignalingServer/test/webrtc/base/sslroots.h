@@ -0,0 +1,14 @@
+// Linux test stand-in for the WebRTC header of the same name. Its only entry
+// isn't a certificate, so no root is trusted and the tests add their own to
+// the store of the context.
+
+#ifndef WEBRTC_BASE_SSLROOTS_H_
+#define WEBRTC_BASE_SSLROOTS_H_
+
+#include <stddef.h>
+
+static const unsigned char kSSLCertNotACertificate[] = { 0 };
+static const unsigned char* const kSSLCertCertificateList[] = { kSSLCertNotACertificate };
+static const size_t kSSLCertCertificateSizeList[] = { sizeof(kSSLCertNotACertificate) };
+
+#endif  // WEBRTC_BASE_SSLROOTS_H_
@@ -0,0 +1,19 @@
+// Linux test stand-in for the WebRTC header of the same name.
+
+#ifndef WEBRTC_BASE_TIMEUTILS_H_
+#define WEBRTC_BASE_TIMEUTILS_H_
+
+#include <stdint.h>
+
+#include <chrono>
+
+namespace rtc
+{
+	inline int64_t TimeMillis()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+#endif  // WEBRTC_BASE_TIMEUTILS_H_
@@ -0,0 +1,340 @@
+#pragma once
+
+// Unreferenced formal parameters in headers
+#pragma warning(disable : 4100)
+
+#include "pch.h"
+#include "nvUtils.h"
+#include "EncoderCalibrator.h"
+#include <chrono>
+#include <string>
+
+using namespace Toolkit3DLibrary;
+
+// Candidates are listed from the highest to the lowest quality, the first
+// one meeting the latency budget is selected.
+static CalibrationCandidate s_candidates[] =
+{
+	{ "lowLatencyHQ", NV_ENC_PARAMS_RC_CBR_LOWDELAY_HQ },
+	{ "lowLatencyHQ", NV_ENC_PARAMS_RC_CBR },
+	{ "lowLatencyHP", NV_ENC_PARAMS_RC_CBR_LOWDELAY_HQ },
+	{ "lowLatencyHP", NV_ENC_PARAMS_RC_CBR },
+	{ "hp", NV_ENC_PARAMS_RC_CBR }
+};
+
+// Constructor for EncoderCalibrator.
+EncoderCalibrator::EncoderCalibrator(ID3D11Device* device, ID3D11DeviceContext* context) :
+	m_d3dDevice(device),
+	m_d3dContext(context),
+	m_measurementCount(0)
+{
+	memset(m_measurements, 0, sizeof(m_measurements));
+}
+
+// Destructor for EncoderCalibrator.
+EncoderCalibrator::~EncoderCalibrator()
+{
+}
+
+bool EncoderCalibrator::LoadOrCalibrate(
+	const char* cacheFileName,
+	int width,
+	int height,
+	int fps,
+	int bitrate,
+	double latencyBudgetMs,
+	CalibrationResult* result)
+{
+	if (LoadCachedResult(cacheFileName, width, height, fps, bitrate, latencyBudgetMs, result))
+	{
+		return true;
+	}
+
+	if (!Calibrate(width, height, fps, bitrate, latencyBudgetMs, result))
+	{
+		return false;
+	}
+
+	SaveResult(cacheFileName, width, height, fps, bitrate, latencyBudgetMs, result);
+	return true;
+}
+
+bool EncoderCalibrator::LoadCachedResult(
+	const char* cacheFileName,
+	int width,
+	int height,
+	int fps,
+	int bitrate,
+	double latencyBudgetMs,
+	CalibrationResult* result)
+{
+	return EncoderCalibrationCache::Load(cacheFileName, width, height, fps, bitrate, latencyBudgetMs, result);
+}
+
+bool EncoderCalibrator::Calibrate(int width, int height, int fps, int bitrate, double latencyBudgetMs, CalibrationResult* result)
+{
+	const CalibrationResult* selected = nullptr;
+	const CalibrationResult* fastest = nullptr;
+	int candidateCount = sizeof(s_candidates) / sizeof(s_candidates[0]);
+
+	m_measurementCount = 0;
+	for (int i = 0; i < candidateCount && m_measurementCount < CALIBRATION_MAX_CANDIDATES; i++)
+	{
+		CalibrationResult* measurement = &m_measurements[m_measurementCount];
+		if (MeasureCandidate(&s_candidates[i], width, height, fps, bitrate, measurement) != NV_ENC_SUCCESS)
+		{
+			PRINTERR("Failed to measure preset %s\n", s_candidates[i].encoderPreset);
+			continue;
+		}
+
+		// Frames must be encoded both within the budget and fast enough to
+		// sustain the requested frame rate.
+		measurement->withinBudget =
+			measurement->averageLatencyMs <= latencyBudgetMs &&
+			measurement->encodeFps >= fps;
+
+		if (!selected && measurement->withinBudget)
+		{
+			selected = measurement;
+		}
+
+		if (!fastest || measurement->averageLatencyMs < fastest->averageLatencyMs)
+		{
+			fastest = measurement;
+		}
+
+		m_measurementCount++;
+	}
+
+	// Falls back to the lowest latency candidate if none meets the budget.
+	if (!selected)
+	{
+		selected = fastest;
+	}
+
+	if (!selected)
+	{
+		return false;
+	}
+
+	*result = *selected;
+	return true;
+}
+
+void EncoderCalibrator::SaveResult(
+	const char* cacheFileName,
+	int width,
+	int height,
+	int fps,
+	int bitrate,
+	double latencyBudgetMs,
+	const CalibrationResult* result)
+{
+	EncoderCalibrationCache::Save(cacheFileName, width, height, fps, bitrate, latencyBudgetMs,
+		result, m_measurements, m_measurementCount);
+}
+
+int EncoderCalibrator::GetMeasurementCount() const
+{
+	return m_measurementCount;
+}
+
+const CalibrationResult* EncoderCalibrator::GetMeasurements() const
+{
+	return m_measurements;
+}
+
+NVENCSTATUS EncoderCalibrator::MeasureCandidate(
+	const CalibrationCandidate* candidate,
+	int width,
+	int height,
+	int fps,
+	int bitrate,
+	CalibrationResult* result)
+{
+	NVENCSTATUS nvStatus = NV_ENC_SUCCESS;
+	EncodeConfig encodeConfig;
+	EncodeBuffer encodeBuffer;
+	ID3D11Texture2D* texture = nullptr;
+	uint8_t* pixels = nullptr;
+	double totalLatencyMs = 0;
+	double totalBytes = 0;
+	int measuredFrames = 0;
+
+	memset(result, 0, sizeof(CalibrationResult));
+	strncpy(result->encoderPreset, candidate->encoderPreset, sizeof(result->encoderPreset) - 1);
+	result->rcMode = candidate->rcMode;
+	result->bitrate = bitrate;
+
+	memset(&encodeConfig, 0, sizeof(EncodeConfig));
+	encodeConfig.width = width;
+	encodeConfig.height = height;
+	encodeConfig.fps = fps;
+	encodeConfig.bitrate = bitrate;
+	encodeConfig.rcMode = candidate->rcMode;
+	encodeConfig.encoderPreset = candidate->encoderPreset;
+	encodeConfig.codec = NV_ENC_H264;
+	encodeConfig.gopLength = NVENC_INFINITE_GOPLENGTH;
+	encodeConfig.pictureStruct = NV_ENC_PIC_STRUCT_FRAME;
+	encodeConfig.i_quant_factor = DEFAULT_I_QFACTOR;
+	encodeConfig.b_quant_factor = DEFAULT_B_QFACTOR;
+	encodeConfig.i_quant_offset = DEFAULT_I_QOFFSET;
+	encodeConfig.b_quant_offset = DEFAULT_B_QOFFSET;
+	encodeConfig.intraRefreshEnableFlag = true;
+	encodeConfig.intraRefreshPeriod = 30;
+	encodeConfig.intraRefreshDuration = 3;
+	encodeConfig.invalidateRefFramesEnableFlag = true;
+
+	CNvHWEncoder* encoder = new CNvHWEncoder();
+	encoder->m_stEncodeConfig.profileGUID = NV_ENC_H264_PROFILE_MAIN_GUID;
+	nvStatus = encoder->Initialize((void*)m_d3dDevice, NV_ENC_DEVICE_TYPE_DIRECTX);
+	if (nvStatus != NV_ENC_SUCCESS)
+	{
+		delete encoder;
+		return nvStatus;
+	}
+
+	encodeConfig.presetGUID = encoder->GetPresetGUID(encodeConfig.encoderPreset, encodeConfig.codec);
+	encoder->m_stEncodeConfig.encodeCodecConfig.h264Config.level = NV_ENC_LEVEL_H264_41;
+	nvStatus = encoder->CreateEncoder(&encodeConfig);
+	if (nvStatus != NV_ENC_SUCCESS)
+	{
+		encoder->NvEncDestroyEncoder();
+		delete encoder;
+		return nvStatus;
+	}
+
+	// Initializes a single input buffer, backed by ID3D11Texture2D*.
+	memset(&encodeBuffer, 0, sizeof(EncodeBuffer));
+	D3D11_TEXTURE2D_DESC desc = { 0 };
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+	desc.Width = width;
+	desc.Height = height;
+	desc.MipLevels = 1;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	if (FAILED(m_d3dDevice->CreateTexture2D(&desc, nullptr, &texture)))
+	{
+		encoder->NvEncDestroyEncoder();
+		delete encoder;
+		return NV_ENC_ERR_OUT_OF_MEMORY;
+	}
+
+	nvStatus = encoder->NvEncRegisterResource(
+		NV_ENC_INPUT_RESOURCE_TYPE_DIRECTX,
+		(void*)texture,
+		width,
+		height,
+		encodeBuffer.stInputBfr.uARGBStride,
+		&encodeBuffer.stInputBfr.nvRegisteredResource);
+
+	encodeBuffer.stInputBfr.bufferFmt = NV_ENC_BUFFER_FORMAT_ARGB;
+	encodeBuffer.stInputBfr.dwWidth = width;
+	encodeBuffer.stInputBfr.dwHeight = height;
+	encodeBuffer.stInputBfr.pARGBSurface = texture;
+
+	if (nvStatus == NV_ENC_SUCCESS)
+	{
+		nvStatus = encoder->NvEncCreateBitstreamBuffer(BITSTREAM_BUFFER_SIZE, &encodeBuffer.stOutputBfr.hBitstreamBuffer);
+		encodeBuffer.stOutputBfr.dwBitstreamBufferSize = BITSTREAM_BUFFER_SIZE;
+	}
+
+	if (nvStatus == NV_ENC_SUCCESS)
+	{
+		nvStatus = encoder->NvEncRegisterAsyncEvent(&encodeBuffer.stOutputBfr.hOutputEvent);
+		encodeBuffer.stOutputBfr.bWaitOnEvent = true;
+	}
+
+	pixels = new uint8_t[width * height * 4];
+	for (int frame = 0; nvStatus == NV_ENC_SUCCESS && frame < CALIBRATION_WARMUP_FRAMES + CALIBRATION_FRAME_COUNT; frame++)
+	{
+		FillSyntheticFrame(texture, pixels, width, height, frame);
+
+		// Measures from the input resource mapping to the locked output, which
+		// is the part of the pipeline the streaming encoder waits on.
+		auto start = std::chrono::high_resolution_clock::now();
+		nvStatus = encoder->NvEncMapInputResource(encodeBuffer.stInputBfr.nvRegisteredResource, &encodeBuffer.stInputBfr.hInputSurface);
+		if (nvStatus != NV_ENC_SUCCESS)
+		{
+			PRINTERR("Failed to Map input buffer %p\n", encodeBuffer.stInputBfr.hInputSurface);
+			break;
+		}
+
+		nvStatus = encoder->NvEncEncodeFrame(&encodeBuffer, NULL, width, height);
+		if (nvStatus == NV_ENC_SUCCESS)
+		{
+			nvStatus = encoder->ProcessOutput(&encodeBuffer);
+		}
+
+		auto end = std::chrono::high_resolution_clock::now();
+		encoder->NvEncUnmapInputResource(encodeBuffer.stInputBfr.hInputSurface);
+		encodeBuffer.stInputBfr.hInputSurface = NULL;
+
+		// Skips the first frames, which include the IDR and driver spin up.
+		if (nvStatus == NV_ENC_SUCCESS && frame >= CALIBRATION_WARMUP_FRAMES)
+		{
+			double latencyMs = std::chrono::duration<double, std::milli>(end - start).count();
+			totalLatencyMs += latencyMs;
+			totalBytes += encoder->GetLockBitStream().bitstreamSizeInBytes;
+			result->maxLatencyMs = max(result->maxLatencyMs, latencyMs);
+			measuredFrames++;
+		}
+	}
+
+	if (measuredFrames > 0)
+	{
+		result->averageLatencyMs = totalLatencyMs / measuredFrames;
+		result->averageFrameBytes = totalBytes / measuredFrames;
+		result->encodeFps = totalLatencyMs > 0 ? measuredFrames * 1000.0 / totalLatencyMs : 0;
+	}
+
+	// Cleanup resources.
+	delete[] pixels;
+	if (encodeBuffer.stOutputBfr.hOutputEvent)
+	{
+		encoder->NvEncUnregisterAsyncEvent(encodeBuffer.stOutputBfr.hOutputEvent);
+		CloseHandle(encodeBuffer.stOutputBfr.hOutputEvent);
+	}
+
+	if (encodeBuffer.stOutputBfr.hBitstreamBuffer)
+	{
+		encoder->NvEncDestroyBitstreamBuffer(encodeBuffer.stOutputBfr.hBitstreamBuffer);
+	}
+
+	if (encodeBuffer.stInputBfr.nvRegisteredResource)
+	{
+		encoder->NvEncUnregisterResource(encodeBuffer.stInputBfr.nvRegisteredResource);
+	}
+
+	SAFE_RELEASE(texture);
+	encoder->NvEncDestroyEncoder();
+	delete encoder;
+
+	return measuredFrames > 0 ? NV_ENC_SUCCESS : NV_ENC_ERR_GENERIC;
+}
+
+// Fills the texture with scrolling bars and a moving block, which gives the
+// encoder both static and moving content to work with.
+void EncoderCalibrator::FillSyntheticFrame(ID3D11Texture2D* texture, uint8_t* pixels, int width, int height, int frameIndex)
+{
+	int blockSize = height / 4;
+	int blockX = (frameIndex * 8) % (width - blockSize);
+	int blockY = (frameIndex * 4) % (height - blockSize);
+
+	for (int y = 0; y < height; y++)
+	{
+		uint8_t* row = pixels + y * width * 4;
+		for (int x = 0; x < width; x++)
+		{
+			bool inBlock = x >= blockX && x < blockX + blockSize && y >= blockY && y < blockY + blockSize;
+			uint8_t bar = (uint8_t)(((x + frameIndex * 2) / 32) * 40);
+			row[x * 4 + 0] = inBlock ? 255 : bar;
+			row[x * 4 + 1] = inBlock ? (uint8_t)(frameIndex * 3) : (uint8_t)(y * 255 / height);
+			row[x * 4 + 2] = inBlock ? 32 : (uint8_t)(255 - bar);
+			row[x * 4 + 3] = 255;
+		}
+	}
+
+	m_d3dContext->UpdateSubresource(texture, 0, nullptr, pixels, width * 4, 0);
+}
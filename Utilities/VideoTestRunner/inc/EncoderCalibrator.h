@@ -0,0 +1,81 @@
+#pragma once
+
+#include <d3d11.h>
+#include "pch.h"
+#include "nvEncodeAPI.h"
+#include "nvCPUOPSys.h"
+#include "NvHWEncoder.h"
+#include "EncoderCalibrationCache.h"
+
+#define CALIBRATION_FRAME_COUNT		120
+#define CALIBRATION_WARMUP_FRAMES	10
+#define CALIBRATION_MAX_CANDIDATES	8
+
+namespace Toolkit3DLibrary
+{
+	// A preset and rate control mode pair to be measured.
+	typedef struct _CalibrationCandidate
+	{
+		char* encoderPreset;
+		int rcMode;
+	} CalibrationCandidate;
+
+	// Encodes a short synthetic clip with a set of candidate presets and picks
+	// the highest quality candidate that meets the latency budget. The choice is
+	// cached per host and resolution so that later starts skip calibration.
+	class EncoderCalibrator
+	{
+	public:
+		EncoderCalibrator(ID3D11Device* device, ID3D11DeviceContext* context);
+		~EncoderCalibrator();
+
+		// Returns the cached result for these settings on this host, or
+		// calibrates and caches.
+		bool									LoadOrCalibrate(
+													const char* cacheFileName,
+													int width,
+													int height,
+													int fps,
+													int bitrate,
+													double latencyBudgetMs,
+													CalibrationResult* result);
+
+		bool									LoadCachedResult(
+													const char* cacheFileName,
+													int width,
+													int height,
+													int fps,
+													int bitrate,
+													double latencyBudgetMs,
+													CalibrationResult* result);
+
+		bool									Calibrate(int width, int height, int fps, int bitrate, double latencyBudgetMs, CalibrationResult* result);
+		void									SaveResult(
+													const char* cacheFileName,
+													int width,
+													int height,
+													int fps,
+													int bitrate,
+													double latencyBudgetMs,
+													const CalibrationResult* result);
+
+		int										GetMeasurementCount() const;
+		const CalibrationResult*				GetMeasurements() const;
+
+	private:
+		ID3D11Device*							m_d3dDevice;
+		ID3D11DeviceContext*					m_d3dContext;
+		CalibrationResult						m_measurements[CALIBRATION_MAX_CANDIDATES];
+		int										m_measurementCount;
+
+		NVENCSTATUS								MeasureCandidate(
+													const CalibrationCandidate* candidate,
+													int width,
+													int height,
+													int fps,
+													int bitrate,
+													CalibrationResult* result);
+
+		void									FillSyntheticFrame(ID3D11Texture2D* texture, uint8_t* pixels, int width, int height, int frameIndex);
+	};
+}